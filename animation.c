@@ -0,0 +1,191 @@
+/* $Id$
+ * $URL$
+ *
+ * shared clock for animated widgets
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * exported functions:
+ *
+ * int animation_add (void (*callback) (void *data), void *data, const int interval)
+ *   animates a widget: callback(data) is called every 'interval' msec
+ *   from the common animation tick; if the widget is already animated,
+ *   only the interval is changed
+ *
+ * int animation_remove (void (*callback) (void *data), void *data)
+ *   stops animating a widget
+ *
+ * void animation_exit (void)
+ *   stops the animation tick and releases all entries
+ *
+ *
+ * All animated widgets (icons, scrolling text) are advanced from a
+ * single timer, so widgets with related speeds change in the same
+ * tick and their draws end up in the same display frame.
+ * The tick rate is limited by Animation.Maxfps (default 50), which
+ * is also the highest rate any widget is animated with.
+ *
+ */
+
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+#include "cfg.h"
+#include "timer.h"
+#include "animation.h"
+#include "drv.h"
+#include "bench.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+
+/* tick rate if Animation.Maxfps is not set */
+#define DEFAULT_FPS 50
+
+typedef struct ANIMATION {
+    void (*callback) (void *data);	/* NULL: unused slot */
+    void *data;
+    int interval;		/* msec */
+    long next;			/* clock value of the next step */
+    int display;		/* display the widget belongs to */
+} ANIMATION;
+
+static ANIMATION *Animations = NULL;
+static int nAnimations = 0;
+
+static int Tick = 0;		/* msec per tick, 0 = timer not running */
+static long Clock = 0;		/* msec since the first animation */
+
+
+static void animation_tick( __attribute__ ((unused))
+			   void *notused)
+{
+    int i;
+
+    Clock += Tick;
+
+    /* slots may be added or removed by the callbacks, so use indices */
+    for (i = 0; i < nAnimations; i++) {
+	ANIMATION *A = &Animations[i];
+	if (A->callback == NULL || A->next > Clock)
+	    continue;
+	/* a late step does not cause a burst of steps */
+	A->next += A->interval;
+	if (A->next <= Clock)
+	    A->next = Clock + A->interval;
+	drv_select(A->display);
+	BENCH_BEGIN(BENCH_UPDATE);
+	A->callback(A->data);
+	BENCH_END(BENCH_UPDATE);
+    }
+}
+
+
+static int animation_start(void)
+{
+    int fps;
+
+    cfg_number("Animation", "Maxfps", DEFAULT_FPS, 1, 1000, &fps);
+    Tick = 1000 / fps;
+    Clock = 0;
+
+    return timer_add(animation_tick, NULL, Tick, 0);
+}
+
+
+int animation_add(void (*callback) (void *data), void *data, const int interval)
+{
+    ANIMATION *A = NULL;
+    int i;
+
+    if (Tick == 0 && animation_start() < 0) {
+	Tick = 0;
+	return -1;
+    }
+
+    for (i = 0; i < nAnimations; i++) {
+	if (Animations[i].callback == callback && Animations[i].data == data) {
+	    /* already animated: the next step is not moved */
+	    Animations[i].interval = interval < Tick ? Tick : interval;
+	    return 0;
+	}
+	if (A == NULL && Animations[i].callback == NULL)
+	    A = &Animations[i];
+    }
+
+    if (A == NULL) {
+	ANIMATION *tmp = realloc(Animations, (nAnimations + 1) * sizeof(ANIMATION));
+	if (tmp == NULL) {
+	    error("animation: realloc() failed");
+	    return -1;
+	}
+	Animations = tmp;
+	A = &Animations[nAnimations++];
+    }
+
+    A->callback = callback;
+    A->data = data;
+    A->interval = interval < Tick ? Tick : interval;
+    A->next = Clock + A->interval;
+    A->display = drv_current();
+
+    return 0;
+}
+
+
+int animation_remove(void (*callback) (void *data), void *data)
+{
+    int i;
+
+    for (i = 0; i < nAnimations; i++) {
+	if (Animations[i].callback == callback && Animations[i].data == data) {
+	    /* keep the slot, the tick may be iterating */
+	    Animations[i].callback = NULL;
+	    Animations[i].data = NULL;
+	    return 0;
+	}
+    }
+
+    return -1;
+}
+
+
+void animation_exit(void)
+{
+    if (Tick > 0) {
+	timer_remove(animation_tick, NULL);
+	Tick = 0;
+    }
+
+    if (Animations) {
+	free(Animations);
+	Animations = NULL;
+    }
+    nAnimations = 0;
+}
@@ -0,0 +1,238 @@
+/* $Id$
+ * $URL$
+ *
+ * frame throughput benchmark
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/* 
+ * The benchmark runs the main loop on a simulated clock (see
+ * timer_simulate()), so a layout is evaluated and rendered as fast
+ * as possible for a given number of simulated seconds. Time spent in
+ * each stage is measured exclusively: a nested stage (e.g. Eval()
+ * called from a widget update) pauses the enclosing one.
+ *
+ * Stages reuse the timestamps of the STATS slots of the same code
+ * path (see STATS_BENCH_BEGIN in bench.h), so an instrumented site
+ * reads the clock once on entry and once on exit, benchmark or not.
+ *
+ * exported functions:
+ *
+ * void bench_startup (void)
+ *   marks the start of the initialization (plugins, drivers,
+ *   layouts), its duration and heap growth are reported as well
+ *
+ * Memory is reported as the bytes in use on the heap (mallinfo),
+ * which shows leaks and growing buffers; the number of malloc()
+ * calls is not counted.
+ *
+ * void bench_init (int seconds)
+ *   starts a benchmark over the given number of simulated seconds
+ *
+ * int bench_done (void)
+ *   returns 1 if the simulated time is over
+ *
+ * void bench_begin (BENCH_STAGE stage, STATS_TIME now)
+ * void bench_end (BENCH_STAGE stage, STATS_TIME now)
+ *   enter and leave a stage at a stats_now() timestamp (use the
+ *   BENCH_BEGIN/BENCH_END or STATS_BENCH_BEGIN/STATS_BENCH_END macros)
+ *
+ * void bench_count (BENCH_COUNTER counter, long n)
+ *   adds to a counter (use the STATS_BENCH_COUNT macro)
+ *
+ * void bench_report (void)
+ *   prints the results to stdout
+ *
+ */
+
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "debug.h"
+#include "timer.h"
+#include "bench.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+/* maximum nesting of stages */
+#define BENCH_DEPTH 16
+
+int bench_active = 0;
+
+static char *StageName[BENCH_STAGES] = { "timer", "event", "update", "eval", "procfs", "draw", "blit" };
+
+static int Seconds;
+static struct timespec Start;
+static STATS_TIME Mark;
+static double Time[BENCH_STAGES];
+static long Calls[BENCH_STAGES];
+static long Counter[BENCH_COUNTERS];
+
+static BENCH_STAGE Stack[BENCH_DEPTH];
+static int Depth = 0;
+static long Overflow = 0;		/* frames nested deeper than BENCH_DEPTH */
+
+static size_t Heap;
+
+static struct timespec Startup;
+static size_t StartupHeap;
+static double StartupTime = -1.0;
+
+
+static double bench_elapsed(const struct timespec *from, const struct timespec *to)
+{
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+
+static size_t bench_heap(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+    return (unsigned int) mallinfo().uordblks;
+#else
+    return 0;
+#endif
+}
+
+
+void bench_startup(void)
+{
+    StartupHeap = bench_heap();
+    clock_gettime(CLOCK_MONOTONIC, &Startup);
+}
+
+
+void bench_init(const int seconds)
+{
+    Seconds = seconds;
+    memset(Time, 0, sizeof(Time));
+    memset(Calls, 0, sizeof(Calls));
+    memset(Counter, 0, sizeof(Counter));
+    Depth = 0;
+    Overflow = 0;
+
+    timer_simulate();
+    Heap = bench_heap();
+    clock_gettime(CLOCK_MONOTONIC, &Start);
+    Mark = stats_now();
+
+    if (Startup.tv_sec || Startup.tv_nsec)
+	StartupTime = bench_elapsed(&Startup, &Start);
+
+    bench_active = 1;
+}
+
+
+int bench_done(void)
+{
+    return timer_simulated() >= Seconds * 1000;
+}
+
+
+void bench_begin(const BENCH_STAGE stage, const STATS_TIME now)
+{
+    /* too deep: this frame is not timed, its time stays */
+    /* with the innermost stage on the stack */
+    if (Depth >= BENCH_DEPTH) {
+	Overflow++;
+	Depth++;
+	return;
+    }
+
+    /* charge the time so far to the enclosing stage */
+    if (Depth > 0)
+	Time[Stack[Depth - 1]] += (now - Mark) / 1e9;
+    Stack[Depth++] = stage;
+
+    Mark = now;
+}
+
+
+void bench_end(const BENCH_STAGE stage, const STATS_TIME now)
+{
+    if (Depth <= 0)
+	return;
+
+    /* leaving a frame bench_begin() did not time */
+    if (Depth > BENCH_DEPTH) {
+	Depth--;
+	return;
+    }
+
+    Time[stage] += (now - Mark) / 1e9;
+    Calls[stage]++;
+    Depth--;
+
+    Mark = now;
+}
+
+
+void bench_count(const BENCH_COUNTER counter, const long n)
+{
+    Counter[counter] += n;
+}
+
+
+void bench_report(void)
+{
+    struct timespec now;
+    double total, simulated;
+    long frames;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    bench_active = 0;
+
+    total = bench_elapsed(&Start, &now);
+    simulated = timer_simulated() / 1000.0;
+    frames = Calls[BENCH_TIMER];
+
+    if (StartupTime >= 0.0)
+	printf("startup: %.3f ms, heap growth %+ld bytes\n", StartupTime * 1e3, (long) (Heap - StartupHeap));
+    printf("benchmark: %.3f s simulated in %.3f s (%.1fx realtime), %ld loop iterations\n",
+	   simulated, total, total > 0.0 ? simulated / total : 0.0, frames);
+    printf("%-8s %10s %12s %10s %8s\n", "stage", "calls", "total ms", "avg us", "share");
+    for (i = 0; i < BENCH_STAGES; i++) {
+	printf("%-8s %10ld %12.3f %10.3f %7.1f%%\n", StageName[i], Calls[i], Time[i] * 1e3,
+	       Calls[i] ? Time[i] * 1e6 / Calls[i] : 0.0, total > 0.0 ? 100.0 * Time[i] / total : 0.0);
+    }
+    printf("blitted: %ld chars/pixels, sent: %ld bytes", Counter[BENCH_BLITTED], Counter[BENCH_SENT]);
+    if (simulated > 0.0)
+	printf(" (%.1f bytes per simulated second)", Counter[BENCH_SENT] / simulated);
+    printf("\n");
+    if (Overflow)
+	printf("%ld stages nested deeper than %d were not timed separately\n", Overflow, BENCH_DEPTH);
+    printf("heap bytes in use (not a count of allocations): %ld at start, growth %+ld\n", (long) Heap,
+	   (long) (bench_heap() - Heap));
+}
@@ -0,0 +1,78 @@
+/* $Id$
+ * $URL$
+ *
+ * frame throughput benchmark
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include "stats.h"
+
+typedef enum {
+    BENCH_TIMER,		/* timer queue processing */
+    BENCH_EVENT,		/* event (file descriptor) processing */
+    BENCH_UPDATE,		/* widget update callbacks */
+    BENCH_EVAL,			/* expression evaluation */
+    BENCH_PROCFS,		/* reading /proc files */
+    BENCH_DRAW,			/* widget rendering into the framebuffer */
+    BENCH_BLIT,			/* transfer to the display */
+    BENCH_STAGES
+} BENCH_STAGE;
+
+typedef enum {
+    BENCH_BLITTED,		/* characters or pixels handed to the driver */
+    BENCH_SENT,			/* bytes written to the device */
+    BENCH_COUNTERS
+} BENCH_COUNTER;
+
+extern int bench_active;
+
+/* a stage which has no STATS slot of its own */
+#define BENCH_BEGIN(stage) do { if (bench_active) bench_begin(stage, stats_now()); } while (0)
+#define BENCH_END(stage) do { if (bench_active) bench_end(stage, stats_now()); } while (0)
+
+/* a STATS slot which is a benchmark stage as well: one clock read on each side */
+#define STATS_BENCH_BEGIN(t, stage) do { \
+    STATS_BEGIN(t); \
+    if (bench_active) bench_begin(stage, t); \
+} while (0)
+#define STATS_BENCH_END(id, t, stage) do { \
+    STATS_TIME _now = stats_now(); \
+    if ((id) >= 0) stats_time(id, _now - (t)); \
+    if (bench_active) bench_end(stage, _now); \
+} while (0)
+#define STATS_BENCH_COUNT(id, counter, n) do { \
+    stats_count(id, n); \
+    if (bench_active) bench_count(counter, n); \
+} while (0)
+
+void bench_startup(void);
+void bench_init(const int seconds);
+int bench_done(void);
+void bench_begin(const BENCH_STAGE stage, const STATS_TIME now);
+void bench_end(const BENCH_STAGE stage, const STATS_TIME now);
+void bench_count(const BENCH_COUNTER counter, const long n);
+void bench_report(void);
+
+#endif
@@ -0,0 +1,231 @@
+/* $Id$
+ * $URL$
+ *
+ * D-Bus connection integration into the main loop
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/* 
+ * exported functions:
+ *
+ * int dbus_event_add (DBusConnection *conn)
+ *  hooks the watches and timeouts of a connection into
+ *  event.c and timer.c, so incoming messages are dispatched
+ *  from the main loop instead of being polled for.
+ *  Connections are reference counted, because plugin_dbus and
+ *  plugin_mpris_dbus share the session bus connection
+ *
+ * void dbus_event_del (DBusConnection *conn)
+ *  removes the hooks again when the last user is gone
+ *
+ */
+
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "debug.h"
+#include "timer.h"
+#include "event.h"
+#include "dbus_event.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+/* configure only defines the DBUS_VERSION_* macros for the dbus plugin */
+#ifndef DBUS_VERSION_MAJOR
+#define DBUS_VERSION_MAJOR DBUS_MAJOR_VERSION
+#define DBUS_VERSION_MINOR DBUS_MINOR_VERSION
+#define DBUS_VERSION_MICRO DBUS_MICRO_VERSION
+#endif
+
+#if (DBUS_VERSION_MAJOR == 1 && DBUS_VERSION_MINOR == 1 && DBUS_VERSION_MICRO >= 1) || (DBUS_VERSION_MAJOR == 1 && DBUS_VERSION_MINOR > 1) || (DBUS_VERSION_MAJOR > 1)
+#define WATCH_FD(w) dbus_watch_get_unix_fd(w)
+#else
+#define WATCH_FD(w) dbus_watch_get_fd(w)
+#endif
+
+/* session and system bus, there will hardly be more */
+#define MAX_CONNECTIONS 4
+
+static DBusConnection *Connection[MAX_CONNECTIONS];
+static int Users[MAX_CONNECTIONS];
+static int nConnection = 0;
+
+
+static void dbus_event_dispatch(void)
+{
+    int i;
+
+    for (i = 0; i < nConnection; i++) {
+	while (dbus_connection_get_dispatch_status(Connection[i]) == DBUS_DISPATCH_DATA_REMAINS) {
+	    dbus_connection_dispatch(Connection[i]);
+	}
+    }
+}
+
+
+static void dbus_event_watch(event_flags_t f, void *data)
+{
+    DBusWatch *w = (DBusWatch *) data;
+    unsigned int flags = 0;
+
+    /* convert the flags */
+    flags |= (f & EVENT_READ) ? DBUS_WATCH_READABLE : 0;
+    flags |= (f & EVENT_WRITE) ? DBUS_WATCH_WRITABLE : 0;
+    flags |= (f & EVENT_HUP) ? DBUS_WATCH_HANGUP : 0;
+    flags |= (f & EVENT_ERR) ? DBUS_WATCH_ERROR : 0;
+
+    if (!dbus_watch_handle(w, flags)) {
+	info("[DBus] dbus_watch_handle(): Not enough memory!");
+    }
+    dbus_event_dispatch();
+}
+
+
+static dbus_bool_t dbus_event_add_watch(DBusWatch * w, void *data)
+{
+    int flags = dbus_watch_get_flags(w);
+
+    (void) data;
+    event_add(dbus_event_watch, w, WATCH_FD(w), flags & DBUS_WATCH_READABLE, flags & DBUS_WATCH_WRITABLE,
+	      dbus_watch_get_enabled(w));
+    return TRUE;
+}
+
+
+static void dbus_event_remove_watch(DBusWatch * w, void *data)
+{
+    (void) data;
+    event_del(WATCH_FD(w));
+}
+
+
+static void dbus_event_toggle_watch(DBusWatch * w, void *data)
+{
+    int flags = dbus_watch_get_flags(w);
+
+    (void) data;
+    event_modify(WATCH_FD(w), flags & DBUS_WATCH_READABLE, flags & DBUS_WATCH_WRITABLE, dbus_watch_get_enabled(w));
+}
+
+
+static void dbus_event_timeout(void *data)
+{
+    DBusTimeout *t = (DBusTimeout *) data;
+
+    if (!dbus_timeout_handle(t)) {
+	info("[DBus] Not enough memory to handle timeout!");
+    }
+    dbus_event_dispatch();
+}
+
+
+static dbus_bool_t dbus_event_add_timeout(DBusTimeout * t, void *data)
+{
+    (void) data;
+
+    /* disabled timeouts must not fire */
+    if (!dbus_timeout_get_enabled(t))
+	return TRUE;
+
+    if (timer_add_late(dbus_event_timeout, t, dbus_timeout_get_interval(t), 0) < 0) {
+	return FALSE;
+    }
+    return TRUE;
+}
+
+
+static void dbus_event_remove_timeout(DBusTimeout * t, void *data)
+{
+    (void) data;
+    timer_remove(dbus_event_timeout, t);
+}
+
+
+static void dbus_event_toggle_timeout(DBusTimeout * t, void *data)
+{
+    dbus_event_remove_timeout(t, data);
+    dbus_event_add_timeout(t, data);
+}
+
+
+int dbus_event_add(DBusConnection * conn)
+{
+    int i;
+
+    for (i = 0; i < nConnection; i++) {
+	if (Connection[i] == conn) {
+	    Users[i]++;
+	    return 0;
+	}
+    }
+
+    if (nConnection >= MAX_CONNECTIONS) {
+	error("[DBus] too many connections (max %d)", MAX_CONNECTIONS);
+	return -1;
+    }
+
+    if (!dbus_connection_set_watch_functions
+	(conn, dbus_event_add_watch, dbus_event_remove_watch, dbus_event_toggle_watch, NULL, NULL)) {
+	error("[DBus] dbus_connection_set_watch_functions(): Not enough memory!");
+	return -1;
+    }
+    if (!dbus_connection_set_timeout_functions
+	(conn, dbus_event_add_timeout, dbus_event_remove_timeout, dbus_event_toggle_timeout, NULL, NULL)) {
+	error("[DBus] dbus_connection_set_timeout_functions(): Not enough memory!");
+	dbus_connection_set_watch_functions(conn, NULL, NULL, NULL, NULL, NULL);
+	return -1;
+    }
+
+    Connection[nConnection] = conn;
+    Users[nConnection] = 1;
+    nConnection++;
+
+    /* messages may have been queued before we were hooked in */
+    dbus_event_dispatch();
+
+    return 0;
+}
+
+
+void dbus_event_del(DBusConnection * conn)
+{
+    int i;
+
+    for (i = 0; i < nConnection; i++) {
+	if (Connection[i] == conn)
+	    break;
+    }
+    if (i == nConnection || --Users[i] > 0)
+	return;
+
+    /* removing the functions calls remove_watch/remove_timeout for every hook */
+    dbus_connection_set_watch_functions(conn, NULL, NULL, NULL, NULL, NULL);
+    dbus_connection_set_timeout_functions(conn, NULL, NULL, NULL, NULL, NULL);
+
+    nConnection--;
+    Connection[i] = Connection[nConnection];
+    Users[i] = Users[nConnection];
+}
@@ -34,6 +34,18 @@
  *   this function should not be called directly,
  *   but the macros info(), debug() and error()
  *
+ * message_buffering (on)
+ *   while buffering is on, message() only queues the
+ *   message in a ring buffer, which is written by
+ *   message_flush() from the main loop. Repeated info
+ *   and debug messages are folded and their rate is
+ *   limited; errors are always passed through, the last
+ *   slots of the ring are reserved for them.
+ *
+ * message_flush (void)
+ *   writes all queued messages and pending notices
+ *   about folded or suppressed ones
+ *
  */
 
 #include "config.h"
@@ -41,35 +53,86 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 #include <syslog.h>
+#include <time.h>
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #include "debug.h"
+#include "stats.h"
 
 int running_foreground = 0;
 int running_background = 0;
 
 int verbose_level = 0;
 
-void message(const int level, const char *format, ...)
-{
-    va_list ap;
-    char buffer[256];
-    static int log_open = 0;
+/* ring buffer size, must be a power of two */
+#define MESSAGE_RING 256
+#define MESSAGE_SIZE 256
 
-    if (level > verbose_level)
-	return;
+/* the last slots of the ring are kept for errors */
+#define MESSAGE_RESERVE 32
 
-    va_start(ap, format);
-    vsnprintf(buffer, sizeof(buffer), format, ap);
-    va_end(ap);
+/* more messages per second are dropped */
+#define MESSAGE_RATE 50
+
+/* report repeated messages at least this often (seconds) */
+#define MESSAGE_REPEAT 10
+
+typedef struct {
+    volatile int ready;
+    int level;
+    char text[MESSAGE_SIZE];
+} MESSAGE;
+
+static MESSAGE Ring[MESSAGE_RING];
+static volatile unsigned int Head = 0;	/* next slot to fill */
+static volatile unsigned int Tail = 0;	/* next slot to write */
+static int Buffering = 0;
+
+/* message() is called from the output threads, too: slots of the */
+/* ring are reserved without a lock, Lock protects the repetition */
+/* and rate limit state only */
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK() pthread_mutex_lock(&Lock)
+#define UNLOCK() pthread_mutex_unlock(&Lock)
+#else
+#define LOCK() do { } while (0)
+#define UNLOCK() do { } while (0)
+#endif
+
+/* the last message, for suppressing repetitions */
+static char Last[MESSAGE_SIZE];
+static int LastLevel = -1;
+static unsigned int Repeated = 0;
+static time_t RepeatedSince;
+
+/* rate limit */
+static time_t Second;
+static unsigned int Rate = 0;
+
+/* counters */
+static volatile unsigned int Dropped = 0;	/* ring buffer full */
+static unsigned int Limited = 0;	/* over the rate limit */
+static unsigned int DroppedReported = 0;
+static int StatsDropped = -1, StatsLimited = -1, StatsRepeated = -1;
+
+
+static void message_write(const int level, const char *text)
+{
+    static int log_open = 0;
 
     if (!running_background) {
 
 #ifdef WITH_CURSES
 	extern int curses_error(char *);
-	if (!curses_error(buffer))
+	if (!curses_error((char *) text))
 #endif
-	    fprintf(level ? stdout : stderr, "%s\n", buffer);
+	    fprintf(level ? stdout : stderr, "%s\n", text);
     }
 
     if (running_foreground)
@@ -82,12 +145,214 @@ void message(const int level, const char *format, ...)
 
     switch (level) {
     case 0:
-	syslog(LOG_ERR, "%s", buffer);
+	syslog(LOG_ERR, "%s", text);
 	break;
     case 1:
-	syslog(LOG_INFO, "%s", buffer);
+	syslog(LOG_INFO, "%s", text);
 	break;
     default:
-	syslog(LOG_DEBUG, "%s", buffer);
+	syslog(LOG_DEBUG, "%s", text);
+    }
+}
+
+
+/* queue a message, or write it right away if we are not buffering */
+static void message_queue(const int level, const char *text)
+{
+    unsigned int head;
+    MESSAGE *M;
+
+    if (!Buffering) {
+	message_write(level, text);
+	return;
+    }
+
+    /* reserve a slot, drop the message if there is none; */
+    /* errors may use the reserve, and are written right away */
+    /* (ahead of the queued ones) if even that is full */
+    do {
+	head = Head;
+	if (head - Tail >= (level == 0 ? MESSAGE_RING : MESSAGE_RING - MESSAGE_RESERVE)) {
+	    if (level == 0) {
+		message_write(level, text);
+		return;
+	    }
+	    __sync_fetch_and_add(&Dropped, 1);
+	    return;
+	}
+    } while (!__sync_bool_compare_and_swap(&Head, head, head + 1));
+
+    M = &Ring[head & (MESSAGE_RING - 1)];
+    M->level = level;
+    strncpy(M->text, text, sizeof(M->text) - 1);
+    M->text[sizeof(M->text) - 1] = '\0';
+
+    /* publish the slot */
+    __sync_synchronize();
+    M->ready = 1;
+}
+
+
+/* notice about folded repetitions of the last message (Lock held) */
+/* returns its level, or -1 if there is none */
+static int message_repeated(char *buffer, const size_t size)
+{
+    if (Repeated == 0)
+	return -1;
+
+    snprintf(buffer, size, "last message repeated %u time%s", Repeated, Repeated > 1 ? "s" : "");
+    if (StatsRepeated >= 0)
+	stats_count(StatsRepeated, Repeated);
+    Repeated = 0;
+    return LastLevel;
+}
+
+
+/* notice about messages over the rate limit (Lock held) */
+/* returns its level, or -1 if there is none */
+static int message_limited(char *buffer, const size_t size)
+{
+    if (Limited == 0)
+	return -1;
+
+    snprintf(buffer, size, "%u messages suppressed (more than %d per second)", Limited, MESSAGE_RATE);
+    Limited = 0;
+    return 1;
+}
+
+
+void message(const int level, const char *format, ...)
+{
+    va_list ap;
+    char buffer[MESSAGE_SIZE];
+    char repeated[64], limited[64];
+    int repeated_level = -1, limited_level = -1, queue = 1;
+    time_t now;
+
+    if (level > verbose_level)
+	return;
+
+    va_start(ap, format);
+    vsnprintf(buffer, sizeof(buffer), format, ap);
+    va_end(ap);
+
+    LOCK();
+
+    if (level == 0 || !Buffering) {
+	/* errors are never folded nor limited, and nothing */
+	/* is limited unless the main loop writes the messages */
+	repeated_level = message_repeated(repeated, sizeof(repeated));
+	LastLevel = -1;
+    } else {
+	now = time(NULL);
+	if (level == LastLevel && strcmp(buffer, Last) == 0) {
+	    /* the same message again: only count it */
+	    if (Repeated++ == 0)
+		RepeatedSince = now;
+	    queue = 0;
+	} else {
+	    repeated_level = message_repeated(repeated, sizeof(repeated));
+	    strcpy(Last, buffer);
+	    LastLevel = level;
+
+	    /* rate limit */
+	    if (now != Second) {
+		limited_level = message_limited(limited, sizeof(limited));
+		Second = now;
+		Rate = 0;
+	    }
+	    if (++Rate > MESSAGE_RATE) {
+		Limited++;
+		if (StatsLimited >= 0)
+		    stats_count(StatsLimited, 1);
+		queue = 0;
+	    }
+	}
     }
+
+    UNLOCK();
+
+    /* the ring needs no lock */
+    if (repeated_level >= 0)
+	message_queue(repeated_level, repeated);
+    if (limited_level >= 0)
+	message_queue(limited_level, limited);
+    if (queue)
+	message_queue(level, buffer);
+}
+
+
+/* write the queued messages, and the notices if they are due */
+static void message_drain(const int force)
+{
+    char repeated[64], limited[64];
+    int repeated_level = -1, limited_level = -1;
+    unsigned int dropped;
+    time_t now = time(NULL);
+
+    LOCK();
+    /* long runs of the same message are reported from time to time */
+    if (Repeated && (force || now - RepeatedSince >= MESSAGE_REPEAT))
+	repeated_level = message_repeated(repeated, sizeof(repeated));
+    /* suppressed messages once their second is over */
+    if (Limited && (force || now != Second))
+	limited_level = message_limited(limited, sizeof(limited));
+    UNLOCK();
+
+    if (repeated_level >= 0)
+	message_queue(repeated_level, repeated);
+    if (limited_level >= 0)
+	message_queue(limited_level, limited);
+
+    while (Tail != Head) {
+	MESSAGE *M = &Ring[Tail & (MESSAGE_RING - 1)];
+	if (!M->ready)
+	    break;
+	message_write(M->level, M->text);
+	M->ready = 0;
+	__sync_synchronize();
+	Tail++;
+    }
+
+    dropped = Dropped;
+    if (dropped != DroppedReported) {
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%u log messages dropped (buffer full)", dropped - DroppedReported);
+	if (StatsDropped >= 0)
+	    stats_count(StatsDropped, dropped - DroppedReported);
+	DroppedReported = dropped;
+	message_write(1, buffer);
+    }
+}
+
+
+static void message_exit(void)
+{
+    message_drain(1);
+}
+
+
+void message_buffering(const int on)
+{
+    static int registered = 0;
+
+    if (on && !registered) {
+	/* messages still queued when somebody calls exit() */
+	atexit(message_exit);
+	StatsDropped = stats_register("log", "dropped");
+	StatsLimited = stats_register("log", "limited");
+	StatsRepeated = stats_register("log", "repeated");
+	registered = 1;
+    }
+
+    if (!on)
+	message_drain(1);
+
+    Buffering = on;
+}
+
+
+void message_flush(void)
+{
+    message_drain(0);
 }
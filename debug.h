@@ -32,8 +32,18 @@ extern int running_background;
 extern int verbose_level;
 
 void message(const int level, const char *format, ...) __attribute__ ((format(__printf__, 2, 3)));
+void message_buffering(const int on);
+void message_flush(void);
 
-#define debug(args...) message (2, __FILE__ ": " args)
+/* compile with -DWITHOUT_DEBUG to drop debug messages completely */
+#ifdef WITHOUT_DEBUG
+#define DEBUG_MESSAGES 0
+#else
+#define DEBUG_MESSAGES 1
+#endif
+
+/* arguments of a debug message are not even evaluated unless they are shown */
+#define debug(args...) do { if (DEBUG_MESSAGES && verbose_level >= 2) message (2, __FILE__ ": " args); } while (0)
 #define info(args...)  message (1, args)
 #define error(args...) message (0, args)
 
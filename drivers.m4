@@ -38,7 +38,7 @@ AC_ARG_WITH(
   [                        LW_ABP, M50530, MatrixOrbital, MatrixOrbitalGX, MilfordInstruments, MDM166A,]
   [                        Newhaven, Noritake, NULL, Pertelian, PHAnderson,]
   [                        PICGraphic, picoLCD, picoLCDGraphic, PNG, PPM, RouterBoard,]
-  [                        Sample, SamsungSPF, serdisplib, ShuttleVFD, SimpleLCD, st2205, T6963,]
+  [                        Sample, SamsungSPF, serdisplib, Shm, ShuttleVFD, SimpleLCD, st2205, T6963,]
   [                        TeakLCM, Trefon, ULA200, USBHUB, USBLCD, VNC, WincorNixdorf, X11],
   drivers=$withval,
   drivers=all
@@ -104,6 +104,7 @@ for driver in $drivers; do
          SAMSUNGSPF="yes"
          ST2205="yes"
 	 SERDISPLIB="yes"
+         SHM="yes"
 	 SHUTTLEVFD="yes"
          SIMPLELCD="yes"
          T6963="yes"
@@ -245,6 +246,9 @@ for driver in $drivers; do
       serdisplib)
          SERDISPLIB=$val;
          ;;
+      Shm)
+         SHM=$val
+         ;;
       ShuttleVFD) 
 	 SHUTTLEVFD=$val
 	 ;;          
@@ -295,6 +299,7 @@ TEXT="no"
 GRAPHIC="no"
 IMAGE="no"
 GPIO="no"
+HDMODEL="no"
 
 # generiv I/O drivers
 PARPORT="no"
@@ -446,6 +451,7 @@ if test "$HD44780_I2C" = "yes"; then
    TEXT="yes"
    I2C="yes"
    GPIO="yes"
+   HDMODEL="yes"
    DRIVERS="$DRIVERS drv_HD44780.o"
    AC_DEFINE(WITH_HD44780,1,[HD44780 driver])
 fi
@@ -457,6 +463,7 @@ if test "$HD44780" = "yes"; then
          PARPORT="yes"
          I2C="yes"
          GPIO="yes"
+         HDMODEL="yes"
          KEYPAD="yes"
          DRIVERS="$DRIVERS drv_HD44780.o"
          AC_DEFINE(WITH_HD44780,1,[HD44780 driver])
@@ -747,6 +754,13 @@ if test "$SERDISPLIB" = "yes"; then
    fi
 fi
 
+if test "$SHM" = "yes"; then
+   GRAPHIC="yes"
+   DRIVERS="$DRIVERS drv_Shm.o"
+   DRVLIBS="$DRVLIBS -lrt"
+   AC_DEFINE(WITH_SHM,1,[Shm driver])
+fi
+
 if test "$SHUTTLEVFD" = "yes"; then 
    if test "$has_usb" = "true"; then 
       TEXT="yes" 
@@ -871,6 +885,9 @@ if test "$X11" = "yes"; then
       else
         DRVLIBS="$DRVLIBS -L$ac_x_libraries -lX11"
       fi
+      if test "$has_xshm" = "true"; then
+        DRVLIBS="$DRVLIBS -lXext"
+      fi
       CPP_FLAGS="$CPPFLAGS $X_CFLAGS"
       AC_DEFINE(WITH_X11, 1, [X11 driver])
    fi
@@ -908,6 +925,11 @@ if test "$GPIO" = "yes"; then
    DRIVERS="$DRIVERS drv_generic_gpio.o"
 fi
 
+# software model of the HD44780 controller
+if test "$HDMODEL" = "yes"; then
+   DRIVERS="$DRIVERS drv_generic_hd44780.o"
+fi
+
 # generic parport driver
 if test "$PARPORT" = "yes"; then
    DRIVERS="$DRIVERS drv_generic_parport.o"
@@ -30,11 +30,59 @@
  * drv_list (void)
  *   lists all available drivers to stdout
  *
- * drv_init (char *driver)
- *    initializes the named driver
+ * drv_init (char *section, char *driver, int quiet)
+ *    adds a display and initializes its driver;
+ *    may be called once for every display
  *
- * int drv_quit (void)
- *    de-initializes the driver
+ * int drv_quit (int quiet)
+ *    de-initializes the drivers of all displays
+ *
+ * int drv_displays (void)
+ *    returns the number of displays
+ *
+ * int drv_current (void)
+ *    returns the selected display, or -1 if there is none
+ *
+ * int drv_select (int display)
+ *    makes a display the selected one, returns the previous one
+ *
+ * void drv_state (void *state, size_t size)
+ *    registers a global variable of a generic driver module,
+ *    which must be kept separately for every display
+ *
+ * int drv_output (int (*flush) (void))
+ *    moves the output of the selected display into a thread of its own
+ *
+ * void drv_output_pending (void)
+ *    wakes up the output thread of the selected display
+ *
+ * int drv_output_preempted (void)
+ *    returns 1 if the main loop wants the displays back
+ *
+ * void drv_idle (int idle)
+ *    called by event_process() right before (1) and after (0) it
+ *    sleeps in poll(), so no timer or event callback ever runs while
+ *    the displays are lent to the output threads
+ *
+ *
+ * Drivers and the generic driver modules keep their state in global
+ * variables. To drive several displays from one process, every piece
+ * of state which may be shared by two displays (generic text/graphic
+ * framebuffers, display size, bus handles) is registered with
+ * drv_state(), and drv_select() swaps these variables when another
+ * display is selected. A driver can be used by one display only.
+ *
+ * Timers, events, evaluator functions and widgets remember the display
+ * which was selected when they were created, and select it again when
+ * they are processed.
+ *
+ * A display may hand its output to a thread of its own (drv_output), so
+ * slow hardware does not hold up the main loop. The driver state is not
+ * protected piece by piece: the main loop owns all displays while it is
+ * busy, and lends them to the output threads only while it sleeps
+ * (drv_idle). An output thread selects its display, calls flush(), and
+ * gives the displays back as soon as drv_output_preempted() tells it
+ * the main loop woke up. flush() returns 1 if it did not finish.
  */
 
 #include "config.h"
@@ -43,9 +91,15 @@
 #include <stdio.h>
 #include <string.h>
 
+#ifdef HAVE_LIBPTHREAD
+#include <signal.h>
+#include <pthread.h>
+#endif
+
 #include "debug.h"
 #include "cfg.h"
 #include "drv.h"
+#include "drv_generic.h"
 
 extern DRIVER drv_ASTUSB;
 extern DRIVER drv_BeckmannEgle;
@@ -89,6 +143,7 @@ extern DRIVER drv_Sample;
 extern DRIVER drv_SamsungSPF;
 extern DRIVER drv_st2205;
 extern DRIVER drv_serdisplib;
+extern DRIVER drv_Shm;
 extern DRIVER drv_ShuttleVFD;
 extern DRIVER drv_SimpleLCD;
 extern DRIVER drv_T6963;
@@ -239,6 +294,9 @@ DRIVER *Driver[] = {
 #ifdef WITH_SERDISPLIB
     &drv_serdisplib,
 #endif
+#ifdef WITH_SHM
+    &drv_Shm,
+#endif
 #ifdef WITH_SIMPLELCD
     &drv_SimpleLCD,
 #endif
@@ -274,7 +332,43 @@ DRIVER *Driver[] = {
 };
 
 
-static DRIVER *Drv = NULL;
+/* a variable which is kept separately for every display */
+typedef struct STATE {
+    void *addr;
+    size_t size;
+    void *initial;		/* contents on registration, for displays which did not use it yet */
+} STATE;
+
+typedef struct DISPLAY {
+    char *section;
+    DRIVER *Drv;
+    void **saved;		/* contents of the states while the display is not selected */
+    int nSaved;
+    int (*flush) (void);	/* output thread: write pending changes to the display */
+    int pending;		/* output thread: flush() has work to do */
+    int stop;			/* output thread: terminate */
+#ifdef HAVE_LIBPTHREAD
+    pthread_t thread;
+#endif
+} DISPLAY;
+
+static STATE *States = NULL;
+static int nStates = 0;
+
+static DISPLAY Displays[MAX_DISPLAYS];
+static int nDisplays = 0;
+
+/* the display whose state is in the global variables */
+static int Current = -1;
+
+#ifdef HAVE_LIBPTHREAD
+/* held by the main loop unless it is sleeping */
+static pthread_mutex_t Output = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t Wakeup = PTHREAD_COND_INITIALIZER;
+static int Threads = 0;
+static int Idle = 0;
+static volatile int Preempt = 0;
+#endif
 
 
 /* maybe we need this */
@@ -303,25 +397,301 @@ int drv_list(void)
 }
 
 
-int drv_init(const char *section, const char *driver, const int quiet)
+void drv_state(void *state, const size_t size)
 {
+    STATE *tmp;
     int i;
-    for (i = 0; Driver[i]; i++) {
-	if (strcmp(Driver[i]->name, driver) == 0) {
-	    Drv = Driver[i];
-	    if (Drv->init == NULL)
-		return 0;
-	    return Drv->init(section, quiet);
+
+    for (i = 0; i < nStates; i++) {
+	if (States[i].addr == state)
+	    return;
+    }
+
+    tmp = realloc(States, (nStates + 1) * sizeof(STATE));
+    if (tmp == NULL) {
+	error("drv_state: realloc() failed");
+	return;
+    }
+    States = tmp;
+    States[nStates].addr = state;
+    States[nStates].size = size;
+    States[nStates].initial = malloc(size);
+    if (States[nStates].initial == NULL) {
+	error("drv_state: malloc() failed");
+	return;
+    }
+    memcpy(States[nStates].initial, state, size);
+    nStates++;
+}
+
+
+static void drv_save(DISPLAY * D)
+{
+    int i;
+
+    if (D->nSaved < nStates) {
+	void **tmp = realloc(D->saved, nStates * sizeof(void *));
+	if (tmp == NULL) {
+	    error("drv_select: realloc() failed");
+	    return;
+	}
+	D->saved = tmp;
+	for (i = D->nSaved; i < nStates; i++) {
+	    D->saved[i] = malloc(States[i].size);
+	    if (D->saved[i] == NULL) {
+		error("drv_select: malloc() failed");
+		D->nSaved = i;
+		return;
+	    }
+	}
+	D->nSaved = nStates;
+    }
+
+    for (i = 0; i < nStates; i++)
+	memcpy(D->saved[i], States[i].addr, States[i].size);
+}
+
+
+static void drv_load(DISPLAY * D)
+{
+    int i;
+
+    for (i = 0; i < nStates; i++)
+	memcpy(States[i].addr, i < D->nSaved ? D->saved[i] : States[i].initial, States[i].size);
+}
+
+
+int drv_displays(void)
+{
+    return nDisplays;
+}
+
+
+int drv_current(void)
+{
+    return Current;
+}
+
+
+int drv_select(const int display)
+{
+    int previous = Current;
+
+    if (display == Current || display < 0 || display >= nDisplays)
+	return previous;
+
+    if (Current >= 0)
+	drv_save(&Displays[Current]);
+    drv_load(&Displays[display]);
+    Current = display;
+
+    return previous;
+}
+
+
+#ifdef HAVE_LIBPTHREAD
+static void *drv_output_thread(void *arg)
+{
+    DISPLAY *D = arg;
+    sigset_t signals;
+    int previous;
+
+    /* signals are for the main loop */
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    pthread_mutex_lock(&Output);
+    while (!D->stop) {
+	if (!Idle || Preempt || !D->pending) {
+	    pthread_cond_wait(&Wakeup, &Output);
+	    continue;
 	}
+	previous = drv_select(D - Displays);
+	D->pending = D->flush();
+	drv_select(previous);
     }
-    error("drv_init(%s) failed: no such driver", driver);
+    pthread_mutex_unlock(&Output);
+
+    return NULL;
+}
+
+
+static void drv_output_stop(DISPLAY * D)
+{
+    if (D->flush == NULL)
+	return;
+
+    D->stop = 1;
+    pthread_cond_broadcast(&Wakeup);
+    pthread_mutex_unlock(&Output);
+    pthread_join(D->thread, NULL);
+    D->flush = NULL;
+    if (--Threads > 0)
+	pthread_mutex_lock(&Output);
+}
+#endif
+
+
+int drv_output(int (*flush) (void))
+{
+    DISPLAY *D;
+
+    if (Current < 0)
+	return -1;
+    D = &Displays[Current];
+
+#ifdef HAVE_LIBPTHREAD
+    /* the main loop owns the displays from now on */
+    if (Threads == 0)
+	pthread_mutex_lock(&Output);
+
+    D->flush = flush;
+    D->pending = 0;
+    D->stop = 0;
+    if (pthread_create(&D->thread, NULL, drv_output_thread, D) != 0) {
+	error("%s: could not create output thread", D->section);
+	D->flush = NULL;
+	if (Threads == 0)
+	    pthread_mutex_unlock(&Output);
+	return -1;
+    }
+    Threads++;
+
+    return 0;
+#else
+    (void) flush;
+    error("%s: output threads not supported (no pthread library)", D->section);
     return -1;
+#endif
 }
 
 
-int drv_quit(const int quiet)
+void drv_output_pending(void)
+{
+    if (Current >= 0)
+	Displays[Current].pending = 1;
+}
+
+
+int drv_output_preempted(void)
+{
+#ifdef HAVE_LIBPTHREAD
+    return Preempt;
+#else
+    return 0;
+#endif
+}
+
+
+void drv_idle(const int idle)
+{
+#ifdef HAVE_LIBPTHREAD
+    if (Threads == 0)
+	return;
+
+    if (idle) {
+	Idle = 1;
+	pthread_cond_broadcast(&Wakeup);
+	pthread_mutex_unlock(&Output);
+    } else {
+	Preempt = 1;
+	pthread_mutex_lock(&Output);
+	Preempt = 0;
+	Idle = 0;
+    }
+#else
+    (void) idle;
+#endif
+}
+
+
+int drv_init(const char *section, const char *driver, const int quiet)
 {
-    if (Drv->quit == NULL)
+    DISPLAY *D;
+    int i, d;
+
+    for (i = 0; Driver[i]; i++) {
+	if (strcmp(Driver[i]->name, driver) == 0)
+	    break;
+    }
+    if (Driver[i] == NULL) {
+	error("drv_init(%s) failed: no such driver", driver);
+	return -1;
+    }
+
+    for (d = 0; d < nDisplays; d++) {
+	if (Displays[d].Drv == Driver[i]) {
+	    error("drv_init(%s) failed: driver already used by %s", driver, Displays[d].section);
+	    return -1;
+	}
+    }
+
+    if (nDisplays >= MAX_DISPLAYS) {
+	error("drv_init(%s) failed: too many displays (max: %d)", driver, MAX_DISPLAYS);
+	return -1;
+    }
+
+    /* the generic variables every display has */
+    if (nDisplays == 0) {
+	drv_state(&LROWS, sizeof(LROWS));
+	drv_state(&LCOLS, sizeof(LCOLS));
+	drv_state(&DROWS, sizeof(DROWS));
+	drv_state(&DCOLS, sizeof(DCOLS));
+	drv_state(&XRES, sizeof(XRES));
+	drv_state(&YRES, sizeof(YRES));
+	drv_state(&DTYPE, sizeof(DTYPE));
+	drv_state(&drv_generic_blit, sizeof(drv_generic_blit));
+    }
+
+    D = &Displays[nDisplays++];
+    D->section = strdup(section);
+    D->Drv = Driver[i];
+    D->saved = NULL;
+    D->nSaved = 0;
+    D->flush = NULL;
+    D->pending = 0;
+    D->stop = 0;
+
+    drv_select(nDisplays - 1);
+
+    if (D->Drv->init == NULL)
 	return 0;
-    return Drv->quit(quiet);
+    return D->Drv->init(D->section, quiet);
+}
+
+
+int drv_quit(const int quiet)
+{
+    int d, i, ret = 0;
+
+#ifdef HAVE_LIBPTHREAD
+    /* the drivers write their goodbye themselves */
+    for (d = 0; d < nDisplays; d++)
+	drv_output_stop(&Displays[d]);
+#endif
+
+    for (d = nDisplays - 1; d >= 0; d--) {
+	DISPLAY *D = &Displays[d];
+	drv_select(d);
+	if (D->Drv->quit != NULL && D->Drv->quit(quiet) < 0)
+	    ret = -1;
+    }
+
+    for (d = 0; d < nDisplays; d++) {
+	DISPLAY *D = &Displays[d];
+	for (i = 0; i < D->nSaved; i++)
+	    free(D->saved[i]);
+	free(D->saved);
+	free(D->section);
+    }
+    nDisplays = 0;
+    Current = -1;
+
+    for (i = 0; i < nStates; i++)
+	free(States[i].initial);
+    free(States);
+    States = NULL;
+    nStates = 0;
+
+    return ret;
 }
@@ -27,6 +27,8 @@
 #ifndef _DRV_H_
 #define _DRV_H_
 
+#include <stddef.h>
+
 typedef struct DRIVER {
     char *name;
     int (*list) (void);
@@ -49,8 +51,19 @@ extern char *output;
 void drv_X11_parseArgs(int *argc, char *arvg[]);
 #endif
 
+/* maximum number of displays driven by one process */
+#define MAX_DISPLAYS 8
+
 int drv_list(void);
 int drv_init(const char *section, const char *driver, const int quiet);
 int drv_quit(const int quiet);
+int drv_displays(void);
+int drv_current(void);
+int drv_select(const int display);
+void drv_state(void *state, const size_t size);
+int drv_output(int (*flush) (void));
+void drv_output_pending(void);
+int drv_output_preempted(void);
+void drv_idle(const int idle);
 
 #endif
@@ -78,6 +78,8 @@
 #include "drv_generic_i2c.h"
 #endif
 
+#include "drv_generic_hd44780.h"
+
 static char Name[] = "HD44780";
 
 static int Bus;
@@ -177,6 +179,63 @@ static void (*drv_HD_data) (const unsigned char controller, const char *string,
 static void (*drv_HD_stop) (void);
 
 
+static void drv_HD_timings(const char *section)
+{
+    /* HD44780 execution timings [microseconds]
+     * as these values differ from spec to spec,
+     * we use the worst-case default values, but allow
+     * modification from the config file.
+     */
+    T_INIT1 = timing(Name, section, "INIT1", 4100, "us");	/* first init sequence: 4.1 msec */
+    T_INIT2 = timing(Name, section, "INIT2", 100, "us");	/* second init sequence: 100 usec */
+    T_EXEC = timing(Name, section, "EXEC", 80, "us");	/* normal execution time */
+    T_WRCG = timing(Name, section, "WRCG", 120, "us");	/* CG RAM Write */
+    T_CLEAR = timing(Name, section, "CLEAR", 2250, "us");	/* Clear Display */
+    T_HOME = timing(Name, section, "HOME", 2250, "us");	/* Return Cursor Home */
+    T_ONOFF = timing(Name, section, "ONOFF", 2250, "us");	/* Display On/Off Control */
+}
+
+
+/* DDRAM address of a display position, and the controller which shows it */
+static int drv_HD_address(int row, int col, int *controller)
+{
+    int pos, c;
+
+    /* handle multiple controllers */
+    for (pos = 0, c = 0; c < numControllers; c++) {
+	pos += CROWS[c];
+	if (row < pos)
+	    break;
+	row -= CROWS[c];
+    }
+    *controller = c;
+
+    /* row or column outside of current display's size */
+    if (c >= numControllers || col >= CCOLS[c])
+	return -1;
+
+    /* 16x1 Displays are organized as 8x2 :-( */
+    if (CCOLS[c] == 16 && CROWS[c] == 1 && col > 7) {
+	row++;
+	col -= 8;
+    }
+
+    if (Capabilities & CAP_HD66712) {
+	/* the HD66712 doesn't have a braindamadged RAM layout */
+	pos = row * 32 + col;
+    } else {
+	/* 16x4 Controllers use a slightly different layout */
+	if (CCOLS[c] == 16 && CROWS[c] == 4) {
+	    pos = (row % 2) * 64 + (row / 2) * 16 + col;
+	} else {
+	    pos = (row % 2) * 64 + (row / 2) * 20 + col;
+	}
+    }
+
+    return pos;
+}
+
+
 
 /****************************************/
 /***  parport dependant functions     ***/
@@ -193,6 +252,7 @@ static void drv_HD_PP_busy(const int controller)
     unsigned char busymask;
     unsigned char ctrlmask;
     unsigned int counter;
+    unsigned long long end = 0;
 
     if (Bits == 8) {
 	busymask = 0x80;
@@ -230,7 +290,7 @@ static void drv_HD_PP_busy(const int controller)
 	    }
 
 	    /* Address set-up time */
-	    ndelay(T_AS);
+	    drv_generic_parport_delay(T_AS);
 
 	    /* rise ENABLE */
 	    if (Bits == 8) {
@@ -256,21 +316,14 @@ static void drv_HD_PP_busy(const int controller)
 		counter++;
 
 		if (counter >= 5) {
-		    struct timeval now, end;
+		    unsigned long long now = nclock();
 
 		    if (counter == 5) {
 			/* determine the time when the timeout has expired */
-			gettimeofday(&end, NULL);
-			end.tv_usec += MAX_BUSYFLAG_WAIT;
-			while (end.tv_usec > 1000000) {
-			    end.tv_usec -= 1000000;
-			    end.tv_sec++;
-			}
+			end = now + MAX_BUSYFLAG_WAIT * 1000ULL;
 		    }
 
-		    /* get the current time */
-		    gettimeofday(&now, NULL);
-		    if (now.tv_sec == end.tv_sec ? now.tv_usec >= end.tv_usec : now.tv_sec >= end.tv_sec) {
+		    if (now >= end) {
 			error("%s: timeout waiting for busy flag on controller %x (0x%02x)", Name, ctrlmask, data);
 			if (++errors >= MAX_BUSYFLAG_ERRORS) {
 			    error("%s: too many busy flag failures, turning off busy flag checking.", Name);
@@ -287,13 +340,13 @@ static void drv_HD_PP_busy(const int controller)
 		drv_generic_parport_control(enable, 0);
 
 		/* Address hold time */
-		ndelay(T_AH);
+		drv_generic_parport_delay(T_AH);
 
 		drv_generic_parport_control(SIGNAL_RW | SIGNAL_RS, 0);
 	    } else {
 		/* Lower EN */
 		drv_generic_parport_data(SIGNAL_RW ^ invert_data_bits);
-		ndelay(T_AH);
+		drv_generic_parport_delay(T_AH);
 		drv_generic_parport_data(0 ^ invert_data_bits);
 	    }
 
@@ -328,13 +381,13 @@ static void drv_HD_PP_nibble(const unsigned char controller, const unsigned char
     drv_generic_parport_data(nibble ^ invert_data_bits);
 
     /* Address set-up time */
-    ndelay(T_AS);
+    drv_generic_parport_delay(T_AS);
 
     /* rise ENABLE */
     drv_generic_parport_data((nibble | enable) ^ invert_data_bits);
 
     /* Enable pulse width */
-    ndelay(T_PW);
+    drv_generic_parport_delay(T_PW);
 
     /* lower ENABLE */
     drv_generic_parport_data(nibble ^ invert_data_bits);
@@ -347,7 +400,7 @@ static void drv_HD_PP_byte(const unsigned char controller, const unsigned char d
     drv_HD_PP_nibble(controller, ((data >> 4) & 0x0f) | RS);
 
     /* Make sure we honour T_CY */
-    ndelay(T_CY - T_AS - T_PW);
+    drv_generic_parport_delay(T_CY - T_AS - T_PW);
 
     /* send low nibble of the data */
     drv_HD_PP_nibble(controller, (data & 0x0f) | RS);
@@ -383,7 +436,7 @@ static void drv_HD_PP_command(const unsigned char controller, const unsigned cha
 	drv_generic_parport_control(SIGNAL_RW | SIGNAL_RS, 0);
 
 	/* Address set-up time */
-	ndelay(T_AS);
+	drv_generic_parport_delay(T_AS);
 
 	/* send command */
 	drv_generic_parport_toggle(enable, 1, T_PW);
@@ -396,7 +449,7 @@ static void drv_HD_PP_command(const unsigned char controller, const unsigned cha
 
     /* wait for command completion */
     if (!UseBusy)
-	udelay(delay);
+	drv_generic_parport_delay(delay * 1000);
 
 }
 
@@ -429,7 +482,7 @@ static void drv_HD_PP_data(const unsigned char controller, const char *string, c
 	    /* clear RW, set RS */
 	    drv_generic_parport_control(SIGNAL_RW | SIGNAL_RS, SIGNAL_RS);
 	    /* Address set-up time */
-	    ndelay(T_AS);
+	    drv_generic_parport_delay(T_AS);
 	}
 
 	while (l--) {
@@ -439,7 +492,7 @@ static void drv_HD_PP_data(const unsigned char controller, const char *string, c
 		/* clear RW, set RS */
 		drv_generic_parport_control(SIGNAL_RW | SIGNAL_RS, SIGNAL_RS);
 		/* Address set-up time */
-		ndelay(T_AS);
+		drv_generic_parport_delay(T_AS);
 	    }
 
 	    /* put data on DB1..DB8 */
@@ -450,7 +503,7 @@ static void drv_HD_PP_data(const unsigned char controller, const char *string, c
 
 	    /* wait for command completion */
 	    if (!UseBusy)
-		udelay(delay);
+		drv_generic_parport_delay(delay * 1000);
 	}
 
     } else {			/* 4 bit mode */
@@ -464,12 +517,49 @@ static void drv_HD_PP_data(const unsigned char controller, const char *string, c
 
 	    /* wait for command completion */
 	    if (!UseBusy)
-		udelay(delay);
+		drv_generic_parport_delay(delay * 1000);
 	}
     }
 }
 
 
+/* a simulated port feeds the display pins into a software model */
+static int drv_HD_PP_probe(const unsigned long long time, const unsigned char data, const unsigned char control)
+{
+    unsigned char pins, enable;
+    int controllers, value;
+
+    /* 8 bit: control lines and data port, */
+    /* 4 bit: all signals on the data port, DB0..DB3 drive D4..D7 */
+    if (Bits == 8) {
+	pins = control;
+    } else {
+	pins = data ^ invert_data_bits;
+    }
+
+    enable = pins & (SIGNAL_ENABLE | SIGNAL_ENABLE2 | SIGNAL_ENABLE3 | SIGNAL_ENABLE4);
+    controllers = 0;
+    if (enable & SIGNAL_ENABLE)
+	controllers |= 0x01;
+    if (enable & SIGNAL_ENABLE2)
+	controllers |= 0x02;
+    if (enable & SIGNAL_ENABLE3)
+	controllers |= 0x04;
+    if (enable & SIGNAL_ENABLE4)
+	controllers |= 0x08;
+
+    if (Bits == 8) {
+	value = drv_generic_hd44780_pins(time, controllers, (pins & SIGNAL_RS) != 0, (pins & SIGNAL_RW) != 0,
+					 data ^ invert_data_bits);
+	return value < 0 ? data : value;
+    }
+
+    value = drv_generic_hd44780_pins(time, controllers, (pins & SIGNAL_RS) != 0, (pins & SIGNAL_RW) != 0,
+				     (pins & 0x0f) << 4);
+    return value < 0 ? data : (data & 0xf0) | ((value >> 4) & 0x0f);
+}
+
+
 static int drv_HD_PP_load(const char *section)
 {
     if (cfg_number(section, "Bits", 8, 4, 8, &Bits) < 0)
@@ -584,18 +674,8 @@ static int drv_HD_PP_load(const char *section)
 	T_GPO_PW = 0;
     }
 
-    /* HD44780 execution timings [microseconds]
-     * as these values differ from spec to spec,
-     * we use the worst-case default values, but allow
-     * modification from the config file.
-     */
-    T_INIT1 = timing(Name, section, "INIT1", 4100, "us");	/* first init sequence: 4.1 msec */
-    T_INIT2 = timing(Name, section, "INIT2", 100, "us");	/* second init sequence: 100 usec */
-    T_EXEC = timing(Name, section, "EXEC", 80, "us");	/* normal execution time */
-    T_WRCG = timing(Name, section, "WRCG", 120, "us");	/* CG RAM Write */
-    T_CLEAR = timing(Name, section, "CLEAR", 2250, "us");	/* Clear Display */
-    T_HOME = timing(Name, section, "HOME", 2250, "us");	/* Return Cursor Home */
-    T_ONOFF = timing(Name, section, "ONOFF", 2250, "us");	/* Display On/Off Control */
+    /* HD44780 execution timings */
+    drv_HD_timings(section);
 
     /* Power-on delay */
     if (SIGNAL_POWER != 0) {
@@ -604,6 +684,12 @@ static int drv_HD_PP_load(const char *section)
 	T_POWER = 0;
     }
 
+    /* a simulated port drives a software model of the controllers */
+    if (drv_generic_parport_probe(drv_HD_PP_probe) == 0) {
+	if (drv_generic_hd44780_open(section, Name, numControllers, DROWS, DCOLS, drv_HD_address) < 0)
+	    return -1;
+    }
+
     /* clear all signals */
     if (Bits == 8) {
 	drv_generic_parport_control(SIGNAL_RS | SIGNAL_RW |
@@ -620,7 +706,7 @@ static int drv_HD_PP_load(const char *section)
     /* raise power pin */
     if (SIGNAL_POWER != 0) {
 	drv_generic_parport_control(SIGNAL_POWER, SIGNAL_POWER);
-	udelay(1000 * T_POWER);
+	drv_generic_parport_delay(1000000UL * T_POWER);
     }
 
     /* initialize *all* controllers */
@@ -630,13 +716,13 @@ static int drv_HD_PP_load(const char *section)
 	drv_HD_PP_command(allControllers, 0x38, T_EXEC);	/* 8 Bit mode, 1/16 duty cycle, 5x8 font */
     } else {
 	drv_HD_PP_nibble(allControllers, 0x03);
-	udelay(T_INIT1);	/* 4 Bit mode, wait 4.1 ms */
+	drv_generic_parport_delay(T_INIT1 * 1000);	/* 4 Bit mode, wait 4.1 ms */
 	drv_HD_PP_nibble(allControllers, 0x03);
-	udelay(T_INIT2);	/* 4 Bit mode, wait 100 us */
+	drv_generic_parport_delay(T_INIT2 * 1000);	/* 4 Bit mode, wait 100 us */
 	drv_HD_PP_nibble(allControllers, 0x03);
-	udelay(T_INIT1);	/* 4 Bit mode, wait 4.1 ms */
+	drv_generic_parport_delay(T_INIT1 * 1000);	/* 4 Bit mode, wait 4.1 ms */
 	drv_HD_PP_nibble(allControllers, 0x02);
-	udelay(T_INIT2);	/* 4 Bit mode, wait 100 us */
+	drv_generic_parport_delay(T_INIT2 * 1000);	/* 4 Bit mode, wait 100 us */
 	drv_HD_PP_command(allControllers, 0x28, T_EXEC);	/* 4 Bit mode, 1/16 duty cycle, 5x8 font */
     }
 
@@ -682,7 +768,7 @@ static void drv_HD_PP_stop(void)
     }
 
     drv_generic_parport_close();
-
+    drv_generic_hd44780_close();
 }
 
 #endif
@@ -773,16 +859,22 @@ static void drv_HD_I2C_byte(const unsigned char controller, const unsigned char
 }
 
 
-static void drv_HD_I2C_command(const unsigned char controller, const unsigned char cmd, __attribute__ ((unused))
-			       const unsigned long delay)
+static void drv_HD_I2C_command(const unsigned char controller, const unsigned char cmd, const unsigned long delay)
 {
     /* send command data with RS disabled */
+    drv_generic_i2c_burst(1);
     if (Bits == 4) {
 	drv_HD_I2C(controller, ((cmd >> 4) & 0x0f), 0, 0);
 	drv_HD_I2C(controller, ((cmd) & 0x0f), 0, 0);
     } else if (Bits == 8) {
 	drv_HD_I2C(controller, cmd, 0, 0);
     }
+    drv_generic_i2c_burst(0);
+
+    /* the bus is slow enough for normal instructions, */
+    /* but not for clear, home and display on/off */
+    if (delay > (unsigned long) T_EXEC)
+	drv_generic_i2c_wait(delay);
 }
 
 static void drv_HD_I2C_data(const unsigned char controller, const char *string, const int len, __attribute__ ((unused))
@@ -794,9 +886,42 @@ static void drv_HD_I2C_data(const unsigned char controller, const char *string,
     if (len <= 0)
 	return;
 
+    drv_generic_i2c_burst(1);
     while (l--) {
 	drv_HD_I2C_byte(controller, *(string++));
     }
+    drv_generic_i2c_burst(0);
+}
+
+
+/* a simulated bus feeds the expander outputs into a software model */
+static void drv_HD_I2C_probe(const unsigned long long time, const int datadev, const int pos, const unsigned char byte)
+{
+    static unsigned char data = 0;
+    static unsigned char ctrl = 0;
+    int controllers;
+
+    if (Bits == 8) {
+	/* register based expanders: register number, then value */
+	if (pos != 1)
+	    return;
+	if (datadev)
+	    data = byte;
+	else
+	    ctrl = byte;
+    } else {
+	/* every byte is a new state of the expander, DB0..DB3 drive D4..D7 */
+	ctrl = byte;
+	data = (byte & 0x0f) << 4;
+    }
+
+    controllers = 0;
+    if (ctrl & SIGNAL_ENABLE)
+	controllers |= 0x01;
+    if (ctrl & SIGNAL_ENABLE2)
+	controllers |= 0x02;
+
+    drv_generic_hd44780_pins(time, controllers, (ctrl & SIGNAL_RS) != 0, (ctrl & SIGNAL_RW) != 0, data);
 }
 
 
@@ -805,6 +930,9 @@ static int drv_HD_I2C_load(const char *section)
     if (cfg_number(section, "Bits", 8, 4, 8, &Bits) < 0)
 	return -1;
 
+    /* HD44780 execution timings */
+    drv_HD_timings(section);
+
     info("%s: using %d bit mode", Name, Bits);
 
     if (Bits != 4 && Bits != 8) {
@@ -828,22 +956,28 @@ static int drv_HD_I2C_load(const char *section)
     if ((SIGNAL_GPO = drv_generic_i2c_wire("GPO", "GND")) == 0xff)
 	return -1;
 
+    /* a simulated bus drives a software model of the controllers */
+    if (drv_generic_i2c_probe(drv_HD_I2C_probe) == 0) {
+	if (drv_generic_hd44780_open(section, Name, numControllers, DROWS, DCOLS, drv_HD_address) < 0)
+	    return -1;
+    }
+
     if (Bits == 4) {
 	/* initialize display */
 	drv_HD_I2C(allControllers, 0x02, 0, 0);
-	udelay(T_INIT1);	/* 4 Bit mode, wait 4.1 ms */
+	drv_generic_i2c_wait(T_INIT1);	/* 4 Bit mode, wait 4.1 ms */
 	drv_HD_I2C(allControllers, 0x03, 0, 0);
-	udelay(T_INIT2);	/* 4 Bit mode, wait 100 us */
+	drv_generic_i2c_wait(T_INIT2);	/* 4 Bit mode, wait 100 us */
 	drv_HD_I2C(allControllers, 0x03, 0, 0);
-	udelay(T_INIT1);	/* 4 Bit mode, wait 4.1 ms */
+	drv_generic_i2c_wait(T_INIT1);	/* 4 Bit mode, wait 4.1 ms */
 	drv_HD_I2C(allControllers, 0x02, 0, 0);
-	udelay(T_INIT2);	/* 4 Bit mode, wait 100 us */
+	drv_generic_i2c_wait(T_INIT2);	/* 4 Bit mode, wait 100 us */
 	drv_HD_I2C_command(allControllers, 0x28, T_EXEC);	/* 4 Bit mode, 1/16 duty cycle, 5x8 font */
     } else if (Bits == 8) {
 	drv_HD_I2C(allControllers, 0x30, 0, 0);	/* 8 Bit mode, wait 4.1 ms */
-	udelay(T_INIT1);	/* 8 Bit mode, wait 4.1 ms */
+	drv_generic_i2c_wait(T_INIT1);	/* 8 Bit mode, wait 4.1 ms */
 	drv_HD_I2C(allControllers, 0x30, 0, 0);	/* 8 Bit mode, wait 100 us */
-	udelay(T_INIT2);	/* 8 Bit mode, wait 4.1 ms */
+	drv_generic_i2c_wait(T_INIT2);	/* 8 Bit mode, wait 4.1 ms */
 	drv_HD_I2C_command(allControllers, 0x38, T_EXEC);	/* 8 Bit mode, 1/16 duty cycle, 5x8 font */
     }
 
@@ -860,6 +994,7 @@ static void drv_HD_I2C_stop(void)
 
     /* close port */
     drv_generic_i2c_close();
+    drv_generic_hd44780_close();
 }
 
 /* END OF DISCLAIMER */
@@ -881,18 +1016,12 @@ static int drv_HD_goto(int row, int col)
 {
     int pos, controller;
 
-    /* handle multiple controllers */
-    for (pos = 0, controller = 0; controller < numControllers; controller++) {
-	pos += CROWS[controller];
-	if (row < pos) {
-	    currController = (1 << controller);
-	    break;
-	}
-	row -= CROWS[controller];
-    }
+    pos = drv_HD_address(row, col, &controller);
+    if (controller < numControllers)
+	currController = (1 << controller);
 
     /* column outside of current display's width */
-    if (col >= CCOLS[controller])
+    if (pos < 0)
 	return -1;
 
     if (0) {
@@ -900,23 +1029,6 @@ static int drv_HD_goto(int row, int col)
 	      CROWS[controller], CCOLS[controller]);
     }
 
-    /* 16x1 Displays are organized as 8x2 :-( */
-    if (CCOLS[controller] == 16 && CROWS[controller] == 1 && col > 7) {
-	row++;
-	col -= 8;
-    }
-
-    if (Capabilities & CAP_HD66712) {
-	/* the HD66712 doesn't have a braindamadged RAM layout */
-	pos = row * 32 + col;
-    } else {
-	/* 16x4 Controllers use a slightly different layout */
-	if (CCOLS[controller] == 16 && CROWS[controller] == 4) {
-	    pos = (row % 2) * 64 + (row / 2) * 16 + col;
-	} else {
-	    pos = (row % 2) * 64 + (row / 2) * 20 + col;
-	}
-    }
     drv_HD_command(currController, (0x80 | pos), T_EXEC);
 
     /* return columns left on current display */
@@ -925,12 +1037,32 @@ static int drv_HD_goto(int row, int col)
 }
 
 
+/* collect the pulses of a whole write into one schedule */
+static void drv_HD_burst(const int on)
+{
+#ifdef WITH_PARPORT
+    if (Bus == BUS_PP)
+	drv_generic_parport_burst(on);
+#endif
+#ifdef WITH_I2C
+    if (Bus == BUS_I2C)
+	drv_generic_i2c_burst(on);
+#endif
+    /* a simulated controller dumps the screen after the transport is done */
+    drv_generic_hd44780_burst(on);
+}
+
+
 static void drv_HD_write(const int row, const int col, const char *data, const int len)
 {
-    int space = drv_HD_goto(row, col);
+    int space;
+
+    drv_HD_burst(1);
+    space = drv_HD_goto(row, col);
     if (space > 0) {
 	drv_HD_data(currController, data, len > space ? space : len, T_EXEC);
     }
+    drv_HD_burst(0);
 }
 
 
@@ -944,8 +1076,10 @@ static void drv_HD_defchar(const int ascii, const unsigned char *matrix)
     }
 
     /* define chars on *all* controllers! */
+    drv_HD_burst(1);
     drv_HD_command(allControllers, 0x40 | 8 * ascii, T_EXEC);
     drv_HD_data(allControllers, buffer, 8, T_WRCG);
+    drv_HD_burst(0);
 }
 
 
@@ -1010,7 +1144,7 @@ static int drv_HD_GPO(const int num, const int val)
     drv_generic_parport_data(GPO ^ invert_data_bits);
 
     /* 74HCT573 set-up time */
-    ndelay(T_GPO_ST);
+    drv_generic_parport_delay(T_GPO_ST);
 
     /* send data */
     /* 74HCT573 enable pulse width */
@@ -1028,7 +1162,7 @@ static int drv_HD_GPI(const int num)
     drv_generic_parport_control(SIGNAL_GPI, SIGNAL_GPI);
 
     /* 74HCT573 set-up time + enable pulse width */
-    ndelay(T_GPO_ST + T_GPO_PW);
+    drv_generic_parport_delay(T_GPO_ST + T_GPO_PW);
 
     /* read data from DB1..DB8 */
     v = drv_generic_parport_read() ^ invert_data_bits;
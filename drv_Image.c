@@ -42,7 +42,10 @@
 #include <unistd.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <signal.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
 
 
 #ifdef WITH_PNG
@@ -73,6 +76,8 @@
 #include "plugin.h"
 #include "drv.h"
 #include "drv_generic_graphic.h"
+#include "bench.h"
+#include "stats.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -89,59 +94,66 @@ static int cgap = 0;		/* column gap between characters */
 static int border = 0;		/* window border */
 
 static int dimx, dimy;		/* total window dimension in pixel */
+static int xsize, ysize;	/* output image size including border */
 
 static RGBA BC;
 static RGBA *drv_IMG_FB = NULL;
 
+/* the scaled output image, maintained from the blits */
+static unsigned char *Bitmap = NULL;	/* PPM: 3 bytes per pixel */
+#ifdef WITH_PNG
+static gdImagePtr Im = NULL;		/* PNG */
+static int Compression = -1;		/* zlib level, 0 = store only */
+#endif
+
+static int Seq = 0;			/* sequence number for the file name */
+static char *Stream = NULL;		/* FIFO receiving every frame */
+static int StreamFd = -1;
+
 static int dirty = 1;
+static int Stats = -1;
 
 /****************************************/
 /***  hardware dependant functions    ***/
 /****************************************/
 
-#ifdef WITH_PPM
-static int drv_IMG_flush_PPM(void)
+/* paint one display pixel into the output image */
+static void drv_IMG_paint(const int row, const int col, const RGBA p)
 {
-    static int seq = 0;
-    static RGBA *bitbuf = NULL;
-    static unsigned char *rowbuf = NULL;
-    int xsize, ysize, row, col, i;
-    char path[256], tmp[256], buffer[256];
-    int fd;
+    int x = border + (col / XRES) * cgap + col * (pixel + pgap);
+    int y = border + (row / YRES) * rgap + row * (pixel + pgap);
+    int a, b;
 
-    xsize = 2 * border + (DCOLS / XRES - 1) * cgap + DCOLS * pixel + (DCOLS - 1) * pgap;
-    ysize = 2 * border + (DROWS / YRES - 1) * rgap + DROWS * pixel + (DROWS - 1) * pgap;
-
-    if (bitbuf == NULL) {
-	if ((bitbuf = malloc(xsize * ysize * sizeof(*bitbuf))) == NULL) {
-	    error("%s: malloc() failed: %s", Name, strerror(errno));
-	    return -1;
-	}
-    }
-
-    if (rowbuf == NULL) {
-	if ((rowbuf = malloc(3 * xsize * sizeof(*rowbuf))) == NULL) {
-	    error("Raster: malloc() failed: %s", strerror(errno));
-	    return -1;
+    switch (Format) {
+    case PPM:
+	for (a = 0; a < pixel; a++) {
+	    unsigned char *q = Bitmap + 3 * ((y + a) * xsize + x);
+	    for (b = 0; b < pixel; b++) {
+		*q++ = p.R;
+		*q++ = p.G;
+		*q++ = p.B;
+	    }
 	}
+	break;
+    case PNG:
+#ifdef WITH_PNG
+	gdImageFilledRectangle(Im, x, y, x + pixel - 1, y + pixel - 1, gdTrueColor(p.R, p.G, p.B));
+#endif
+	break;
+    default:
+	break;
     }
+}
 
-    for (i = 0; i < xsize * ysize; i++) {
-	bitbuf[i] = BC;
-    }
 
-    for (row = 0; row < DROWS; row++) {
-	int y = border + (row / YRES) * rgap + row * (pixel + pgap);
-	for (col = 0; col < DCOLS; col++) {
-	    int x = border + (col / XRES) * cgap + col * (pixel + pgap);
-	    int a, b;
-	    for (a = 0; a < pixel; a++)
-		for (b = 0; b < pixel; b++)
-		    bitbuf[y * xsize + x + a * xsize + b] = drv_IMG_FB[row * DCOLS + col];
-	}
-    }
+/* write one frame to the next output file */
+static int drv_IMG_write(const struct iovec *iov, const int count, const ssize_t total)
+{
+    char path[256], tmp[256];
+    ssize_t len;
+    int fd;
 
-    snprintf(path, sizeof(path), output, seq++);
+    snprintf(path, sizeof(path), output, Seq++);
     qprintf(tmp, sizeof(tmp), "%s.tmp", path);
 
     /* remove the file */
@@ -155,25 +167,14 @@ static int drv_IMG_flush_PPM(void)
 	return -1;
     }
 
-    qprintf(buffer, sizeof(buffer), "P6\n%d %d\n255\n", xsize, ysize);
-    if (write(fd, buffer, strlen(buffer)) < 0) {
-	error("%s: write(%s) failed: %s", Name, tmp, strerror(errno));
+    len = writev(fd, iov, count);
+    if (len != total) {
+	error("%s: write(%s) failed: %s", Name, tmp, len < 0 ? strerror(errno) : "short write");
+	close(fd);
+	unlink(tmp);
 	return -1;
     }
-
-    for (row = 0; row < ysize; row++) {
-	int c = 0;
-	for (col = 0; col < xsize; col++) {
-	    RGBA p = bitbuf[row * xsize + col];
-	    rowbuf[c++] = p.R;
-	    rowbuf[c++] = p.G;
-	    rowbuf[c++] = p.B;
-	}
-	if (write(fd, rowbuf, c) < 0) {
-	    error("%s: write(%s) failed: %s", Name, tmp, strerror(errno));
-	    break;
-	}
-    }
+    STATS_BENCH_COUNT(Stats, BENCH_SENT, len);
 
     if (close(fd) < 0) {
 	error("%s: close(%s) failed: %s", Name, tmp, strerror(errno));
@@ -186,75 +187,106 @@ static int drv_IMG_flush_PPM(void)
 
     return 0;
 }
-#endif
 
-#ifdef WITH_PNG
-static int drv_IMG_flush_PNG(void)
-{
-    static int seq = 0;
-    int xsize, ysize, row, col;
-    char path[256], tmp[256];
-    FILE *fp;
-    int fd;
-    gdImagePtr im;
 
-    xsize = 2 * border + (DCOLS / XRES - 1) * cgap + DCOLS * pixel + (DCOLS - 1) * pgap;
-    ysize = 2 * border + (DROWS / YRES - 1) * rgap + DROWS * pixel + (DROWS - 1) * pgap;
+/* append one frame to the stream FIFO */
+static void drv_IMG_stream(const struct iovec *iov, const int count, const ssize_t total)
+{
+    int size, queued;
+
+    if (Stream == NULL)
+	return;
+
+    /* a FIFO can only be opened for writing when there is a reader */
+    if (StreamFd < 0) {
+	StreamFd = open(Stream, O_WRONLY | O_NONBLOCK);
+	if (StreamFd < 0) {
+	    if (errno != ENXIO)
+		error("%s: open(%s) failed: %s", Name, Stream, strerror(errno));
+	    return;
+	}
+	/* the pipe must hold at least one whole frame */
+	size = fcntl(StreamFd, F_GETPIPE_SZ);
+	if (size >= 0 && size < total && fcntl(StreamFd, F_SETPIPE_SZ, total) < 0) {
+	    error("%s: frames of %d bytes do not fit into %s: %s", Name, (int) total, Stream, strerror(errno));
+	}
+    }
 
-    im = gdImageCreateTrueColor(xsize, ysize);
-    gdImageFilledRectangle(im, 0, 0, xsize, ysize, gdTrueColor(BC.R, BC.G, BC.B));
+    /* never write a partial frame: drop it if the reader is behind */
+    size = fcntl(StreamFd, F_GETPIPE_SZ);
+    if (size >= 0 && ioctl(StreamFd, FIONREAD, &queued) == 0 && size - queued < total) {
+	debug("%s: reader of %s is behind, dropping frame", Name, Stream);
+	return;
+    }
 
-    for (row = 0; row < DROWS; row++) {
-	int y = border + (row / YRES) * rgap + row * (pixel + pgap);
-	for (col = 0; col < DCOLS; col++) {
-	    int x = border + (col / XRES) * cgap + col * (pixel + pgap);
-	    RGBA p = drv_IMG_FB[row * DCOLS + col];
-	    int c = gdTrueColor(p.R, p.G, p.B);
-	    gdImageFilledRectangle(im, x, y, x + pixel - 1, y + pixel - 1, c);
-	}
+    if (writev(StreamFd, iov, count) < 0 && errno != EAGAIN) {
+	/* reader went away */
+	close(StreamFd);
+	StreamFd = -1;
     }
+}
 
-    snprintf(path, sizeof(path), output, seq++);
-    qprintf(tmp, sizeof(tmp), "%s.tmp", path);
 
-    /* remove the file */
-    unlink(tmp);
+static int drv_IMG_output(const struct iovec *iov, const int count)
+{
+    ssize_t total = 0;
+    int i, ret;
 
-    /* avoid symlink security hole:  */
-    /* open it with O_EXCL will fail if the file exists.  */
-    /* This should not happen because we just unlinked it. */
-    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0) {
-	error("%s: open(%s) failed: %s", Name, tmp, strerror(errno));
-	return -1;
-    }
+    for (i = 0; i < count; i++)
+	total += iov[i].iov_len;
 
-    if ((fp = fdopen(fd, "w")) == NULL) {
-	error("%s: fdopen(%s) failed: %s\n", Name, tmp, strerror(errno));
-	close(fd);
-	return -1;
-    }
+    ret = drv_IMG_write(iov, count, total);
+    drv_IMG_stream(iov, count, total);
 
-    gdImagePng(im, fp);
-    gdImageDestroy(im);
+    return ret;
+}
 
 
-    if (fclose(fp) != 0) {
-	error("%s: fclose(%s) failed: %s\n", Name, tmp, strerror(errno));
-	return -1;
-    }
+#ifdef WITH_PPM
+static int drv_IMG_flush_PPM(void)
+{
+    char header[32];
+    struct iovec iov[2];
 
-    if (rename(tmp, path) < 0) {
-	error("%s: rename(%s) failed: %s\n", Name, tmp, strerror(errno));
+    /* header and image with a single writev() */
+    iov[0].iov_base = header;
+    iov[0].iov_len = qprintf(header, sizeof(header), "P6\n%d %d\n255\n", xsize, ysize);
+    iov[1].iov_base = Bitmap;
+    iov[1].iov_len = 3 * xsize * ysize;
+
+    return drv_IMG_output(iov, 2);
+}
+#endif
+
+#ifdef WITH_PNG
+static int drv_IMG_flush_PNG(void)
+{
+    struct iovec iov[1];
+    void *png;
+    int size, ret;
+
+    png = gdImagePngPtrEx(Im, &size, Compression);
+    if (png == NULL) {
+	error("%s: PNG encoding failed", Name);
 	return -1;
     }
 
-    return 0;
+    iov[0].iov_base = png;
+    iov[0].iov_len = size;
+    ret = drv_IMG_output(iov, 1);
+
+    gdFree(png);
+
+    return ret;
 }
 #endif
 
 
 static void drv_IMG_flush(void)
 {
+    STATS_TIME t;
+
+    STATS_BENCH_BEGIN(t, BENCH_BLIT);
     switch (Format) {
     case PPM:
 #ifdef WITH_PPM
@@ -269,6 +301,7 @@ static void drv_IMG_flush(void)
     default:
 	break;
     }
+    STATS_BENCH_END(Stats, t, BENCH_BLIT);
 }
 
 
@@ -292,6 +325,7 @@ static void drv_IMG_blit(const int row, const int col, const int height, const i
 	    RGBA p2 = drv_generic_graphic_rgb(r, c);
 	    if (p1.R != p2.R || p1.G != p2.G || p1.B != p2.B) {
 		drv_IMG_FB[r * DCOLS + c] = p2;
+		drv_IMG_paint(r, c, p2);
 		dirty = 1;
 	    }
 	}
@@ -301,9 +335,11 @@ static void drv_IMG_blit(const int row, const int col, const int height, const i
 
 static int drv_IMG_start(const char *section)
 {
-    int i;
+    int i, rate;
     char *s;
 
+    Stats = stats_register("write", Name);
+
     if (output == NULL || *output == '\0') {
 	error("%s: no output file specified (use -o switch)", Name);
 	return -1;
@@ -394,13 +430,56 @@ static int drv_IMG_start(const char *section)
     dimx = DCOLS * pixel + (DCOLS - 1) * pgap + (DCOLS / XRES - 1) * cgap;
     dimy = DROWS * pixel + (DROWS - 1) * pgap + (DROWS / YRES - 1) * rgap;
 
+    /* a partial last character still needs its gap */
+    xsize = 2 * border + ((DCOLS - 1) / XRES) * cgap + DCOLS * pixel + (DCOLS - 1) * pgap;
+    ysize = 2 * border + ((DROWS - 1) / YRES) * rgap + DROWS * pixel + (DROWS - 1) * pgap;
+
+    /* the output image, initially filled with the base color */
+    switch (Format) {
+    case PPM:
+	Bitmap = malloc(3 * xsize * ysize);
+	if (Bitmap == NULL) {
+	    error("%s: image could not be allocated: malloc() failed", Name);
+	    return -1;
+	}
+	for (i = 0; i < xsize * ysize; i++) {
+	    Bitmap[3 * i + 0] = BC.R;
+	    Bitmap[3 * i + 1] = BC.G;
+	    Bitmap[3 * i + 2] = BC.B;
+	}
+	break;
+    case PNG:
+#ifdef WITH_PNG
+	cfg_number(section, "Compression", -1, -1, 9, &Compression);
+	Im = gdImageCreateTrueColor(xsize, ysize);
+	if (Im == NULL) {
+	    error("%s: image could not be allocated: gdImageCreateTrueColor() failed", Name);
+	    return -1;
+	}
+	gdImageFilledRectangle(Im, 0, 0, xsize - 1, ysize - 1, gdTrueColor(BC.R, BC.G, BC.B));
+#endif
+	break;
+    default:
+	break;
+    }
+
+    /* optional FIFO receiving every frame (e.g. for ffmpeg -f image2pipe) */
+    Stream = cfg_get(section, "Stream", NULL);
+    if (Stream != NULL && *Stream == '\0') {
+	free(Stream);
+	Stream = NULL;
+    }
+    if (Stream != NULL) {
+	/* a reader going away must not kill us */
+	signal(SIGPIPE, SIG_IGN);
+    }
 
     /* initially flush the image to a file */
     drv_IMG_flush();
 
     /* regularly flush the image to a file */
-    /* Fixme: make 100msec configurable */
-    timer_add(drv_IMG_timer, NULL, 100, 0);
+    cfg_number(section, "Updaterate", 100, 10, -1, &rate);
+    timer_add(drv_IMG_timer, NULL, rate, 0);
 
 
     return 0;
@@ -473,6 +552,26 @@ int drv_IMG_quit(const __attribute__ ((unused))
 	drv_IMG_FB = NULL;
     }
 
+    if (Bitmap) {
+	free(Bitmap);
+	Bitmap = NULL;
+    }
+#ifdef WITH_PNG
+    if (Im) {
+	gdImageDestroy(Im);
+	Im = NULL;
+    }
+#endif
+
+    if (StreamFd >= 0) {
+	close(StreamFd);
+	StreamFd = -1;
+    }
+    if (Stream) {
+	free(Stream);
+	Stream = NULL;
+    }
+
     return (0);
 }
 
@@ -38,8 +38,13 @@
 
 #include "config.h"
 
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 
 #include <usb.h>
 #include <jpeglib.h>
@@ -49,6 +54,7 @@
 #include "qprintf.h"
 #include "timer.h"
 #include "drv.h"
+#include "stats.h"
 
 /* graphic display? */
 #include "drv_generic_graphic.h"
@@ -105,8 +111,15 @@ static struct {
     RGB *buf;
     int dirty;
     int fbsize;
+    uint64_t hash;		/* hash of the last frame sent */
+    int quality;		/* JPEG quality [0..100] */
 } image;
 
+/* loopback mode: transfers go to this file instead of the USB device */
+static int loopFd = -1;
+
+static int Stats = -1;
+
 static struct {
     unsigned char *buf;
     unsigned long int size;
@@ -138,7 +151,7 @@ int convert2JPG()
 
     /* call some jpeg helpers */
     jpeg_set_defaults(&cinfo);
-    jpeg_set_quality(&cinfo, 100, 1);	/*set the quality [0..100]  */
+    jpeg_set_quality(&cinfo, image.quality, 1);	/*set the quality [0..100]  */
     jpeg_start_compress(&cinfo, 1);
 
     row_stride = cinfo.image_width;
@@ -243,6 +256,33 @@ static int drv_SamsungSPF_open()
 }
 
 
+/* FNV-1a hash of the framebuffer */
+static uint64_t drv_SamsungSPF_hash(void)
+{
+    const unsigned char *p = (const unsigned char *) image.buf;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    int i;
+
+    for (i = 0; i < image.fbsize; i++) {
+	hash ^= p[i];
+	hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+
+/* loopback mode: write the bytes of a bulk transfer to a file */
+static int drv_SamsungSPF_loopback(char *data, unsigned int len)
+{
+    if (write(loopFd, data, len) != (int) len) {
+	error("%s: loopback write failed: %s", Name, strerror(errno));
+	return -1;
+    }
+    return len;
+}
+
+
 /* dummy function that sends something to the display */
 static int drv_SamsungSPF_send(char *data, unsigned int len)
 {
@@ -258,6 +298,13 @@ static int drv_SamsungSPF_send(char *data, unsigned int len)
 
     debug("bytes_to_send: %d, offset: %d", len, 12);
 
+    if (loopFd >= 0) {
+	if (drv_SamsungSPF_loopback(usb_hdr, 12) < 0 || drv_SamsungSPF_loopback(data, len) < 0
+	    || drv_SamsungSPF_loopback(buffer, 1) < 0)
+	    return -1;
+	return 0;
+    }
+
     /* Send USB header */
     if ((ret = usb_bulk_write(myDevHandle, usb_endpoint, usb_hdr, 12, usb_timeout)) < 0) {
 	error("%s: Error occurred while writing data to device.", Name);
@@ -289,13 +336,13 @@ static void drv_SamsungSPF_blit(const int row, const int col, const int height,
     int r, c;
 
     for (r = row; r < row + height; r++) {
-	for (c = col; c < col + width; c++) {
-	    RGB p1 = image.buf[r * myFrame->xRes + c];
+	RGB *p1 = image.buf + r * myFrame->xRes + col;
+	for (c = col; c < col + width; c++, p1++) {
 	    RGBA p2 = drv_generic_graphic_rgb(r, c);
-	    if (p1.R != p2.R || p1.G != p2.G || p1.B != p2.B) {
-		image.buf[r * myFrame->xRes + c].R = p2.R;
-		image.buf[r * myFrame->xRes + c].G = p2.G;
-		image.buf[r * myFrame->xRes + c].B = p2.B;
+	    if (p1->R != p2.R || p1->G != p2.G || p1->B != p2.B) {
+		p1->R = p2.R;
+		p1->G = p2.G;
+		p1->B = p2.B;
 		image.dirty = 1;
 	    }
 	}
@@ -307,15 +354,28 @@ static void drv_SamsungSPF_timer( __attribute__ ((unused))
 				 void *notused)
 {
     if (image.dirty) {
+	STATS_TIME t;
+	uint64_t hash;
+
+	/* Clean dirty bit */
+	image.dirty = 0;
+
+	/* pixels may have changed back to the frame on the display */
+	hash = drv_SamsungSPF_hash();
+	if (hash == image.hash)
+	    return;
+	image.hash = hash;
+
 	debug("FB dirty, writing jpeg...");
+	STATS_BEGIN(t);
 	convert2JPG();
 
 	/* Sent image to display */
 	if ((drv_SamsungSPF_send((char *) jpegImage.buf, jpegImage.size)) != 0) {
 	    error("%s: Error occurred while sending jpeg image to device.", Name);
 	}
-	/* Clean dirty bit */
-	image.dirty = 0;
+	STATS_END(Stats, t);
+	stats_count(Stats, jpegImage.size);
 
 	/* Free JPEG buffer since a new is allocated each time an image is 
 	   compressed */
@@ -335,6 +395,8 @@ static int drv_SamsungSPF_start(const char *section)
     cfg_number(section, "update", timerInterval, 0, -1, &timerInterval);
     debug("Updating display every %dms", timerInterval);
 
+    cfg_number(section, "Quality", 100, 0, 100, &image.quality);
+
     DROWS = myFrame->yRes;
     DCOLS = myFrame->xRes;
     info("%s: Using SPF with %dx%d pixels.", Name, DCOLS, DROWS);
@@ -363,6 +425,7 @@ static int drv_SamsungSPF_start(const char *section)
     image.buf = malloc(image.fbsize);
     memset(image.buf, 128, image.fbsize);
     image.dirty = 0;
+    image.hash = 0;
 
     /* JPEG buffer is allocated by jpeglib */
     jpegImage.buf = 0;
@@ -438,16 +501,31 @@ int drv_SamsungSPF_init(const char *section, const int quiet)
 
     free(s);
 
-    /* try to open USB device */
-    drv_SamsungSPF_find();
-    if (!myDev) {
-	error("%s: No Samsung '%s' found!", Name, myFrame->type);
-	return -1;
-    }
+    Stats = stats_register("write", Name);
 
-    /* open display and switch to monitor mode if necessary */
-    if (drv_SamsungSPF_open() == -1)
-	return -1;
+    /* loopback mode: write the transfers to a file instead of the device */
+    s = cfg_get(section, "Loopback", NULL);
+    if (s != NULL && *s != '\0') {
+	loopFd = open(s, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (loopFd < 0) {
+	    error("%s: cannot open loopback file %s: %s", Name, s, strerror(errno));
+	    free(s);
+	    return -1;
+	}
+	info("%s: loopback mode, writing to %s", Name, s);
+    } else {
+	/* try to open USB device */
+	drv_SamsungSPF_find();
+	if (!myDev) {
+	    error("%s: No Samsung '%s' found!", Name, myFrame->type);
+	    return -1;
+	}
+
+	/* open display and switch to monitor mode if necessary */
+	if (drv_SamsungSPF_open() == -1)
+	    return -1;
+    }
+    free(s);
 
     int ret;
 
@@ -492,11 +570,20 @@ int drv_SamsungSPF_quit(const int quiet)
 
     drv_generic_graphic_quit();
 
+    /* send the last frame */
+    timer_remove(drv_SamsungSPF_timer, NULL);
+    drv_SamsungSPF_timer(NULL);
+
     debug("closing connection");
     printf("%s: Closing driver...\n", Name);
-    usb_close(myDevHandle);
-    free(myDev);
-    free(myDevHandle);
+    if (loopFd >= 0) {
+	close(loopFd);
+	loopFd = -1;
+    } else {
+	usb_close(myDevHandle);
+	free(myDev);
+	free(myDevHandle);
+    }
 
     return (0);
 }
@@ -0,0 +1,413 @@
+/* $Id$
+ * $URL$
+ *
+ * shared memory framebuffer driver for local consumers
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/* 
+ *
+ * exported fuctions:
+ *
+ * struct DRIVER drv_Shm
+ *
+ */
+
+/*
+ * The composited framebuffer is published in a POSIX shared memory
+ * object (see lcd4linux_shm.h for the layout), so recorders, bridges
+ * or test harnesses on the same host can read the frames in place
+ * without any encoding. Blits only collect the damaged areas; a timer
+ * copies them into the shared memory once per frame under a sequence
+ * lock and optionally writes the frame number to a FIFO to wake up
+ * the consumers.
+ *
+ * Display Shm {
+ *     Driver 'Shm'
+ *     Size   '240x64'
+ *     Font   '6x8'
+ *     Object '/lcd4linux'         (name of the shared memory object)
+ *     Fifo   '/tmp/lcd4linux.fb'  (optional notification FIFO)
+ *     Maxfps 50
+ * }
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "debug.h"
+#include "cfg.h"
+#include "timer.h"
+#include "qprintf.h"
+#include "stats.h"
+#include "drv.h"
+#include "drv_generic_graphic.h"
+#include "lcd4linux_shm.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+/* frame rate if Maxfps is not set */
+#define DEFAULT_FPS 50
+
+static char Name[] = "Shm";
+
+static char *Object = NULL;	/* name of the shared memory object */
+static char *Fifo = NULL;	/* notification FIFO */
+static int FifoFd = -1;
+
+static SHM_FB_HEADER *Header = NULL;
+static unsigned char *Pixels = NULL;
+static size_t Size = 0;
+
+static DAMAGE Damage;
+static int everything = 1;	/* the whole framebuffer is damaged */
+static int Stats = -1;
+
+
+/****************************************/
+/***  hardware dependant functions    ***/
+/****************************************/
+
+static void drv_Shm_notify(void)
+{
+    char buffer[16];
+    int len;
+
+    if (Fifo == NULL)
+	return;
+
+    /* a FIFO can only be opened for writing when there is a reader */
+    if (FifoFd < 0) {
+	FifoFd = open(Fifo, O_WRONLY | O_NONBLOCK);
+	if (FifoFd < 0) {
+	    if (errno != ENXIO)
+		error("%s: open(%s) failed: %s", Name, Fifo, strerror(errno));
+	    return;
+	}
+    }
+
+    len = qprintf(buffer, sizeof(buffer), "%u\n", Header->frame);
+
+    /* a full FIFO means the reader is behind: it will find the latest frame anyway */
+    if (write(FifoFd, buffer, len) < 0 && errno != EAGAIN) {
+	/* reader went away */
+	close(FifoFd);
+	FifoFd = -1;
+    }
+}
+
+
+static void drv_Shm_copy(const int x1, const int y1, const int x2, const int y2)
+{
+    int r, c;
+
+    for (r = y1; r < y2; r++) {
+	unsigned char *p = Pixels + r * Header->stride + 4 * x1;
+	for (c = x1; c < x2; c++) {
+	    RGBA rgb = drv_generic_graphic_rgb(r, c);
+	    *p++ = rgb.R;
+	    *p++ = rgb.G;
+	    *p++ = rgb.B;
+	    *p++ = rgb.A;
+	}
+    }
+}
+
+
+/* publish the damage collected since the last frame */
+static void drv_Shm_frame( __attribute__ ((unused))
+			  void *notused)
+{
+    struct timespec now;
+    STATS_TIME t;
+    long bytes = 0;
+    int i;
+
+    if (!everything && Damage.count == 0)
+	return;
+
+    STATS_BEGIN(t);
+
+    /* odd sequence: frame in progress */
+    __sync_fetch_and_add(&Header->seq, 1);
+
+    if (everything) {
+	drv_Shm_copy(0, 0, DCOLS, DROWS);
+	Header->nrects = 0;
+	bytes = Header->stride * DROWS;
+    } else {
+	for (i = 0; i < Damage.count; i++) {
+	    DAMAGE_RECT *R = &Damage.rect[i];
+	    drv_Shm_copy(R->x1, R->y1, R->x2, R->y2);
+	    Header->rect[i].x = R->x1;
+	    Header->rect[i].y = R->y1;
+	    Header->rect[i].width = R->x2 - R->x1;
+	    Header->rect[i].height = R->y2 - R->y1;
+	    bytes += 4 * (R->x2 - R->x1) * (R->y2 - R->y1);
+	}
+	Header->nrects = Damage.count;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    Header->timestamp = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+    Header->frame++;
+
+    /* even sequence: frame complete */
+    __sync_fetch_and_add(&Header->seq, 1);
+
+    Damage.count = 0;
+    everything = 0;
+
+    STATS_END(Stats, t);
+    stats_count(Stats, bytes);
+
+    drv_Shm_notify();
+}
+
+
+static void drv_Shm_blit(const int row, const int col, const int height, const int width)
+{
+    drv_generic_graphic_damage(&Damage, row, col, height, width);
+}
+
+
+static int drv_Shm_open(void)
+{
+    size_t offset;
+    int fd;
+
+    /* pixels start at the next cache line */
+    offset = (sizeof(SHM_FB_HEADER) + 63) & ~63;
+    Size = offset + 4 * DCOLS * DROWS;
+
+    fd = shm_open(Object, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+	error("%s: shm_open(%s) failed: %s", Name, Object, strerror(errno));
+	return -1;
+    }
+
+    if (ftruncate(fd, Size) < 0) {
+	error("%s: ftruncate(%s) failed: %s", Name, Object, strerror(errno));
+	close(fd);
+	return -1;
+    }
+
+    Header = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (Header == MAP_FAILED) {
+	error("%s: mmap(%s) failed: %s", Name, Object, strerror(errno));
+	Header = NULL;
+	return -1;
+    }
+
+    /* an odd sequence keeps readers away while the header is set up */
+    Header->seq |= 1;
+    __sync_synchronize();
+
+    Header->magic = SHM_FB_MAGIC;
+    Header->version = SHM_FB_VERSION;
+    Header->width = DCOLS;
+    Header->height = DROWS;
+    Header->stride = 4 * DCOLS;
+    Header->format = SHM_FB_RGBA;
+    Header->offset = offset;
+    Header->frame = 0;
+    Header->nrects = 0;
+    Header->timestamp = 0;
+    memset((unsigned char *) Header + offset, 0, Size - offset);
+
+    __sync_fetch_and_add(&Header->seq, 1);
+
+    Pixels = (unsigned char *) Header + offset;
+
+    return 0;
+}
+
+
+static int drv_Shm_close(void)
+{
+    if (FifoFd >= 0) {
+	close(FifoFd);
+	FifoFd = -1;
+    }
+
+    if (Header != NULL) {
+	munmap(Header, Size);
+	Header = NULL;
+	Pixels = NULL;
+    }
+
+    if (Object != NULL) {
+	shm_unlink(Object);
+	free(Object);
+	Object = NULL;
+    }
+
+    if (Fifo != NULL) {
+	free(Fifo);
+	Fifo = NULL;
+    }
+
+    return 0;
+}
+
+
+static int drv_Shm_start(const char *section)
+{
+    char *s;
+    int fps;
+
+    if (sscanf(s = cfg_get(section, "Size", "240x64"), "%dx%d", &DCOLS, &DROWS) != 2 || DCOLS < 1 || DROWS < 1) {
+	error("%s: bad %s.Size '%s' from %s", Name, section, s, cfg_source());
+	free(s);
+	return -1;
+    }
+    free(s);
+
+    if (sscanf(s = cfg_get(section, "Font", "6x8"), "%dx%d", &XRES, &YRES) != 2 || XRES < 1 || YRES < 1) {
+	error("%s: bad %s.Font '%s' from %s", Name, section, s, cfg_source());
+	free(s);
+	return -1;
+    }
+    free(s);
+
+    Object = cfg_get(section, "Object", "/lcd4linux");
+    if (*Object != '/') {
+	error("%s: bad %s.Object '%s' from %s (must start with '/')", Name, section, Object, cfg_source());
+	return -1;
+    }
+
+    Fifo = cfg_get(section, "Fifo", NULL);
+    if (Fifo != NULL && *Fifo == '\0') {
+	free(Fifo);
+	Fifo = NULL;
+    }
+    if (Fifo != NULL) {
+	/* a reader going away must not kill us */
+	signal(SIGPIPE, SIG_IGN);
+    }
+
+    cfg_number(section, "Maxfps", DEFAULT_FPS, 1, 1000, &fps);
+
+    if (drv_Shm_open() < 0)
+	return -1;
+
+    info("%s: publishing %dx%d framebuffer as %s", Name, DCOLS, DROWS, Object);
+
+    Stats = stats_register("write", Name);
+    timer_add(drv_Shm_frame, NULL, 1000 / fps, 0);
+
+    return 0;
+}
+
+
+/****************************************/
+/***            plugins               ***/
+/****************************************/
+
+/* none at the moment... */
+
+
+/****************************************/
+/***        exported functions        ***/
+/****************************************/
+
+
+/* list models */
+int drv_Shm_list(void)
+{
+    printf("POSIX shared memory");
+    return 0;
+}
+
+
+/* initialize driver & display */
+int drv_Shm_init(const char *section, const int quiet)
+{
+    int ret;
+
+    info("%s: %s", Name, "$Rev$");
+
+    /* real worker functions */
+    drv_generic_graphic_real_blit = drv_Shm_blit;
+
+    /* start display */
+    if ((ret = drv_Shm_start(section)) != 0)
+	return ret;
+
+    /* initialize generic graphic driver */
+    if ((ret = drv_generic_graphic_init(section, Name)) != 0)
+	return ret;
+
+    if (!quiet) {
+	char buffer[40];
+	qprintf(buffer, sizeof(buffer), "%s %dx%d", Name, DCOLS, DROWS);
+	if (drv_generic_graphic_greet(buffer, NULL)) {
+	    sleep(3);
+	    drv_generic_graphic_clear();
+	}
+    }
+
+    return 0;
+}
+
+
+/* close driver & display */
+int drv_Shm_quit(const int quiet)
+{
+    info("%s: shutting down.", Name);
+
+    drv_generic_graphic_clear();
+
+    if (!quiet) {
+	drv_generic_graphic_greet("goodbye!", NULL);
+    }
+
+    /* publish the last frame */
+    timer_remove(drv_Shm_frame, NULL);
+    drv_Shm_frame(NULL);
+
+    drv_generic_graphic_quit();
+    drv_Shm_close();
+
+    return (0);
+}
+
+
+DRIVER drv_Shm = {
+    .name = Name,
+    .list = drv_Shm_list,
+    .init = drv_Shm_init,
+    .quit = drv_Shm_quit,
+};
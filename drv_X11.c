@@ -47,10 +47,17 @@
 #include <fcntl.h>
 #include <sys/time.h>
 #include <signal.h>
+#include <stdint.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xresource.h>
 
+#ifdef HAVE_X11_EXTENSIONS_XSHM_H
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#endif
+
 #include "debug.h"
 #include "cfg.h"
 #include "qprintf.h"
@@ -62,6 +69,7 @@
 #include "widget_keypad.h"
 #include "drv_generic_graphic.h"
 #include "drv_generic_keypad.h"
+#include "stats.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -69,6 +77,9 @@
 
 static char Name[] = "X11";
 
+/* frame rate if Maxfps is not set */
+#define DEFAULT_FPS 50
+
 static int pixel = -1;		/* pointsize in pixel */
 static int pgap = 0;		/* gap between points */
 static int rgap = 0;		/* row gap between lines */
@@ -83,6 +94,23 @@ static Atom wmDeleteMessage;
 
 static RGBA *drv_X11_FB = NULL;	/* framebuffer */
 
+static XImage *xi = NULL;	/* client side copy of the LCD area */
+static int fast = 0;		/* image pixels can be stored as 32 bit words */
+static DAMAGE Damage;		/* areas changed since the last frame */
+static int Brightness = 255;
+static int Stats = -1;
+
+/* bit position and width of red, green and blue in a TrueColor pixel */
+static int shift[3], bits[3];
+
+#ifdef HAVE_X11_EXTENSIONS_XSHM_H
+static XShmSegmentInfo shminfo;
+static int shm = 0;		/* image lives in a MIT-SHM segment */
+static int shm_event = 0;	/* ShmCompletion event type */
+static int shm_busy = 0;	/* the server still reads the last frame */
+static int shm_failed = 0;	/* XShmAttach() raised an error */
+#endif
+
 static RGBA BP_COL = {.R = 0xff,.G = 0xff,.B = 0xff,.A = 0x00 };	/* pixel background color */
 static RGBA BR_COL = {.R = 0xff,.G = 0xff,.B = 0xff,.A = 0x00 };	/* border color */
 
@@ -110,7 +138,7 @@ static XrmDatabase commandlineDB;
 /***  hardware dependant functions    ***/
 /****************************************/
 
-static XColor drv_X11_color(RGBA c, int brightness)
+static XColor drv_X11_alloc(RGBA c, int brightness)
 {
     static XColor col[64];
     static unsigned char alloced[64] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -138,36 +166,186 @@ static XColor drv_X11_color(RGBA c, int brightness)
 	alloced[key] = 1;
     }
 
+    return (xc);
+}
+
+
+static XColor drv_X11_color(RGBA c, int brightness)
+{
+    XColor xc = drv_X11_alloc(c, brightness);
+
     XSetForeground(dp, gc, xc.pixel);
 
     return (xc);
 }
 
 
+/* pixel value of a color in the image */
+static unsigned long drv_X11_pixel(const RGBA c)
+{
+    unsigned long p = 0;
+    unsigned int v[3];
+    int i;
+
+    /* TrueColor pixels are computed, everything else goes through the colormap */
+    if (vi->class != TrueColor)
+	return drv_X11_alloc(c, Brightness).pixel;
+
+    v[0] = c.R * Brightness / 255;
+    v[1] = c.G * Brightness / 255;
+    v[2] = c.B * Brightness / 255;
+
+    for (i = 0; i < 3; i++) {
+	if (bits[i] < 8)
+	    v[i] >>= 8 - bits[i];
+	else
+	    v[i] <<= bits[i] - 8;
+	p |= (unsigned long) v[i] << shift[i];
+    }
+
+    return p;
+}
+
+
+/* screen position of a LCD pixel */
+static int drv_X11_x(const int col)
+{
+    return border + (col / XRES) * cgap + col * (pixel + pgap);
+}
+
+static int drv_X11_y(const int row)
+{
+    return border + (row / YRES) * rgap + row * (pixel + pgap);
+}
+
+
+/* fill a rectangle of the image, one span per line */
+static void drv_X11_fill(const int x, const int y, const int width, const int height, const unsigned long p)
+{
+    int i, j;
+
+    for (j = y; j < y + height; j++) {
+	if (fast) {
+	    uint32_t *span = (uint32_t *) (xi->data + j * xi->bytes_per_line) + x;
+	    for (i = 0; i < width; i++)
+		span[i] = p;
+	} else {
+	    for (i = x; i < x + width; i++)
+		XPutPixel(xi, i, j, p);
+	}
+    }
+}
+
+
+/* copy part of the image to the window */
+static void drv_X11_put(const int x, const int y, const int width, const int height, const int notify)
+{
+#ifdef HAVE_X11_EXTENSIONS_XSHM_H
+    if (shm) {
+	/* the completion event tells us when the server is done with the segment */
+	XShmPutImage(dp, w, gc, xi, x, y, x, y, width, height, notify ? True : False);
+	if (notify)
+	    shm_busy = 1;
+	return;
+    }
+#else
+    (void) notify;
+#endif
+    XPutImage(dp, w, gc, xi, x, y, x, y, width, height);
+}
+
+
+/* push the damage collected since the last frame */
+static void drv_X11_frame( __attribute__ ((unused))
+			  void *notused)
+{
+    STATS_TIME t;
+    long bytes = 0;
+    int i;
+
+    if (Damage.count == 0)
+	return;
+
+#ifdef HAVE_X11_EXTENSIONS_XSHM_H
+    /* keep collecting until the server has read the last frame */
+    if (shm_busy)
+	return;
+#endif
+
+    STATS_BEGIN(t);
+
+    for (i = 0; i < Damage.count; i++) {
+	DAMAGE_RECT *R = &Damage.rect[i];
+	int x = drv_X11_x(R->x1);
+	int y = drv_X11_y(R->y1);
+	int width = drv_X11_x(R->x2 - 1) + pixel - x;
+	int height = drv_X11_y(R->y2 - 1) + pixel - y;
+	drv_X11_put(x, y, width, height, i == Damage.count - 1);
+	bytes += width * height * xi->bits_per_pixel / 8;
+    }
+    Damage.count = 0;
+
+    XFlush(dp);
+
+    STATS_END(Stats, t);
+    stats_count(Stats, bytes);
+}
+
+
 static void drv_X11_blit(const int row, const int col, const int height, const int width)
 {
     int r, c;
+    int r1 = row + height, c1 = col + width;
+    int r2 = -1, c2 = -1;
 
     for (r = row; r < row + height; r++) {
-	int y = border + (r / YRES) * rgap + r * (pixel + pgap);
+	int y = drv_X11_y(r);
 	for (c = col; c < col + width; c++) {
-	    int x = border + (c / XRES) * cgap + c * (pixel + pgap);
 	    RGBA p1 = drv_X11_FB[r * DCOLS + c];
 	    RGBA p2 = drv_generic_graphic_rgb(r, c);
 	    if (p1.R != p2.R || p1.G != p2.G || p1.B != p2.B) {
-		XClearArea(dp, w, x, y, pixel, pixel, 1);
+		drv_X11_fill(drv_X11_x(c), y, pixel, pixel, drv_X11_pixel(p2));
 		drv_X11_FB[r * DCOLS + c] = p2;
+		/* bounding box of the changed pixels */
+		if (r < r1)
+		    r1 = r;
+		if (r > r2)
+		    r2 = r;
+		if (c < c1)
+		    c1 = c;
+		if (c > c2)
+		    c2 = c;
 	    }
 	}
     }
+
+    if (r2 >= 0)
+	drv_generic_graphic_damage(&Damage, r1, c1, r2 - r1 + 1, c2 - c1 + 1);
 }
 
 
-static int drv_X11_brightness(int brightness)
+/* paint the whole image from scratch */
+static void drv_X11_repaint(void)
 {
-    static int Brightness = 255;
-    int i;
+    int r, c;
+
+    drv_X11_fill(0, 0, xi->width, xi->height, drv_X11_pixel(BR_COL));
 
+    for (r = 0; r < DROWS; r++) {
+	for (c = 0; c < DCOLS; c++) {
+	    /* before the generic driver is up, every pixel is inactive */
+	    RGBA p = LROWS > 0 ? drv_generic_graphic_rgb(r, c) : BL_COL;
+	    drv_X11_fill(drv_X11_x(c), drv_X11_y(r), pixel, pixel, drv_X11_pixel(p));
+	    drv_X11_FB[r * DCOLS + c] = p;
+	}
+    }
+
+    drv_generic_graphic_damage(&Damage, 0, 0, DROWS, DCOLS);
+}
+
+
+static int drv_X11_brightness(int brightness)
+{
     /* -1 is used to query the current brightness */
     if (brightness == -1)
 	return Brightness;
@@ -183,18 +361,17 @@ static int drv_X11_brightness(int brightness)
 
 	debug("%s: set brightness to %d%%", Name, (int) (dim * 100));
 
+	/* remember new brightness */
+	Brightness = brightness;
+
 	/* set new background */
-	XSetWindowBackground(dp, w, drv_X11_color(BR_COL, brightness).pixel);
+	XSetWindowBackground(dp, w, drv_X11_alloc(BR_COL, brightness).pixel);
 
 	/* redraw every LCD pixel */
-	XClearWindow(dp, w);
-	for (i = 0; i < DROWS * DCOLS; i++) {
-	    drv_X11_FB[i] = NO_COL;
-	}
-	drv_X11_blit(0, 0, LROWS, LCOLS);
+	drv_X11_repaint();
 
-	/* remember new brightness */
-	Brightness = brightness;
+	/* the keypad area shows the window background */
+	XClearArea(dp, w, xi->width, 0, 0, 0, 1 /* true */ );
     }
 
     return Brightness;
@@ -245,13 +422,11 @@ static void drv_X11_expose(const int x, const int y, const int width, const int
 {
     /*
      * theory of operation:
-     * instead of the old, fully-featured but complicated update
-     * region calculation, we do an update of the whole display,
-     * but check before every pixel if the pixel region is inside
-     * the update region.
+     * the image always holds the current LCD contents,
+     * so exposed parts of it are just copied again.
      */
 
-    int r, c;
+    int r;
     int x0, y0;
     int x1, y1;
     XFontStruct *xfs;
@@ -260,55 +435,17 @@ static void drv_X11_expose(const int x, const int y, const int width, const int
     int yk;
     char *s;
     char unknownTxt[10];
-    XRectangle rect[DROWS * DCOLS];
-    int nrect = 0;
-    RGBA col;
-    RGBA lastCol = { 0, 0, 0, 0 };
-    int hasLastCol = 0;
-    int brightness = drv_X11_brightness(-1);
-
-    x0 = x - pixel;
-    x1 = x + pixel + width;
-    y0 = y - pixel;
-    y1 = y + pixel + height;
 
-    for (r = 0; r < DROWS; r++) {
-	int yc = border + (r / YRES) * rgap + r * (pixel + pgap);
-	if (yc < y0 || yc > y1)
-	    continue;
-	for (c = 0; c < DCOLS; c++) {
-	    int xc = border + (c / XRES) * cgap + c * (pixel + pgap);
-	    if (xc < x0 || xc > x1)
-		continue;
-	    col = drv_generic_graphic_rgb(r, c);
-	    if (hasLastCol) {
-		/* if the color of this pixel is different to the last pixels draw the old ones */
-		if (col.R != lastCol.R || col.G != lastCol.G || col.B != lastCol.B) {
-		    drv_X11_color(lastCol, brightness);
-		    XFillRectangles(dp, w, gc, rect, nrect);
-		    nrect = 0;
-		    lastCol = col;
-		}
-		rect[nrect].x = xc;
-		rect[nrect].y = yc;
-		rect[nrect].width = pixel;
-		rect[nrect].height = pixel;
-		nrect++;
-	    } else {
-		/* 1st shot: no old color */
-		drv_X11_color(col, brightness);
-		XFillRectangle(dp, w, gc, xc, yc, pixel, pixel);
-		lastCol = col;
-		hasLastCol = 1;
-	    }
-	}
-    }
-    /* draw the last block of rectangles */
-    drv_X11_color(lastCol, brightness);
-    XFillRectangles(dp, w, gc, rect, nrect);
+    x0 = MAX(x, 0);
+    y0 = MAX(y, 0);
+    x1 = MIN(x + width, xi->width);
+    y1 = MIN(y + height, xi->height);
+
+    if (x1 > x0 && y1 > y0)
+	drv_X11_put(x0, y0, x1 - x0, y1 - y0, 0);
 
     /* Keypad on the right side */
-    if (x1 >= xoffset) {
+    if (x + width >= xoffset) {
 	xfs = XQueryFont(dp, XGContextFromGC(DefaultGC(dp, 0)));
 	if (drv_X11_brightness(-1) > 127) {
 	    drv_X11_color(FG_COL, 255);
@@ -359,6 +496,12 @@ static void drv_X11_timer( __attribute__ ((unused))
     int yoffset = border + (DROWS / YRES) * rgap;
     static int btn = 0;
 
+#ifdef HAVE_X11_EXTENSIONS_XSHM_H
+    /* the server has read the last frame from the segment */
+    if (shm_busy && XCheckTypedEvent(dp, shm_event, &ev))
+	shm_busy = 0;
+#endif
+
     if (XCheckWindowEvent
 	(dp, w, ExposureMask | KeyPressMask | KeyReleaseMask | ButtonPressMask | ButtonReleaseMask, &ev) == 0
 	/* there is no ClientMessageMask, so this will be checked separately */
@@ -522,8 +665,135 @@ static void drv_X11_timer( __attribute__ ((unused))
 }
 
 
+#ifdef HAVE_X11_EXTENSIONS_XSHM_H
+static int drv_X11_shm_error( __attribute__ ((unused)) Display * display, __attribute__ ((unused)) XErrorEvent * event)
+{
+    shm_failed = 1;
+    return 0;
+}
+
+
+/* create the image in a shared memory segment, remote displays will refuse */
+static XImage *drv_X11_shm_image(const int width, const int height)
+{
+    XErrorHandler handler;
+    XImage *image;
+
+    if (!XShmQueryExtension(dp))
+	return NULL;
+
+    image = XShmCreateImage(dp, vi, dd, ZPixmap, NULL, &shminfo, width, height);
+    if (image == NULL)
+	return NULL;
+
+    shminfo.shmid = shmget(IPC_PRIVATE, image->bytes_per_line * image->height, IPC_CREAT | 0600);
+    if (shminfo.shmid < 0) {
+	error("%s: shmget() failed: %s", Name, strerror(errno));
+	XDestroyImage(image);
+	return NULL;
+    }
+
+    shminfo.shmaddr = image->data = shmat(shminfo.shmid, NULL, 0);
+    shminfo.readOnly = False;
+
+    /* the segment goes away with the last detach */
+    shmctl(shminfo.shmid, IPC_RMID, NULL);
+
+    if (shminfo.shmaddr == (char *) -1) {
+	error("%s: shmat() failed: %s", Name, strerror(errno));
+	image->data = NULL;
+	XDestroyImage(image);
+	return NULL;
+    }
+
+    shm_failed = 0;
+    handler = XSetErrorHandler(drv_X11_shm_error);
+    XShmAttach(dp, &shminfo);
+    XSync(dp, False);
+    XSetErrorHandler(handler);
+
+    if (shm_failed) {
+	shmdt(shminfo.shmaddr);
+	image->data = NULL;
+	XDestroyImage(image);
+	return NULL;
+    }
+
+    shm_event = XShmGetEventBase(dp) + ShmCompletion;
+    shm = 1;
+
+    return image;
+}
+#endif
+
+
+/* client side image of the LCD area */
+static int drv_X11_image(const char *section)
+{
+    int width = dimx + 2 * border;
+    int height = dimy + 2 * border;
+    int one = 1;
+    int i;
+
+    if (vi->class == TrueColor) {
+	unsigned long mask[3];
+	mask[0] = vi->red_mask;
+	mask[1] = vi->green_mask;
+	mask[2] = vi->blue_mask;
+	for (i = 0; i < 3; i++) {
+	    shift[i] = 0;
+	    bits[i] = 0;
+	    while (mask[i] && !(mask[i] & 1)) {
+		mask[i] >>= 1;
+		shift[i]++;
+	    }
+	    while (mask[i] & 1) {
+		mask[i] >>= 1;
+		bits[i]++;
+	    }
+	}
+    }
+
+    xi = NULL;
+
+#ifdef HAVE_X11_EXTENSIONS_XSHM_H
+    if (cfg_number(section, "Shm", 1, 0, 1, &i) > 0 && i) {
+	xi = drv_X11_shm_image(width, height);
+	if (xi == NULL)
+	    info("%s: MIT-SHM not available, using XPutImage()", Name);
+    }
+#else
+    (void) section;
+#endif
+
+    if (xi == NULL) {
+	xi = XCreateImage(dp, vi, dd, ZPixmap, 0, NULL, width, height, 32, 0);
+	if (xi == NULL) {
+	    error("%s: XCreateImage() failed", Name);
+	    return -1;
+	}
+	xi->data = malloc(xi->bytes_per_line * xi->height);
+	if (xi->data == NULL) {
+	    error("%s: image could not be allocated: malloc() failed", Name);
+	    XDestroyImage(xi);
+	    xi = NULL;
+	    return -1;
+	}
+    }
+
+    /* 32 bit pixels in host byte order can be written directly */
+    fast = xi->bits_per_pixel == 32 && xi->byte_order == (*(char *) &one ? LSBFirst : MSBFirst);
+
+    Damage.count = 0;
+    drv_X11_repaint();
+
+    return 0;
+}
+
+
 static int drv_X11_start(const char *section)
 {
+    int fps;
     int i;
     char *s;
     XrmValue value;
@@ -629,8 +899,8 @@ static int drv_X11_start(const char *section)
     rw = DefaultRootWindow(dp);
     cm = DefaultColormap(dp, sc);
 
-    dimx = DCOLS * pixel + (DCOLS - 1) * pgap + (DCOLS / XRES - 1) * cgap;
-    dimy = DROWS * pixel + (DROWS - 1) * pgap + (DROWS / YRES - 1) * rgap;
+    dimx = DCOLS * pixel + (DCOLS - 1) * pgap + ((DCOLS - 1) / XRES) * cgap;
+    dimy = DROWS * pixel + (DROWS - 1) * pgap + ((DROWS - 1) / YRES) * rgap;
     if (buttons != 0) {
 	btnwidth = (DCOLS * pixel + (DCOLS - 1) * pgap) / 10;
 	btnheight = (DROWS * pixel + (DROWS - 1) * pgap) / buttons;
@@ -661,6 +931,9 @@ static int drv_X11_start(const char *section)
     XSetWindowBackground(dp, w, drv_X11_color(BR_COL, 255).pixel);
     XClearWindow(dp, w);
 
+    if (drv_X11_image(section) < 0)
+	return -1;
+
     /* set brightness (after first background painting) */
     if (cfg_number(section, "Brightness", 255, 0, 255, &i) > 0) {
 	drv_X11_brightness(i);
@@ -681,6 +954,10 @@ static int drv_X11_start(const char *section)
     /* Fixme: make 20msec configurable */
     timer_add(drv_X11_timer, NULL, 20, 0);
 
+    /* push changes once per frame */
+    cfg_number(section, "Maxfps", DEFAULT_FPS, 1, 1000, &fps);
+    timer_add(drv_X11_frame, NULL, 1000 / fps, 0);
+
     return 0;
 }
 
@@ -740,6 +1017,8 @@ int drv_X11_init(const char *section, const int quiet)
 
     info("%s: %s", Name, "$Rev$");
 
+    Stats = stats_register("write", Name);
+
     /* start display */
     if ((ret = drv_X11_start(section)) != 0)
 	return ret;
@@ -769,6 +1048,7 @@ int drv_X11_init(const char *section, const int quiet)
 	qprintf(buffer, sizeof(buffer), "%s %dx%d", Name, DCOLS, DROWS);
 	if (drv_generic_graphic_greet(buffer, NULL)) {
 	    drv_X11_expose(0, 0, dimx + 2 * border, dimy + 2 * border);
+	    XFlush(dp);
 	    sleep(3);
 	    drv_generic_graphic_clear();
 	}
@@ -791,6 +1071,24 @@ int drv_X11_quit(const __attribute__ ((unused))
     drv_generic_graphic_quit();
     drv_generic_keypad_quit();
 
+    timer_remove(drv_X11_frame, NULL);
+    timer_remove(drv_X11_timer, NULL);
+
+    if (xi) {
+#ifdef HAVE_X11_EXTENSIONS_XSHM_H
+	if (shm) {
+	    XShmDetach(dp, &shminfo);
+	    XSync(dp, False);
+	    shmdt(shminfo.shmaddr);
+	    xi->data = NULL;
+	    shm = 0;
+	    shm_busy = 0;
+	}
+#endif
+	XDestroyImage(xi);
+	xi = NULL;
+    }
+
     if (drv_X11_FB) {
 	free(drv_X11_FB);
 	drv_X11_FB = NULL;
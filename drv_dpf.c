@@ -46,6 +46,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include "debug.h"
 #include "cfg.h"
@@ -56,7 +57,9 @@
 #include "widget_text.h"
 #include "widget_icon.h"
 #include "widget_bar.h"
+#include "timer.h"
 #include "drv.h"
+#include "stats.h"
 
 #include "drv_generic_graphic.h"
 
@@ -80,6 +83,19 @@
  */
 DPFAXHANDLE dpf_ax_open(const char *device);
 
+/**
+ * Open a loopback device.
+ *
+ * Instead of talking to a dpf over USB, every transfer is appended
+ * to a file, which allows to verify the bytes sent to the device.
+ *
+ * \param file		file receiving the transfers
+ * \param width	display width
+ * \param height	display height
+ * \return		device handle or NULL
+ */
+DPFAXHANDLE dpf_ax_loopback(const char *file, int width, int height);
+
 /**
  *  Close DPF device.
  */
@@ -117,6 +133,9 @@ int dpf_ax_getheight(DPFAXHANDLE h);
 
 static char Name[] = "DPF";
 
+/* frame rate if Maxfps is not set */
+#define DEFAULT_FPS 50
+
 
 /*
  * Dpf status
@@ -133,15 +152,19 @@ static struct {
     int rotate90;
     int flip;
 
-    // Current dirty rectangle
-    int minx, maxx;
-    int miny, maxy;
+    // Offset in lcdBuf between two logical pixels of a row
+    int step;
+
+    // Dirty rectangles (physical coordinates)
+    DAMAGE damage;
 
     // Config properties
     int orientation;
     int backlight;
 } dpf;
 
+static int Stats = -1;
+
 
 // Convert RGBA pixel to RGB565 pixel(s)
 
@@ -149,22 +172,14 @@ static struct {
 #define _RGB565_1(p) (( ((p.G) & 0x1c) << 3 ) | (((p.B) & 0xf8) >> 3))
 
 /*
- * Set one pixel in lcdBuf.
- * 
- * Respects orientation and updates dirty rectangle.
+ * Offset of a logical pixel in lcdBuf.
  *
- * in:	x, y - pixel coordinates
- * 	pix  - RGBA pixel value
- * out:	-
+ * Translates logical to physical orientation.
  */
-static void drv_set_pixel(int x, int y, RGBA pix)
+static int drv_dpf_offset(int x, int y, int *px, int *py)
 {
-    int changed = 0;
-
-    int sx = DCOLS;
-    int sy = DROWS;
-    int lx = x % sx;
-    int ly = y % sy;
+    int lx = x;
+    int ly = y;
 
     if (dpf.flip) {
 	// upside down orientation
@@ -179,73 +194,123 @@ static void drv_set_pixel(int x, int y, RGBA pix)
 	lx = i;
     }
 
-    if (lx < 0 || lx >= (int) dpf.pwidth || ly < 0 || ly >= (int) dpf.pheight) {
-	error("dpf: x/y out of bounds (x=%d, y=%d, rot=%d, flip=%d, lx=%d, ly=%d)\n", x, y, dpf.rotate90, dpf.flip, lx,
-	      ly);
-	return;
-    }
+    if (px)
+	*px = lx;
+    if (py)
+	*py = ly;
 
-    unsigned char c1 = _RGB565_0(pix);
-    unsigned char c2 = _RGB565_1(pix);
-    unsigned int i = (ly * dpf.pwidth + lx) * DPF_BPP;
-    if (dpf.lcdBuf[i] != c1 || dpf.lcdBuf[i + 1] != c2) {
-	dpf.lcdBuf[i] = c1;
-	dpf.lcdBuf[i + 1] = c2;
-	changed = 1;
+    return (ly * dpf.pwidth + lx) * DPF_BPP;
+}
+
+/*
+ * Convert a span of logical pixels to RGB565 in lcdBuf.
+ *
+ * Whatever the orientation, consecutive pixels of a logical row
+ * are dpf.step bytes apart in lcdBuf.
+ * Returns the number of changed pixels, and the first and last of them.
+ */
+static int drv_dpf_span(const int row, const int col, const int width, int *first, int *last)
+{
+    unsigned char *p = dpf.lcdBuf + drv_dpf_offset(col, row, NULL, NULL);
+    int changed = 0;
+    int c;
+
+    for (c = col; c < col + width; c++, p += dpf.step) {
+	RGBA pix = drv_generic_graphic_rgb(row, c);
+	unsigned char c1 = _RGB565_0(pix);
+	unsigned char c2 = _RGB565_1(pix);
+	if (p[0] != c1 || p[1] != c2) {
+	    p[0] = c1;
+	    p[1] = c2;
+	    if (changed++ == 0)
+		*first = c;
+	    *last = c;
+	}
     }
 
-    if (changed) {
-	if (lx < dpf.minx)
-	    dpf.minx = lx;
-	if (lx > dpf.maxx)
-	    dpf.maxx = lx;
-	if (ly < dpf.miny)
-	    dpf.miny = ly;
-	if (ly > dpf.maxy)
-	    dpf.maxy = ly;
+    return changed;
+}
+
+/*
+ * Send the dirty rectangles to the dpf
+ */
+static void drv_dpf_flush(void)
+{
+    STATS_TIME t;
+    long bytes = 0;
+    int i, y;
+
+    if (dpf.damage.count == 0)
+	return;
+
+    STATS_BEGIN(t);
+
+    for (i = 0; i < dpf.damage.count; i++) {
+	DAMAGE_RECT *R = &dpf.damage.rect[i];
+
+	// Copy data in dirty rectangle from data buffer to temp transfer buffer
+	unsigned int cpylength = (R->x2 - R->x1) * DPF_BPP;
+	unsigned char *ps = dpf.lcdBuf + (R->y1 * dpf.pwidth + R->x1) * DPF_BPP;
+	unsigned char *pd = dpf.xferBuf;
+	for (y = R->y1; y < R->y2; y++) {
+	    memcpy(pd, ps, cpylength);
+	    ps += dpf.pwidth * DPF_BPP;
+	    pd += cpylength;
+	}
+
+	// Send the buffer
+	short rect[4];
+	rect[0] = R->x1;
+	rect[1] = R->y1;
+	rect[2] = R->x2;
+	rect[3] = R->y2;
+	dpf_ax_screen_blit(dpf.dpfh, dpf.xferBuf, rect);
+	bytes += cpylength * (R->y2 - R->y1);
     }
+
+    dpf.damage.count = 0;
+
+    STATS_END(Stats, t);
+    stats_count(Stats, bytes);
+}
+
+static void drv_dpf_frame( __attribute__ ((unused))
+			  void *notused)
+{
+    drv_dpf_flush();
 }
 
 /*
- * Send pixel data to dpf
+ * Convert pixel data, transfer happens once per frame
  */
 static void drv_dpf_blit(const int row, const int col, const int height, const int width)
 {
-    int x, y;
-
-    // Set pixels one by one
-    // Note: here is room for optimization :-)
-    for (y = row; y < row + height; y++)
-	for (x = col; x < col + width; x++)
-	    drv_set_pixel(x, y, drv_generic_graphic_rgb(y, x));
+    int r1 = -1, r2 = -1;
+    int c1 = col + width, c2 = -1;
+    int first = 0, last = 0;
+    int x1, y1, x2, y2;
+    int y;
+
+    for (y = row; y < row + height; y++) {
+	if (drv_dpf_span(y, col, width, &first, &last)) {
+	    if (r1 < 0)
+		r1 = y;
+	    r2 = y;
+	    if (first < c1)
+		c1 = first;
+	    if (last > c2)
+		c2 = last;
+	}
+    }
 
     // If nothing has changed, skip transfer
-    if (dpf.minx > dpf.maxx || dpf.miny > dpf.maxy)
+    if (r1 < 0)
 	return;
 
-    // Copy data in dirty rectangle from data buffer to temp transfer buffer
-    unsigned int cpylength = (dpf.maxx - dpf.minx + 1) * DPF_BPP;
-    unsigned char *ps = dpf.lcdBuf + (dpf.miny * dpf.pwidth + dpf.minx) * DPF_BPP;
-    unsigned char *pd = dpf.xferBuf;
-    for (y = dpf.miny; y <= dpf.maxy; y++) {
-	memcpy(pd, ps, cpylength);
-	ps += dpf.pwidth * DPF_BPP;
-	pd += cpylength;
-    }
-
-    // Send the buffer
-    short rect[4];
-    rect[0] = dpf.minx;
-    rect[1] = dpf.miny;
-    rect[2] = dpf.maxx + 1;
-    rect[3] = dpf.maxy + 1;
-    dpf_ax_screen_blit(dpf.dpfh, dpf.xferBuf, rect);
-
-    // Reset dirty rectangle
-    dpf.minx = dpf.pwidth - 1;
-    dpf.maxx = 0;
-    dpf.miny = dpf.pheight - 1;
-    dpf.maxy = 0;
+    // opposite corners of the changed area in physical coordinates
+    drv_dpf_offset(c1, r1, &x1, &y1);
+    drv_dpf_offset(c2, r2, &x2, &y2);
+    drv_generic_graphic_damage(&dpf.damage, MIN(y1, y2), MIN(x1, x2), abs(y2 - y1) + 1, abs(x2 - x1) + 1);
 }
 
 
@@ -254,13 +319,15 @@ static int drv_dpf_start(const char *section)
 {
     int i;
     char *dev;
+    char *loop;
     char *s;
 
     // Check if config is valid
 
-    // Get the device
+    // Get the device, or a file for the loopback mode
+    loop = cfg_get(section, "Loopback", NULL);
     dev = cfg_get(section, "Port", NULL);
-    if (dev == NULL || *dev == '\0') {
+    if ((loop == NULL || *loop == '\0') && (dev == NULL || *dev == '\0')) {
 	error("dpf: no '%s.Port' entry from %s", section, cfg_source());
 	return -1;
     }
@@ -302,11 +369,29 @@ static int drv_dpf_start(const char *section)
 	dpf.backlight = 7;
 
     /* open communication with the display */
-    dpf.dpfh = dpf_ax_open(dev);
-    if (dpf.dpfh == NULL) {
-	error("dpf: cannot open dpf device %s", dev);
-	return -1;
+    if (loop != NULL && *loop != '\0') {
+	int width, height;
+	if (sscanf(s = cfg_get(section, "Size", "320x240"), "%dx%d", &width, &height) != 2 || width < 1 || height < 1) {
+	    error("%s: bad %s.Size '%s' from %s", Name, section, s, cfg_source());
+	    free(s);
+	    return -1;
+	}
+	free(s);
+	dpf.dpfh = dpf_ax_loopback(loop, width, height);
+	if (dpf.dpfh == NULL) {
+	    error("dpf: cannot open loopback file %s: %s", loop, strerror(errno));
+	    return -1;
+	}
+	info("%s: loopback mode, writing to %s", Name, loop);
+    } else {
+	dpf.dpfh = dpf_ax_open(dev);
+	if (dpf.dpfh == NULL) {
+	    error("dpf: cannot open dpf device %s", dev);
+	    return -1;
+	}
     }
+    free(dev);
+    free(loop);
     // Get dpfs physical dimensions
     dpf.pwidth = dpf_ax_getwidth(dpf.dpfh);
     dpf.pheight = dpf_ax_getheight(dpf.dpfh);
@@ -329,18 +414,23 @@ static int drv_dpf_start(const char *section)
 
     // clear display buffer + set it to "dirty"
     memset(dpf.lcdBuf, 0, dpf.pwidth * dpf.pheight * DPF_BPP);	//Black
-    dpf.minx = 0;
-    dpf.maxx = dpf.pwidth - 1;
-    dpf.miny = 0;
-    dpf.maxy = dpf.pheight - 1;
+    dpf.damage.count = 0;
+    drv_generic_graphic_damage(&dpf.damage, 0, 0, dpf.pheight, dpf.pwidth);
 
     // set the logical width/height for lcd4linux
     DCOLS = ((!dpf.rotate90) ? dpf.pwidth : dpf.pheight);
     DROWS = ((!dpf.rotate90) ? dpf.pheight : dpf.pwidth);
 
+    // distance of two pixels in a logical row
+    dpf.step = drv_dpf_offset(1, 0, NULL, NULL) - drv_dpf_offset(0, 0, NULL, NULL);
+
     // Set backlight (brightness)
     dpf_ax_setbacklight(dpf.dpfh, dpf.backlight);
 
+    // transfer the dirty rectangles once per frame
+    cfg_number(section, "Maxfps", DEFAULT_FPS, 1, 1000, &i);
+    timer_add(drv_dpf_frame, NULL, 1000 / i, 0);
+
     return 0;
 }
 
@@ -380,6 +470,8 @@ int drv_dpf_init(const char *section, const int quiet)
 {
     int ret;
 
+    Stats = stats_register("write", Name);
+
     /* real worker functions */
     drv_generic_graphic_real_blit = drv_dpf_blit;
 
@@ -395,6 +487,7 @@ int drv_dpf_init(const char *section, const int quiet)
 	char buffer[40];
 	qprintf(buffer, sizeof(buffer), "%s %dx%d", Name, DCOLS, DROWS);
 	if (drv_generic_graphic_greet(buffer, NULL)) {
+	    drv_dpf_flush();
 	    sleep(3);
 	    drv_generic_graphic_clear();
 	}
@@ -422,6 +515,9 @@ int drv_dpf_quit(const int quiet)
 
     drv_generic_graphic_quit();
 
+    timer_remove(drv_dpf_frame, NULL);
+    drv_dpf_flush();
+
     debug("closing connection");
     dpf_ax_close(dpf.dpfh);
 
@@ -458,6 +554,7 @@ DRIVER drv_DPF = {
 typedef
     struct dpf_context {
     usb_dev_handle *udev;
+    int fd;			// loopback file, -1 for USB
     unsigned int width;
     unsigned int height;
 } DPFContext;
@@ -540,6 +637,7 @@ DPFAXHANDLE dpf_ax_open(const char *dev)
     }
 
     dpf->udev = u;
+    dpf->fd = -1;
 
     static unsigned char buf[5];
     static unsigned char cmd[16] = {
@@ -561,6 +659,35 @@ DPFAXHANDLE dpf_ax_open(const char *dev)
     return (DPFAXHANDLE) dpf;
 }
 
+/**
+ * Open a loopback device.
+ *
+ * \param file		file receiving the transfers
+ * \param width	display width
+ * \param height	display height
+ * \return		device handle or NULL
+ */
+DPFAXHANDLE dpf_ax_loopback(const char *file, int width, int height)
+{
+    DPFContext *dpf;
+
+    dpf = (DPFContext *) malloc(sizeof(DPFContext));
+    if (!dpf)
+	return NULL;
+
+    dpf->fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dpf->fd < 0) {
+	free(dpf);
+	return NULL;
+    }
+
+    dpf->udev = NULL;
+    dpf->width = width;
+    dpf->height = height;
+
+    return (DPFAXHANDLE) dpf;
+}
+
 /**
  *  Close DPF device
  */
@@ -569,8 +696,12 @@ void dpf_ax_close(DPFAXHANDLE h)
 {
     DPFContext *dpf = (DPFContext *) h;
 
-    usb_release_interface(dpf->udev, 0);
-    usb_close(dpf->udev);
+    if (dpf->fd >= 0) {
+	close(dpf->fd);
+    } else {
+	usb_release_interface(dpf->udev, 0);
+	usb_close(dpf->udev);
+    }
     free(dpf);
 }
 
@@ -681,6 +812,15 @@ static int wrap_scsi(DPFContext * h, unsigned char *cmd, int cmdlen, char out,
     g_buf[10] = block_len >> 16;
     g_buf[11] = block_len >> 24;
 
+    // loopback: the bytes of both bulk writes, there is nothing to read
+    if (h->fd >= 0) {
+	if (write(h->fd, g_buf, sizeof(g_buf)) != (int) sizeof(g_buf))
+	    return -1;
+	if (out == DIR_OUT && data && write(h->fd, data, block_len) != (int) block_len)
+	    return -1;
+	return 0;
+    }
+
     ret = usb_bulk_write(h->udev, ENDPT_OUT, (const char *) g_buf, sizeof(g_buf), 1000);
     if (ret < 0)
 	return ret;
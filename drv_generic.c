@@ -59,6 +59,8 @@ int DCOLS = 20;			/* display size: columns */
 int XRES = 6;			/* pixel widtht of one char */
 int YRES = 8;			/* pixel height of one char */
 
+int DTYPE = DISPLAY_UNKNOWN;	/* display type */
+
 
 void (*drv_generic_blit) () = NULL;
 
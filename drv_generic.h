@@ -35,6 +35,13 @@ extern int DROWS, DCOLS;	/* display size */
 
 extern int XRES, YRES;		/* pixel width/height of one char */
 
+/* kind of the active display, set by the generic text/graphic driver */
+#define DISPLAY_UNKNOWN 0
+#define DISPLAY_TEXT    1
+#define DISPLAY_GRAPHIC 2
+
+extern int DTYPE;
+
 /* these function must be implemented by the generic driver */
 extern void (*drv_generic_blit) (const int row, const int col, const int height, const int width);
 
@@ -69,6 +69,7 @@
 #include "widget.h"
 #include "widget_gpo.h"
 
+#include "drv.h"
 #include "drv_generic_gpio.h"
 
 #ifdef WITH_DMALLOC
@@ -152,6 +153,16 @@ int drv_generic_gpio_init(const char *section, const char *driver)
 {
     WIDGET_CLASS wc;
 
+    /* every display has its own GPIOs */
+    drv_state(&Section, sizeof(Section));
+    drv_state(&Driver, sizeof(Driver));
+    drv_state(GPI, sizeof(GPI));
+    drv_state(GPO, sizeof(GPO));
+    drv_state(&GPOS, sizeof(GPOS));
+    drv_state(&GPIS, sizeof(GPIS));
+    drv_state(&drv_generic_gpio_real_set, sizeof(drv_generic_gpio_real_set));
+    drv_state(&drv_generic_gpio_real_get, sizeof(drv_generic_gpio_real_get));
+
     Section = (char *) section;
     Driver = (char *) driver;
 
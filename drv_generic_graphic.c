@@ -43,6 +43,14 @@
  *   renders Bar widget into framebuffer
  *   calls drv_generic_graphic_real_blit()
  *
+ * int drv_generic_graphic_graph_draw (WIDGET *W);
+ *   scrolls a Graph widget and renders its new columns only
+ *   calls drv_generic_graphic_real_blit()
+ *
+ * void drv_generic_graphic_damage (DAMAGE *D, int row, int col, int height, int width);
+ *   adds a rectangle to a damage list, for drivers which
+ *   send their frames from a timer rather than from the blit
+ *
  * int drv_generic_graphic_quit (void);
  *   closes generic graphic driver
  *
@@ -58,6 +66,7 @@
 #include <unistd.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <math.h>
 
 #include "debug.h"
 #include "cfg.h"
@@ -68,11 +77,14 @@
 #include "widget_text.h"
 #include "widget_icon.h"
 #include "widget_bar.h"
+#include "widget_graph.h"
 #include "widget_image.h"
 #include "rgb.h"
 #include "drv.h"
 #include "drv_generic.h"
 #include "drv_generic_graphic.h"
+#include "bench.h"
+#include "stats.h"
 #include "font_6x8.h"
 #include "font_6x8_bold.h"
 
@@ -88,6 +100,7 @@ RGBA NO_COL = {.R = 0x00,.G = 0x00,.B = 0x00,.A = 0x00 };
 
 static char *Section = NULL;
 static char *Driver = NULL;
+static int Stats = -1;
 
 /* framebuffer */
 static RGBA *drv_generic_graphic_FB[LAYERS] = { NULL, };
@@ -170,7 +183,11 @@ static void drv_generic_graphic_blit(const int row, const int col, const int hei
 	drv_generic_graphic_window(row, height, DROWS, &r, &h);
 	drv_generic_graphic_window(col, width, DCOLS, &c, &w);
 	if (h > 0 && w > 0) {
+	    STATS_TIME t;
+	    STATS_BENCH_BEGIN(t, BENCH_BLIT);
 	    drv_generic_graphic_real_blit(r, c, h, w);
+	    STATS_BENCH_END(Stats, t, BENCH_BLIT);
+	    STATS_BENCH_COUNT(Stats, BENCH_BLITTED, h * w);
 	}
     }
 }
@@ -225,6 +242,228 @@ static RGBA drv_generic_graphic_blend(const int row, const int col)
 }
 
 
+/****************************************/
+/*** generic font handling            ***/
+/****************************************/
+
+/* Every glyph is pre-rendered into a XRES x YRES cell once: as a mask */
+/* (built at init, from Font_6x8 or from a BDF file) and, on first use, */
+/* as RGBA pixels for each fg/bg/bold combination, so that rendering */
+/* text is a memcpy() per glyph row. */
+
+#define GLYPHS 256
+
+/* number of cached color combinations */
+#define ATLAS_CACHE 4
+
+typedef struct ATLAS {
+    RGBA fg, bg;
+    int bold;
+    int used;			/* age for LRU replacement, 0 = empty slot */
+    RGBA *pixels;		/* GLYPHS cells of XRES x YRES */
+    unsigned char ready[GLYPHS];	/* glyph has been colored */
+} ATLAS;
+
+/* glyph masks (normal, bold): one byte per pixel */
+static unsigned char *Mask[2] = { NULL, NULL };
+
+static ATLAS Atlas[ATLAS_CACHE];
+static int AtlasAge = 0;
+
+
+static int drv_generic_graphic_same(const RGBA a, const RGBA b)
+{
+    return a.R == b.R && a.G == b.G && a.B == b.B && a.A == b.A;
+}
+
+
+/* scale the builtin 6x8 font to the cell size */
+static void drv_generic_graphic_font_6x8(void)
+{
+    int b, g, x, y;
+
+    for (b = 0; b < 2; b++) {
+	for (g = 0; g < GLYPHS; g++) {
+	    unsigned char *chr = b ? Font_6x8_bold[g] : Font_6x8[g];
+	    unsigned char *m = Mask[b] + g * XRES * YRES;
+	    for (y = 0; y < YRES; y++) {
+		for (x = 0; x < XRES; x++) {
+		    int mask = 1 << 6;
+		    mask >>= ((x * 6) / (XRES)) + 1;
+		    *m++ = (chr[(y * 8) / (YRES)] & mask) != 0;
+		}
+	    }
+	}
+    }
+}
+
+
+/* load glyphs 0..255 of a BDF font, aligned to the font bounding box */
+static int drv_generic_graphic_font_bdf(const char *file)
+{
+    FILE *fp;
+    char line[256];
+    int fw = 0, fh = 0, fx = 0, fy = 0;
+    int w = 0, h = 0, xo = 0, yo = 0;
+    int enc = -1, row = -1;
+    int g, x, y, n = 0;
+
+    fp = fopen(file, "r");
+    if (fp == NULL) {
+	error("%s: open(%s) failed: %s", Driver, file, strerror(errno));
+	return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if (strncmp(line, "FONTBOUNDINGBOX ", 16) == 0) {
+	    sscanf(line + 16, "%d %d %d %d", &fw, &fh, &fx, &fy);
+	} else if (strncmp(line, "ENCODING ", 9) == 0) {
+	    enc = atoi(line + 9);
+	} else if (strncmp(line, "BBX ", 4) == 0) {
+	    sscanf(line + 4, "%d %d %d %d", &w, &h, &xo, &yo);
+	} else if (strncmp(line, "BITMAP", 6) == 0) {
+	    /* top row of the glyph, counted from the top of the cell */
+	    row = (fh + fy) - (yo + h);
+	    if (enc >= 0 && enc < GLYPHS)
+		n++;
+	} else if (strncmp(line, "ENDCHAR", 7) == 0) {
+	    enc = -1;
+	    row = -1;
+	} else if (row >= 0) {
+	    unsigned long bits = strtoul(line, NULL, 16);
+	    int bytes = (w + 7) / 8;
+	    y = row++;
+	    if (enc < 0 || enc >= GLYPHS || y < 0 || y >= YRES)
+		continue;
+	    for (x = 0; x < w && x < 8 * bytes && x < 32; x++) {
+		int c = x + xo - fx;
+		if (c < 0 || c >= XRES)
+		    continue;
+		if (bits & (1UL << (8 * bytes - 1 - x)))
+		    Mask[0][(enc * YRES + y) * XRES + c] = 1;
+	    }
+	}
+    }
+    fclose(fp);
+
+    if (n == 0) {
+	error("%s: no glyphs found in font '%s'", Driver, file);
+	return -1;
+    }
+    if (fw > XRES || fh > YRES) {
+	info("%s: font '%s' (%dx%d) clipped to %dx%d", Driver, file, fw, fh, XRES, YRES);
+    }
+    info("%s: loaded %d glyphs from font '%s'", Driver, n, file);
+
+    /* BDF fonts have no bold face: smear every pixel to the right */
+    for (g = 0; g < GLYPHS * YRES; g++) {
+	unsigned char *src = Mask[0] + g * XRES;
+	unsigned char *dst = Mask[1] + g * XRES;
+	for (x = 0; x < XRES; x++)
+	    dst[x] = src[x] || (x > 0 && src[x - 1]);
+    }
+
+    return 0;
+}
+
+
+static int drv_generic_graphic_font_init(void)
+{
+    char *file;
+    int b, ret = 0;
+
+    for (b = 0; b < 2; b++) {
+	Mask[b] = calloc(GLYPHS * XRES * YRES, 1);
+	if (Mask[b] == NULL) {
+	    error("%s: font could not be allocated: malloc() failed", Driver);
+	    return -1;
+	}
+    }
+
+    file = cfg_get(Section, "Fontfile", NULL);
+    if (file != NULL && *file != '\0') {
+	ret = drv_generic_graphic_font_bdf(file);
+    } else {
+	drv_generic_graphic_font_6x8();
+    }
+    if (file)
+	free(file);
+
+    memset(Atlas, 0, sizeof(Atlas));
+    AtlasAge = 0;
+
+    return ret;
+}
+
+
+static void drv_generic_graphic_font_quit(void)
+{
+    int i;
+
+    for (i = 0; i < ATLAS_CACHE; i++) {
+	if (Atlas[i].pixels)
+	    free(Atlas[i].pixels);
+    }
+    memset(Atlas, 0, sizeof(Atlas));
+
+    for (i = 0; i < 2; i++) {
+	if (Mask[i]) {
+	    free(Mask[i]);
+	    Mask[i] = NULL;
+	}
+    }
+}
+
+
+/* find (or set up) the atlas for a color combination */
+static ATLAS *drv_generic_graphic_atlas(const RGBA fg, const RGBA bg, const int bold)
+{
+    ATLAS *A = NULL;
+    int i;
+
+    for (i = 0; i < ATLAS_CACHE; i++) {
+	if (Atlas[i].used && Atlas[i].bold == bold
+	    && drv_generic_graphic_same(Atlas[i].fg, fg) && drv_generic_graphic_same(Atlas[i].bg, bg)) {
+	    Atlas[i].used = ++AtlasAge;
+	    return &Atlas[i];
+	}
+	/* empty slots first, least recently used otherwise */
+	if (A == NULL || A->used > Atlas[i].used)
+	    A = &Atlas[i];
+    }
+
+    if (A->pixels == NULL) {
+	A->pixels = malloc(GLYPHS * XRES * YRES * sizeof(RGBA));
+	if (A->pixels == NULL)
+	    return NULL;
+    }
+    A->fg = fg;
+    A->bg = bg;
+    A->bold = bold;
+    A->used = ++AtlasAge;
+    memset(A->ready, 0, sizeof(A->ready));
+
+    return A;
+}
+
+
+/* the colored pixels of one glyph */
+static RGBA *drv_generic_graphic_glyph(ATLAS * A, const unsigned char chr)
+{
+    RGBA *p = A->pixels + chr * XRES * YRES;
+
+    if (!A->ready[chr]) {
+	unsigned char *m = Mask[A->bold] + chr * XRES * YRES;
+	int i;
+	for (i = 0; i < XRES * YRES; i++)
+	    p[i] = m[i] ? A->fg : A->bg;
+	A->ready[chr] = 1;
+    }
+
+    return p;
+}
+
+
 /****************************************/
 /*** generic text handling            ***/
 /****************************************/
@@ -232,8 +471,9 @@ static RGBA drv_generic_graphic_blend(const int row, const int col)
 static void drv_generic_graphic_render(const int layer, const int row, const int col, const RGBA fg, const RGBA bg,
 				       const char *style, const char *txt)
 {
-    int c, r, x, y, len;
-    int bold;
+    int c, y, len;
+    int bold, style_bold;
+    ATLAS *atlas[2];
 
     /* sanity checks */
     if (layer < 0 || layer >= LAYERS) {
@@ -246,13 +486,17 @@ static void drv_generic_graphic_render(const int layer, const int row, const int
     /* maybe grow layout framebuffer */
     drv_generic_graphic_resizeFB(row + YRES, col + XRES * len);
 
-    r = row;
     c = col;
 
+    /* a bold style makes the whole text bold, otherwise '\a' toggles it */
+    style_bold = strstr(style, "bold") != NULL;
+    atlas[0] = atlas[1] = NULL;
+
     /* render text into layout FB */
     bold = 0;
     while (*txt != '\0') {
-	unsigned char *chr;
+	RGBA *glyph, *dst;
+	int b;
 
 	/* magic char to toggle bold */
 	if (*txt == '\a') {
@@ -260,21 +504,19 @@ static void drv_generic_graphic_render(const int layer, const int row, const int
 	    txt++;
 	    continue;
 	}
-	if (bold || strstr(style, "bold") != NULL) {
-	    chr = Font_6x8_bold[(int) *(unsigned char *) txt];
-	} else {
-	    chr = Font_6x8[(int) *(unsigned char *) txt];
+
+	b = bold | style_bold;
+	if (atlas[b] == NULL && (atlas[b] = drv_generic_graphic_atlas(fg, bg, b)) == NULL) {
+	    error("%s: glyph atlas could not be allocated: malloc() failed", Driver);
+	    return;
 	}
 
+	glyph = drv_generic_graphic_glyph(atlas[b], *(unsigned char *) txt);
+	dst = drv_generic_graphic_FB[layer] + row * LCOLS + c;
 	for (y = 0; y < YRES; y++) {
-	    for (x = 0; x < XRES; x++) {
-		int mask = 1 << 6;
-		mask >>= ((x * 6) / (XRES)) + 1;
-		if (chr[(y * 8) / (YRES)] & mask)
-		    drv_generic_graphic_FB[layer][(r + y) * LCOLS + c + x] = fg;
-		else
-		    drv_generic_graphic_FB[layer][(r + y) * LCOLS + c + x] = bg;
-	    }
+	    memcpy(dst, glyph, XRES * sizeof(RGBA));
+	    dst += LCOLS;
+	    glyph += XRES;
 	}
 	c += XRES;
 	txt++;
@@ -542,6 +784,77 @@ int drv_generic_graphic_bar_draw(WIDGET * W)
 }
 
 
+/****************************************/
+/*** generic graph handling           ***/
+/****************************************/
+
+int drv_generic_graphic_graph_draw(WIDGET * W)
+{
+    WIDGET_GRAPH *Graph = W->data;
+    RGBA fg, bg, gc, *FB;
+    int layer, row, col, width, height, shift, len;
+    int x, y;
+    double val;
+
+    layer = W->layer;
+    row = YRES * W->row;
+    col = XRES * W->col;
+    width = XRES * Graph->width;
+    height = YRES * Graph->height;
+
+    fg = W->fg_valid ? W->fg_color : FG_COL;
+    bg = W->bg_valid ? W->bg_color : BG_COL;
+    gc = Graph->color_valid ? Graph->color : fg;
+
+    /* sanity check */
+    if (layer < 0 || layer >= LAYERS) {
+	error("%s: layer %d out of bounds (0..%d)", Driver, layer, LAYERS - 1);
+	return -1;
+    }
+
+    /* maybe grow layout framebuffer */
+    drv_generic_graphic_resizeFB(row + height, col + width);
+    FB = drv_generic_graphic_FB[layer];
+
+    /* columns to render: the new samples only, unless the scale changed */
+    shift = Graph->samples - Graph->drawn;
+    if (Graph->rescaled || shift > width) {
+	Graph->rescaled = 0;
+	shift = width;
+    }
+    Graph->drawn = Graph->samples;
+
+    /* scroll the older columns to the left */
+    if (shift < width) {
+	for (y = 0; y < height; y++) {
+	    RGBA *p = FB + (row + y) * LCOLS + col;
+	    memmove(p, p + shift, (width - shift) * sizeof(RGBA));
+	}
+    }
+
+    /* render the new columns, bottom up */
+    for (x = width - shift; x < width; x++) {
+	val = widget_graph_value(Graph, width - 1 - x);
+	if (isnan(val)) {
+	    len = 0;
+	} else {
+	    len = val * height;
+	    if (len < 1)
+		len = 1;
+	}
+	for (y = 0; y < height; y++) {
+	    FB[(row + height - 1 - y) * LCOLS + col + x] = y < len ? gc : bg;
+	}
+    }
+
+    /* scrolling moves every pixel on the display, and the layers are */
+    /* composed in screen order, so the whole area has to be flushed */
+    drv_generic_graphic_blit(row, col, height, width);
+
+    return 0;
+}
+
+
 /****************************************/
 /*** generic image handling           ***/
 /****************************************/
@@ -604,8 +917,28 @@ int drv_generic_graphic_init(const char *section, const char *driver)
     char *color;
     WIDGET_CLASS wc;
 
+    /* every display has its own framebuffers, colors and font */
+    drv_state(&FG_COL, sizeof(FG_COL));
+    drv_state(&BG_COL, sizeof(BG_COL));
+    drv_state(&BL_COL, sizeof(BL_COL));
+    drv_state(&Section, sizeof(Section));
+    drv_state(&Driver, sizeof(Driver));
+    drv_state(&Stats, sizeof(Stats));
+    drv_state(drv_generic_graphic_FB, sizeof(drv_generic_graphic_FB));
+    drv_state(&INVERTED, sizeof(INVERTED));
+    drv_state(&drv_generic_graphic_real_blit, sizeof(drv_generic_graphic_real_blit));
+    drv_state(Mask, sizeof(Mask));
+    drv_state(Atlas, sizeof(Atlas));
+    drv_state(&AtlasAge, sizeof(AtlasAge));
+
     Section = (char *) section;
     Driver = (char *) driver;
+    Stats = stats_register("blit", driver);
+    DTYPE = DISPLAY_GRAPHIC;
+
+    /* pre-render the font */
+    if (drv_generic_graphic_font_init() < 0)
+	return -1;
 
     /* init layout framebuffer */
     LROWS = 0;
@@ -667,6 +1000,11 @@ int drv_generic_graphic_init(const char *section, const char *driver)
     wc.draw = drv_generic_graphic_bar_draw;
     widget_register(&wc);
 
+    /* register graph widget */
+    wc = Widget_Graph;
+    wc.draw = drv_generic_graphic_graph_draw;
+    widget_register(&wc);
+
     /* register image widget */
 #ifdef WITH_IMAGE
     wc = Widget_Image;
@@ -716,10 +1054,61 @@ unsigned char drv_generic_graphic_black(const int row, const int col)
 }
 
 
+void drv_generic_graphic_damage(DAMAGE * D, const int row, const int col, const int height, const int width)
+{
+    int x1 = col, y1 = row, x2 = col + width, y2 = row + height;
+    int i, best, grow;
+    DAMAGE_RECT *R;
+
+    /* merge with a rectangle it overlaps or touches */
+    for (i = 0; i < D->count; i++) {
+	R = &D->rect[i];
+	if (x1 <= R->x2 && x2 >= R->x1 && y1 <= R->y2 && y2 >= R->y1)
+	    break;
+    }
+
+    if (i == D->count) {
+	if (D->count < DAMAGE_RECTS) {
+	    R = &D->rect[D->count++];
+	    R->x1 = x1;
+	    R->y1 = y1;
+	    R->x2 = x2;
+	    R->y2 = y2;
+	    return;
+	}
+	/* list is full: extend the rectangle which grows least */
+	best = 0;
+	grow = -1;
+	for (i = 0; i < D->count; i++) {
+	    int w, h, g;
+	    R = &D->rect[i];
+	    w = MAX(R->x2, x2) - MIN(R->x1, x1);
+	    h = MAX(R->y2, y2) - MIN(R->y1, y1);
+	    g = w * h - (R->x2 - R->x1) * (R->y2 - R->y1);
+	    if (grow < 0 || g < grow) {
+		grow = g;
+		best = i;
+	    }
+	}
+	i = best;
+    }
+
+    R = &D->rect[i];
+    R->x1 = MIN(R->x1, x1);
+    R->y1 = MIN(R->y1, y1);
+    R->x2 = MAX(R->x2, x2);
+    R->y2 = MAX(R->y2, y2);
+}
+
+
 int drv_generic_graphic_quit(void)
 {
     int l;
 
+    DTYPE = DISPLAY_UNKNOWN;
+
+    drv_generic_graphic_font_quit();
+
     for (l = 0; l < LAYERS; l++) {
 	if (drv_generic_graphic_FB[l]) {
 	    free(drv_generic_graphic_FB[l]);
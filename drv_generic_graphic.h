@@ -45,6 +45,21 @@ extern RGBA drv_generic_graphic_rgb(const int row, const int col);
 extern unsigned char drv_generic_graphic_gray(const int row, const int col);
 extern unsigned char drv_generic_graphic_black(const int row, const int col);
 
+/* damaged rectangles collected between two frames */
+#define DAMAGE_RECTS 8
+
+typedef struct {
+    int x1, y1;			/* top left corner */
+    int x2, y2;			/* bottom right corner (exclusive) */
+} DAMAGE_RECT;
+
+typedef struct {
+    int count;
+    DAMAGE_RECT rect[DAMAGE_RECTS];
+} DAMAGE;
+
+void drv_generic_graphic_damage(DAMAGE * D, const int row, const int col, const int height, const int width);
+
 
 /* generic functions and widget callbacks */
 int drv_generic_graphic_init(const char *section, const char *driver);
@@ -53,6 +68,7 @@ int drv_generic_graphic_greet(const char *msg1, const char *msg2);
 int drv_generic_graphic_draw(WIDGET * W);
 int drv_generic_graphic_icon_draw(WIDGET * W);
 int drv_generic_graphic_bar_draw(WIDGET * W);
+int drv_generic_graphic_graph_draw(WIDGET * W);
 int drv_generic_graphic_quit(void);
 
 #endif
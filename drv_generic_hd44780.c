@@ -0,0 +1,556 @@
+/* $Id$
+ * $URL$
+ *
+ * generic driver helper: software model of HD44780 controllers
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/* 
+ * The model sits behind a simulated transport ('sim:' ports of
+ * drv_generic_parport and drv_generic_i2c): the driver decodes every
+ * change of the port lines into the levels of the E, RS, RW and data
+ * pins of the display, together with the simulated time of the change.
+ *
+ * Like a real controller, the model latches RS, RW and the data pins
+ * on the falling edge of E, in 8 bit or (after a function set with
+ * DL=0) in 4 bit mode, and keeps DDRAM, CGRAM and address counter.
+ * Every edge is checked against the minimum bus timing of the
+ * datasheet (HD44780U, VCC 4.5..5.5 V):
+ *   tcycE  500 ns  enable cycle time
+ *   PWEH   230 ns  enable pulse width (high level)
+ *   tAS     40 ns  RS and RW set-up time before E rises
+ *   tAH     10 ns  RS and RW hold time after E falls
+ *   tDSW    80 ns  data set-up time before E falls
+ *   tH      10 ns  data hold time after E falls
+ *
+ * Every instruction keeps its controller busy for the execution time
+ * given in the datasheet (fosc = 270 kHz). A byte which arrives while
+ * the controller is still busy is ignored, just like a real controller
+ * may do. A read cycle (RW high) returns the busy flag and the address
+ * counter. Timing and busy violations are counted and the first ones
+ * are reported, so a driver with too short delays shows up both in the
+ * log and in the screen dump.
+ *
+ * Costs are accounted in the statistics (see stats.c):
+ *   cycle:<driver>  time between two bytes written
+ *   frame:<driver>  time of every burst (one display update)
+ *
+ * If the config has a 'Dump' entry, the model writes the visible
+ * characters and the user-defined chars to this file after every update.
+ *
+ */
+
+/* 
+ *
+ * exported fuctions:
+ *
+ * int drv_generic_hd44780_open (char *section, char *driver, int controllers,
+ *                               int rows, int cols, int (*address)(int row, int col, int *controller))
+ *   creates 'controllers' simulated controllers, reads the 'Dump' entry from
+ *   config; 'address' maps a display position to controller and DDRAM address
+ *   returns 0 if ok, -1 on failure
+ *
+ * int drv_generic_hd44780_pins (unsigned long long time, int enable, int rs, int rw,
+ *                               unsigned char data)
+ *   the pins of the display change at 'time' [nsec]: 'enable' is the bitmask
+ *   of the controllers whose E is high, 'data' the levels of D7..D0
+ *   (D7..D4 on a 4 bit bus); returns the levels the controllers drive on
+ *   D7..D0 in a read cycle, or -1 if they don't drive the bus
+ *
+ * void drv_generic_hd44780_burst (int on)
+ *   brackets the pin changes of one display update
+ *
+ * int drv_generic_hd44780_close (void)
+ *   writes a summary to the log and releases the model
+ *   returns 0 if ok, -1 on failure
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "debug.h"
+#include "cfg.h"
+#include "stats.h"
+#include "drv.h"
+#include "drv_generic_hd44780.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+
+/* execution times from the datasheet [nsec] */
+#define EXEC_CLEAR 1520000	/* clear display, return home */
+#define EXEC_INSTR 37000	/* all other instructions */
+#define EXEC_DATA  41000	/* data write incl. address counter update */
+
+/* bus timing from the datasheet [nsec] */
+#define T_CYCE 500		/* enable cycle time */
+#define T_PWEH 230		/* enable pulse width */
+#define T_AS   40		/* address set-up time */
+#define T_AH   10		/* address hold time */
+#define T_DSW  80		/* data set-up time */
+#define T_H    10		/* data hold time */
+
+/* report this many violations in detail */
+#define MAX_VIOLATIONS 10
+
+typedef struct {
+    unsigned char DDRAM[128];
+    unsigned char CGRAM[64];
+    int AC;			/* address counter */
+    int CG;			/* address counter points to CGRAM */
+    int increment;		/* entry mode: +1 or -1 */
+    int display;		/* display on */
+    int RE;			/* HD66712 extended register enable */
+    int DL;			/* 8 bit interface */
+    int nibble;			/* 4 bit interface: high nibble is in */
+    unsigned char high;		/* 4 bit interface: the high nibble */
+    unsigned long long busy;	/* busy until [nsec] */
+    int E;			/* level of the enable pin */
+    int cycles;			/* E has risen and fallen before */
+    unsigned long long rise;	/* last rising edge of E */
+    unsigned long long fall;	/* last falling edge of E */
+} HD44780;
+
+static char *Driver = "";
+static HD44780 *Controller = NULL;
+static int nControllers = 0;
+
+/* pins shared by all controllers, and when they changed [nsec] */
+static int RS = 0;
+static int RW = 0;
+static unsigned char Data = 0;
+static unsigned long long AddrTime = 0;
+static unsigned long long DataTime = 0;
+
+/* simulated time of the last pin change [nsec] */
+static unsigned long long Now = 0;
+static unsigned long long Start = 0;
+static unsigned long long LastByte = 0;
+static int Burst = 0;
+
+static unsigned long Bytes = 0;
+static unsigned long Violations = 0;
+static unsigned long Lost = 0;
+static int StatsCycle = -1;
+static int StatsFrame = -1;
+
+/* screen dump */
+static char *Dump = NULL;
+static int Dirty = 0;
+static int Rows = 0;
+static int Cols = 0;
+static int (*Address) (int row, int col, int *controller) = NULL;
+
+
+/* a bus timing of controller c is shorter than the datasheet allows */
+static void drv_generic_hd44780_timing(const int c, const char *name, const unsigned long long t, const int min)
+{
+    if (Violations + Lost < MAX_VIOLATIONS) {
+	error("%s: controller %d: %s is %llu ns at %llu ns, should be at least %d ns", Driver, c, name, t, Now,
+	      min);
+    }
+    Violations++;
+}
+
+
+static void drv_generic_hd44780_instruction(HD44780 * C, const unsigned char cmd)
+{
+    if (cmd & 0x80) {
+	/* set DDRAM address */
+	C->AC = cmd & 0x7f;
+	C->CG = 0;
+    } else if (cmd & 0x40) {
+	/* set CGRAM address */
+	C->AC = cmd & 0x3f;
+	C->CG = 1;
+    } else if (cmd & 0x20) {
+	/* function set: interface width, lines are the display's business, */
+	/* the font bit of the HD44780 is the RE bit of the HD66712 */
+	C->DL = (cmd & 0x10) != 0;
+	C->RE = (cmd & 0x04) != 0;
+    } else if (C->RE && (cmd & 0x18)) {
+	/* HD66712 extended function set and scroll enable */
+    } else if (cmd & 0x10) {
+	/* cursor or display shift: only cursor moves change the address */
+	if (!(cmd & 0x08))
+	    C->AC += (cmd & 0x04) ? 1 : -1;
+    } else if (cmd & 0x08) {
+	/* display on/off control */
+	C->display = (cmd & 0x04) != 0;
+    } else if (cmd & 0x04) {
+	/* entry mode set */
+	C->increment = (cmd & 0x02) ? 1 : -1;
+    } else if (cmd & 0x02) {
+	/* return home */
+	C->AC = 0;
+	C->CG = 0;
+    } else if (cmd & 0x01) {
+	/* clear display */
+	memset(C->DDRAM, ' ', sizeof(C->DDRAM));
+	C->AC = 0;
+	C->CG = 0;
+	C->increment = 1;
+    }
+    C->AC &= C->CG ? 0x3f : 0x7f;
+}
+
+
+static void drv_generic_hd44780_data(HD44780 * C, const unsigned char data)
+{
+    if (C->CG) {
+	C->CGRAM[C->AC] = data;
+	C->AC = (C->AC + C->increment) & 0x3f;
+    } else {
+	C->DDRAM[C->AC] = data;
+	C->AC = (C->AC + C->increment) & 0x7f;
+    }
+}
+
+
+static void drv_generic_hd44780_dump(void)
+{
+    HD44780 *C;
+    FILE *fp;
+    char *tmp;
+    int used[8];
+    int row, col, pos, c, i, n;
+
+    Dirty = 0;
+
+    if (Dump == NULL || Address == NULL)
+	return;
+
+    /* write a new file and rename it, so readers never see half a screen */
+    tmp = malloc(strlen(Dump) + 5);
+    strcpy(tmp, Dump);
+    strcat(tmp, ".tmp");
+
+    fp = fopen(tmp, "w");
+    if (fp == NULL) {
+	error("%s: fopen(%s) failed: %s", Driver, tmp, strerror(errno));
+	free(Dump);
+	Dump = NULL;
+	free(tmp);
+	return;
+    }
+
+    memset(used, 0, sizeof(used));
+    for (row = 0; row < Rows; row++) {
+	for (col = 0; col < Cols; col++) {
+	    pos = Address(row, col, &c);
+	    if (pos < 0 || c < 0 || c >= nControllers || !Controller[c].display) {
+		fputc(' ', fp);
+		continue;
+	    }
+	    n = Controller[c].DDRAM[pos & 0x7f];
+	    if (n < 16) {
+		/* user-defined chars show up as their number */
+		used[n & 7] = 1;
+		fputc('0' + (n & 7), fp);
+	    } else {
+		fputc(n < 0x80 && n != 0x7f ? n : '?', fp);
+	    }
+	}
+	fputc('\n', fp);
+    }
+
+    /* the glyphs of all user-defined chars on the screen (first controller) */
+    C = &Controller[0];
+    for (n = 0; n < 8; n++) {
+	if (!used[n])
+	    continue;
+	fprintf(fp, "\nchar %d:\n", n);
+	for (row = 0; row < 8; row++) {
+	    for (i = 4; i >= 0; i--)
+		fputc(C->CGRAM[8 * n + row] & (1 << i) ? '#' : '.', fp);
+	    fputc('\n', fp);
+	}
+    }
+
+    fclose(fp);
+    if (rename(tmp, Dump) < 0) {
+	error("%s: rename(%s) failed: %s", Driver, tmp, strerror(errno));
+    }
+    free(tmp);
+}
+
+
+/* falling edge of E: the controller latches RS, RW and the data pins */
+static void drv_generic_hd44780_latch(const int c)
+{
+    HD44780 *C = &Controller[c];
+    unsigned char byte;
+
+    if (!C->DL) {
+	/* 4 bit interface: two nibbles on D7..D4, the high one first */
+	if (!C->nibble) {
+	    C->nibble = 1;
+	    C->high = Data & 0xf0;
+	    return;
+	}
+	C->nibble = 0;
+	byte = C->high | (Data >> 4);
+    } else {
+	byte = Data;
+    }
+
+    /* a read cycle changes nothing */
+    if (RW)
+	return;
+
+    if (Now < C->busy) {
+	if (Violations + Lost < MAX_VIOLATIONS) {
+	    error("%s: controller %d still busy for %llu ns at %llu ns, %s 0x%02x lost", Driver, c, C->busy - Now,
+		  Now, RS ? "data" : "instruction", byte);
+	}
+	Lost++;
+	return;
+    }
+
+    if (RS) {
+	drv_generic_hd44780_data(C, byte);
+	C->busy = Now + EXEC_DATA;
+    } else {
+	drv_generic_hd44780_instruction(C, byte);
+	C->busy = Now + (byte == 0x01 || (byte & 0xfe) == 0x02 ? EXEC_CLEAR : EXEC_INSTR);
+	/* switching the interface width starts with the high nibble */
+	if ((byte & 0xe0) == 0x20)
+	    C->nibble = 0;
+    }
+
+    Bytes++;
+    Dirty = 1;
+    if (LastByte > 0)
+	stats_time(StatsCycle, Now - LastByte);
+    stats_count(StatsCycle, 1);
+    LastByte = Now;
+}
+
+
+int drv_generic_hd44780_open(const char *section, const char *driver, const int controllers,
+			     const int rows, const int cols, int (*address) (int row, int col, int *controller))
+{
+    char *s;
+    int c;
+
+    /* every display has its own controllers */
+    drv_state(&Driver, sizeof(Driver));
+    drv_state(&Controller, sizeof(Controller));
+    drv_state(&nControllers, sizeof(nControllers));
+    drv_state(&RS, sizeof(RS));
+    drv_state(&RW, sizeof(RW));
+    drv_state(&Data, sizeof(Data));
+    drv_state(&AddrTime, sizeof(AddrTime));
+    drv_state(&DataTime, sizeof(DataTime));
+    drv_state(&Now, sizeof(Now));
+    drv_state(&Start, sizeof(Start));
+    drv_state(&LastByte, sizeof(LastByte));
+    drv_state(&Burst, sizeof(Burst));
+    drv_state(&Bytes, sizeof(Bytes));
+    drv_state(&Violations, sizeof(Violations));
+    drv_state(&Lost, sizeof(Lost));
+    drv_state(&StatsCycle, sizeof(StatsCycle));
+    drv_state(&StatsFrame, sizeof(StatsFrame));
+    drv_state(&Dump, sizeof(Dump));
+    drv_state(&Dirty, sizeof(Dirty));
+    drv_state(&Rows, sizeof(Rows));
+    drv_state(&Cols, sizeof(Cols));
+    drv_state(&Address, sizeof(Address));
+
+    Driver = (char *) driver;
+
+    if (controllers < 1 || controllers > 4) {
+	error("%s: cannot simulate %d controllers", Driver, controllers);
+	return -1;
+    }
+
+    nControllers = controllers;
+    Controller = malloc(nControllers * sizeof(HD44780));
+    if (Controller == NULL) {
+	error("%s: out of memory", Driver);
+	return -1;
+    }
+
+    /* power-on state: random RAM contents, display off, 8 bit interface */
+    for (c = 0; c < nControllers; c++) {
+	memset(&Controller[c], 0, sizeof(HD44780));
+	memset(Controller[c].DDRAM, '?', sizeof(Controller[c].DDRAM));
+	Controller[c].increment = 1;
+	Controller[c].DL = 1;
+    }
+
+    RS = 0;
+    RW = 0;
+    Data = 0;
+    AddrTime = 0;
+    DataTime = 0;
+    Now = 0;
+    LastByte = 0;
+    Burst = 0;
+    Bytes = 0;
+    Violations = 0;
+    Lost = 0;
+    StatsCycle = stats_register("cycle", driver);
+    StatsFrame = stats_register("frame", driver);
+
+    Rows = rows;
+    Cols = cols;
+    Address = address;
+
+    s = cfg_get(section, "Dump", NULL);
+    if (s != NULL && *s == '\0') {
+	free(s);
+	s = NULL;
+    }
+    Dump = s;
+
+    info("%s: simulating %d controller%s%s%s", Driver, nControllers, nControllers > 1 ? "s" : "",
+	 Dump ? ", screen dump to " : "", Dump ? Dump : "");
+
+    return 0;
+}
+
+
+int drv_generic_hd44780_pins(const unsigned long long time, const int enable, const int rs, const int rw,
+			     const unsigned char data)
+{
+    HD44780 *C;
+    int c, e, value;
+
+    if (Controller == NULL)
+	return -1;
+
+    Now = time;
+
+    /* RS and RW must be stable while E is high, and a bit longer */
+    if (rs != RS || rw != RW) {
+	for (c = 0; c < nControllers; c++) {
+	    C = &Controller[c];
+	    if (C->E)
+		drv_generic_hd44780_timing(c, "tAH (RS/RW change while E is high)", 0, T_AH);
+	    else if (C->cycles && Now - C->fall < T_AH)
+		drv_generic_hd44780_timing(c, "tAH", Now - C->fall, T_AH);
+	}
+	RS = rs;
+	RW = rw;
+	AddrTime = Now;
+    }
+
+    /* the data must be held after E falls */
+    if (data != Data) {
+	for (c = 0; c < nControllers; c++) {
+	    C = &Controller[c];
+	    if (!C->E && C->cycles && !RW && Now - C->fall < T_H)
+		drv_generic_hd44780_timing(c, "tH", Now - C->fall, T_H);
+	}
+	Data = data;
+	DataTime = Now;
+    }
+
+    for (c = 0; c < nControllers; c++) {
+	C = &Controller[c];
+	e = (enable & (1 << c)) != 0;
+	if (e && !C->E) {
+	    if (Now - AddrTime < T_AS)
+		drv_generic_hd44780_timing(c, "tAS", Now - AddrTime, T_AS);
+	    if (C->cycles && Now - C->rise < T_CYCE)
+		drv_generic_hd44780_timing(c, "tcycE", Now - C->rise, T_CYCE);
+	    C->rise = Now;
+	    C->E = 1;
+	} else if (!e && C->E) {
+	    if (Now - C->rise < T_PWEH)
+		drv_generic_hd44780_timing(c, "PWEH", Now - C->rise, T_PWEH);
+	    if (!RW && Now - DataTime < T_DSW)
+		drv_generic_hd44780_timing(c, "tDSW", Now - DataTime, T_DSW);
+	    C->fall = Now;
+	    C->E = 0;
+	    C->cycles = 1;
+	    drv_generic_hd44780_latch(c);
+	}
+    }
+
+    if (Dirty && Burst == 0)
+	drv_generic_hd44780_dump();
+
+    /* in a read cycle, the first enabled controller drives the bus */
+    if (!RW)
+	return -1;
+    for (c = 0; c < nControllers; c++) {
+	C = &Controller[c];
+	if (!C->E)
+	    continue;
+	value = (Now < C->busy ? 0x80 : 0x00) | (C->AC & 0x7f);
+	if (!C->DL && C->nibble)
+	    value = (value << 4) & 0xf0;
+	return value;
+    }
+    return -1;
+}
+
+
+void drv_generic_hd44780_burst(const int on)
+{
+    if (Controller == NULL)
+	return;
+
+    if (on) {
+	if (Burst++ == 0)
+	    Start = Now;
+	return;
+    }
+
+    if (Burst == 0 || --Burst > 0)
+	return;
+
+    stats_time(StatsFrame, Now - Start);
+
+    if (Dirty)
+	drv_generic_hd44780_dump();
+}
+
+
+int drv_generic_hd44780_close(void)
+{
+    if (Controller == NULL)
+	return 0;
+
+    info("%s: simulated %lu bytes in %llu.%03llu msec, %lu timing violation%s, %lu byte%s lost while busy", Driver,
+	 Bytes, Now / 1000000, (Now / 1000) % 1000, Violations, Violations == 1 ? "" : "s", Lost,
+	 Lost == 1 ? "" : "s");
+
+    free(Controller);
+    Controller = NULL;
+    nControllers = 0;
+
+    if (Dump) {
+	free(Dump);
+	Dump = NULL;
+    }
+
+    return 0;
+}
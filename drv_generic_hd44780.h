@@ -0,0 +1,65 @@
+/* $Id$
+ * $URL$
+ *
+ * generic driver helper: software model of HD44780 controllers
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/* 
+ *
+ * exported fuctions:
+ *
+ * int drv_generic_hd44780_open (char *section, char *driver, int controllers,
+ *                               int rows, int cols, int (*address)(int row, int col, int *controller))
+ *   creates 'controllers' simulated controllers, reads the 'Dump' entry from
+ *   config; 'address' maps a display position to controller and DDRAM address
+ *   returns 0 if ok, -1 on failure
+ *
+ * int drv_generic_hd44780_pins (unsigned long long time, int enable, int rs, int rw,
+ *                               unsigned char data)
+ *   the pins of the display change at 'time' [nsec]: 'enable' is the bitmask
+ *   of the controllers whose E is high, 'data' the levels of D7..D0
+ *   (D7..D4 on a 4 bit bus); E edges are checked against the datasheet
+ *   timing, and a falling E latches the pins like a real controller;
+ *   returns the levels the controllers drive on D7..D0 in a read cycle,
+ *   or -1 if they don't drive the bus
+ *
+ * void drv_generic_hd44780_burst (int on)
+ *   brackets the pin changes of one display update, which are accounted
+ *   and dumped together (calls may nest)
+ *
+ * int drv_generic_hd44780_close (void)
+ *   writes a summary to the log and releases the model
+ *   returns 0 if ok, -1 on failure
+ *
+ */
+
+#ifndef _DRV_GENERIC_HD44780_H_
+#define _DRV_GENERIC_HD44780_H_
+
+int drv_generic_hd44780_open(const char *section, const char *driver, const int controllers,
+			     const int rows, const int cols, int (*address) (int row, int col, int *controller));
+int drv_generic_hd44780_pins(const unsigned long long time, const int enable, const int rs, const int rw,
+			     const unsigned char data);
+void drv_generic_hd44780_burst(const int on);
+int drv_generic_hd44780_close(void);
+
+#endif
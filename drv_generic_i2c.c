@@ -36,6 +36,21 @@
 
      */
 
+/*
+ * If the adapter supports plain i2c transfers (I2C_FUNC_I2C), every write
+ * is queued as an i2c message and sent with a single I2C_RDWR ioctl.
+ * Between drv_generic_i2c_burst(1) and drv_generic_i2c_burst(0) messages
+ * are collected, and consecutive bytes for an expander without registers
+ * (like the PCF8574) are merged into one message. So a whole row costs
+ * one syscall instead of one per expander state.
+ *
+ * Port 'sim:<file>' opens no device at all, but writes every transfer
+ * to the file (e.g. for checking the output without the display).
+ * The simulated bus runs at 100 kHz: a message costs start and address
+ * (10 clocks), 9 clocks per byte and a stop, and a probe sees every byte
+ * at the time the expander changes its outputs.
+ */
+
 #include "config.h"
 
 #include <stdlib.h>
@@ -56,6 +71,8 @@
 #include "qprintf.h"
 #include "cfg.h"
 #include "udelay.h"
+#include "stats.h"
+#include "drv.h"
 #include "drv_generic_i2c.h"
 
 
@@ -65,6 +82,26 @@ static int i2c_device;
 static int ctrldev;
 static int datadev;
 
+/* batched transfers */
+#define I2C_BUFFER 4096
+
+static int Batch = 0;		/* send writes with I2C_RDWR */
+static int Burst = 0;		/* nesting level of drv_generic_i2c_burst() */
+static struct i2c_msg *Msgs = NULL;
+static int nMsgs = 0;
+static int Merge = 0;		/* last message may be extended */
+static unsigned char *Buffer = NULL;
+static int nBuffer = 0;
+static int Stats = -1;
+
+/* simulator: transfers go to a file, time advances by the clocks and waits */
+#define SIM_CLOCK 10000		/* nsec per clock at 100 kHz */
+
+static FILE *Sim = NULL;
+static unsigned long long SimTime = 0;
+static void (*Probe) (const unsigned long long time, const int datadev, const int pos, const unsigned char byte) =
+    NULL;
+
 static void my_i2c_smbus_write_byte_data(const int device, const unsigned char val)
 {
     struct i2c_smbus_ioctl_data args;
@@ -92,6 +129,114 @@ static void my_i2c_smbus_read_byte_data(const int device, const unsigned char da
 }
 #endif
 
+/* send all queued messages */
+static void drv_generic_i2c_flush(void)
+{
+    struct i2c_rdwr_ioctl_data rdwr;
+    STATS_TIME t;
+    int i, n;
+
+    if (nMsgs == 0)
+	return;
+
+    STATS_BEGIN(t);
+    if (Sim) {
+	fprintf(Sim, "%llu transfer", SimTime);
+	for (i = 0; i < nMsgs; i++) {
+	    /* (repeated) start and address */
+	    SimTime += 10 * SIM_CLOCK;
+	    fprintf(Sim, " 0x%02x:", Msgs[i].addr);
+	    for (n = 0; n < Msgs[i].len; n++) {
+		fprintf(Sim, "%s%02x", n ? "," : "", Msgs[i].buf[n]);
+		/* the expander changes its outputs on the acknowledge */
+		SimTime += 9 * SIM_CLOCK;
+		if (Probe)
+		    Probe(SimTime, datadev && Msgs[i].addr == datadev, n, Msgs[i].buf[n]);
+	    }
+	}
+	/* stop */
+	SimTime += SIM_CLOCK;
+	fprintf(Sim, "\n");
+    } else {
+	rdwr.msgs = Msgs;
+	rdwr.nmsgs = nMsgs;
+	if (ioctl(i2c_device, I2C_RDWR, &rdwr) < 0) {
+	    error("%s: I2C_RDWR with %d messages failed: %s", Driver, nMsgs, strerror(errno));
+	}
+    }
+    STATS_END(Stats, t);
+    stats_count(Stats, nBuffer);
+
+    nMsgs = 0;
+    nBuffer = 0;
+    Merge = 0;
+}
+
+
+/* queue a write to one device, send it unless we are in a burst */
+static void drv_generic_i2c_queue(const int dev, const unsigned char *data, const int len, const int merge)
+{
+    struct i2c_msg *M;
+
+    if (nMsgs >= I2C_RDRW_IOCTL_MAX_MSGS || nBuffer + len > I2C_BUFFER)
+	drv_generic_i2c_flush();
+
+    if (merge && Merge && nMsgs > 0 && Msgs[nMsgs - 1].addr == dev) {
+	/* the buffer grows in order, so the last message can grow too */
+	Msgs[nMsgs - 1].len += len;
+    } else {
+	M = &Msgs[nMsgs++];
+	M->addr = dev;
+	M->flags = 0;
+	M->len = len;
+	M->buf = Buffer + nBuffer;
+    }
+    memcpy(Buffer + nBuffer, data, len);
+    nBuffer += len;
+    Merge = merge;
+
+    if (Burst == 0)
+	drv_generic_i2c_flush();
+}
+
+
+void drv_generic_i2c_burst(const int on)
+{
+    if (!Batch)
+	return;
+
+    if (on) {
+	Burst++;
+	return;
+    }
+
+    if (Burst > 0 && --Burst == 0)
+	drv_generic_i2c_flush();
+}
+
+
+void drv_generic_i2c_wait(const unsigned long usec)
+{
+    drv_generic_i2c_flush();
+    if (Sim) {
+	SimTime += 1000ULL * usec;
+	return;
+    }
+    udelay(usec);
+}
+
+
+int drv_generic_i2c_probe(void (*probe) (const unsigned long long time, const int datadev, const int pos,
+					 const unsigned char byte))
+{
+    if (Sim == NULL)
+	return -1;
+
+    Probe = probe;
+    return 0;
+}
+
+
 int drv_generic_i2c_pre_write(int dev)
 {
 
@@ -113,15 +258,61 @@ int drv_generic_i2c_pre_write(int dev)
 int drv_generic_i2c_open(const char *section, const char *driver)
 {
     char *bus, *device;
+    unsigned long funcs;
+
+    /* every display has its own bus */
+    drv_state(&Driver, sizeof(Driver));
+    drv_state(&Section, sizeof(Section));
+    drv_state(&i2c_device, sizeof(i2c_device));
+    drv_state(&ctrldev, sizeof(ctrldev));
+    drv_state(&datadev, sizeof(datadev));
+    drv_state(&Batch, sizeof(Batch));
+    drv_state(&Burst, sizeof(Burst));
+    drv_state(&Msgs, sizeof(Msgs));
+    drv_state(&nMsgs, sizeof(nMsgs));
+    drv_state(&Merge, sizeof(Merge));
+    drv_state(&Buffer, sizeof(Buffer));
+    drv_state(&nBuffer, sizeof(nBuffer));
+    drv_state(&Stats, sizeof(Stats));
+    drv_state(&Sim, sizeof(Sim));
+    drv_state(&SimTime, sizeof(SimTime));
+    drv_state(&Probe, sizeof(Probe));
+
     udelay_init();
     Section = (char *) section;
     Driver = (char *) driver;
+    Stats = stats_register("write", driver);
     bus = cfg_get(Section, "Port", NULL);
-    device = cfg_get(Section, "Device", NULL);
+    device = cfg_get(Section, "Device", "0");
     ctrldev = atoi(device);
-    device = cfg_get(Section, "DDevice", NULL);
+    free(device);
+    device = cfg_get(Section, "DDevice", "0");
     datadev = atoi(device);
 
+    Msgs = malloc(I2C_RDRW_IOCTL_MAX_MSGS * sizeof(struct i2c_msg));
+    Buffer = malloc(I2C_BUFFER);
+    nMsgs = 0;
+    nBuffer = 0;
+    Merge = 0;
+    Burst = 0;
+
+    i2c_device = -1;
+    if (bus != NULL && strncmp(bus, "sim:", 4) == 0) {
+	Sim = fopen(bus + 4, "w");
+	if (Sim == NULL) {
+	    error("%s: fopen(%s) failed: %s", Driver, bus + 4, strerror(errno));
+	    goto exit_error;
+	}
+	info("%s: simulating I2C bus, transfers go to %s", Driver, bus + 4);
+	fprintf(Sim, "# %s i2c transfers, device 0x%02x, data device 0x%02x\n", Driver, ctrldev, datadev);
+	Batch = 1;
+	SimTime = 0;
+	Probe = NULL;
+	free(bus);
+	free(device);
+	return 0;
+    }
+
     info("%s: initializing I2C bus %s", Driver, bus);
     if ((i2c_device = open(bus, O_WRONLY)) < 0) {
 	error("%s: I2C bus %s open failed !\n", Driver, bus);
@@ -136,17 +327,50 @@ int drv_generic_i2c_open(const char *section, const char *driver)
     if (drv_generic_i2c_pre_write(ctrldev) < 0)
 	goto exit_error;
 
+    /* batch writes if the adapter can do plain i2c transfers */
+    if (ioctl(i2c_device, I2C_FUNCS, &funcs) < 0)
+	funcs = 0;
+    cfg_number(Section, "Batch", 1, 0, 1, &Batch);
+    if (Batch && !(funcs & I2C_FUNC_I2C)) {
+	info("%s: adapter supports SMBus transfers only", Driver);
+	Batch = 0;
+    }
+    info("%s: %susing batched I2C transfers", Driver, Batch ? "" : "not ");
+
+    free(bus);
+    free(device);
     return 0;
 
   exit_error:
     free(bus);
     free(device);
-    close(i2c_device);
+    if (i2c_device >= 0)
+	close(i2c_device);
+    free(Msgs);
+    Msgs = NULL;
+    free(Buffer);
+    Buffer = NULL;
     return -1;
 }
 
 int drv_generic_i2c_close(void)
 {
+    drv_generic_i2c_flush();
+    Burst = 0;
+
+    free(Msgs);
+    Msgs = NULL;
+    free(Buffer);
+    Buffer = NULL;
+
+    if (Sim) {
+	fprintf(Sim, "%llu end\n", SimTime);
+	fclose(Sim);
+	Sim = NULL;
+	Probe = NULL;
+	return 0;
+    }
+
     close(i2c_device);
     return 0;
 }
@@ -180,12 +404,21 @@ unsigned char drv_generic_i2c_wire(const char *name, const char *deflt)
 
 void drv_generic_i2c_byte(const unsigned char data)
 {
+    if (Batch) {
+	drv_generic_i2c_queue(ctrldev, &data, 1, 1);
+	return;
+    }
     i2c_smbus_write_byte(i2c_device, data);
 }
 
 
 void drv_generic_i2c_data(const unsigned char data)
 {
+    if (Batch) {
+	unsigned char buffer[2] = { data, data };
+	drv_generic_i2c_queue(ctrldev, buffer, 2, 0);
+	return;
+    }
     my_i2c_smbus_write_byte_data(i2c_device, data);
 }
 
@@ -203,6 +436,27 @@ static void i2c_out(int dev, unsigned char val)
 void drv_generic_i2c_command(const unsigned char command, /*const */ unsigned char *data, const unsigned char length,
 			     int bits)
 {
+    if (Batch) {
+	unsigned char buffer[3];
+	if (bits == 4) {
+	    /* the expander states: nibble, nibble with enable, nibble */
+	    int n = length > 2 ? 2 : length;
+	    buffer[0] = command;
+	    memcpy(buffer + 1, data, n);
+	    drv_generic_i2c_queue(ctrldev, buffer, 1 + n, 1);
+	} else if (bits == 8 && datadev) {
+	    /* output register 1 of the data and the control expander */
+	    buffer[0] = 1;
+	    buffer[1] = data[0];
+	    drv_generic_i2c_queue(datadev, buffer, 2, 0);
+	    buffer[1] = command | data[1];
+	    drv_generic_i2c_queue(ctrldev, buffer, 2, 0);
+	    buffer[1] = command;
+	    drv_generic_i2c_queue(ctrldev, buffer, 2, 0);
+	}
+	return;
+    }
+
     if (bits == 4) {
 	i2c_smbus_write_block_data(i2c_device, command, length, data);
     } else if (bits == 8 && datadev) {
@@ -46,6 +46,20 @@
  *
  * void drv_generic_i2c_command(unsigned char command, unsigned char *data,unsigned char length)
  *   send command and the data to the i2c device
+ *
+ * void drv_generic_i2c_burst (int on)
+ *   collects all writes between burst(1) and burst(0) into
+ *   one I2C_RDWR transfer (calls may nest)
+ *
+ * void drv_generic_i2c_wait (unsigned long usec)
+ *   sends all collected writes and waits
+ *
+ * int drv_generic_i2c_probe (void (*probe)(unsigned long long time, int datadev,
+ *                            int pos, unsigned char byte))
+ *   on a simulated bus, 'probe' is called for every byte written, with
+ *   the simulated time [nsec], whether it goes to the data device, and
+ *   its position in the message
+ *   returns 0 if ok, -1 if the bus is not simulated
  * 
  */
 
@@ -59,5 +73,9 @@ void drv_generic_i2c_byte(const unsigned char data);
 void drv_generic_i2c_data(const unsigned char data);
 void drv_generic_i2c_command(const unsigned char command, /*const */ unsigned char *data, const unsigned char length,
 			     int bits);
+void drv_generic_i2c_burst(const int on);
+void drv_generic_i2c_wait(const unsigned long usec);
+int drv_generic_i2c_probe(void (*probe) (const unsigned long long time, const int datadev, const int pos,
+					 const unsigned char byte));
 
 #endif
@@ -33,6 +33,7 @@
 #include "widget.h"
 #include "widget_keypad.h"
 
+#include "drv.h"
 #include "drv_generic_keypad.h"
 
 static char *Section = NULL;
@@ -44,6 +45,11 @@ int drv_generic_keypad_init(const char *section, const char *driver)
 {
     WIDGET_CLASS wc;
 
+    /* every display has its own keypad */
+    drv_state(&Section, sizeof(Section));
+    drv_state(&Driver, sizeof(Driver));
+    drv_state(&drv_generic_keypad_real_press, sizeof(drv_generic_keypad_real_press));
+
     Section = (char *) section;
     Driver = (char *) driver;
 
@@ -64,8 +70,8 @@ int drv_generic_keypad_press(const int num)
 
     w = widget_find(WIDGET_TYPE_KEYPAD, &val);
 
-    if (w && w->class->draw)
-	w->class->draw(w);
+    if (w)
+	widget_draw(w);
 
     return val;
 }
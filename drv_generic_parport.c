@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdarg.h>
 #include <errno.h>
 #include <unistd.h>
 #include <termios.h>
@@ -81,6 +82,8 @@
 #include "qprintf.h"
 #include "cfg.h"
 #include "udelay.h"
+#include "stats.h"
+#include "drv.h"
 #include "drv_generic_parport.h"
 
 
@@ -101,16 +104,106 @@ static unsigned char ctr = 0xc;
 static int PPfd = -1;
 #endif
 
+/* pulse schedule: port accesses and the delays between them */
+#define PULSE_DATA    0
+#define PULSE_CONTROL 1
+
+typedef struct {
+    unsigned char reg;		/* PULSE_DATA or PULSE_CONTROL */
+    unsigned char mask;		/* bits to change, 0 for a delay only */
+    unsigned char value;	/* register value of these bits */
+    unsigned long delay;	/* nsec to pass before the next access */
+} PULSE;
+
+static PULSE *Schedule = NULL;
+static int nSchedule = 0;
+static int aSchedule = 0;
+static int Burst = 0;		/* nesting level of drv_generic_parport_burst() */
+static unsigned long long Ready = 0;	/* no access before this time [nsec] */
+static int Stats = -1;
+
+/* last values written, to skip writes which change nothing */
+static unsigned char Data = 0;
+static int DataKnown = 0;
+static unsigned char Control = 0;
+static unsigned char ControlKnown = 0;
+
+/* simulator: dumps the waveform, time advances by the delays and */
+/* the port accesses, a probe sees every change of the pins */
+#define SIM_ACCESS 100		/* nsec per port access */
+
+static FILE *Sim = NULL;
+static unsigned long long SimTime = 0;
+static unsigned long long SimDumped = 0;
+static int (*Probe) (const unsigned long long time, const unsigned char data, const unsigned char control) = NULL;
+
 
 int drv_generic_parport_open(const char *section, const char *driver)
 {
     char *s, *e;
 
+    /* every display has its own port */
+    drv_state(&Driver, sizeof(Driver));
+    drv_state(&Section, sizeof(Section));
+    drv_state(&Port, sizeof(Port));
+    drv_state(&PPdev, sizeof(PPdev));
+    drv_state(&inverted_control_bits, sizeof(inverted_control_bits));
+#ifdef WITH_OUTB
+    drv_state(&ctr, sizeof(ctr));
+#endif
+#ifdef WITH_PPDEV
+    drv_state(&PPfd, sizeof(PPfd));
+#endif
+    drv_state(&Schedule, sizeof(Schedule));
+    drv_state(&nSchedule, sizeof(nSchedule));
+    drv_state(&aSchedule, sizeof(aSchedule));
+    drv_state(&Burst, sizeof(Burst));
+    drv_state(&Ready, sizeof(Ready));
+    drv_state(&Stats, sizeof(Stats));
+    drv_state(&Data, sizeof(Data));
+    drv_state(&DataKnown, sizeof(DataKnown));
+    drv_state(&Control, sizeof(Control));
+    drv_state(&ControlKnown, sizeof(ControlKnown));
+    drv_state(&Sim, sizeof(Sim));
+    drv_state(&SimTime, sizeof(SimTime));
+    drv_state(&SimDumped, sizeof(SimDumped));
+    drv_state(&Probe, sizeof(Probe));
+
     Section = (char *) section;
     Driver = (char *) driver;
+    Stats = stats_register("burst", driver);
 
     udelay_init();
 
+    s = cfg_get(Section, "Port", NULL);
+    if (s != NULL && strncmp(s, "sim:", 4) == 0) {
+	Sim = fopen(s + 4, "w");
+	if (Sim == NULL) {
+	    error("%s: fopen(%s) failed: %s", Driver, s + 4, strerror(errno));
+	    free(s);
+	    return -1;
+	}
+	info("%s: simulating parallel port, writing waveform to %s", Driver, s + 4);
+	free(s);
+	SimTime = 0;
+	SimDumped = 0;
+	Probe = NULL;
+	fprintf(Sim, "$comment %s parallel port $end\n", Driver);
+	fprintf(Sim, "$timescale 1 ns $end\n");
+	fprintf(Sim, "$scope module parport $end\n");
+	fprintf(Sim, "$var wire 8 D data $end\n");
+	fprintf(Sim, "$var wire 1 S strobe $end\n");
+	fprintf(Sim, "$var wire 1 A autofd $end\n");
+	fprintf(Sim, "$var wire 1 I init $end\n");
+	fprintf(Sim, "$var wire 1 L slctin $end\n");
+	fprintf(Sim, "$var wire 1 R input $end\n");
+	fprintf(Sim, "$upscope $end\n");
+	fprintf(Sim, "$enddefinitions $end\n");
+	fprintf(Sim, "#0\nbxxxxxxxx D\nxS\nxA\nxI\nxL\n0R\n");
+	return 0;
+    }
+    free(s);
+
 #ifndef WITH_PPDEV
     error("The files include/linux/parport.h and/or include/linux/ppdev.h");
     error("were missing at compile time. Even if your system supports");
@@ -182,6 +275,23 @@ int drv_generic_parport_open(const char *section, const char *driver)
 
 int drv_generic_parport_close(void)
 {
+    /* the last burst and its delays */
+    drv_generic_parport_wait();
+
+    if (Schedule) {
+	free(Schedule);
+	Schedule = NULL;
+    }
+    nSchedule = 0;
+    aSchedule = 0;
+
+    if (Sim) {
+	fprintf(Sim, "#%llu\n", SimTime);
+	fclose(Sim);
+	Sim = NULL;
+	Probe = NULL;
+	return 0;
+    }
 #ifdef WITH_PPDEV
     if (PPdev) {
 	debug("closing ppdev %s", PPdev);
@@ -378,8 +488,241 @@ unsigned char drv_generic_parport_wire_data(const char *name, const char *deflt)
 }
 
 
+/* the simulator dumps every change of a signal */
+static void drv_generic_parport_dump(const char *fmt, ...)
+    __attribute__ ((format(__printf__, 1, 2)));
+
+static void drv_generic_parport_dump(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (SimTime != SimDumped) {
+	fprintf(Sim, "#%llu\n", SimTime);
+	SimDumped = SimTime;
+    }
+    va_start(ap, fmt);
+    vfprintf(Sim, fmt, ap);
+    va_end(ap);
+}
+
+
+/* the simulated port needs some time for an access, */
+/* and shows the logical levels of the pins to the probe */
+static int drv_generic_parport_sim(void)
+{
+    int value = Data;
+
+    if (Probe)
+	value = Probe(SimTime, Data, Control ^ PARPORT_CONTROL_INVERTED ^ inverted_control_bits);
+    SimTime += SIM_ACCESS;
+
+    return value;
+}
+
+
+static unsigned long long drv_generic_parport_now(void)
+{
+    return Sim ? SimTime : nclock();
+}
+
+
+/* honour the delays of the preceding accesses */
+static void drv_generic_parport_ready(void)
+{
+    if (Sim) {
+	if (SimTime < Ready)
+	    SimTime = Ready;
+    } else if (Ready > 0) {
+	ndelay_until(Ready);
+    }
+}
+
+
+static void drv_generic_parport_write(const PULSE * P)
+{
+    unsigned char val = P->value;
+    int i;
+
+    if (P->mask == 0)
+	return;
+
+    if (P->reg == PULSE_DATA) {
+	if (DataKnown && Data == val)
+	    return;
+	drv_generic_parport_ready();
+	Data = val;
+	DataKnown = 1;
+	if (Sim) {
+	    char bits[9];
+	    for (i = 0; i < 8; i++)
+		bits[i] = val & (0x80 >> i) ? '1' : '0';
+	    bits[8] = '\0';
+	    drv_generic_parport_dump("b%s D\n", bits);
+	    drv_generic_parport_sim();
+	}
+#ifdef WITH_PPDEV
+	if (PPdev) {
+	    ioctl(PPfd, PPWDATA, &val);
+	}
+#endif
+#ifdef WITH_OUTB
+	if (Port) {
+	    outb(val, Port);
+	}
+#endif
+	return;
+    }
+
+    if ((ControlKnown & P->mask) == P->mask && (Control & P->mask) == val)
+	return;
+    drv_generic_parport_ready();
+    Control = (Control & ~P->mask) | val;
+    ControlKnown |= P->mask;
+    if (Sim) {
+	/* signal levels at the connector: Strobe, Select and AutoFeed are inverted */
+	unsigned char pins = Control ^ PARPORT_CONTROL_INVERTED;
+	if (P->mask & PARPORT_CONTROL_STROBE)
+	    drv_generic_parport_dump("%dS\n", pins & PARPORT_CONTROL_STROBE ? 1 : 0);
+	if (P->mask & PARPORT_CONTROL_AUTOFD)
+	    drv_generic_parport_dump("%dA\n", pins & PARPORT_CONTROL_AUTOFD ? 1 : 0);
+	if (P->mask & PARPORT_CONTROL_INIT)
+	    drv_generic_parport_dump("%dI\n", pins & PARPORT_CONTROL_INIT ? 1 : 0);
+	if (P->mask & PARPORT_CONTROL_SELECT)
+	    drv_generic_parport_dump("%dL\n", pins & PARPORT_CONTROL_SELECT ? 1 : 0);
+	drv_generic_parport_sim();
+    }
+#ifdef WITH_PPDEV
+    if (PPdev) {
+	struct ppdev_frob_struct frob;
+	frob.mask = P->mask;
+	frob.val = val;
+	ioctl(PPfd, PPFCONTROL, &frob);
+    }
+#endif
+#ifdef WITH_OUTB
+    if (Port) {
+	/* code stolen from linux/parport_pc.h */
+	ctr = (ctr & ~P->mask) ^ val;
+	outb(ctr, Port + 2);
+    }
+#endif
+}
+
+
+static void drv_generic_parport_step(const PULSE * P)
+{
+    unsigned long long t;
+
+    drv_generic_parport_write(P);
+
+    /* the next access has to wait, but we don't */
+    if (P->delay > 0) {
+	/* a skipped write counts as done when it was due */
+	t = drv_generic_parport_now();
+	if (t < Ready)
+	    t = Ready;
+	Ready = t + P->delay;
+    }
+}
+
+
+/* execute the schedule in one go */
+static void drv_generic_parport_flush(void)
+{
+    STATS_TIME t;
+    int i;
+
+    if (nSchedule == 0)
+	return;
+
+    STATS_BEGIN(t);
+    for (i = 0; i < nSchedule; i++) {
+	drv_generic_parport_step(&Schedule[i]);
+    }
+    STATS_END(Stats, t);
+    stats_count(Stats, nSchedule);
+
+    nSchedule = 0;
+}
+
+
+static void drv_generic_parport_access(const unsigned char reg, const unsigned char mask, const unsigned char value)
+{
+    PULSE P;
+
+    P.reg = reg;
+    P.mask = mask;
+    P.value = value;
+    P.delay = 0;
+
+    if (Burst) {
+	if (nSchedule >= aSchedule) {
+	    int n = aSchedule ? 2 * aSchedule : 256;
+	    PULSE *tmp = realloc(Schedule, n * sizeof(PULSE));
+	    if (tmp == NULL) {
+		/* no memory: execute what we have */
+		drv_generic_parport_flush();
+		drv_generic_parport_step(&P);
+		return;
+	    }
+	    Schedule = tmp;
+	    aSchedule = n;
+	}
+	Schedule[nSchedule++] = P;
+	return;
+    }
+
+    drv_generic_parport_step(&P);
+}
+
+
+void drv_generic_parport_delay(const unsigned long nsec)
+{
+    unsigned long long t;
+
+    if (Burst) {
+	if (nSchedule == 0) {
+	    drv_generic_parport_access(PULSE_DATA, 0, 0);
+	}
+	/* drv_generic_parport_access() may have flushed */
+	if (nSchedule > 0) {
+	    Schedule[nSchedule - 1].delay += nsec;
+	    return;
+	}
+    }
+
+    t = drv_generic_parport_now();
+    if (t < Ready)
+	t = Ready;
+    Ready = t + nsec;
+}
+
+
+void drv_generic_parport_wait(void)
+{
+    drv_generic_parport_flush();
+    drv_generic_parport_ready();
+}
+
+
+void drv_generic_parport_burst(const int on)
+{
+    if (on) {
+	Burst++;
+    } else if (Burst > 0 && --Burst == 0) {
+	drv_generic_parport_flush();
+    }
+}
+
+
 void drv_generic_parport_direction(const int direction)
 {
+    /* reading needs a valid schedule */
+    drv_generic_parport_wait();
+
+    if (Sim) {
+	drv_generic_parport_dump("%dR\n", direction ? 1 : 0);
+    }
 #ifdef WITH_PPDEV
     if (PPdev) {
 	ioctl(PPfd, PPDATADIR, &direction);
@@ -402,7 +745,9 @@ unsigned char drv_generic_parport_status(void)
 	PARPORT_STATUS_ERROR | PARPORT_STATUS_SELECT | PARPORT_STATUS_PAPEROUT | PARPORT_STATUS_ACK |
 	PARPORT_STATUS_BUSY;
 
-    unsigned char data;
+    unsigned char data = 0;
+
+    drv_generic_parport_wait();
 
 #ifdef WITH_PPDEV
     if (PPdev) {
@@ -435,22 +780,7 @@ void drv_generic_parport_control(const unsigned char mask, const unsigned char v
     /* Strobe, Select and AutoFeed are inverted! */
     val = mask & (value ^ PARPORT_CONTROL_INVERTED ^ inverted_control_bits);
 
-#ifdef WITH_PPDEV
-    if (PPdev) {
-	struct ppdev_frob_struct frob;
-	frob.mask = mask;
-	frob.val = val;
-	ioctl(PPfd, PPFCONTROL, &frob);
-    }
-#endif
-
-#ifdef WITH_OUTB
-    if (Port) {
-	/* code stolen from linux/parport_pc.h */
-	ctr = (ctr & ~mask) ^ val;
-	outb(ctr, Port + 2);
-    }
-#endif
+    drv_generic_parport_access(PULSE_CONTROL, mask, val);
 }
 
 
@@ -471,61 +801,31 @@ void drv_generic_parport_toggle(const unsigned char bits, const int level, const
     value1 = bits & (value1 ^ PARPORT_CONTROL_INVERTED ^ inverted_control_bits);
     value2 = bits & (value2 ^ PARPORT_CONTROL_INVERTED ^ inverted_control_bits);
 
-#ifdef WITH_PPDEV
-    if (PPdev) {
-	struct ppdev_frob_struct frob;
-	frob.mask = bits;
-
-	/* rise */
-	frob.val = value1;
-	ioctl(PPfd, PPFCONTROL, &frob);
-
-	/* pulse width */
-	ndelay(delay);
+    /* rise */
+    drv_generic_parport_access(PULSE_CONTROL, bits, value1);
 
-	/* lower */
-	frob.val = value2;
-	ioctl(PPfd, PPFCONTROL, &frob);
-
-    }
-#endif
+    /* pulse width */
+    drv_generic_parport_delay(delay);
 
-#ifdef WITH_OUTB
-    if (Port) {
-	/* rise */
-	ctr = (ctr & ~bits) ^ value1;
-	outb(ctr, Port + 2);
-
-	/* pulse width */
-	ndelay(delay);
-
-	/* lower */
-	ctr = (ctr & ~bits) ^ value2;
-	outb(ctr, Port + 2);
-    }
-#endif
+    /* lower */
+    drv_generic_parport_access(PULSE_CONTROL, bits, value2);
 }
 
 
 void drv_generic_parport_data(const unsigned char data)
 {
-#ifdef WITH_PPDEV
-    if (PPdev) {
-	ioctl(PPfd, PPWDATA, &data);
-    }
-#endif
-
-#ifdef WITH_OUTB
-    if (Port) {
-	outb(data, Port);
-    }
-#endif
+    drv_generic_parport_access(PULSE_DATA, 0xff, data);
 }
 
 unsigned char drv_generic_parport_read(void)
 {
     unsigned char data = 0;
 
+    drv_generic_parport_wait();
+
+    if (Sim) {
+	data = drv_generic_parport_sim();
+    }
 #ifdef WITH_PPDEV
     if (PPdev) {
 	ioctl(PPfd, PPRDATA, &data);
@@ -542,10 +842,26 @@ unsigned char drv_generic_parport_read(void)
 }
 
 
+int drv_generic_parport_probe(int (*probe) (const unsigned long long time, const unsigned char data,
+					    const unsigned char control))
+{
+    if (Sim == NULL)
+	return -1;
+
+    Probe = probe;
+    return 0;
+}
+
+
 void drv_generic_parport_debug(void)
 {
     unsigned char control = 0;
 
+    drv_generic_parport_wait();
+
+    if (Sim) {
+	control = Control;
+    }
 #ifdef WITH_PPDEV
     if (PPdev) {
 	ioctl(PPfd, PPRCONTROL, &control);
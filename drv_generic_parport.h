@@ -75,9 +75,32 @@
  * unsigned char drv_generic_parport_read (void)
  *   reads a byte from the parallel port
  *
+ * int drv_generic_parport_probe (int (*probe)(unsigned long long time, unsigned char data,
+ *                                unsigned char control))
+ *   on a simulated port, 'probe' is called at every change of the pins
+ *   with the simulated time [nsec], the data lines and the logical levels
+ *   of the control lines (as passed to drv_generic_parport_control());
+ *   its return value is what drv_generic_parport_read() reads
+ *   returns 0 if ok, -1 if the port is not simulated
+ *
  * void drv_generic_parport_debug(void)
  *   prints status of control lines
  *
+ * void drv_generic_parport_delay (unsigned long nsec)
+ *   the next access must not happen within nsec nanoseconds
+ *   (waits only if the next access comes too early)
+ *
+ * void drv_generic_parport_burst (int on)
+ *   on=1 starts collecting the following accesses and delays into a
+ *   pulse schedule, on=0 executes it in one tight loop; may be nested
+ *
+ * void drv_generic_parport_wait (void)
+ *   executes pending accesses and waits for all delays to pass
+ *
+ * A Port 'sim:<file>' does not touch any hardware, but writes the
+ * waveform as a Value Change Dump (VCD) to <file>. Time advances by
+ * the delays and 100 nsec per port access only.
+ *
  */
 
 #ifndef _DRV_GENERIC_PARPORT_H_
@@ -95,6 +118,11 @@ void drv_generic_parport_control(const unsigned char mask, const unsigned char v
 void drv_generic_parport_toggle(const unsigned char bit, const int level, const unsigned long delay);
 void drv_generic_parport_data(const unsigned char data);
 unsigned char drv_generic_parport_read(void);
+int drv_generic_parport_probe(int (*probe) (const unsigned long long time, const unsigned char data,
+					    const unsigned char control));
 void drv_generic_parport_debug(void);
+void drv_generic_parport_delay(const unsigned long nsec);
+void drv_generic_parport_burst(const int on);
+void drv_generic_parport_wait(void);
 
 #endif
@@ -66,7 +66,10 @@
 #include "debug.h"
 #include "qprintf.h"
 #include "cfg.h"
+#include "drv.h"
 #include "drv_generic_serial.h"
+#include "bench.h"
+#include "stats.h"
 
 
 extern int got_signal;
@@ -76,6 +79,7 @@ static char *Driver;
 static char *Port;
 static speed_t Speed;
 static int Device = -1;
+static int Stats = -1;
 
 
 #define LOCK "/var/lock/LCK..%s"
@@ -233,8 +237,17 @@ int drv_generic_serial_open(const char *section, const char *driver, const unsig
     pid_t pid;
     struct termios portset;
 
+    /* every display has its own port */
+    drv_state(&Section, sizeof(Section));
+    drv_state(&Driver, sizeof(Driver));
+    drv_state(&Port, sizeof(Port));
+    drv_state(&Speed, sizeof(Speed));
+    drv_state(&Device, sizeof(Device));
+    drv_state(&Stats, sizeof(Stats));
+
     Section = (char *) section;
     Driver = (char *) driver;
+    Stats = stats_register("write", driver);
 
     Port = cfg_get(section, "Port", NULL);
     if (Port == NULL || *Port == '\0') {
@@ -372,12 +385,15 @@ void drv_generic_serial_write(const char *string, const int len)
 {
     static int error = 0;
     int run, ret;
+    STATS_TIME t;
 
     if (Device == -1) {
 	error("%s: write to closed port %s failed!", Driver, Port);
 	return;
     }
 
+    STATS_BEGIN(t);
+
     for (run = 0; run < 10; run++) {
 	ret = write(Device, string, len);
 	if (ret >= 0 || errno != EAGAIN) {
@@ -401,6 +417,10 @@ void drv_generic_serial_write(const char *string, const int len)
     } else {
 	error = 0;
     }
+    if (ret > 0) {
+	STATS_BENCH_COUNT(Stats, BENCH_SENT, ret);
+    }
+    STATS_END(Stats, t);
     return;
 }
 
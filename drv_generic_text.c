@@ -61,6 +61,7 @@
  *
  * int drv_generic_text_bar_init (int single_segments);
  *   initializes the generic icon driver
+ *   and registers the Graph widget, which is drawn with bars
  *
  * void drv_generic_text_bar_add_segment (int val1, int val2, DIRECTION dir, int ascii);
  *   adds a 'fixed' character to the bar-renderer
@@ -69,9 +70,19 @@
  *   renders Bar widget into framebuffer
  *   calls drv_generic_text_real_write() and drv_generic_text_real_defchar()
  *
+ * int drv_generic_text_graph_draw (WIDGET *W);
+ *   renders the new columns of a Graph widget as bars
+ *
  * int drv_generic_text_quit (void);
  *   closes the generic text driver
  *
+ *
+ * With 'Thread 1' in the display section, drawing a widget only updates
+ * the layout framebuffer, and real_write() and real_defchar() are called
+ * by an output thread (see drv_output() in drv.c). The thread always
+ * sends what the layout framebuffer holds right now, so changes which
+ * pile up while the hardware is busy are merged into one update.
+ *
  */
 
 #include "config.h"
@@ -83,6 +94,7 @@
 #include <unistd.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <math.h>
 
 #include "debug.h"
 #include "cfg.h"
@@ -91,9 +103,12 @@
 #include "widget_text.h"
 #include "widget_icon.h"
 #include "widget_bar.h"
+#include "widget_graph.h"
 #include "drv.h"
 #include "drv_generic.h"
 #include "drv_generic_text.h"
+#include "bench.h"
+#include "stats.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -120,6 +135,7 @@ typedef struct {
 
 static char *Section = NULL;
 static char *Driver = NULL;
+static int Stats = -1;
 
 int CHARS = 0;			/* number of user-defineable characters */
 int CHAR0 = 0;			/* ASCII of first user-defineable char */
@@ -144,6 +160,17 @@ static int fSegment = 0;
 static SEGMENT Segment[128];
 static BAR *BarFB = NULL;
 
+static int icon_counter = 0;
+
+/* output thread */
+static int Async = 0;		/* widgets are sent by the output thread */
+static int Dirty[4] = { 0, 0, 0, 0 };	/* changed area: row, col, height, width */
+static unsigned char *Charset = NULL;	/* pending user-defined chars */
+static char *Redefine = NULL;
+static int Updates = 0;		/* changes since the display was up to date */
+static STATS_TIME Produced = 0;	/* time of the first of these changes */
+static int Latency = -1;
+
 
 /****************************************/
 /*** generic Framebuffer stuff        ***/
@@ -231,7 +258,8 @@ static void drv_generic_text_resizeFB(int rows, int cols)
 }
 
 
-static void drv_generic_text_blit(const int row, const int col, const int height, const int width)
+/* send changed areas to the display, returns the row where it was preempted, or -1 */
+static int drv_generic_text_send(const int row, const int col, const int height, const int width)
 {
     int lr, lc;			/* layout  row/col */
     int dr, dc;			/* display row/col */
@@ -240,6 +268,9 @@ static void drv_generic_text_blit(const int row, const int col, const int height
 
     /* loop over layout rows */
     for (lr = row; lr < LROWS && lr < row + height; lr++) {
+	/* the output thread gives way to the main loop */
+	if (Async && drv_output_preempted())
+	    return lr;
 	/* transform layout to display row */
 	dr = lr;
 	/* sanity check */
@@ -272,10 +303,127 @@ static void drv_generic_text_blit(const int row, const int col, const int height
 	    }
 	    /* send to display */
 	    memcpy(DisplayFB + dr * DCOLS + p1, LayoutFB + lr * LCOLS + p1, p2 - p1 + 1);
-	    if (drv_generic_text_real_write)
+	    if (drv_generic_text_real_write) {
+		STATS_TIME t;
+		STATS_BENCH_BEGIN(t, BENCH_BLIT);
 		drv_generic_text_real_write(dr, p1, DisplayFB + dr * DCOLS + p1, p2 - p1 + 1);
+		STATS_BENCH_END(Stats, t, BENCH_BLIT);
+		STATS_BENCH_COUNT(Stats, BENCH_BLITTED, p2 - p1 + 1);
+	    }
 	}
     }
+    return -1;
+}
+
+
+/* output thread: there is something new to send */
+static void drv_generic_text_produce(void)
+{
+    if (Updates++ == 0)
+	Produced = stats_now();
+    drv_output_pending();
+}
+
+
+static int drv_generic_text_changed(const int row, const int col, const int height, const int width)
+{
+    int r, c;
+
+    for (r = MAX(row, 0); r < LROWS && r < DROWS && r < row + height; r++) {
+	for (c = MAX(col, 0); c < LCOLS && c < DCOLS && c < col + width; c++) {
+	    if (DisplayFB[r * DCOLS + c] != LayoutFB[r * LCOLS + c])
+		return 1;
+	}
+    }
+    return 0;
+}
+
+
+static void drv_generic_text_blit(const int row, const int col, const int height, const int width)
+{
+    int r2, c2;
+
+    if (!Async) {
+	drv_generic_text_send(row, col, height, width);
+	return;
+    }
+
+    if (!drv_generic_text_changed(row, col, height, width))
+	return;
+
+    /* remember the changed area, the output thread will send it */
+    if (Dirty[2] == 0 || Dirty[3] == 0) {
+	Dirty[0] = row;
+	Dirty[1] = col;
+	Dirty[2] = height;
+	Dirty[3] = width;
+    } else {
+	r2 = MAX(Dirty[0] + Dirty[2], row + height);
+	c2 = MAX(Dirty[1] + Dirty[3], col + width);
+	Dirty[0] = MIN(Dirty[0], row);
+	Dirty[1] = MIN(Dirty[1], col);
+	Dirty[2] = r2 - Dirty[0];
+	Dirty[3] = c2 - Dirty[1];
+    }
+
+    drv_generic_text_produce();
+}
+
+
+static void drv_generic_text_defchar(const int ascii, unsigned char *bitmap)
+{
+    int c = ascii - CHAR0;
+
+    if (Async && Charset == NULL && CHARS > 0) {
+	Charset = malloc(CHARS * YRES);
+	Redefine = calloc(CHARS, 1);
+    }
+
+    if (!Async || Charset == NULL || Redefine == NULL || c < 0 || c >= CHARS) {
+	if (drv_generic_text_real_defchar)
+	    drv_generic_text_real_defchar(ascii, bitmap);
+	return;
+    }
+
+    /* a char which is redefined twice is sent once */
+    memcpy(Charset + c * YRES, bitmap, YRES);
+    Redefine[c] = 1;
+    drv_generic_text_produce();
+}
+
+
+/* called by the output thread */
+static int drv_generic_text_flush(void)
+{
+    int c, row;
+
+    for (c = 0; Redefine != NULL && c < CHARS; c++) {
+	if (Redefine[c]) {
+	    Redefine[c] = 0;
+	    if (drv_generic_text_real_defchar)
+		drv_generic_text_real_defchar(CHAR0 + c, Charset + c * YRES);
+	}
+    }
+
+    row = drv_generic_text_send(Dirty[0], Dirty[1], Dirty[2], Dirty[3]);
+    if (row >= 0) {
+	/* rows above are done */
+	Dirty[2] -= row - Dirty[0];
+	Dirty[0] = row;
+	return 1;
+    }
+
+    Dirty[2] = 0;
+    Dirty[3] = 0;
+
+    /* how long the oldest change waited, how many changes were merged */
+    if (Updates > 0) {
+	STATS_END(Latency, Produced);
+	stats_count(Latency, Updates - 1);
+	Updates = 0;
+    }
+
+    return 0;
 }
 
 
@@ -285,9 +433,38 @@ static void drv_generic_text_blit(const int row, const int col, const int height
 
 int drv_generic_text_init(const char *section, const char *driver)
 {
+    /* every display has its own framebuffers */
+    drv_state(&Section, sizeof(Section));
+    drv_state(&Driver, sizeof(Driver));
+    drv_state(&Stats, sizeof(Stats));
+    drv_state(&CHARS, sizeof(CHARS));
+    drv_state(&CHAR0, sizeof(CHAR0));
+    drv_state(&ICONS, sizeof(ICONS));
+    drv_state(&GOTO_COST, sizeof(GOTO_COST));
+    drv_state(&INVALIDATE, sizeof(INVALIDATE));
+    drv_state(&drv_generic_text_real_write, sizeof(drv_generic_text_real_write));
+    drv_state(&drv_generic_text_real_defchar, sizeof(drv_generic_text_real_defchar));
+    drv_state(&LayoutFB, sizeof(LayoutFB));
+    drv_state(&DisplayFB, sizeof(DisplayFB));
+    drv_state(&L2D, sizeof(L2D));
+    drv_state(&Single_Segments, sizeof(Single_Segments));
+    drv_state(&nSegment, sizeof(nSegment));
+    drv_state(&fSegment, sizeof(fSegment));
+    drv_state(Segment, sizeof(Segment));
+    drv_state(&BarFB, sizeof(BarFB));
+    drv_state(&icon_counter, sizeof(icon_counter));
+    drv_state(&Async, sizeof(Async));
+    drv_state(Dirty, sizeof(Dirty));
+    drv_state(&Charset, sizeof(Charset));
+    drv_state(&Redefine, sizeof(Redefine));
+    drv_state(&Updates, sizeof(Updates));
+    drv_state(&Produced, sizeof(Produced));
+    drv_state(&Latency, sizeof(Latency));
 
     Section = (char *) section;
     Driver = (char *) driver;
+    Stats = stats_register("blit", driver);
+    DTYPE = DISPLAY_TEXT;
 
     /* init display framebuffer */
     DisplayFB = (char *) malloc(DCOLS * DROWS * sizeof(*DisplayFB));
@@ -310,6 +487,21 @@ int drv_generic_text_init(const char *section, const char *driver)
     drv_generic_blit = drv_generic_text_blit;
     drv_generic_init();
 
+    /* maybe send widgets from a thread of its own */
+    cfg_number(section, "Thread", 0, 0, 1, &Async);
+    if (Async) {
+	Latency = stats_register("latency", driver);
+	Dirty[2] = 0;
+	Dirty[3] = 0;
+	Updates = 0;
+	if (drv_output(drv_generic_text_flush) < 0) {
+	    error("%s: sending widgets from the main loop", Driver);
+	    Async = 0;
+	} else {
+	    info("%s: sending widgets from an output thread", Driver);
+	}
+    }
+
     return 0;
 }
 
@@ -402,6 +594,7 @@ int drv_generic_text_draw(WIDGET * W)
 
 int drv_generic_text_quit(void)
 {
+    DTYPE = DISPLAY_UNKNOWN;
 
     if (DisplayFB) {
 	free(DisplayFB);
@@ -423,6 +616,18 @@ int drv_generic_text_quit(void)
 	BarFB = NULL;
     }
 
+    if (Charset) {
+	free(Charset);
+	Charset = NULL;
+    }
+
+    if (Redefine) {
+	free(Redefine);
+	Redefine = NULL;
+    }
+
+    Async = 0;
+
     widget_unregister();
 
     return (0);
@@ -446,7 +651,6 @@ int drv_generic_text_icon_init(void)
 
 int drv_generic_text_icon_draw(WIDGET * W)
 {
-    static int icon_counter = 0;
     WIDGET_ICON *Icon = W->data;
     int row, col;
     int visible;
@@ -480,8 +684,7 @@ int drv_generic_text_icon_draw(WIDGET * W)
     /* maybe redefine icon */
     if (Icon->curmap != Icon->prvmap && visible) {
 	Icon->prvmap = Icon->curmap;
-	if (drv_generic_text_real_defchar)
-	    drv_generic_text_real_defchar(Icon->ascii, Icon->bitmap + YRES * Icon->curmap);
+	drv_generic_text_defchar(Icon->ascii, Icon->bitmap + YRES * Icon->curmap);
 	invalidate = INVALIDATE;
     }
 
@@ -529,6 +732,8 @@ static void drv_generic_text_bar_clear(void)
 
 int drv_generic_text_bar_init(const int single_segments)
 {
+    WIDGET_CLASS wc;
+
     if (BarFB)
 	free(BarFB);
 
@@ -544,6 +749,11 @@ int drv_generic_text_bar_init(const int single_segments)
 
     drv_generic_text_bar_clear();
 
+    /* graphs are drawn with bar segments, too */
+    wc = Widget_Graph;
+    wc.draw = drv_generic_text_graph_draw;
+    widget_register(&wc);
+
     return 0;
 }
 
@@ -896,8 +1106,7 @@ static void drv_generic_text_bar_define_chars(void)
 	    }
 	    break;
 	}
-	if (drv_generic_text_real_defchar)
-	    drv_generic_text_real_defchar(CHAR0 + c, buffer);
+	drv_generic_text_defchar(CHAR0 + c, buffer);
 
 	/* maybe invalidate framebuffer */
 	if (INVALIDATE) {
@@ -911,11 +1120,58 @@ static void drv_generic_text_bar_define_chars(void)
 }
 
 
+/* turn all bars into (maybe redefined) characters and send them */
+static void drv_generic_text_bar_update(void)
+{
+    int row, col, c, n, s;
+
+    /* process all bars */
+    drv_generic_text_bar_create_segments();
+    drv_generic_text_bar_pack_segments();
+    drv_generic_text_bar_define_chars();
+
+    /* reset usage flags */
+    for (s = 0; s < nSegment; s++) {
+	Segment[s].used = 0;
+    }
+
+    /* set usage flags */
+    for (n = 0; n < LROWS * LCOLS; n++) {
+	if ((s = BarFB[n].segment) != -1)
+	    Segment[s].used = 1;
+    }
+
+    /* transfer bars into layout buffer */
+    for (row = 0; row < LROWS; row++) {
+	for (col = 0; col < LCOLS; col++) {
+	    n = row * LCOLS + col;
+	    s = BarFB[n].segment;
+	    if (s == -1)
+		continue;
+	    c = Segment[s].ascii;
+	    if (c == -1)
+		continue;
+	    if (s >= fSegment)
+		c += CHAR0;	/* ascii offset for user-defineable chars */
+	    LayoutFB[n] = c;
+	    /* maybe invalidate display framebuffer */
+	    if (BarFB[n].invalid) {
+		BarFB[n].invalid = 0;
+		/* ugly invalidation: change display FB to a wrong value so blit() will really send it */
+		DisplayFB[row * DCOLS + col] = ~LayoutFB[n];
+	    }
+	}
+    }
+
+    /* blit whole layout FB */
+    drv_generic_text_blit(0, 0, LROWS, LCOLS);
+}
+
+
 int drv_generic_text_bar_draw(WIDGET * W)
 {
     WIDGET_BAR *Bar = W->data;
     int row, col, len, res, max, val1, val2;
-    int c, n, s;
     DIRECTION dir;
     STYLE style;
 
@@ -954,48 +1210,57 @@ int drv_generic_text_bar_draw(WIDGET * W)
     /* create this bar */
     drv_generic_text_bar_create_bar(row, col, dir, style, len, val1, val2);
 
-    /* process all bars */
-    drv_generic_text_bar_create_segments();
-    drv_generic_text_bar_pack_segments();
-    drv_generic_text_bar_define_chars();
+    drv_generic_text_bar_update();
 
-    /* reset usage flags */
-    for (s = 0; s < nSegment; s++) {
-	Segment[s].used = 0;
-    }
 
-    /* set usage flags */
-    for (n = 0; n < LROWS * LCOLS; n++) {
-	if ((s = BarFB[n].segment) != -1)
-	    Segment[s].used = 1;
+    return 0;
+
+}
+
+
+/****************************************/
+/*** generic graph handling           ***/
+/****************************************/
+
+/* every column is a bar heading North, so graphs share the bar segments */
+int drv_generic_text_graph_draw(WIDGET * W)
+{
+    WIDGET_GRAPH *Graph = W->data;
+    int row, col, width, height, max, shift, x, y;
+    double val;
+
+    row = W->row;
+    col = W->col;
+    width = Graph->width;
+    height = Graph->height;
+    max = height * YRES;
+
+    /* maybe grow layout framebuffer */
+    drv_generic_text_resizeFB(row + height, col + width);
+
+    /* columns to create: the new samples only, unless the scale changed */
+    shift = Graph->samples - Graph->drawn;
+    if (Graph->rescaled || shift > width) {
+	Graph->rescaled = 0;
+	shift = width;
     }
+    Graph->drawn = Graph->samples;
 
-    /* transfer bars into layout buffer */
-    for (row = 0; row < LROWS; row++) {
-	for (col = 0; col < LCOLS; col++) {
-	    n = row * LCOLS + col;
-	    s = BarFB[n].segment;
-	    if (s == -1)
-		continue;
-	    c = Segment[s].ascii;
-	    if (c == -1)
-		continue;
-	    if (s >= fSegment)
-		c += CHAR0;	/* ascii offset for user-defineable chars */
-	    LayoutFB[n] = c;
-	    /* maybe invalidate display framebuffer */
-	    if (BarFB[n].invalid) {
-		BarFB[n].invalid = 0;
-		/* ugly invalidation: change display FB to a wrong value so blit() will really send it */
-		DisplayFB[row * DCOLS + col] = ~LayoutFB[n];
-	    }
+    /* scroll the older columns to the left */
+    if (shift < width) {
+	for (y = row; y < row + height && y < LROWS; y++) {
+	    BAR *b = BarFB + y * LCOLS + col;
+	    memmove(b, b + shift, (width - shift) * sizeof(BAR));
 	}
     }
 
-    /* blit whole layout FB */
-    drv_generic_text_blit(0, 0, LROWS, LCOLS);
+    for (x = width - shift; x < width; x++) {
+	val = widget_graph_value(Graph, width - 1 - x);
+	drv_generic_text_bar_create_bar(row, col + x, DIR_NORTH, 0, height, isnan(val) ? 0 : val * max,
+					isnan(val) ? 0 : val * max);
+    }
 
+    drv_generic_text_bar_update();
 
     return 0;
-
 }
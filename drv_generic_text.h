@@ -51,6 +51,7 @@ int drv_generic_text_icon_draw(WIDGET * W);
 int drv_generic_text_bar_init(const int single_segments);
 void drv_generic_text_bar_add_segment(const int val1, const int val2, const DIRECTION dir, const int ascii);
 int drv_generic_text_bar_draw(WIDGET * W);
+int drv_generic_text_graph_draw(WIDGET * W);
 int drv_generic_text_quit(void);
 
 
@@ -54,15 +54,25 @@
 #include "widget_text.h"
 #include "widget_icon.h"
 #include "widget_bar.h"
+#include "timer.h"
 #include "drv.h"
+#include "stats.h"
 
 #include "drv_generic_graphic.h"
 
 static char Name[] = "st2205";
+
+/* frame rate if Maxfps is not set */
+#define DEFAULT_FPS 25
+
 /* libst2205 handle */
 static st2205_handle *h;
 /* Display data */
 static unsigned char *fb;
+/* fb changed since the last transfer */
+static int dirty = 0;
+
+static int Stats = -1;
 
 static int drv_st2205_open(const char *section)
 {
@@ -92,19 +102,45 @@ static int drv_st2205_close(void)
 }
 
 
+/* libst2205 always sends the whole frame, so do it once per frame */
+static void drv_st2205_flush(void)
+{
+    STATS_TIME t;
+
+    if (!dirty)
+	return;
+
+    STATS_BEGIN(t);
+    st2205_send_data(h, fb);
+    dirty = 0;
+    STATS_END(Stats, t);
+    stats_count(Stats, h->height * h->width * 3);
+}
+
+
+static void drv_st2205_frame( __attribute__ ((unused))
+			     void *notused)
+{
+    drv_st2205_flush();
+}
+
+
 static void drv_st2205_blit(const int row, const int col, const int height, const int width)
 {
     int r, c;
     RGBA p;
     for (r = row; r < row + height; r++) {
-	for (c = col; c < col + width; c++) {
+	unsigned char *q = fb + (r * h->width + col) * 3;
+	for (c = col; c < col + width; c++, q += 3) {
 	    p = drv_generic_graphic_rgb(r, c);
-	    fb[(r * h->width + c) * 3 + 0] = p.R;
-	    fb[(r * h->width + c) * 3 + 1] = p.G;
-	    fb[(r * h->width + c) * 3 + 2] = p.B;
+	    if (q[0] != p.R || q[1] != p.G || q[2] != p.B) {
+		q[0] = p.R;
+		q[1] = p.G;
+		q[2] = p.B;
+		dirty = 1;
+	    }
 	}
     }
-    st2205_send_data(h, fb);
 }
 
 
@@ -112,6 +148,7 @@ static void drv_st2205_blit(const int row, const int col, const int height, cons
 static int drv_st2205_start2(const char *section)
 {
     char *s;
+    int fps;
 
     s = cfg_get(section, "Font", "6x8");
     if (s == NULL || *s == '\0') {
@@ -140,11 +177,17 @@ static int drv_st2205_start2(const char *section)
 
     /* you surely want to allocate a framebuffer or something... */
     fb = malloc(h->height * h->width * 3);
+    memset(fb, 0, h->height * h->width * 3);
+    dirty = 1;
 
     /* set width/height from st2205 firmware specs */
     DROWS = h->height;
     DCOLS = h->width;
 
+    /* send changes once per frame */
+    cfg_number(section, "Maxfps", DEFAULT_FPS, 1, 1000, &fps);
+    timer_add(drv_st2205_frame, NULL, 1000 / fps, 0);
+
     return 0;
 }
 
@@ -190,6 +233,8 @@ int drv_st2205_init2(const char *section, const int quiet)
 {
     int ret;
 
+    Stats = stats_register("write", Name);
+
     /* real worker functions */
     drv_generic_graphic_real_blit = drv_st2205_blit;
 
@@ -205,6 +250,7 @@ int drv_st2205_init2(const char *section, const int quiet)
 	char buffer[40];
 	qprintf(buffer, sizeof(buffer), "%s %dx%d", Name, DCOLS, DROWS);
 	if (drv_generic_graphic_greet(buffer, NULL)) {
+	    drv_st2205_flush();
 	    sleep(3);
 	    drv_generic_graphic_clear();
 	}
@@ -232,6 +278,9 @@ int drv_st2205_quit2(const int quiet)
 
     drv_generic_graphic_quit();
 
+    timer_remove(drv_st2205_frame, NULL);
+    drv_st2205_flush();
+
     debug("closing connection");
     drv_st2205_close();
 
@@ -52,6 +52,8 @@
 #include "qprintf.h"
 #include "udelay.h"
 #include "plugin.h"
+#include "timer.h"
+#include "stats.h"
 #include "widget.h"
 #include "widget_text.h"
 #include "widget_icon.h"
@@ -65,7 +67,15 @@
 
 #define NO_MOUSE_BUTTON_PRESSED 0
 #define LEFT_MOUSE_BUTTON_PRESSED 1
-#define SLEEP_STEPS 1000
+
+/* frame rate if Maxfps is not set */
+#define DEFAULT_FPS 50
+
+/* per-client accounting */
+typedef struct {
+    long frames;
+    int bytes;			/* sent bytes at the last frame */
+} VNC_CLIENT;
 
 static char Name[] = "VNC";
 
@@ -93,12 +103,13 @@ static int mouse_x = 0;
 static int mouse_y = 0;
 static int mouse_stat_old = 0;
 static int process_event = 0;
-static long frames = 0;
 static char *password;
 static char *javaClassFiles;
-static struct timeval startDriver;
 static int maxfps = -1;
 
+static DAMAGE Damage;
+static int Stats = -1;
+
 /* draws a simple rect, used to display keypad */
 int draw_rect(int x, int y, int size, unsigned char col, char *buffer)
 {
@@ -159,10 +170,19 @@ void display_keypad()
 }
 
 /* called if a vnc client disconnects */
-static void clientgone( __attribute__ ((unused)) rfbClientPtr cl)
+static void clientgone(rfbClientPtr cl)
 {
+    VNC_CLIENT *C = cl->clientData;
+
     if (clientCount > 0)
 	clientCount--;
+
+    if (C != NULL) {
+	info("%s: client %s gone after %ld frames, %d bytes sent (%ld bytes/frame)", Name, cl->host, C->frames,
+	     C->bytes, C->frames ? C->bytes / C->frames : 0);
+	free(C);
+	cl->clientData = NULL;
+    }
     debug("%d clients connected", clientCount);
 }
 
@@ -171,6 +191,7 @@ static enum rfbNewClientAction hook_newclient(rfbClientPtr cl)
 {
     if (clientCount < max_clients) {
 	clientCount++;
+	cl->clientData = calloc(1, sizeof(VNC_CLIENT));
 	cl->clientGoneHook = clientgone;
 	debug("%d clients connected", clientCount);
 	return RFB_CLIENT_ACCEPT;
@@ -313,82 +334,122 @@ static int drv_vnc_close(void)
 }
 
 
-/* actual blitting method */
+/* convert a rectangle of the generic framebuffer */
 static void drv_vnc_blit_it(const int row, const int col, const int height, const int width, unsigned char *buffer)
 {
-    static int sleep = 0;
-    int r, c, ofs;
+    int r, c;
     RGBA p;
 
     for (r = row; r < row + height; r++) {
+	unsigned char *dst = buffer + (r * xres + col) * BPP;
 	for (c = col; c < col + width; c++) {
 	    p = drv_generic_graphic_rgb(r, c);
-	    ofs = (r * xres + c) * BPP;
-	    buffer[ofs++] = p.R;
-	    buffer[ofs++] = p.G;
-	    buffer[ofs++] = p.B;
-	    buffer[ofs] = 255;
+	    dst[0] = p.R;
+	    dst[1] = p.G;
+	    dst[2] = p.B;
+	    dst[3] = 255;
+	    dst += BPP;
 	}
     }
+}
 
-    /* display osd keypad */
-    if (show_keypad_osd == 1) {
-	display_keypad();
 
-	/* check if the osd should be disabled after the waittime */
-	struct timeval now;
-	gettimeofday(&now, NULL);
-	int timedelta = (now.tv_sec - osd_timestamp.tv_sec) * 1000 + (now.tv_usec - osd_timestamp.tv_usec) / 1000;
+static void drv_vnc_blit(const int row, const int col, const int height, const int width)
+{
+    if (rfbIsActive(server)) {
+	drv_vnc_blit_it(row, col, height, width, (unsigned char *) server->frameBuffer);
+	drv_generic_graphic_damage(&Damage, row, col, height, width);
+    }
+}
+
 
-	if (timedelta > osd_showtime) {
-	    show_keypad_osd = 0;
-	}
+/* draw or remove the osd keypad */
+static void drv_vnc_osd(void)
+{
+    struct timeval now;
+    int x1, y1, x2, y2, timedelta;
+
+    if (show_keypad_osd == 0 || buttons == 0)
+	return;
+
+    x1 = keypadxofs;
+    y1 = keypadyofs;
+    x2 = MIN(x1 + buttons * (buttonsize + keypadgap), xres);
+    y2 = MIN(y1 + buttonsize + 1, yres);
+
+    /* check if the osd should be disabled after the waittime */
+    gettimeofday(&now, NULL);
+    timedelta = (now.tv_sec - osd_timestamp.tv_sec) * 1000 + (now.tv_usec - osd_timestamp.tv_usec) / 1000;
+
+    if (timedelta > osd_showtime) {
+	/* restore the area below the keypad */
+	show_keypad_osd = 0;
+	drv_vnc_blit_it(y1, x1, y2 - y1, x2 - x1, (unsigned char *) server->frameBuffer);
+    } else {
+	display_keypad();
     }
-    frames++;
-    if ((frames % 10) == 0 && maxfps > 0) {
-	struct timeval blittime;
-	gettimeofday(&blittime, NULL);
-	int time_since_start =
-	    (blittime.tv_sec - startDriver.tv_sec) * 1000 + (blittime.tv_usec - startDriver.tv_usec) / 1000;
-
-	/* if time changed since start of lcd4linux */
-	if (time_since_start < 0) {
-	    gettimeofday(&startDriver, NULL);
-	    time_since_start =
-		(blittime.tv_sec - startDriver.tv_sec) * 1000 + (blittime.tv_usec - startDriver.tv_usec) / 1000;
-	    if (time_since_start == 0)
-		time_since_start = 1;
-	}
-	//info("time :%d, frames: %d, sleep: %d", time_since_start, frames, sleep);
 
-	int fps = (int) (1000 * frames / time_since_start);
+    drv_generic_graphic_damage(&Damage, y1, x1, y2 - y1, x2 - x1);
+}
 
-	if (fps > maxfps) {
-	    sleep += SLEEP_STEPS;
-	}
 
-	if (fps < maxfps && sleep >= SLEEP_STEPS) {
-	    sleep -= SLEEP_STEPS;
+/* count the encoded bytes of this frame per client */
+static void drv_vnc_account(void)
+{
+    rfbClientIteratorPtr iterator;
+    rfbClientPtr cl;
+    long total = 0;
+
+    iterator = rfbGetClientIterator(server);
+    while ((cl = rfbClientIteratorNext(iterator)) != NULL) {
+	VNC_CLIENT *C = cl->clientData;
+	int bytes;
+	if (C == NULL)
+	    continue;
+	bytes = rfbStatGetSentBytes(cl);
+	if (bytes != C->bytes) {
+	    C->frames++;
+	    total += bytes - C->bytes;
+	    C->bytes = bytes;
 	}
     }
-    usleep(sleep);
+    rfbReleaseClientIterator(iterator);
 
+    stats_count(Stats, total);
 }
 
 
-static void drv_vnc_blit(const int row, const int col, const int height, const int width)
+/* send the damage collected since the last frame */
+static void drv_vnc_frame( __attribute__ ((unused))
+			  void *notused)
 {
+    STATS_TIME t;
+    int i;
 
-    if (rfbIsActive(server)) {
-	drv_vnc_blit_it(row, col, height, width, (unsigned char *) server->frameBuffer);
+    if (!rfbIsActive(server))
+	return;
+
+    drv_vnc_osd();
 
-	if (clientCount > 0) {
-	    rfbMarkRectAsModified(server, 0, 0, xres, yres);
+    /* without clients the damage is of no interest: */
+    /* a new client receives the whole framebuffer anyway */
+    if (Damage.count > 0 && clientCount > 0) {
+	STATS_BEGIN(t);
+	for (i = 0; i < Damage.count; i++) {
+	    DAMAGE_RECT *R = &Damage.rect[i];
+	    rfbMarkRectAsModified(server, R->x1, R->y1, R->x2, R->y2);
 	}
-	rfbProcessEvents(server, server->deferUpdateTime * 500);
+	rfbProcessEvents(server, 0);
+	drv_vnc_account();
+	STATS_END(Stats, t);
+    } else {
+	rfbProcessEvents(server, 0);
     }
+
+    Damage.count = 0;
 }
 
+
 /* start graphic display */
 static int drv_vnc_start(const char *section)
 {
@@ -425,6 +486,7 @@ static int drv_vnc_start(const char *section)
     server->alwaysShared = (1 == 1);
     server->port = port;
     server->ptrAddEvent = hook_mouseaction;
+    server->deferUpdateTime = 0;	/* we collect the damage per frame ourselves */
     server->newClientHook = hook_newclient;
 
     if (password != NULL) {
@@ -446,8 +508,9 @@ static int drv_vnc_start(const char *section)
     DROWS = yres;
     DCOLS = xres;
 
-    /* set timestamp */
-    gettimeofday(&startDriver, NULL);
+    /* frames are sent from a timer, never from the blit */
+    Stats = stats_register("write", Name);
+    timer_add(drv_vnc_frame, NULL, 1000 / (maxfps > 0 ? maxfps : DEFAULT_FPS), 0);
 
     return 0;
 }
@@ -532,6 +595,10 @@ int drv_vnc_quit(const int quiet)
 	free(javaClassFiles);
     }
 
+    /* flush the last frame */
+    timer_remove(drv_vnc_frame, NULL);
+    drv_vnc_frame(NULL);
+
     debug("closing connection");
     drv_vnc_close();
 
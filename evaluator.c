@@ -40,6 +40,10 @@
  * int AddFunction (char *name, int argc, void (*func)())
  *   adds a function to the evaluator
  *
+ * void SetFunctionLoader (int (*loader)(char *name))
+ *   the loader is called by Compile() for unknown functions and
+ *   may add them on demand (lazy plugin initialization)
+ *
  * void DeleteVariables    (void);
  *   frees all allocated variables
  *
@@ -82,6 +86,9 @@
 
 #include "debug.h"
 #include "evaluator.h"
+#include "bench.h"
+#include "stats.h"
+#include "drv.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -149,6 +156,8 @@ typedef struct {
     char *name;
     int argc;
     void (*func) ();
+    int stats;
+    int display;		/* display selected when the function was added */
 } FUNCTION;
 
 typedef struct _NODE {
@@ -212,9 +221,13 @@ static OPERATOR Operator = O_UNDEF;
 static VARIABLE Variable[255];
 static unsigned int nVariable = 0;
 
-static FUNCTION *Function = NULL;
+/* compiled trees point to the functions, so they must not move */
+static FUNCTION **Function = NULL;
 static unsigned int nFunction = 0;
 
+static int (*FunctionLoader) (const char *name) = NULL;
+static int FunctionLoading = 0;
+
 
 /* strndup() may be not available on several platforms */
 #ifndef HAVE_STRNDUP
@@ -476,7 +489,7 @@ void DeleteVariables(void)
 static int LookupFunction(const void *a, const void *b)
 {
     char *n = (char *) a;
-    FUNCTION *f = (FUNCTION *) b;
+    FUNCTION *f = *(FUNCTION **) b;
 
     return strcmp(n, f->name);
 }
@@ -485,8 +498,8 @@ static int LookupFunction(const void *a, const void *b)
 /* qsort compare function for functions */
 static int SortFunction(const void *a, const void *b)
 {
-    FUNCTION *fa = (FUNCTION *) a;
-    FUNCTION *fb = (FUNCTION *) b;
+    FUNCTION *fa = *(FUNCTION **) a;
+    FUNCTION *fb = *(FUNCTION **) b;
 
     return strcmp(fa->name, fb->name);
 }
@@ -494,30 +507,64 @@ static int SortFunction(const void *a, const void *b)
 
 static FUNCTION *FindFunction(const char *name)
 {
-    return bsearch(name, Function, nFunction, sizeof(FUNCTION), LookupFunction);
+    FUNCTION **F, **f;
+    int display;
+
+    F = bsearch(name, Function, nFunction, sizeof(FUNCTION *), LookupFunction);
+    if (F == NULL)
+	return NULL;
+
+    /* several displays may add functions with the same name: */
+    /* prefer the one of the display selected at compile time */
+    display = drv_current();
+    for (f = F; f >= Function && strcmp((*f)->name, name) == 0; f--) {
+	if ((*f)->display == display)
+	    return *f;
+    }
+    for (f = F + 1; f < Function + nFunction && strcmp((*f)->name, name) == 0; f++) {
+	if ((*f)->display == display)
+	    return *f;
+    }
+
+    return *F;
 }
 
 
 int AddFunction(const char *name, const int argc, void (*func) ())
 {
+    FUNCTION *F;
+
+    F = malloc(sizeof(FUNCTION));
+    F->name = strdup(name);
+    F->argc = argc;
+    F->func = func;
+    F->stats = stats_register("func", name);
+    /* functions loaded on demand belong to no display, like the ones added at startup */
+    F->display = FunctionLoading ? -1 : drv_current();
+
     nFunction++;
-    Function = realloc(Function, nFunction * sizeof(FUNCTION));
-    Function[nFunction - 1].name = strdup(name);
-    Function[nFunction - 1].argc = argc;
-    Function[nFunction - 1].func = func;
+    Function = realloc(Function, nFunction * sizeof(FUNCTION *));
+    Function[nFunction - 1] = F;
 
-    qsort(Function, nFunction, sizeof(FUNCTION), SortFunction);
+    qsort(Function, nFunction, sizeof(FUNCTION *), SortFunction);
 
     return 0;
 }
 
 
+void SetFunctionLoader(int (*loader) (const char *name))
+{
+    FunctionLoader = loader;
+}
+
+
 void DeleteFunctions(void)
 {
     unsigned int i;
 
     for (i = 0; i < nFunction; i++) {
-	free(Function[i].name);
+	free(Function[i]->name);
+	free(Function[i]);
     }
     free(Function);
     Function = NULL;
@@ -822,6 +869,28 @@ static NODE *Level12(void)
 	    Root->Token = T_FUNCTION;
 	    Root->Result = NewResult();
 	    Root->Function = FindFunction(Word);
+	    if (Root->Function == NULL && FunctionLoader != NULL) {
+		/* the loader may compile expressions itself (e.g. cfg_get() */
+		/* in a plugin init), so save and restore the parser state */
+		char *expression = Expression;
+		char *exprptr = ExprPtr;
+		char *word = Word;
+		TOKEN token = Token;
+		OPERATOR operator = Operator;
+		int loaded;
+		Word = NULL;
+		FunctionLoading = 1;
+		loaded = FunctionLoader(word);
+		FunctionLoading = 0;
+		free(Word);
+		Expression = expression;
+		ExprPtr = exprptr;
+		Word = word;
+		Token = token;
+		Operator = operator;
+		if (loaded == 0)
+		    Root->Function = FindFunction(Word);
+	    }
 	    if (Root->Function == NULL) {
 		error("Evaluator: unknown function '%s' in <%s>", Word, Expression);
 		Root->Token = T_STRING;
@@ -1098,6 +1167,7 @@ static int EvalTree(NODE * Root)
 {
     int i;
     int argc;
+    int display;
     int type = -1;
     double number = 0.0;
     double dummy;
@@ -1105,6 +1175,7 @@ static int EvalTree(NODE * Root)
     char *string = NULL;
     char *s1, *s2;
     RESULT *param[10];
+    STATS_TIME t;
 
     switch (Root->Token) {
 
@@ -1129,6 +1200,9 @@ static int EvalTree(NODE * Root)
 	    EvalTree(Root->Child[i]);
 	    param[i] = Root->Child[i]->Result;
 	}
+	STATS_BEGIN(t);
+	/* functions of a driver run on the display they belong to */
+	display = drv_select(Root->Function->display);
 	if (Root->Function->argc < 0) {
 	    /* Function with variable argument list:  */
 	    /* pass number of arguments as first parameter */
@@ -1137,6 +1211,8 @@ static int EvalTree(NODE * Root)
 	    Root->Function->func(Root->Result, param[0], param[1], param[2], param[3], param[4], param[5], param[6],
 				 param[7], param[8], param[9]);
 	}
+	drv_select(display);
+	STATS_END(Root->Function->stats, t);
 	return 0;
 
     case T_OPERATOR:
@@ -1421,6 +1497,8 @@ int Compile(const char *expression, void **tree)
 
 int Eval(void *tree, RESULT * result)
 {
+    static int Stats = -1;
+    STATS_TIME t;
     int ret;
     NODE *Tree = (NODE *) tree;
 
@@ -1431,7 +1509,12 @@ int Eval(void *tree, RESULT * result)
 	return 0;
     }
 
+    if (Stats < 0)
+	Stats = stats_register("eval", NULL);
+
+    STATS_BENCH_BEGIN(t, BENCH_EVAL);
     ret = EvalTree(Tree);
+    STATS_BENCH_END(Stats, t, BENCH_EVAL);
 
     result->type = Tree->Result->type;
     result->size = Tree->Result->size;
@@ -51,6 +51,7 @@ int SetVariableNumeric(const char *name, const double value);
 int SetVariableString(const char *name, const char *value);
 
 int AddFunction(const char *name, const int argc, void (*func) ());
+void SetFunctionLoader(int (*loader) (const char *name));
 
 void DeleteVariables(void);
 void DeleteFunctions(void);
@@ -65,6 +65,8 @@
 #include "debug.h"
 #include "cfg.h"
 #include "event.h"
+#include "drv.h"
+#include "stats.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -78,6 +80,7 @@ typedef struct {
     int write;
     int active;
     int fds_id;
+    int display;		/* display selected when the event was added */
 } event_t;
 
 
@@ -100,13 +103,20 @@ int event_add(void (*callback) (event_flags_t flags, void *data), void *data, co
     events[i].write = write;
     events[i].active = active;
     events[i].fds_id = -1;
+    events[i].display = drv_current();
     return 0;
 }
 
 
 int event_process(const struct timespec *timeout)
 {
+    static int Stats = -1;
+    STATS_TIME t;
     int i, j;
+
+    if (Stats < 0)
+	Stats = stats_register("event", NULL);
+
     struct pollfd *fds = malloc(sizeof(struct pollfd) * event_count);
     for (i = 0, j = 0; i < event_count; i++) {
 	events[i].fds_id = -1;
@@ -123,11 +133,15 @@ int event_process(const struct timespec *timeout)
 	    j++;
 	}
     }
+    /* output threads may use the displays while we sleep, */
+    /* but they must be back before any callback runs */
+    drv_idle(1);
 #if (__GLIBC__ >= 2 && __GLIBC_MINOR__ >= 4)
     int ready = ppoll(fds, j, timeout, NULL);
 #else
     int ready = poll(fds, j, timeout->tv_sec * 1000 + timeout->tv_nsec / 1000000);
 #endif
+    drv_idle(0);
 
     if (ready > 0) {
 	//search the file descriptors, call all relavant callbacks
@@ -149,7 +163,10 @@ int event_process(const struct timespec *timeout)
 		if (fds[j].revents & POLLERR) {
 		    flags |= EVENT_ERR;
 		}
+		STATS_BEGIN(t);
+		drv_select(events[i].display);
 		events[i].callback(flags, events[i].data);
+		STATS_END(Stats, t);
 
 	    }
 	    j++;
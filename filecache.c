@@ -0,0 +1,368 @@
+/* $Id$
+ * $URL$
+ *
+ * shared cache for plain files, refreshed via inotify
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/* 
+ * Plugins reading small state files (file::readline, w1retap, seti,
+ * asterisk) used to open and scan the file on every evaluation. The
+ * cache keeps each file in memory with an index of its lines and
+ * reads it again only when it has changed: the directory of every
+ * file is watched with inotify (so files replaced by rename() are
+ * noticed, too), and the inotify descriptor is hooked into event.c.
+ * Without inotify, or if a directory cannot be watched, the file is
+ * re-read when stat() reports a different size, mtime or inode.
+ *
+ * exported functions:
+ *
+ * int filecache_open (char *path)
+ *   returns a handle for the file, the same one for the same path
+ *
+ * int filecache_read (int file)
+ *   brings the cached copy up to date, returns a generation number
+ *   which changes whenever the file has been re-read (so callers
+ *   can keep their own parsed data), or -1 if it cannot be read
+ *
+ * int filecache_lines (int file)
+ *   returns the number of lines
+ *
+ * char *filecache_line (int file, int line)
+ *   returns line number 'line' (starting with 1) without the line
+ *   terminator, or NULL if there is no such line
+ *
+ * void filecache_exit (void)
+ *   releases all files and the inotify descriptor
+ *
+ */
+
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+#include "debug.h"
+#include "event.h"
+#include "filecache.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+/* initial buffer size, doubled whenever a file does not fit */
+#define FILECACHE_CHUNK 4096
+
+typedef struct {
+    char *path;
+    char *name;			/* basename, as reported by inotify */
+    int wd;			/* inotify watch of the directory, -1 if none */
+    int dirty;
+    int failed;
+    struct stat st;		/* for files without a watch */
+    int generation;
+    char *buffer;
+    size_t size;
+    char **line;
+    int nLines;
+} FILECACHE;
+
+static FILECACHE *Files = NULL;
+static int nFiles = 0;
+
+static int Inotify = -1;
+
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+static void filecache_drain(void)
+{
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    struct inotify_event *ev;
+    ssize_t len;
+    char *p;
+    int i;
+
+    while ((len = read(Inotify, buffer, sizeof(buffer))) > 0) {
+	for (p = buffer; p < buffer + len; p += sizeof(struct inotify_event) + ev->len) {
+	    ev = (struct inotify_event *) p;
+	    for (i = 0; i < nFiles; i++) {
+		if (Files[i].wd != ev->wd)
+		    continue;
+		if (ev->mask & IN_IGNORED) {
+		    /* directory is gone, fall back to stat() */
+		    Files[i].wd = -1;
+		    Files[i].dirty = 1;
+		} else if (ev->len == 0 || strcmp(ev->name, Files[i].name) == 0) {
+		    Files[i].dirty = 1;
+		}
+	    }
+	}
+    }
+}
+
+
+static void filecache_event(event_flags_t flags, void *data)
+{
+    (void) flags;
+    (void) data;
+
+    filecache_drain();
+}
+
+
+static void filecache_watch(FILECACHE * F)
+{
+    char *dir;
+
+    if (Inotify < 0) {
+	Inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (Inotify < 0) {
+	    info("inotify_init1() failed: %s, watching files with stat()", strerror(errno));
+	    return;
+	}
+	event_add(filecache_event, NULL, Inotify, 1, 0, 1);
+    }
+
+    dir = strdup(F->path);
+    if (F->name == F->path) {
+	strcpy(dir, ".");
+    } else {
+	dir[F->name - F->path - 1] = '\0';
+	if (*dir == '\0')
+	    strcpy(dir, "/");
+    }
+
+    F->wd = inotify_add_watch(Inotify, dir,
+			      IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+			      IN_MOVED_TO);
+    if (F->wd < 0)
+	debug("inotify_add_watch(%s) failed: %s", dir, strerror(errno));
+
+    free(dir);
+}
+
+#else
+
+static void filecache_drain(void)
+{
+}
+
+static void filecache_watch(FILECACHE * F)
+{
+    (void) F;
+}
+
+#endif
+
+
+/* has a file without a watch changed? */
+static int filecache_changed(FILECACHE * F)
+{
+    struct stat st;
+
+    if (stat(F->path, &st) < 0)
+	return 1;
+
+    if (st.st_size == F->st.st_size && st.st_ino == F->st.st_ino && st.st_mtime == F->st.st_mtime
+#ifdef _STATBUF_ST_NSEC
+	&& st.st_mtim.tv_nsec == F->st.st_mtim.tv_nsec
+#endif
+	)
+	return 0;
+
+    return 1;
+}
+
+
+static int filecache_load(FILECACHE * F)
+{
+    ssize_t len;
+    size_t used;
+    char *p;
+    int fd, n;
+
+    fd = open(F->path, O_RDONLY);
+    if (fd < 0) {
+	if (!F->failed)
+	    error("open(%s) failed: %s", F->path, strerror(errno));
+	F->failed = 1;
+	return -1;
+    }
+
+    if (F->buffer == NULL) {
+	F->size = FILECACHE_CHUNK;
+	F->buffer = malloc(F->size);
+    }
+
+    used = 0;
+    while ((len = read(fd, F->buffer + used, F->size - used - 1)) != 0) {
+	if (len < 0) {
+	    if (errno == EINTR)
+		continue;
+	    if (!F->failed)
+		error("read(%s) failed: %s", F->path, strerror(errno));
+	    F->failed = 1;
+	    close(fd);
+	    return -1;
+	}
+	used += len;
+	if (used == F->size - 1) {
+	    F->size *= 2;
+	    F->buffer = realloc(F->buffer, F->size);
+	}
+    }
+    fstat(fd, &F->st);
+    close(fd);
+
+    F->buffer[used] = '\0';
+
+    /* index the lines, terminating them in place */
+    n = 0;
+    for (p = F->buffer; p < F->buffer + used; p++) {
+	if (*p == '\n')
+	    n++;
+    }
+    if (used > 0 && F->buffer[used - 1] != '\n')
+	n++;
+    F->line = realloc(F->line, (n + 1) * sizeof(char *));
+
+    F->nLines = 0;
+    p = F->buffer;
+    while (p < F->buffer + used) {
+	char *end = strchr(p, '\n');
+	F->line[F->nLines++] = p;
+	if (end == NULL)
+	    end = F->buffer + used;
+	if (end > p && *(end - 1) == '\r')
+	    *(end - 1) = '\0';
+	*end = '\0';
+	p = end + 1;
+    }
+
+    F->failed = 0;
+    F->generation++;
+
+    return 0;
+}
+
+
+int filecache_open(const char *path)
+{
+    FILECACHE *F;
+    int i;
+
+    for (i = 0; i < nFiles; i++) {
+	if (strcmp(Files[i].path, path) == 0)
+	    return i;
+    }
+
+    Files = realloc(Files, (nFiles + 1) * sizeof(FILECACHE));
+    F = &Files[nFiles];
+    memset(F, 0, sizeof(FILECACHE));
+    F->path = strdup(path);
+    F->name = strrchr(F->path, '/');
+    F->name = F->name ? F->name + 1 : F->path;
+    F->wd = -1;
+    F->dirty = 1;
+
+    /* watch before the first read, so no change gets lost */
+    filecache_watch(F);
+
+    return nFiles++;
+}
+
+
+int filecache_read(const int file)
+{
+    FILECACHE *F;
+
+    if (file < 0 || file >= nFiles)
+	return -1;
+
+    /* pick up changes made since the last main loop iteration */
+    if (Inotify >= 0)
+	filecache_drain();
+
+    F = &Files[file];
+    if (F->wd < 0 && !F->dirty)
+	F->dirty = filecache_changed(F);
+
+    if (F->dirty || F->failed) {
+	F->dirty = 0;
+	if (filecache_load(F) < 0)
+	    return -1;
+    }
+
+    return F->generation;
+}
+
+
+int filecache_lines(const int file)
+{
+    if (file < 0 || file >= nFiles)
+	return 0;
+
+    return Files[file].nLines;
+}
+
+
+char *filecache_line(const int file, const int line)
+{
+    if (file < 0 || file >= nFiles || line < 1 || line > Files[file].nLines)
+	return NULL;
+
+    return Files[file].line[line - 1];
+}
+
+
+void filecache_exit(void)
+{
+    int i;
+
+    for (i = 0; i < nFiles; i++) {
+	free(Files[i].path);
+	if (Files[i].buffer)
+	    free(Files[i].buffer);
+	if (Files[i].line)
+	    free(Files[i].line);
+    }
+    if (Files)
+	free(Files);
+    Files = NULL;
+    nFiles = 0;
+
+    if (Inotify >= 0) {
+	event_del(Inotify);
+	close(Inotify);
+	Inotify = -1;
+    }
+}
@@ -0,0 +1,36 @@
+/* $Id$
+ * $URL$
+ *
+ * shared cache for plain files, refreshed via inotify
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef _FILECACHE_H_
+#define _FILECACHE_H_
+
+int filecache_open(const char *path);
+int filecache_read(const int file);
+int filecache_lines(const int file);
+char *filecache_line(const int file, const int line);
+void filecache_exit(void);
+
+#endif
@@ -62,6 +62,7 @@
 #include <regex.h>
 
 #include "debug.h"
+#include "timer.h"
 #include "hash.h"
 
 #ifdef WITH_DMALLOC
@@ -228,7 +229,7 @@ int hash_age(HASH * Hash, const char *key)
 	timestamp = &(Item->Slot[Item->index].timestamp);
     }
 
-    gettimeofday(&now, NULL);
+    timer_now(&now);
 
     return (now.tv_sec - timestamp->tv_sec) * 1000 + (now.tv_usec - timestamp->tv_usec) / 1000;
 }
@@ -449,7 +450,7 @@ static HASH_ITEM *hash_set(HASH * Hash, const char *key, const char *value, cons
     strcpy(Slot->value, value);
 
     /* set timestamps */
-    gettimeofday(&(Hash->timestamp), NULL);
+    timer_now(&(Hash->timestamp));
     Slot->timestamp = Hash->timestamp;
 
     return Item;
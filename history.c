@@ -0,0 +1,507 @@
+/* $Id$
+ * $URL$
+ *
+ * persistent time-series history with downsampling
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/* 
+ * A history samples an expression periodically and keeps the values
+ * in up to HISTORY_ARCHIVES ring buffers of decreasing resolution,
+ * e.g. one slot per second for ten minutes and one slot per minute
+ * for a day. Every archive is fed with the raw samples and keeps
+ * average, minimum and maximum of each slot in separate columns.
+ * Slots are addressed by time, so gaps (and restarts) simply leave
+ * empty (NAN) slots behind.
+ *
+ * Histories are configured in 'History:<name>' sections:
+ *
+ *   History load {
+ *       expression loadavg(1)
+ *       retention  '1s:10m, 1m:24h'
+ *       file       '/var/lib/lcd4linux/load.history'
+ *   }
+ *
+ * With 'file' the archives are mmap'ed from that file, so they survive
+ * a restart without any reload. A file with a different layout is
+ * started anew.
+ *
+ * exported functions:
+ *
+ * HISTORY *history_open (char *name)
+ *   returns the history 'name', creating it from the config and
+ *   starting to sample it on first use. Returns NULL on error.
+ *
+ * void history_add (HISTORY *History, double value)
+ *   adds a sample to all archives
+ *
+ * int history_fetch (HISTORY *History, int column, int seconds, double **values)
+ *   points values to the (non-empty) slots of the last 'seconds',
+ *   oldest first, taken from the finest archive covering them.
+ *   Returns the number of values. The array belongs to the history
+ *   and is overwritten by the next call.
+ *
+ * int history_resample (HISTORY *History, int column, int interval, int count, double *values)
+ *   fills values with 'count' samples 'interval' msec apart, the last
+ *   one now, oldest first. Every sample consolidates the slots of its
+ *   interval (average, minimum or maximum, like the column), a slot
+ *   longer than the interval is held. Samples without data are NAN.
+ *   Returns the number of samples with data.
+ *
+ * void history_exit (void)
+ *   stops sampling and releases (or unmaps) all histories
+ *
+ */
+
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "debug.h"
+#include "cfg.h"
+#include "timer.h"
+#include "history.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+
+#define HISTORY_MAGIC "L4LHIST1"
+
+static HISTORY **Histories = NULL;
+static int nHistories = 0;
+
+
+/* '90', '90s', '10m', '24h', '7d' => seconds */
+static int history_duration(const char *s, char **end)
+{
+    long n = strtol(s, end, 10);
+
+    if (*end == s)
+	return -1;
+
+    switch (**end) {
+    case 's':
+	(*end)++;
+	break;
+    case 'm':
+	(*end)++;
+	n *= 60;
+	break;
+    case 'h':
+	(*end)++;
+	n *= 3600;
+	break;
+    case 'd':
+	(*end)++;
+	n *= 86400;
+	break;
+    }
+
+    return n > 0 && n < 0x7fffffff ? (int) n : -1;
+}
+
+
+/* 'step:span, step:span, ...' */
+static int history_retention(HISTORY_HEADER * Header, const char *retention)
+{
+    const char *s = retention;
+    char *end;
+    int step, span, n = 0;
+
+    memset(Header, 0, sizeof(HISTORY_HEADER));
+    memcpy(Header->magic, HISTORY_MAGIC, sizeof(Header->magic));
+
+    while (*s != '\0') {
+	while (*s == ' ' || *s == ',')
+	    s++;
+	if (*s == '\0')
+	    break;
+	if (n >= HISTORY_ARCHIVES) {
+	    error("too many archives in retention '%s' (max %d)", retention, HISTORY_ARCHIVES);
+	    return -1;
+	}
+	step = history_duration(s, &end);
+	if (step < 0 || *end != ':') {
+	    error("bad retention '%s': expected 'step:span'", retention);
+	    return -1;
+	}
+	span = history_duration(end + 1, &end);
+	if (span < step) {
+	    error("bad retention '%s': span shorter than step", retention);
+	    return -1;
+	}
+	if (n > 0 && step <= Header->Archive[n - 1].step) {
+	    error("bad retention '%s': steps must increase", retention);
+	    return -1;
+	}
+	Header->Archive[n].step = step;
+	Header->Archive[n].size = span / step;
+	Header->Archive[n].offset = Header->length;
+	Header->length += HISTORY_COLUMNS * Header->Archive[n].size;
+	n++;
+	s = end;
+    }
+
+    if (n == 0) {
+	error("empty retention '%s'", retention);
+	return -1;
+    }
+
+    Header->nArchive = n;
+    return 0;
+}
+
+
+static int history_compatible(HISTORY_HEADER * a, HISTORY_HEADER * b)
+{
+    int i;
+
+    if (memcmp(a->magic, b->magic, sizeof(a->magic)) != 0 || a->nArchive != b->nArchive || a->length != b->length)
+	return 0;
+
+    for (i = 0; i < a->nArchive; i++) {
+	if (a->Archive[i].step != b->Archive[i].step || a->Archive[i].size != b->Archive[i].size)
+	    return 0;
+    }
+
+    return 1;
+}
+
+
+static void history_clear(HISTORY * H, HISTORY_HEADER * Layout)
+{
+    int i;
+
+    memcpy(H->Header, Layout, sizeof(HISTORY_HEADER));
+    for (i = 0; i < Layout->length; i++)
+	H->Data[i] = NAN;
+}
+
+
+static int history_map(HISTORY * H, const char *file, HISTORY_HEADER * Layout)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(file, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+	error("history '%s': open(%s) failed: %s", H->name, file, strerror(errno));
+	return -1;
+    }
+
+    /* a file of the wrong size cannot be ours */
+    if (fstat(fd, &st) < 0 || st.st_size != (off_t) H->size) {
+	if (ftruncate(fd, 0) < 0 || ftruncate(fd, H->size) < 0) {
+	    error("history '%s': ftruncate(%s) failed: %s", H->name, file, strerror(errno));
+	    close(fd);
+	    return -1;
+	}
+    }
+
+    map = mmap(NULL, H->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+	error("history '%s': mmap(%s) failed: %s", H->name, file, strerror(errno));
+	return -1;
+    }
+
+    H->mapped = 1;
+    H->Header = map;
+    H->Data = (double *) (H->Header + 1);
+
+    if (history_compatible(H->Header, Layout)) {
+	info("history '%s': continuing from %s", H->name, file);
+    } else {
+	info("history '%s': starting new file %s", H->name, file);
+	history_clear(H, Layout);
+    }
+
+    return 0;
+}
+
+
+static void history_sample(void *data)
+{
+    HISTORY *H = (HISTORY *) data;
+
+    property_eval(&H->expression);
+    history_add(H, P2N(&H->expression));
+}
+
+
+static HISTORY *history_create(const char *name)
+{
+    HISTORY *H;
+    HISTORY_HEADER Layout;
+    char *section, *retention, *file;
+    int i, ret, largest;
+
+    section = malloc(strlen(name) + 9);
+    strcpy(section, "History:");
+    strcat(section, name);
+
+    H = malloc(sizeof(HISTORY));
+    memset(H, 0, sizeof(HISTORY));
+    H->name = strdup(name);
+
+    property_load(section, "expression", NULL, &H->expression);
+    if (!property_valid(&H->expression)) {
+	error("history '%s': no 'expression' in %s", name, cfg_source());
+	ret = -1;
+    } else {
+	retention = cfg_get(section, "retention", "1s:10m, 1m:24h");
+	ret = history_retention(&Layout, retention);
+	free(retention);
+    }
+
+    if (ret == 0) {
+	H->size = sizeof(HISTORY_HEADER) + Layout.length * sizeof(double);
+	file = cfg_get(section, "file", "");
+	if (*file != '\0') {
+	    ret = history_map(H, file, &Layout);
+	} else {
+	    H->Header = malloc(H->size);
+	    H->Data = (double *) (H->Header + 1);
+	    history_clear(H, &Layout);
+	}
+	free(file);
+    }
+
+    free(section);
+
+    /* a broken history is remembered, so the error is reported once */
+    if (ret < 0)
+	return H;
+
+    for (largest = 0, i = 0; i < Layout.nArchive; i++) {
+	if (Layout.Archive[i].size > largest)
+	    largest = Layout.Archive[i].size;
+    }
+    H->Fetch = malloc(largest * sizeof(double));
+
+    /* sample at the finest resolution */
+    history_sample(H);
+    timer_add(history_sample, H, Layout.Archive[0].step * 1000, 0);
+
+    return H;
+}
+
+
+HISTORY *history_open(const char *name)
+{
+    HISTORY *H;
+    int i;
+
+    for (i = 0; i < nHistories; i++) {
+	if (strcmp(Histories[i]->name, name) == 0)
+	    return Histories[i]->Header ? Histories[i] : NULL;
+    }
+
+    H = history_create(name);
+
+    Histories = realloc(Histories, (nHistories + 1) * sizeof(HISTORY *));
+    Histories[nHistories++] = H;
+
+    return H->Header ? H : NULL;
+}
+
+
+void history_add(HISTORY * H, const double value)
+{
+    HISTORY_ARCHIVE *A;
+    double *avg, *min, *max;
+    int64_t now, t, s;
+    int a, i;
+
+    if (isnan(value))
+	return;
+
+    now = time(NULL);
+
+    for (a = 0; a < H->Header->nArchive; a++) {
+	A = &H->Header->Archive[a];
+	avg = H->Data + A->offset;
+	min = avg + A->size;
+	max = min + A->size;
+
+	t = now / A->step;
+	if (t != A->last) {
+	    /* slots skipped since the last sample stay empty */
+	    s = A->last + 1;
+	    if (s < t - A->size + 1)
+		s = t - A->size + 1;
+	    for (; s < t; s++) {
+		i = s % A->size;
+		avg[i] = min[i] = max[i] = NAN;
+	    }
+	    A->last = t;
+	    A->sum = 0.0;
+	    A->count = 0;
+	}
+
+	i = t % A->size;
+	if (A->count == 0 || value < min[i])
+	    min[i] = value;
+	if (A->count == 0 || value > max[i])
+	    max[i] = value;
+	A->sum += value;
+	A->count++;
+	avg[i] = A->sum / A->count;
+    }
+}
+
+
+int history_fetch(HISTORY * H, const int column, const int seconds, double **values)
+{
+    HISTORY_ARCHIVE *A;
+    double *data, v;
+    int64_t t, s;
+    int a, n, count;
+
+    /* the finest archive covering the window, or the longest one */
+    for (a = 0; a < H->Header->nArchive - 1; a++) {
+	A = &H->Header->Archive[a];
+	if ((int64_t) A->step * A->size >= seconds)
+	    break;
+    }
+    A = &H->Header->Archive[a];
+    data = H->Data + A->offset + column * A->size;
+
+    n = (seconds + A->step - 1) / A->step;
+    if (n < 1)
+	n = 1;
+    if (n > A->size)
+	n = A->size;
+
+    t = time(NULL) / A->step;
+    count = 0;
+    for (s = t - n + 1; s <= t; s++) {
+	/* not written yet, or already overwritten */
+	if (s > A->last || s <= A->last - A->size)
+	    continue;
+	v = data[s % A->size];
+	if (!isnan(v))
+	    H->Fetch[count++] = v;
+    }
+
+    *values = H->Fetch;
+    return count;
+}
+
+
+int history_resample(HISTORY * H, const int column, const int interval, const int count, double *values)
+{
+    HISTORY_ARCHIVE *A;
+    double *data, v, value;
+    int64_t now, step, t, s, s0, s1;
+    int a, i, n, found;
+
+    /* the finest archive covering the window, or the longest one */
+    for (a = 0; a < H->Header->nArchive - 1; a++) {
+	A = &H->Header->Archive[a];
+	if ((int64_t) A->step * A->size * 1000 >= (int64_t) interval * count)
+	    break;
+    }
+    A = &H->Header->Archive[a];
+    data = H->Data + A->offset + column * A->size;
+    step = (int64_t) A->step * 1000;
+
+    /* the current second is over when the next sample is taken */
+    now = (int64_t) time(NULL) * 1000 + 999;
+
+    found = 0;
+    for (i = 0; i < count; i++) {
+	t = now - (int64_t) (count - 1 - i) * interval;
+
+	/* the slots ending in this interval, or the one holding it */
+	s1 = t / step;
+	s0 = (t - interval) / step + 1;
+	if (s0 > s1)
+	    s0 = s1;
+
+	value = NAN;
+	for (n = 0, s = s0; s <= s1; s++) {
+	    /* not written yet, or already overwritten */
+	    if (s < 0 || s > A->last || s <= A->last - A->size)
+		continue;
+	    v = data[s % A->size];
+	    if (isnan(v))
+		continue;
+	    if (n == 0)
+		value = v;
+	    else if (column == HISTORY_MIN)
+		value = v < value ? v : value;
+	    else if (column == HISTORY_MAX)
+		value = v > value ? v : value;
+	    else
+		value += v;
+	    n++;
+	}
+	if (column == HISTORY_AVG && n > 1)
+	    value /= n;
+
+	values[i] = value;
+	if (n > 0)
+	    found++;
+    }
+
+    return found;
+}
+
+
+void history_exit(void)
+{
+    HISTORY *H;
+    int i;
+
+    for (i = 0; i < nHistories; i++) {
+	H = Histories[i];
+	if (H->Header) {
+	    timer_remove(history_sample, H);
+	    if (H->mapped)
+		munmap(H->Header, H->size);
+	    else
+		free(H->Header);
+	}
+	property_free(&H->expression);
+	free(H->Fetch);
+	free(H->name);
+	free(H);
+    }
+
+    free(Histories);
+    Histories = NULL;
+    nHistories = 0;
+}
@@ -0,0 +1,77 @@
+/* $Id$
+ * $URL$
+ *
+ * persistent time-series history with downsampling
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+#include <stdint.h>
+
+#include "property.h"
+
+#define HISTORY_ARCHIVES 4
+
+/* columns of every archive */
+#define HISTORY_AVG 0
+#define HISTORY_MIN 1
+#define HISTORY_MAX 2
+#define HISTORY_COLUMNS 3
+
+
+/* header and archive descriptors are stored in the file, too */
+typedef struct {
+    int32_t step;		/* seconds per slot */
+    int32_t size;		/* number of slots */
+    int64_t last;		/* time of the current slot, in steps */
+    double sum;			/* current slot, being consolidated */
+    int32_t count;
+    int32_t offset;		/* of the columns, in doubles */
+} HISTORY_ARCHIVE;
+
+typedef struct {
+    char magic[8];
+    int32_t nArchive;
+    int32_t length;		/* of the data, in doubles */
+    HISTORY_ARCHIVE Archive[HISTORY_ARCHIVES];
+} HISTORY_HEADER;
+
+typedef struct {
+    char *name;
+    PROPERTY expression;
+    HISTORY_HEADER *Header;
+    double *Data;
+    size_t size;		/* of header and data, in bytes */
+    int mapped;
+    double *Fetch;
+} HISTORY;
+
+
+HISTORY *history_open(const char *name);
+void history_add(HISTORY * History, const double value);
+int history_fetch(HISTORY * History, const int column, const int seconds, double **values);
+int history_resample(HISTORY * History, const int column, const int interval, const int count, double *values);
+void history_exit(void);
+
+#endif
@@ -46,12 +46,15 @@
 #include "drv.h"
 #include "timer.h"
 #include "timer_group.h"
+#include "animation.h"
 #include "layout.h"
 #include "plugin.h"
 #include "thread.h"
 #include "event.h"
 #include "widget.h"
 #include "widget_timer.h"
+#include "bench.h"
+#include "stats.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -92,6 +95,7 @@ static void usage(void)
     printf("  -F               do not fork and detach (run in foreground)\n");
     printf("  -o <output-file> write picture to file (raster driver only)\n");
     printf("  -q               suppress startup and exit splash screen\n");
+    printf("  -B <seconds>     benchmark: run the layout for <seconds> simulated seconds and report timings\n");
 #ifdef WITH_X11
     printf("special X11 options:\n");
     printf("  -display <X11 display name>  preceeds X connection given in $DISPLAY\n");
@@ -209,12 +213,14 @@ int main(int argc, char *argv[])
 {
     char *cfg = "/etc/lcd4linux.conf";
     char *pidfile = PIDFILE;
-    char *display, *driver, *layout;
-    char section[32];
-    int c;
+    char *display, *driver[MAX_DISPLAYS], *layout, *d;
+    char section[MAX_DISPLAYS][32];
+    int c, n, nDisplays;
     int quiet = 0;
     int interactive = 0;
     int list_mode = 0;
+    int benchmark = 0;
+    int stats_timer;
     int pid;
 
     /* save arguments for restart */
@@ -238,9 +244,16 @@ int main(int argc, char *argv[])
 	printf("recognized special X11 parameters\n");
     }
 #endif
-    while ((c = getopt(argc, argv, "c:Ff:hilo:qvp:")) != EOF) {
+    while ((c = getopt(argc, argv, "B:c:Ff:hilo:qvp:")) != EOF) {
 
 	switch (c) {
+	case 'B':
+	    benchmark = atoi(optarg);
+	    if (benchmark <= 0) {
+		fprintf(stderr, "%s: illegal argument -B '%s'\n", argv[0], optarg);
+		exit(2);
+	    }
+	    break;
 	case 'c':
 	    if (cfg_cmd(optarg) < 0) {
 		fprintf(stderr, "%s: illegal argument -c '%s'\n", argv[0], optarg);
@@ -284,8 +297,8 @@ int main(int argc, char *argv[])
 	exit(2);
     }
 
-    /* do not fork in interactive mode */
-    if (interactive) {
+    /* do not fork in interactive or benchmark mode */
+    if (interactive || benchmark) {
 	running_foreground = 1;
     }
 
@@ -310,22 +323,41 @@ int main(int argc, char *argv[])
 	exit(1);
     }
 
+    if (benchmark)
+	bench_startup();
+
     if (plugin_init() == -1) {
 	error("Error initializing plugins. Exit!");
 	exit(1);
     }
 
+    stats_init();
+    stats_timer = stats_register("timer", NULL);
+
     display = cfg_get(NULL, "Display", NULL);
     if (display == NULL || *display == '\0') {
 	error("missing 'Display' entry in %s!", cfg_source());
 	exit(1);
     }
 
-    qprintf(section, sizeof(section), "Display:%s", display);
+    /* several displays may be listed, separated by commas */
+    nDisplays = 0;
+    for (d = strtok(display, ", \t"); d != NULL; d = strtok(NULL, ", \t")) {
+	if (nDisplays >= MAX_DISPLAYS) {
+	    error("too many displays in 'Display' entry (max: %d)", MAX_DISPLAYS);
+	    exit(1);
+	}
+	qprintf(section[nDisplays], sizeof(section[nDisplays]), "Display:%s", d);
+	driver[nDisplays] = cfg_get(section[nDisplays], "Driver", NULL);
+	if (driver[nDisplays] == NULL || *driver[nDisplays] == '\0') {
+	    error("missing '%s.Driver' entry in %s!", section[nDisplays], cfg_source());
+	    exit(1);
+	}
+	nDisplays++;
+    }
     free(display);
-    driver = cfg_get(section, "Driver", NULL);
-    if (driver == NULL || *driver == '\0') {
-	error("missing '%s.Driver' entry in %s!", section, cfg_source());
+    if (nDisplays == 0) {
+	error("missing 'Display' entry in %s!", cfg_source());
 	exit(1);
     }
 
@@ -362,19 +394,22 @@ int main(int argc, char *argv[])
 	cfg_number(NULL, "Quiet", 0, 0, 1, &quiet);
     }
 
-    debug("initializing driver %s", driver);
-    if (drv_init(section, driver, quiet) == -1) {
-	error("Error initializing driver %s: Exit!", driver);
-	pid_exit(pidfile);
-	exit(1);
+    for (n = 0; n < nDisplays; n++) {
+	debug("initializing driver %s", driver[n]);
+	if (drv_init(section[n], driver[n], quiet) == -1) {
+	    error("Error initializing driver %s: Exit!", driver[n]);
+	    pid_exit(pidfile);
+	    exit(1);
+	}
+	free(driver[n]);
     }
-    free(driver);
 
     /* register timer widget */
     widget_timer_register();
 
     /* go into interactive mode (display has been initialized) */
     if (interactive >= 1) {
+	drv_select(0);
 	interactive_mode();
 	drv_quit(quiet);
 	pid_exit(pidfile);
@@ -382,15 +417,27 @@ int main(int argc, char *argv[])
 	exit(0);
     }
 
-    /* check for new-style layout */
-    layout = cfg_get(NULL, "Layout", NULL);
-    if (layout == NULL || *layout == '\0') {
-	error("missing 'Layout' entry in %s!", cfg_source());
-	exit(1);
+    /* every display may have its own layout */
+    for (n = 0; n < nDisplays; n++) {
+	drv_select(n);
+	layout = cfg_get(section[n], "Layout", NULL);
+	if (layout == NULL || *layout == '\0') {
+	    if (layout)
+		free(layout);
+	    layout = cfg_get(NULL, "Layout", NULL);
+	}
+	if (layout == NULL || *layout == '\0') {
+	    error("missing 'Layout' entry in %s!", cfg_source());
+	    exit(1);
+	}
+	layout_init(layout);
+	free(layout);
     }
 
-    layout_init(layout);
-    free(layout);
+    /* benchmark mode: run on a simulated clock */
+    if (benchmark) {
+	bench_init(benchmark);
+    }
 
     debug("starting main loop");
 
@@ -401,19 +448,39 @@ int main(int argc, char *argv[])
     signal(SIGQUIT, handler);
     signal(SIGTERM, handler);
 
+    /* from now on messages are written by the main loop */
+    message_buffering(1);
+
     while (got_signal == 0) {
 	struct timespec delay;
-	if (timer_process(&delay) < 0)
+	STATS_TIME t;
+	int ret;
+	STATS_BENCH_BEGIN(t, BENCH_TIMER);
+	ret = timer_process(&delay);
+	STATS_BENCH_END(stats_timer, t, BENCH_TIMER);
+	if (ret < 0)
 	    break;
+	message_flush();
+	BENCH_BEGIN(BENCH_EVENT);
 	event_process(&delay);
+	BENCH_END(BENCH_EVENT);
+	if (benchmark && bench_done())
+	    break;
     }
 
+    message_buffering(0);
     debug("leaving main loop");
 
+    if (benchmark) {
+	bench_report();
+    }
+
     drv_quit(quiet);
     pid_exit(pidfile);
     cfg_exit();
     plugin_exit();
+    stats_exit();
+    animation_exit();
     timer_exit_group();
     timer_exit();
 
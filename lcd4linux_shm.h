@@ -0,0 +1,78 @@
+/* $Id$
+ * $URL$
+ *
+ * layout of the shared memory framebuffer exported by the Shm driver
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * The shared memory object starts with a SHM_FB_HEADER, the pixels
+ * follow at 'offset' as 'height' rows of 'stride' bytes, each pixel
+ * being four bytes R, G, B, A.
+ *
+ * The header is protected by a sequence lock: the writer increments
+ * 'seq' before and after updating a frame, so it is odd while a frame
+ * is being written. A reader copies what it needs and retries if 'seq'
+ * was odd or has changed meanwhile:
+ *
+ *   do {
+ *       seq = hdr->seq;
+ *       __sync_synchronize();
+ *       ... read rect[], pixels ...
+ *       __sync_synchronize();
+ *   } while ((seq & 1) || seq != hdr->seq);
+ *
+ * 'rect' lists the areas changed by the last frame; 'nrects' == 0
+ * means the whole framebuffer has changed.
+ *
+ */
+
+#ifndef _LCD4LINUX_SHM_H_
+#define _LCD4LINUX_SHM_H_
+
+#include <stdint.h>
+
+#define SHM_FB_MAGIC   0x4c34464d	/* "L4FM" */
+#define SHM_FB_VERSION 1
+#define SHM_FB_RGBA    0		/* pixel format: R, G, B, A bytes */
+#define SHM_FB_RECTS   8
+
+typedef struct {
+    uint16_t x, y;
+    uint16_t width, height;
+} SHM_FB_RECT;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;		/* in pixels */
+    uint32_t height;
+    uint32_t stride;		/* bytes per row */
+    uint32_t format;
+    uint32_t offset;		/* of the pixels from the start of the object */
+    volatile uint32_t seq;	/* sequence lock, odd while writing */
+    uint32_t frame;		/* frame counter */
+    uint32_t nrects;		/* changed areas, 0 = everything */
+    uint64_t timestamp;		/* CLOCK_MONOTONIC of the frame in nsec */
+    SHM_FB_RECT rect[SHM_FB_RECTS];
+} SHM_FB_HEADER;
+
+#endif
@@ -27,10 +27,22 @@
 /* 
  * exported functions:
  *
+ * int plugin_list (void)
+ *  prints the list of compiled-in plugins
+ *
  * int plugin_init (void)
  *  initializes the expression evaluator
  *  adds some handy constants and functions
  *
+ * void plugin_exit (void)
+ *  shuts down all initialized plugins
+ *
+ * Unless "LazyPlugins 0" is set, only the core plugins are initialized
+ * at startup. Every other plugin is initialized when an expression
+ * using one of its functions is compiled for the first time, so
+ * plugins that are not used by the configuration never open their
+ * files, sockets or bus connections.
+ *
  */
 
 
@@ -43,133 +55,9 @@
 #include <string.h>
 
 #include "debug.h"
-
-
-char *Plugins[] = {
-    "cfg",
-    "math",
-    "string",
-    "test",
-    "time",
-#ifdef PLUGIN_APM
-    "apm",
-#endif
-#ifdef PLUGIN_ASTERISK
-    "asterisk",
-#endif
-#ifdef PLUGIN_BUTTON_EXEC
-    "button_exec",
-#endif
-#ifdef PLUGIN_CPUINFO
-    "cpuinfo",
-#endif
-#ifdef PLUGIN_DBUS
-    "dbus",
-#endif
-#ifdef PLUGIN_DISKSTATS
-    "diskstats",
-#endif
-#ifdef PLUGIN_DVB
-    "dvb",
-#endif
-#ifdef PLUGIN_EXEC
-    "exec",
-#endif
-#ifdef PLUGIN_EVENT
-    "event",
-#endif
-#ifdef PLUGIN_FIFO
-    "fifo",
-#endif
-#ifdef PLUGIN_FILE
-    "file",
-#endif
-#ifdef PLUGIN_GPS
-    "gps",
-#endif
-#ifdef PLUGIN_HDDTEMP
-    "hddtemp",
-#endif
-#ifdef PLUGIN_HUAWEI
-    "huawei",
-#endif
-#ifdef PLUGIN_I2C_SENSORS
-    "i2c_sensors",
-#endif
-#ifdef PLUGIN_ICONV
-    "iconv",
-#endif
-#ifdef PLUGIN_IMON
-    "imon",
-#endif
-#ifdef PLUGIN_ISDN
-    "isdn",
-#endif
-#ifdef PLUGIN_KVV
-    "kvv",
-#endif
-#ifdef PLUGIN_LOADAVG
-    "loadavg",
-#endif
-#ifdef PLUGIN_MEMINFO
-    "meminfo",
-#endif
-#ifdef PLUGIN_MPD
-    "mpd",
-#endif
-#ifdef PLUGIN_MPRIS_DBUS
-    "mpris_dbus",
-#endif
-#ifdef PLUGIN_MYSQL
-    "mysql",
-#endif
-#ifdef PLUGIN_NETDEV
-    "netdev",
-#endif
-#ifdef PLUGIN_NETINFO
-    "netinfo",
-#endif
-#ifdef PLUGIN_POP3
-    "pop3",
-#endif
-#ifdef PLUGIN_PPP
-    "ppp",
-#endif
-#ifdef PLUGIN_PROC_STAT
-    "proc_stat",
-#endif
-#ifdef PLUGIN_PYTHON
-    "python",
-#endif
-#ifdef PLUGIN_RASPI
-    "raspi",
-#endif
-#ifdef PLUGIN_SAMPLE
-    "sample",
-#endif
-#ifdef PLUGIN_SETI
-    "seti",
-#endif
-#ifdef PLUGIN_STATFS
-    "statfs",
-#endif
-#ifdef PLUGIN_UNAME
-    "uname",
-#endif
-#ifdef PLUGIN_UPTIME
-    "uptime",
-#endif
-#ifdef PLUGIN_W1RETAP
-    "w1retap",
-#endif
-#ifdef PLUGIN_WIRELESS
-    "wireless",
-#endif
-#ifdef PLUGIN_XMMS
-    "xmms",
-#endif
-    NULL,
-};
+#include "cfg.h"
+#include "filecache.h"
+#include "history.h"
 
 
 /* Prototypes */
@@ -183,6 +71,8 @@ int plugin_init_test(void);
 void plugin_exit_test(void);
 int plugin_init_time(void);
 void plugin_exit_time(void);
+int plugin_init_history(void);
+void plugin_exit_history(void);
 
 int plugin_init_apm(void);
 void plugin_exit_apm(void);
@@ -264,147 +154,200 @@ int plugin_init_xmms(void);
 void plugin_exit_xmms(void);
 
 
-int plugin_list(void)
-{
-    int i;
-
-    printf("available plugins:\n  ");
-
-    for (i = 0; Plugins[i]; i++) {
-	printf("%s", Plugins[i]);
-	if (Plugins[i + 1])
-	    printf(", ");
-    }
-    printf("\n");
-    return 0;
-}
-
-
-int plugin_init(void)
-{
-    plugin_init_cfg();
-    plugin_init_math();
-    plugin_init_string();
-    plugin_init_test();
-    plugin_init_time();
+typedef struct {
+    char *name;
+    char *functions;		/* function (namespace) provided, NULL for core plugins */
+    int (*init) (void);
+    void (*exit) (void);
+    int initialized;
+} PLUGIN;
 
+static PLUGIN Plugins[] = {
+    {"cfg", NULL, plugin_init_cfg, plugin_exit_cfg, 0},
+    {"math", NULL, plugin_init_math, plugin_exit_math, 0},
+    {"string", NULL, plugin_init_string, plugin_exit_string, 0},
+    {"test", NULL, plugin_init_test, plugin_exit_test, 0},
+    {"time", NULL, plugin_init_time, plugin_exit_time, 0},
+    {"history", "history", plugin_init_history, plugin_exit_history, 0},
 #ifdef PLUGIN_APM
-    plugin_init_apm();
+    {"apm", "apm", plugin_init_apm, plugin_exit_apm, 0},
 #endif
 #ifdef PLUGIN_ASTERISK
-    plugin_init_asterisk();
+    {"asterisk", "asterisk", plugin_init_asterisk, plugin_exit_asterisk, 0},
 #endif
 #ifdef PLUGIN_BUTTON_EXEC
-    plugin_init_button_exec();
+    {"button_exec", "button_exec", plugin_init_button_exec, plugin_exit_button_exec, 0},
 #endif
 #ifdef PLUGIN_CPUINFO
-    plugin_init_cpuinfo();
+    {"cpuinfo", "cpuinfo", plugin_init_cpuinfo, plugin_exit_cpuinfo, 0},
 #endif
 #ifdef PLUGIN_DBUS
-    plugin_init_dbus();
+    {"dbus", "dbus", plugin_init_dbus, plugin_exit_dbus, 0},
 #endif
 #ifdef PLUGIN_DISKSTATS
-    plugin_init_diskstats();
+    {"diskstats", "diskstats", plugin_init_diskstats, plugin_exit_diskstats, 0},
 #endif
 #ifdef PLUGIN_DVB
-    plugin_init_dvb();
+    {"dvb", "dvb", plugin_init_dvb, plugin_exit_dvb, 0},
 #endif
 #ifdef PLUGIN_EXEC
-    plugin_init_exec();
+    {"exec", "exec", plugin_init_exec, plugin_exit_exec, 0},
 #endif
 #ifdef PLUGIN_EVENT
-    plugin_init_event();
+    {"event", "event", plugin_init_event, plugin_exit_event, 0},
 #endif
 #ifdef PLUGIN_FIFO
-    plugin_init_fifo();
+    {"fifo", "fifo", plugin_init_fifo, plugin_exit_fifo, 0},
 #endif
 #ifdef PLUGIN_FILE
-    plugin_init_file();
+    {"file", "file", plugin_init_file, plugin_exit_file, 0},
 #endif
 #ifdef PLUGIN_GPS
-    plugin_init_gps();
+    {"gps", "gps", plugin_init_gps, plugin_exit_gps, 0},
 #endif
 #ifdef PLUGIN_HDDTEMP
-    plugin_init_hddtemp();
+    {"hddtemp", "hddtemp", plugin_init_hddtemp, plugin_exit_hddtemp, 0},
 #endif
 #ifdef PLUGIN_HUAWEI
-    plugin_init_huawei();
+    {"huawei", "huawei", plugin_init_huawei, plugin_exit_huawei, 0},
 #endif
 #ifdef PLUGIN_I2C_SENSORS
-    plugin_init_i2c_sensors();
+    {"i2c_sensors", "i2c_sensors", plugin_init_i2c_sensors, plugin_exit_i2c_sensors, 0},
 #endif
 #ifdef PLUGIN_ICONV
-    plugin_init_iconv();
+    {"iconv", "iconv", plugin_init_iconv, plugin_exit_iconv, 0},
 #endif
 #ifdef PLUGIN_IMON
-    plugin_init_imon();
+    {"imon", "imon", plugin_init_imon, plugin_exit_imon, 0},
 #endif
 #ifdef PLUGIN_ISDN
-    plugin_init_isdn();
+    {"isdn", "isdn", plugin_init_isdn, plugin_exit_isdn, 0},
 #endif
 #ifdef PLUGIN_KVV
-    plugin_init_kvv();
+    {"kvv", "kvv", plugin_init_kvv, plugin_exit_kvv, 0},
 #endif
 #ifdef PLUGIN_LOADAVG
-    plugin_init_loadavg();
+    {"loadavg", "loadavg", plugin_init_loadavg, plugin_exit_loadavg, 0},
 #endif
 #ifdef PLUGIN_MEMINFO
-    plugin_init_meminfo();
+    {"meminfo", "meminfo", plugin_init_meminfo, plugin_exit_meminfo, 0},
 #endif
 #ifdef PLUGIN_MPD
-    plugin_init_mpd();
+    {"mpd", "mpd", plugin_init_mpd, plugin_exit_mpd, 0},
 #endif
 #ifdef PLUGIN_MPRIS_DBUS
-    plugin_init_mpris_dbus();
+    {"mpris_dbus", "mpris_dbus", plugin_init_mpris_dbus, plugin_exit_mpris_dbus, 0},
 #endif
 #ifdef PLUGIN_MYSQL
-    plugin_init_mysql();
+    {"mysql", "MySQL", plugin_init_mysql, plugin_exit_mysql, 0},
 #endif
 #ifdef PLUGIN_NETDEV
-    plugin_init_netdev();
+    {"netdev", "netdev", plugin_init_netdev, plugin_exit_netdev, 0},
 #endif
 #ifdef PLUGIN_NETINFO
-    plugin_init_netinfo();
+    {"netinfo", "netinfo", plugin_init_netinfo, plugin_exit_netinfo, 0},
 #endif
 #ifdef PLUGIN_POP3
-    plugin_init_pop3();
+    {"pop3", "POP3check", plugin_init_pop3, plugin_exit_pop3, 0},
 #endif
 #ifdef PLUGIN_PPP
-    plugin_init_ppp();
+    {"ppp", "ppp", plugin_init_ppp, plugin_exit_ppp, 0},
 #endif
 #ifdef PLUGIN_PROC_STAT
-    plugin_init_proc_stat();
+    {"proc_stat", "proc_stat", plugin_init_proc_stat, plugin_exit_proc_stat, 0},
 #endif
 #ifdef PLUGIN_PYTHON
-    plugin_init_python();
+    {"python", "python", plugin_init_python, plugin_exit_python, 0},
 #endif
 #ifdef PLUGIN_RASPI
-    plugin_init_raspi();
+    {"raspi", "raspi", plugin_init_raspi, plugin_exit_raspi, 0},
 #endif
 #ifdef PLUGIN_SAMPLE
-    plugin_init_sample();
+    {"sample", "sample", plugin_init_sample, plugin_exit_sample, 0},
 #endif
 #ifdef PLUGIN_SETI
-    plugin_init_seti();
+    {"seti", "seti", plugin_init_seti, plugin_exit_seti, 0},
 #endif
 #ifdef PLUGIN_STATFS
-    plugin_init_statfs();
+    {"statfs", "statfs", plugin_init_statfs, plugin_exit_statfs, 0},
 #endif
 #ifdef PLUGIN_UNAME
-    plugin_init_uname();
+    {"uname", "uname", plugin_init_uname, plugin_exit_uname, 0},
 #endif
 #ifdef PLUGIN_UPTIME
-    plugin_init_uptime();
+    {"uptime", "uptime", plugin_init_uptime, plugin_exit_uptime, 0},
 #endif
 #ifdef PLUGIN_W1RETAP
-    plugin_init_w1retap();
+    {"w1retap", "w1retap", plugin_init_w1retap, plugin_exit_w1retap, 0},
 #endif
 #ifdef PLUGIN_WIRELESS
-    plugin_init_wireless();
+    {"wireless", "wifi", plugin_init_wireless, plugin_exit_wireless, 0},
 #endif
 #ifdef PLUGIN_XMMS
-    plugin_init_xmms();
+    {"xmms", "xmms", plugin_init_xmms, plugin_exit_xmms, 0},
 #endif
+    {NULL, NULL, NULL, NULL, 0}
+};
+
+
+int plugin_list(void)
+{
+    int i;
+
+    printf("available plugins:\n  ");
+
+    for (i = 0; Plugins[i].name; i++) {
+	printf("%s", Plugins[i].name);
+	if (Plugins[i + 1].name)
+	    printf(", ");
+    }
+    printf("\n");
+    return 0;
+}
+
+
+static void plugin_start(PLUGIN * P)
+{
+    P->initialized = 1;
+    P->init();
+}
+
+
+/* evaluator callback for unknown functions: initialize the plugin providing it */
+static int plugin_load(const char *function)
+{
+    int i;
+    size_t len;
+
+    for (i = 0; Plugins[i].name; i++) {
+	if (Plugins[i].functions == NULL || Plugins[i].initialized)
+	    continue;
+	len = strlen(Plugins[i].functions);
+	if (strncmp(function, Plugins[i].functions, len) == 0
+	    && (function[len] == '\0' || strncmp(function + len, "::", 2) == 0)) {
+	    debug("initializing plugin '%s' for function '%s'", Plugins[i].name, function);
+	    plugin_start(&Plugins[i]);
+	    return 0;
+	}
+    }
+
+    return -1;
+}
+
+
+int plugin_init(void)
+{
+    int i, lazy;
+
+    cfg_number(NULL, "LazyPlugins", 1, 0, 1, &lazy);
+
+    for (i = 0; Plugins[i].name; i++) {
+	if (Plugins[i].functions == NULL || !lazy)
+	    plugin_start(&Plugins[i]);
+    }
+
+    if (lazy)
+	SetFunctionLoader(plugin_load);
 
     return 0;
 }
@@ -412,126 +355,27 @@ int plugin_init(void)
 
 void plugin_exit(void)
 {
-#ifdef PLUGIN_APM
-    plugin_exit_apm();
-#endif
-#ifdef PLUGIN_ASTERISK
-    plugin_exit_asterisk();
-#endif
-#ifdef PLUGIN_BUTTON_EXEC
-    plugin_exit_button_exec();
-#endif
-#ifdef PLUGIN_CPUINFO
-    plugin_exit_cpuinfo();
-#endif
-#ifdef PLUGIN_DBUS
-    plugin_exit_dbus();
-#endif
-#ifdef PLUGIN_DISKSTATS
-    plugin_exit_diskstats();
-#endif
-#ifdef PLUGIN_DVB
-    plugin_exit_dvb();
-#endif
-#ifdef PLUGIN_EXEC
-    plugin_exit_exec();
-#endif
-#ifdef PLUGIN_EVENT
-    plugin_exit_event();
-#endif
-#ifdef PLUGIN_FIFO
-    plugin_exit_fifo();
-#endif
-#ifdef PLUGIN_FILE
-    plugin_exit_file();
-#endif
-#ifdef PLUGIN_GPS
-    plugin_exit_gps();
-#endif
-#ifdef PLUGIN_HUAWEI
-    plugin_exit_huawei();
-#endif
-#ifdef PLUGIN_I2C_SENSORS
-    plugin_exit_i2c_sensors();
-#endif
-#ifdef PLUGIN_ICONV
-    plugin_exit_iconv();
-#endif
-#ifdef PLUGIN_IMON
-    plugin_exit_imon();
-#endif
-#ifdef PLUGIN_ISDN
-    plugin_exit_isdn();
-#endif
-#ifdef PLUGIN_KVV
-    plugin_exit_kvv();
-#endif
-#ifdef PLUGIN_LOADAVG
-    plugin_exit_loadavg();
-#endif
-#ifdef PLUGIN_MEMINFO
-    plugin_exit_meminfo();
-#endif
-#ifdef PLUGIN_MPD
-    plugin_exit_mpd();
-#endif
-#ifdef PLUGIN_MPRIS_DBUS
-    plugin_exit_mpris_dbus();
-#endif
-#ifdef PLUGIN_MYSQL
-    plugin_exit_mysql();
-#endif
-#ifdef PLUGIN_NETDEV
-    plugin_exit_netdev();
-#endif
-#ifdef PLUGIN_NETINFO
-    plugin_exit_netinfo();
-#endif
-#ifdef PLUGIN_POP3
-    plugin_exit_pop3();
-#endif
-#ifdef PLUGIN_PPP
-    plugin_exit_ppp();
-#endif
-#ifdef PLUGIN_PROC_STAT
-    plugin_exit_proc_stat();
-#endif
-#ifdef PLUGIN_PYTHON
-    plugin_exit_python();
-#endif
-#ifdef PLUGIN_RASPI
-    plugin_exit_raspi();
-#endif
-#ifdef PLUGIN_SAMPLE
-    plugin_exit_sample();
-#endif
-#ifdef PLUGIN_SETI
-    plugin_exit_seti();
-#endif
-#ifdef PLUGIN_STATFS
-    plugin_exit_statfs();
-#endif
-#ifdef PLUGIN_UNAME
-    plugin_exit_uname();
-#endif
-#ifdef PLUGIN_UPTIME
-    plugin_exit_uptime();
-#endif
-#ifdef PLUGIN_W1RETAP
-    plugin_exit_w1retap();
-#endif
-#ifdef PLUGIN_WIRELESS
-    plugin_exit_wireless();
-#endif
-#ifdef PLUGIN_XMMS
-    plugin_exit_xmms();
-#endif
+    int i;
+
+    SetFunctionLoader(NULL);
+
+    /* optional plugins first, core plugins last */
+    for (i = 0; Plugins[i].name; i++) {
+	if (Plugins[i].functions != NULL && Plugins[i].initialized) {
+	    Plugins[i].exit();
+	    Plugins[i].initialized = 0;
+	}
+    }
+    for (i = 0; Plugins[i].name; i++) {
+	if (Plugins[i].functions == NULL && Plugins[i].initialized) {
+	    Plugins[i].exit();
+	    Plugins[i].initialized = 0;
+	}
+    }
 
-    plugin_exit_cfg();
-    plugin_exit_math();
-    plugin_exit_string();
-    plugin_exit_test();
-    plugin_exit_time();
+    /* shared by several plugins */
+    filecache_exit();
+    history_exit();
 
     DeleteFunctions();
     DeleteVariables();
@@ -42,6 +42,7 @@
 #include <stdio.h>
 #include "debug.h"
 #include "plugin.h"
+#include "filecache.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -64,7 +65,7 @@ static char *rtrim(char *string, char junk)
 
 static void zapstatus(RESULT * result, RESULT * arg1)
 {
-    FILE *infile;
+    int file, n;
     int skipline = 0;		// Skip the first in the file, it throws off the detection
     char line[100], *SipLoc, Channel[25], Location[25], __attribute__ ((unused)) State[9], Application[25], EndPoint[8],
 	Ret[50];
@@ -85,14 +86,16 @@ static void zapstatus(RESULT * result, RESULT * arg1)
     system("chmod 744 /tmp/asterisk.state");
     system("asterisk -rx \"show channels\" > /tmp/asterisk.state");	// Crappy CLI way to do it
 
-    infile = fopen("/tmp/asterisk.state", "r");
+    file = filecache_open("/tmp/asterisk.state");
+    filecache_read(file);
 
     for (i = 0; i < 100; i++) {
 	line[i] = ' ';
     }
     line[99] = '\0';
 
-    while (fgets(line, 100, infile) != NULL) {
+    for (n = 1; n <= filecache_lines(file); n++) {
+	snprintf(line, sizeof(line), "%s\n", filecache_line(file, n));
 	if (strstr(line, "Zap") != NULL) {
 	    for (i = 0; i < (int) strlen(line); i++) {
 		if (i < 20) {
@@ -150,7 +153,6 @@ static void zapstatus(RESULT * result, RESULT * arg1)
 	}
 	skipline += 1;
     }
-    fclose(infile);
 
     ZapLine -= 1;
     if (ZapLine < 0 || ZapLine > 31) {
@@ -177,20 +179,20 @@ static void zapstatus(RESULT * result, RESULT * arg1)
 
 static void corecalls(RESULT * result)
 {
-    FILE *infile;
     char line[100];
-    int calls;
+    int calls, file, n;
 
     system("asterisk -rx 'core show channels' > /tmp/asterisk.calls");
 
-    infile = fopen("/tmp/asterisk.state", "r");
+    file = filecache_open("/tmp/asterisk.calls");
+    filecache_read(file);
     line[0] = '\0';
-    while (fgets(line, 100, infile) != NULL) {
+    for (n = 1; n <= filecache_lines(file); n++) {
+	snprintf(line, sizeof(line), "%s", filecache_line(file, n));
 	if (strstr(line, "active calls") != NULL) {
 	    break;
 	}
     }
-    fclose(infile);
 
     if (line[0] != '\0') {
 	sscanf(line, "%d active calls", &calls);
@@ -204,17 +206,16 @@ static void corecalls(RESULT * result)
 
 int sipinfo(int type)
 {
-    FILE *infile;
     char line[100];
-    int peers, online;
+    int peers, online, file;
 
     system("asterisk -rx 'sip show peers' > /tmp/asterisk.sip");
 
-    infile = fopen("/tmp/asterisk.sip", "r");
+    file = filecache_open("/tmp/asterisk.sip");
+    filecache_read(file);
     line[0] = '\0';
-    while (fgets(line, 100, infile) != NULL) {
-    }				// Get the last line
-    fclose(infile);
+    if (filecache_lines(file) > 0)	// Get the last line
+	snprintf(line, sizeof(line), "%s", filecache_line(file, filecache_lines(file)));
 
     if (line[0] != '\0') {
 	sscanf(line, "%d sip peers [Monitored: %d online,", &peers, &online);
@@ -244,22 +245,22 @@ static void siponline(RESULT * result)
 
 static void uptime(RESULT * result)
 {
-    FILE *infile;
     char line[100], *tok;
-    int fields[5], toknum = 0, num, s = 0;
+    int fields[5], toknum = 0, num, s = 0, file, n;
 
     fields[0] = fields[1] = fields[2] = fields[3] = fields[4] = 0;
 
     system("asterisk -rx 'core show uptime' > /tmp/asterisk.uptime");
 
-    infile = fopen("/tmp/asterisk.uptime", "r");
+    file = filecache_open("/tmp/asterisk.uptime");
+    filecache_read(file);
     line[0] = '\0';
-    while (fgets(line, 100, infile) != NULL) {
+    for (n = 1; n <= filecache_lines(file); n++) {
+	snprintf(line, sizeof(line), "%s", filecache_line(file, n));
 	if (strstr(line, "System uptime") != NULL) {
 	    break;
 	}
     }
-    fclose(infile);
 
     if (line[0] != '\0') {
 	for (tok = strtok(line, " "); tok != NULL; tok = strtok(NULL, " ")) {
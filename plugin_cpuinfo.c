@@ -44,6 +44,7 @@
 #include "debug.h"
 #include "plugin.h"
 #include "hash.h"
+#include "procfs.h"
 
 #ifdef __MAC_OS_X_VERSION_10_3
 #include <sys/types.h>
@@ -51,7 +52,7 @@
 #endif
 
 static HASH CPUinfo;
-static FILE *stream = NULL;
+static PROCFS Proc;
 
 static int parse_cpuinfo(char __attribute__ ((unused)) * oid)
 {
@@ -66,17 +67,13 @@ static int parse_cpuinfo(char __attribute__ ((unused)) * oid)
 
     /* Linux Kernel, /proc-filesystem */
 
-    if (stream == NULL)
-	stream = fopen("/proc/cpuinfo", "r");
-    if (stream == NULL) {
-	error("fopen(/proc/cpuinfo) failed: %s", strerror(errno));
+    char *buffer;
+
+    if (procfs_read(&Proc) < 0)
 	return -1;
-    }
-    rewind(stream);
-    while (!feof(stream)) {
-	char buffer[256];
+
+    while ((buffer = procfs_line(&Proc)) != NULL) {
 	char *c, *key, *val;
-	fgets(buffer, sizeof(buffer), stream);
 	c = strchr(buffer, ':');
 	if (c == NULL)
 	    continue;
@@ -94,7 +91,7 @@ static int parse_cpuinfo(char __attribute__ ((unused)) * oid)
 	    *val++ = '\0';
 	/* strip trailing blanks from value */
 	for (c = val; *c != '\0'; c++);
-	while (isspace(*--c))
+	while (c > val && isspace(*--c))
 	    *c = '\0';
 
 	/* add entry to hash table */
@@ -152,15 +149,13 @@ static void my_cpuinfo(RESULT * result, RESULT * arg1)
 int plugin_init_cpuinfo(void)
 {
     hash_create(&CPUinfo);
+    procfs_open(&Proc, "/proc/cpuinfo");
     AddFunction("cpuinfo", 1, my_cpuinfo);
     return 0;
 }
 
 void plugin_exit_cpuinfo(void)
 {
-    if (stream != NULL) {
-	fclose(stream);
-	stream = NULL;
-    }
+    procfs_close(&Proc);
     hash_destroy(&CPUinfo);
 }
@@ -53,6 +53,7 @@
 #endif
 
 #include "event.h"
+#include "dbus_event.h"
 #include <dbus/dbus.h>
 #include <stdio.h>
 #include <assert.h>
@@ -151,23 +152,6 @@ static lcd_sig_t *lcd_register_signal(const char *sender, const char *path,
 				      void (*callback) (void *user_data, int argc, char **argv), void *user_data,
 				      void (*user_free) (void *));
 
-static void setup_dbus_events(DBusConnection * conn);
-
-//to handle watches through the main loop
-static dbus_bool_t add_watch(DBusWatch * w, void *data);
-static void remove_watch(DBusWatch * w, void *data);
-static void toggle_watch(DBusWatch * w, void *data);
-static void watch_handle(event_flags_t f, void *data);
-
-static void dispatch_dbus(void);	//tell dbus to read something
-
-
-//to handle timers through the main loop
-static void timeout_dbus_handle(void *data);
-static dbus_bool_t add_dbus_timeout(DBusTimeout * t, void *data);
-static void remove_dbus_timeout(DBusTimeout * t, void *data);
-static void toggle_dbus_timeout(DBusTimeout * t, void *data);
-
 static lcd_sig_t *create_signal(const char *sender, const char *path,
 				const char *interface, const char *member,
 				void (*callback) (void *user_data, int argc, char **argv), void *user_data,
@@ -363,9 +347,11 @@ void plugin_exit_dbus(void)
 	lcd_unregister_signal(lcd_registered_signals[i]);
     }
     if (sysconn != NULL) {
+	dbus_event_del(sysconn);
 	dbus_connection_unref(sysconn);
     }
     if (sessconn != NULL) {
+	dbus_event_del(sessconn);
 	dbus_connection_unref(sessconn);
     }
     //remove all knows signal results
@@ -388,117 +374,6 @@ void plugin_exit_dbus(void)
  *
  */
 
-//watch functions
-static dbus_bool_t add_watch(DBusWatch * w, void *data)
-{
-    (void) data;		//ignore it
-#if (DBUS_VERSION_MAJOR == 1 && DBUS_VERSION_MINOR == 1 && DBUS_VERSION_MICRO >= 1) || (DBUS_VERSION_MAJOR == 1 && DBUS_VERSION_MINOR > 1) || (DBUS_VERSION_MAJOR > 1)
-    int fd = dbus_watch_get_unix_fd(w);
-#else
-    int fd = dbus_watch_get_fd(w);
-#endif
-    // int fd = dbus_watch_get_unix_fd(w);      //we assume we are using unix
-    int flags = dbus_watch_get_flags(w);
-    event_add(watch_handle, w, fd, flags & DBUS_WATCH_READABLE, flags & DBUS_WATCH_WRITABLE, dbus_watch_get_enabled(w));
-    return TRUE;
-}
-
-static void remove_watch(DBusWatch * w, void *data)
-{
-    (void) data;		//ignore it
-#if (DBUS_VERSION_MAJOR == 1 && DBUS_VERSION_MINOR == 1 && DBUS_VERSION_MICRO >= 1) || (DBUS_VERSION_MAJOR == 1 && DBUS_VERSION_MINOR > 1) || (DBUS_VERSION_MAJOR > 1)
-    event_del(dbus_watch_get_unix_fd(w));
-#else
-    event_del(dbus_watch_get_fd(w));
-#endif
-    // event_del(dbus_watch_get_unix_fd(w));
-}
-
-static void toggle_watch(DBusWatch * w, void *data)
-{
-    (void) data;
-#if (DBUS_VERSION_MAJOR == 1 && DBUS_VERSION_MINOR == 1 && DBUS_VERSION_MICRO >= 1) || (DBUS_VERSION_MAJOR == 1 && DBUS_VERSION_MINOR > 1) || (DBUS_VERSION_MAJOR > 1)
-    int fd = dbus_watch_get_unix_fd(w);
-#else
-    int fd = dbus_watch_get_fd(w);
-#endif
-    // int fd = dbus_watch_get_unix_fd(w);      //we assume we are using unix
-    int flags = dbus_watch_get_flags(w);
-    event_modify(fd, flags & DBUS_WATCH_READABLE, flags & DBUS_WATCH_WRITABLE, dbus_watch_get_enabled(w));
-}
-
-static void watch_handle(event_flags_t f, void *data)
-{
-    DBusWatch *w = (DBusWatch *) data;
-
-    //convert the flags
-    unsigned int flags = 0;
-
-    flags |= (f & EVENT_READ) ? DBUS_WATCH_READABLE : 0;
-    flags |= (f & EVENT_WRITE) ? DBUS_WATCH_WRITABLE : 0;
-    flags |= (f & EVENT_HUP) ? DBUS_WATCH_HANGUP : 0;
-    flags |= (f & EVENT_ERR) ? DBUS_WATCH_ERROR : 0;
-
-    //tell dbus
-    if (!dbus_watch_handle(w, flags)) {
-	info("[DBus] dbus_watch_handle(): Not enough memory!");
-    }
-    dispatch_dbus();
-}
-
-static void dispatch_dbus(void)
-{
-    if (sessconn != NULL && dbus_connection_get_dispatch_status(sessconn) == DBUS_DISPATCH_DATA_REMAINS) {
-	while (DBUS_DISPATCH_DATA_REMAINS == dbus_connection_dispatch(sessconn));
-    }
-    if (sysconn != NULL && dbus_connection_get_dispatch_status(sysconn) == DBUS_DISPATCH_DATA_REMAINS) {
-	while (DBUS_DISPATCH_DATA_REMAINS == dbus_connection_dispatch(sysconn));
-    }
-}
-
-static void timeout_dbus_handle(void *data)
-{
-    DBusTimeout *t = (DBusTimeout *) data;
-    if (!dbus_timeout_handle(t)) {
-	info("[DBus] Not enough memory to handle timeout!");
-    }
-    dispatch_dbus();
-}
-
-static dbus_bool_t add_dbus_timeout(DBusTimeout * t, void *data)
-{
-    (void) data;		//ignore warning
-    if (!timer_add_late(timeout_dbus_handle, t, dbus_timeout_get_interval(t), 0)) {
-	return FALSE;
-    }
-    return TRUE;
-}
-
-
-static void remove_dbus_timeout(DBusTimeout * t, void *data)
-{
-    (void) data;		//ignore warning
-    timer_remove(timeout_dbus_handle, t);
-}
-
-static void toggle_dbus_timeout(DBusTimeout * t, void *data)
-{
-    remove_dbus_timeout(t, data);
-    add_dbus_timeout(t, data);
-}
-
-//add the proper events/callbacks so we get notified about out messages
-static void setup_dbus_events(DBusConnection * conn)
-{
-    if (!dbus_connection_set_watch_functions(conn, add_watch, remove_watch, toggle_watch, NULL, NULL)) {
-	error("[DBus] dbus_connection_set_watch_functions(): Not enough memory!");
-    }
-    if (!dbus_connection_set_timeout_functions
-	(conn, add_dbus_timeout, remove_dbus_timeout, toggle_dbus_timeout, NULL, NULL)) {
-	error("[DBus] dbus_connection_set_timeout_functions(): Not enough memory!");
-    }
-}
-
 static int lcd_dbus_init(void)
 {
 
@@ -513,7 +388,7 @@ static int lcd_dbus_init(void)
 #ifdef DEBUG
 	dbus_connection_set_exit_on_disconnect(sessconn, FALSE);
 #endif
-	setup_dbus_events(sessconn);
+	dbus_event_add(sessconn);
     }
 
     sysconn = dbus_bus_get(DBUS_BUS_SYSTEM, &err);
@@ -524,7 +399,7 @@ static int lcd_dbus_init(void)
 #ifdef DEBUG
 	dbus_connection_set_exit_on_disconnect(sysconn, FALSE);
 #endif
-	setup_dbus_events(sysconn);
+	dbus_event_add(sysconn);
     }
 
     return success;
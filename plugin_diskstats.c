@@ -44,39 +44,31 @@
 #include "debug.h"
 #include "plugin.h"
 #include "hash.h"
+#include "procfs.h"
 
 
 static HASH DISKSTATS;
-static FILE *stream = NULL;
+static PROCFS Proc;
 
 
 static int parse_diskstats(void)
 {
     int age;
+    char *buffer;
 
     /* reread every 10 msec only */
     age = hash_age(&DISKSTATS, NULL);
     if (age > 0 && age <= 10)
 	return 0;
 
-    if (stream == NULL)
-	stream = fopen("/proc/diskstats", "r");
-    if (stream == NULL) {
-	error("fopen(/proc/diskstats) failed: %s", strerror(errno));
+    if (procfs_read(&Proc) < 0)
 	return -1;
-    }
-
-    rewind(stream);
 
-    while (!feof(stream)) {
-	char buffer[1024];
+    while ((buffer = procfs_line(&Proc)) != NULL) {
 	char dev[64];
 	char *beg, *end;
 	unsigned int num, len;
 
-	if (fgets(buffer, sizeof(buffer), stream) == NULL)
-	    break;
-
 	/* fetch device name (3rd column) as key */
 	num = 0;
 	beg = buffer;
@@ -136,6 +128,7 @@ int plugin_init_diskstats(void)
     };
 
     hash_create(&DISKSTATS);
+    procfs_open(&Proc, "/proc/diskstats");
     hash_set_delimiter(&DISKSTATS, " \n");
     for (i = 0; *header[i] != '\0'; i++) {
 	hash_set_column(&DISKSTATS, i, header[i]);
@@ -147,9 +140,6 @@ int plugin_init_diskstats(void)
 
 void plugin_exit_diskstats(void)
 {
-    if (stream != NULL) {
-	fclose(stream);
-	stream = NULL;
-    }
+    procfs_close(&Proc);
     hash_destroy(&DISKSTATS);
 }
@@ -34,6 +34,18 @@
  * int plugin_init_exec (void)
  *  adds functions to start external pocesses
  *
+ * exec(cmd, delay) runs a command every 'delay' msec and returns its
+ * output. exec::stream(cmd) starts a long-running command once and
+ * returns the last complete line it printed. Commands are started
+ * with posix_spawn() and their output is read through event.c, so
+ * nothing blocks. The named event 'exec' is triggered whenever a
+ * value changes; an unchanged output is not stored again.
+ *
+ * A command is paused when nobody asked for its value for a while
+ * (e.g. because its widget is not on the display): periodic commands
+ * are not started again, streams are stopped with SIGSTOP. The next
+ * evaluation resumes it.
+ *
  */
 
 
@@ -44,219 +56,354 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/time.h>
+#include <sys/wait.h>
 
 #include "debug.h"
 #include "plugin.h"
 #include "hash.h"
-#include "cfg.h"
-#include "thread.h"
-#include "qprintf.h"
+#include "event.h"
+#include "timer.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+
+#define MAX_COMMANDS 32
+
+/* output is limited to this size, as before */
+#define EXEC_SIZE 4096
+
+/* a finished stream is restarted after this many msec */
+#define STREAM_RESTART 1000
 
+/* how often streams are checked for being idle */
+#define IDLE_CHECK 1000
 
-#define NUM_THREADS 16
-#define SHM_SIZE 4096
+#define EXEC_EVENT "exec"
 
 typedef struct {
-    int delay;
-    int mutex;
-    pid_t pid;
-    int shmid;
     char *cmd;
-    char *key;
-    char *ret;
-} EXEC_THREAD;
+    int delay;			/* msec between runs, 0 for streams */
+    pid_t pid;			/* running (or not yet reaped) child */
+    int fd;			/* its stdout, -1 if closed */
+    char buffer[EXEC_SIZE];
+    size_t len;
+    int paused;
+    int stopped;		/* stream stopped with SIGSTOP */
+    struct timeval access;	/* last evaluation */
+    int period;			/* msec between the last two evaluations */
+} EXEC;
 
-static EXEC_THREAD Thread[NUM_THREADS];
-static int max_thread = -1;
+static EXEC Exec[MAX_COMMANDS];
+static int nExec = 0;
 
-static HASH EXEC;
+static HASH EXEC_HASH;
 
+/* environment for the commands: ours, with a safe path */
+static char **Env = NULL;
 
-/* x^0 + x^5 + x^12 */
-#define CRCPOLY 0x8408
 
-static unsigned short CRC(const char *s)
+static int msec_since(const struct timeval *tv)
 {
-    int i;
-    unsigned short crc;
+    struct timeval now;
 
-    /* seed value */
-    crc = 0xffff;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - tv->tv_sec) * 1000 + (now.tv_usec - tv->tv_usec) / 1000;
+}
 
-    while (*s != '\0') {
-	crc ^= *s++;
-	for (i = 0; i < 8; i++)
-	    crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY : 0);
-    }
-    return crc;
+
+/* nobody asked for the value for more than two of their usual intervals */
+static int exec_idle(EXEC * E)
+{
+    int interval = E->delay > E->period ? E->delay : E->period;
+
+    return msec_since(&E->access) > 2 * interval + IDLE_CHECK;
 }
 
 
-static void exec_thread(void *data)
+static void exec_value(EXEC * E, const char *value)
 {
-    EXEC_THREAD *Thread = (EXEC_THREAD *) data;
-    FILE *pipe;
-    char buffer[SHM_SIZE];
-    int len;
+    char *old = hash_get(&EXEC_HASH, E->cmd, NULL);
 
-    /* use a safe path */
-    putenv("PATH=/usr/local/bin:/usr/bin:/bin");
+    /* nothing to do if the output did not change */
+    if (old != NULL && strcmp(old, value) == 0)
+	return;
 
-    /* forever... */
-    while (1) {
-	pipe = popen(Thread->cmd, "r");
-	if (pipe == NULL) {
-	    error("exec error: could not run pipe '%s': %s", Thread->cmd, strerror(errno));
-	    len = 0;
-	} else {
-	    len = fread(buffer, 1, SHM_SIZE - 1, pipe);
-	    if (len <= 0) {
-		error("exec error: could not read from pipe '%s': %s", Thread->cmd, strerror(errno));
-		len = 0;
-	    }
-	    pclose(pipe);
-	}
+    hash_put(&EXEC_HASH, E->cmd, value);
+    named_event_trigger(EXEC_EVENT);
+}
 
-	/* force trailing zero */
-	buffer[len] = '\0';
 
-	/* remove trailing CR/LF */
-	while (len > 0 && (buffer[len - 1] == '\n' || buffer[len - 1] == '\r')) {
-	    buffer[--len] = '\0';
-	}
+static void exec_timer(void *data);
+static void exec_read(event_flags_t flags, void *data);
 
-	/* lock shared memory */
-	mutex_lock(Thread->mutex);
-	/* write data */
-	strncpy(Thread->ret, buffer, SHM_SIZE);
-	/* unlock shared memory */
-	mutex_unlock(Thread->mutex);
-	usleep(Thread->delay);
+
+static int exec_spawn(EXEC * E)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t signals;
+    char *argv[] = { "sh", "-c", E->cmd, NULL };
+    int fds[2], ret;
+
+    if (pipe(fds) < 0) {
+	error("exec error: could not create pipe for '%s': %s", E->cmd, strerror(errno));
+	return -1;
     }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], 1);
+
+    /* own process group, so a whole pipeline can be stopped or killed */
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setpgroup(&attr, 0);
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGPIPE);
+    sigaddset(&signals, SIGCHLD);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    ret = posix_spawn(&E->pid, "/bin/sh", &actions, &attr, argv, Env);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+
+    if (ret != 0) {
+	error("exec error: could not run '%s': %s", E->cmd, strerror(ret));
+	close(fds[0]);
+	E->pid = 0;
+	return -1;
+    }
+
+    E->fd = fds[0];
+    E->len = 0;
+    E->stopped = 0;
+    event_add(exec_read, E, E->fd, 1, 0, 1);
+
+    return 0;
 }
 
 
-static void destroy_exec_thread(const int n)
+/* returns 1 if the child is gone */
+static int exec_reap(EXEC * E)
 {
-    thread_destroy(Thread[n].pid);
-
-    if (Thread[n].mutex != 0)
-	mutex_destroy(Thread[n].mutex);
-    if (Thread[n].cmd)
-	free(Thread[n].cmd);
-    if (Thread[n].key)
-	free(Thread[n].key);
-    if (Thread[n].ret)
-	shm_destroy(Thread[n].shmid, Thread[n].ret);
-
-    Thread[n].delay = 0;
-    Thread[n].mutex = 0;
-    Thread[n].pid = 0;
-    Thread[n].shmid = 0;
-    Thread[n].cmd = NULL;
-    Thread[n].key = NULL;
-    Thread[n].ret = NULL;
+    pid_t pid;
+
+    if (E->pid == 0)
+	return 1;
+
+    pid = waitpid(E->pid, NULL, WNOHANG);
+    /* ECHILD: someone set SIGCHLD to SIG_IGN (button_exec) */
+    if (pid == E->pid || (pid < 0 && errno == ECHILD)) {
+	E->pid = 0;
+	return 1;
+    }
+
+    return 0;
 }
 
 
-static int create_exec_thread(const char *cmd, const char *key, const int delay)
+/* strip trailing CR/LF in place */
+static void exec_chomp(char *buffer, size_t len)
 {
-    char name[10];
+    buffer[len] = '\0';
+    while (len > 0 && (buffer[len - 1] == '\n' || buffer[len - 1] == '\r')) {
+	buffer[--len] = '\0';
+    }
+}
 
-    if (max_thread >= NUM_THREADS) {
-	error("cannot create exec thread <%s>: thread buffer full!", cmd);
-	return -1;
+
+/* streams: the last complete line is the value */
+static void exec_lines(EXEC * E)
+{
+    char *line = NULL, *end, *p;
+
+    for (p = E->buffer; (end = memchr(p, '\n', E->buffer + E->len - p)) != NULL; p = end + 1) {
+	line = p;
+	*end = '\0';
     }
 
-    max_thread++;
-    Thread[max_thread].delay = delay;
-    Thread[max_thread].mutex = mutex_create();
-    Thread[max_thread].pid = -1;
-    Thread[max_thread].cmd = strdup(cmd);
-    Thread[max_thread].key = strdup(key);
-    Thread[max_thread].ret = NULL;
-
-    /* create communication buffer */
-    Thread[max_thread].shmid = shm_create((void **) &Thread[max_thread].ret, SHM_SIZE);
-
-    /* catch error */
-    if (Thread[max_thread].shmid < 0) {
-	error("cannot create exec thread <%s>: shared memory allocation failed!", cmd);
-	destroy_exec_thread(max_thread--);
-	return -1;
+    if (line != NULL) {
+	exec_chomp(line, strlen(line));
+	exec_value(E, line);
     }
 
-    /* create thread */
-    qprintf(name, sizeof(name), "exec-%s", key);
-    Thread[max_thread].pid = thread_create(name, exec_thread, &Thread[max_thread]);
+    /* keep the incomplete rest */
+    E->len -= p - E->buffer;
+    memmove(E->buffer, p, E->len);
 
-    /* catch error */
-    if (Thread[max_thread].pid < 0) {
-	error("cannot create exec thread <%s>: fork failed?!", cmd);
-	destroy_exec_thread(max_thread--);
-	return -1;
+    /* an overlong line is cut */
+    if (E->len == sizeof(E->buffer) - 1) {
+	exec_chomp(E->buffer, E->len);
+	exec_value(E, E->buffer);
+	E->len = 0;
     }
+}
 
-    return 0;
+
+static void exec_eof(EXEC * E)
+{
+    event_del(E->fd);
+    close(E->fd);
+    E->fd = -1;
+
+    /* a stream's last line may lack its newline */
+    if (E->delay > 0 || E->len > 0) {
+	exec_chomp(E->buffer, E->len);
+	exec_value(E, E->buffer);
+    }
+    E->len = 0;
+
+    exec_reap(E);
+
+    timer_add(exec_timer, E, E->delay > 0 ? E->delay : STREAM_RESTART, 1);
 }
 
 
-static int do_exec(const char *cmd, const char *key, int delay)
+static void exec_read(event_flags_t flags, void *data)
 {
-    int i, age;
+    EXEC *E = (EXEC *) data;
+    char discard[512];
+    ssize_t len;
 
-    age = hash_age(&EXEC, key);
+    (void) flags;
 
-    if (age < 0) {
-	hash_put(&EXEC, key, "");
-	/* first-time call: create thread */
-	if (delay < 10) {
-	    error("exec(%s): delay %d is too short! using 10 msec", cmd, delay);
-	    delay = 10;
+    while (1) {
+	if (E->len < sizeof(E->buffer) - 1) {
+	    len = read(E->fd, E->buffer + E->len, sizeof(E->buffer) - 1 - E->len);
+	} else {
+	    /* periodic output beyond the limit is dropped */
+	    len = read(E->fd, discard, sizeof(discard));
+	    if (len > 0)
+		continue;
 	}
-	if (create_exec_thread(cmd, key, 1000 * delay)) {
-	    return -1;
+	if (len > 0) {
+	    E->len += len;
+	    if (E->delay == 0)
+		exec_lines(E);
+	    continue;
 	}
-	return 0;
+	if (len < 0 && errno == EINTR)
+	    continue;
+	if (len < 0 && errno == EAGAIN)
+	    return;
+	if (len < 0)
+	    error("exec error: could not read from '%s': %s", E->cmd, strerror(errno));
+	exec_eof(E);
+	return;
     }
+}
 
-    /* reread every 10 msec only */
-    if (age > 0 && age <= 10)
-	return 0;
-
-    /* find thread */
-    for (i = 0; i <= max_thread; i++) {
-	if (strcmp(key, Thread[i].key) == 0) {
-	    /* lock shared memory */
-	    mutex_lock(Thread[i].mutex);
-	    /* copy data */
-	    hash_put(&EXEC, key, Thread[i].ret);
-	    /* unlock shared memory */
-	    mutex_unlock(Thread[i].mutex);
-	    return 0;
-	}
+
+/* time for the next run of a periodic command, or the restart of a stream */
+static void exec_timer(void *data)
+{
+    EXEC *E = (EXEC *) data;
+
+    /* the child closed its output but is still running */
+    if (!exec_reap(E)) {
+	timer_add(exec_timer, E, E->delay > 0 ? E->delay : STREAM_RESTART, 1);
+	return;
+    }
+
+    if (exec_idle(E)) {
+	debug("exec: pausing '%s'", E->cmd);
+	E->paused = 1;
+	return;
     }
 
-    error("internal error: could not find thread exec-%s", key);
-    return -1;
+    if (exec_spawn(E) < 0)
+	timer_add(exec_timer, E, E->delay > 0 ? E->delay : STREAM_RESTART, 1);
 }
 
-static void my_exec(RESULT * result, RESULT * arg1, RESULT * arg2)
+
+/* stop streams nobody reads */
+static void exec_check(void *data)
 {
-    char *cmd, key[5], *val;
-    int delay;
+    int i;
 
-    cmd = R2S(arg1);
-    delay = (int) R2N(arg2);
+    (void) data;
 
-    qprintf(key, sizeof(key), "%x", CRC(cmd));
+    for (i = 0; i < nExec; i++) {
+	EXEC *E = &Exec[i];
+	if (E->delay == 0 && E->pid > 0 && E->fd >= 0 && !E->stopped && exec_idle(E)) {
+	    debug("exec: stopping '%s'", E->cmd);
+	    kill(-E->pid, SIGSTOP);
+	    E->stopped = 1;
+	}
+    }
+}
+
+
+static EXEC *exec_find(const char *cmd, const int delay)
+{
+    EXEC *E;
+    int i;
+
+    for (i = 0; i < nExec; i++) {
+	if (Exec[i].delay == delay && strcmp(Exec[i].cmd, cmd) == 0)
+	    return &Exec[i];
+    }
+
+    /* first-time call: start the command */
+    if (nExec >= MAX_COMMANDS) {
+	error("exec error: cannot run <%s>: too many commands (max %d)", cmd, MAX_COMMANDS);
+	return NULL;
+    }
+
+    E = &Exec[nExec++];
+    memset(E, 0, sizeof(EXEC));
+    E->cmd = strdup(cmd);
+    E->delay = delay;
+    E->fd = -1;
+    gettimeofday(&E->access, NULL);
+    hash_put(&EXEC_HASH, E->cmd, "");
+
+    if (exec_spawn(E) < 0)
+	timer_add(exec_timer, E, delay > 0 ? delay : STREAM_RESTART, 1);
+
+    return E;
+}
 
-    if (do_exec(cmd, key, delay) < 0) {
+
+static void exec_result(RESULT * result, const char *cmd, const int delay)
+{
+    EXEC *E;
+    char *val;
+
+    E = exec_find(cmd, delay);
+    if (E == NULL) {
 	SetResult(&result, R_STRING, "");
 	return;
     }
 
-    val = hash_get(&EXEC, key, NULL);
+    E->period = msec_since(&E->access);
+    gettimeofday(&E->access, NULL);
+
+    /* somebody is interested again */
+    if (E->paused) {
+	debug("exec: resuming '%s'", E->cmd);
+	E->paused = 0;
+	if (exec_spawn(E) < 0)
+	    timer_add(exec_timer, E, delay > 0 ? delay : STREAM_RESTART, 1);
+    } else if (E->stopped) {
+	debug("exec: continuing '%s'", E->cmd);
+	kill(-E->pid, SIGCONT);
+	E->stopped = 0;
+    }
+
+    val = hash_get(&EXEC_HASH, E->cmd, NULL);
     if (val == NULL)
 	val = "";
 
@@ -264,10 +411,45 @@ static void my_exec(RESULT * result, RESULT * arg1, RESULT * arg2)
 }
 
 
+static void my_exec(RESULT * result, RESULT * arg1, RESULT * arg2)
+{
+    int delay = (int) R2N(arg2);
+
+    if (delay < 10) {
+	error("exec(%s): delay %d is too short! using 10 msec", R2S(arg1), delay);
+	delay = 10;
+    }
+
+    exec_result(result, R2S(arg1), delay);
+}
+
+
+static void my_stream(RESULT * result, RESULT * arg1)
+{
+    exec_result(result, R2S(arg1), 0);
+}
+
+
 int plugin_init_exec(void)
 {
-    hash_create(&EXEC);
+    extern char **environ;
+    int i, n;
+
+    for (n = 0; environ[n] != NULL; n++);
+    Env = malloc((n + 2) * sizeof(char *));
+    for (i = 0, n = 0; environ[i] != NULL; i++) {
+	if (strncmp(environ[i], "PATH=", 5) != 0)
+	    Env[n++] = environ[i];
+    }
+    /* use a safe path */
+    Env[n++] = "PATH=/usr/local/bin:/usr/bin:/bin";
+    Env[n] = NULL;
+
+    hash_create(&EXEC_HASH);
+    timer_add(exec_check, NULL, IDLE_CHECK, 0);
+
     AddFunction("exec", 2, my_exec);
+    AddFunction("exec::stream", 1, my_stream);
     return 0;
 }
 
@@ -276,9 +458,27 @@ void plugin_exit_exec(void)
 {
     int i;
 
-    for (i = 0; i <= max_thread; i++) {
-	destroy_exec_thread(i);
+    timer_remove(exec_check, NULL);
+
+    for (i = 0; i < nExec; i++) {
+	EXEC *E = &Exec[i];
+	timer_remove(exec_timer, E);
+	if (E->fd >= 0) {
+	    event_del(E->fd);
+	    close(E->fd);
+	}
+	if (E->pid > 0) {
+	    kill(-E->pid, SIGKILL);
+	    waitpid(E->pid, NULL, 0);
+	}
+	free(E->cmd);
+    }
+    nExec = 0;
+
+    if (Env) {
+	free(Env);
+	Env = NULL;
     }
 
-    hash_destroy(&EXEC);
+    hash_destroy(&EXEC_HASH);
 }
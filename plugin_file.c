@@ -42,6 +42,7 @@
 /* these should always be included */
 #include "debug.h"
 #include "plugin.h"
+#include "filecache.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -54,36 +55,24 @@
 
 static void my_readline(RESULT * result, RESULT * arg1, RESULT * arg2)
 {
-    char value[80], val2[80];
-    FILE *fp;
-    int reqline, i, size;
+    char *value;
+    int file, reqline;
 
     reqline = R2N(arg2);
-    fp = fopen(R2S(arg1), "r");
-    if (!fp) {
-	info("readline couldn't open file '%s'", R2S(arg1));
-	value[0] = '\0';
+    file = filecache_open(R2S(arg1));
+
+    if (filecache_read(file) < 0) {
+	value = "";
     } else {
-	i = 0;
-	while (!feof(fp) && i++ < reqline) {
-	    fgets(val2, sizeof(val2), fp);
-	    size = strcspn(val2, "\r\n");
-	    strncpy(value, val2, size);
-	    value[size] = '\0';
-	    /* more than 80 chars, chew up rest of line */
-	    while (!feof(fp) && strchr(val2, '\n') == NULL) {
-		fgets(val2, sizeof(val2), fp);
-	    }
-	}
-	fclose(fp);
-	if (i <= reqline) {
-	    info("readline requested line %d but file only had %d lines", reqline, i - 1);
-	    value[0] = '\0';
+	value = filecache_line(file, reqline);
+	if (value == NULL) {
+	    info("readline requested line %d but file only had %d lines", reqline, filecache_lines(file));
+	    value = "";
 	}
     }
 
     /* store result */
-    SetResult(&result, R_STRING, &value);
+    SetResult(&result, R_STRING, value);
 }
 
 /* plugin initialization */
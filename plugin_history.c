@@ -0,0 +1,159 @@
+/* $Id$
+ * $URL$
+ *
+ * plugin for querying recorded histories
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/* 
+ * exported functions:
+ *
+ * int plugin_init_history (void)
+ *  adds functions to query histories (see history.c)
+ *
+ *  history::avg(name, seconds)
+ *  history::min(name, seconds)
+ *  history::max(name, seconds)
+ *  history::percentile(name, seconds, p)
+ *
+ *  all return 0 if there is no data for the window (yet)
+ *
+ */
+
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "debug.h"
+#include "plugin.h"
+#include "history.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+
+static int fetch(RESULT * name, RESULT * seconds, const int column, double **values)
+{
+    HISTORY *H = history_open(R2S(name));
+
+    if (H == NULL)
+	return 0;
+
+    return history_fetch(H, column, R2N(seconds), values);
+}
+
+
+static void my_avg(RESULT * result, RESULT * arg1, RESULT * arg2)
+{
+    double *values, value = 0.0;
+    int i, n;
+
+    n = fetch(arg1, arg2, HISTORY_AVG, &values);
+    for (i = 0; i < n; i++)
+	value += values[i];
+    if (n > 0)
+	value /= n;
+
+    SetResult(&result, R_NUMBER, &value);
+}
+
+
+static void my_min(RESULT * result, RESULT * arg1, RESULT * arg2)
+{
+    double *values, value = 0.0;
+    int i, n;
+
+    n = fetch(arg1, arg2, HISTORY_MIN, &values);
+    for (i = 0; i < n; i++) {
+	if (i == 0 || values[i] < value)
+	    value = values[i];
+    }
+
+    SetResult(&result, R_NUMBER, &value);
+}
+
+
+static void my_max(RESULT * result, RESULT * arg1, RESULT * arg2)
+{
+    double *values, value = 0.0;
+    int i, n;
+
+    n = fetch(arg1, arg2, HISTORY_MAX, &values);
+    for (i = 0; i < n; i++) {
+	if (i == 0 || values[i] > value)
+	    value = values[i];
+    }
+
+    SetResult(&result, R_NUMBER, &value);
+}
+
+
+static int compare(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+
+static void my_percentile(RESULT * result, RESULT * arg1, RESULT * arg2, RESULT * arg3)
+{
+    double *values, value = 0.0, p, pos;
+    int n, i;
+
+    n = fetch(arg1, arg2, HISTORY_AVG, &values);
+    if (n > 0) {
+	p = R2N(arg3);
+	if (p < 0.0)
+	    p = 0.0;
+	if (p > 100.0)
+	    p = 100.0;
+	/* the fetched values are a scratch copy, so sort them in place */
+	qsort(values, n, sizeof(double), compare);
+	pos = p / 100.0 * (n - 1);
+	i = (int) pos;
+	value = values[i];
+	if (i < n - 1)
+	    value += (pos - i) * (values[i + 1] - values[i]);
+    }
+
+    SetResult(&result, R_NUMBER, &value);
+}
+
+
+int plugin_init_history(void)
+{
+    AddFunction("history::avg", 2, my_avg);
+    AddFunction("history::min", 2, my_min);
+    AddFunction("history::max", 2, my_max);
+    AddFunction("history::percentile", 3, my_percentile);
+
+    return 0;
+}
+
+
+void plugin_exit_history(void)
+{
+    /* histories are shared, see plugin_exit() */
+}
@@ -51,85 +51,248 @@
 
 
 
+/* number of conversion descriptors kept open */
+#define ICONV_CACHE_SIZE 8
+
+/* number of call sites whose last conversion is remembered */
+#define ICONV_MEMO_SIZE 32
+
+typedef struct {
+    char *from;
+    char *to;
+    iconv_t cd;
+    unsigned int used;
+} ICONV_DESC;
+
+typedef struct {
+    RESULT *site;
+    char *from;
+    char *to;
+    char *input;
+    char *output;
+    unsigned int used;
+} ICONV_MEMO;
+
+static ICONV_DESC Desc[ICONV_CACHE_SIZE];
+static ICONV_MEMO Memo[ICONV_MEMO_SIZE];
+static unsigned int Clock = 0;
+
+/* reusable output buffer, grows on demand */
+static char *Buffer = NULL;
+static size_t BufSize = 0;
+
+
+/* return an open descriptor for (from, to) */
+/* the least recently used descriptor is recycled if the cache is full */
+static iconv_t iconv_get(const char *from, const char *to)
+{
+    ICONV_DESC *slot = NULL;
+    iconv_t cd;
+    int i;
+
+    for (i = 0; i < ICONV_CACHE_SIZE; i++) {
+	if (Desc[i].from == NULL) {
+	    if (slot == NULL || slot->from != NULL)
+		slot = &Desc[i];
+	    continue;
+	}
+	if (strcmp(Desc[i].from, from) == 0 && strcmp(Desc[i].to, to) == 0) {
+	    Desc[i].used = ++Clock;
+	    /* reset shift state left over from the last conversion */
+	    iconv(Desc[i].cd, NULL, NULL, NULL, NULL);
+	    return Desc[i].cd;
+	}
+	if (slot == NULL || (slot->from != NULL && Desc[i].used < slot->used))
+	    slot = &Desc[i];
+    }
+
+    cd = iconv_open(to, from);
+    if (cd == (iconv_t) (-1))
+	return cd;
+
+    if (slot->from != NULL) {
+	iconv_close(slot->cd);
+	free(slot->from);
+	free(slot->to);
+    }
+    slot->from = strdup(from);
+    slot->to = strdup(to);
+    slot->cd = cd;
+    slot->used = ++Clock;
+
+    return cd;
+}
+
+
+/* make sure the output buffer holds at least 'size' bytes */
+static int iconv_grow(const size_t size)
+{
+    char *tmp;
+
+    if (size <= BufSize)
+	return 0;
+
+    tmp = realloc(Buffer, size);
+    if (tmp == NULL) {
+	error("plugin_iconv: out of memory");
+	return -1;
+    }
+    Buffer = tmp;
+    BufSize = size;
+
+    return 0;
+}
+
+
+static void memo_free(ICONV_MEMO * memo)
+{
+    free(memo->from);
+    free(memo->to);
+    free(memo->input);
+    free(memo->output);
+    memset(memo, 0, sizeof(ICONV_MEMO));
+}
+
+
+/* find the memo entry of a call site, or a free/stale one to reuse */
+static ICONV_MEMO *memo_find(RESULT * site)
+{
+    ICONV_MEMO *slot = &Memo[0];
+    int i;
+
+    for (i = 0; i < ICONV_MEMO_SIZE; i++) {
+	if (Memo[i].site == site)
+	    return &Memo[i];
+	if (Memo[i].used < slot->used)
+	    slot = &Memo[i];
+    }
+
+    memo_free(slot);
+    slot->site = site;
+
+    return slot;
+}
+
+
+static void memo_store(ICONV_MEMO * memo, const char *from, const char *to, const char *input, const char *output)
+{
+    free(memo->from);
+    free(memo->to);
+    free(memo->input);
+    free(memo->output);
+    memo->from = strdup(from);
+    memo->to = strdup(to);
+    memo->input = strdup(input);
+    memo->output = strdup(output);
+}
+
+
 /* iconv function, convert charsets */
 /* valid "to" and "from" charsets can be listed by running "iconv --list" from a shell */
 /* utf16 & utf32 encodings won't work, as they contain null bytes, confusing strlen */
 static void my_iconv(RESULT * result, RESULT * charset_from, RESULT * charset_to, RESULT * arg)
 {
+    char *from, *to, *input;
     char *source;
     size_t source_left;
-    char *dest;
     char *dest_pos;
     size_t dest_left;
+    ICONV_MEMO *memo;
     iconv_t cd;
 
-    source = R2S(arg);
+    from = R2S(charset_from);
+    to = R2S(charset_to);
+    input = R2S(arg);
+
+    /* the result pointer identifies the call site: */
+    /* skip the conversion if this site sees the same string again */
+    memo = memo_find(result);
+    memo->used = ++Clock;
+    if (memo->input != NULL && strcmp(memo->input, input) == 0 && strcmp(memo->from, from) == 0
+	&& strcmp(memo->to, to) == 0) {
+	SetResult(&result, R_STRING, memo->output);
+	return;
+    }
+
+    source = input;
     source_left = strlen(source);
 
-    /* use twice the memory needed in best case, but save lots of reallocs in worst case */
-    /* increase to 4 if most conversions are to utf32 (quite unlikely) */
-    /* also alloc a "safety byte" so we can always zero-terminate the string. */
+    /* start with twice the memory needed in best case, grow if needed */
+    /* also keep a "safety byte" so we can always zero-terminate the string. */
+    if (iconv_grow(2 * source_left + 1) < 0) {
+	SetResult(&result, R_STRING, "");
+	return;
+    }
 
-    dest_left = 2 * source_left;
-    dest = malloc(dest_left + 1);
-    dest_pos = dest;
+    cd = iconv_get(from, to);
+    if (cd == (iconv_t) (-1)) {
+	error("plugin_iconv: could not open conversion descriptor. Check if your charsets are supported!");
+	SetResult(&result, R_STRING, input);
+	return;
+    }
 
-    cd = iconv_open(R2S(charset_to), R2S(charset_from));
-    if (cd != (iconv_t) (-1)) {
+    dest_pos = Buffer;
+    dest_left = BufSize - 1;
 
-	do {
+    do {
 
-	    /* quite spammy: debug("plugin_iconv: calling iconv with %ld,[%s]/%ld,%ld", cd, source, source_left, dest_left); */
-	    if (iconv(cd, &source, &source_left, &dest_pos, &dest_left) == (size_t) (-1)) {
-		switch (errno) {
-		case EILSEQ:
-		    /* illegal bytes in input sequence */
-		    /* try to fix by skipping a byte */
-		    info("plugin_iconv: illegal character in input string: %c", *source);
-		    source_left--;
-		    source++;
-		    break;
-		case EINVAL:
-		    /* input string ends during a multibyte sequence */
-		    /* try to fix by simply ignoring */
-		    info("plugin_iconv: illegal character at end of input");
-		    source_left = 0;
-		    break;
-		case E2BIG:
-		    /* not enough bytes in outbuf. */
-		    /* TODO: Realloc output buffer, probably doubling its size? */
-		    /* for now, just bail out. For lcd4linux 99% of all conversions will go to ascii or latin1 anyways */
-		    error
-			("plugin_iconv: out of memory in destination buffer. Seems like Ernst was too lazy, complain to him!");
+	/* quite spammy: debug("plugin_iconv: calling iconv with %ld,[%s]/%ld,%ld", cd, source, source_left, dest_left); */
+	if (iconv(cd, &source, &source_left, &dest_pos, &dest_left) == (size_t) (-1)) {
+	    size_t done;
+	    switch (errno) {
+	    case EILSEQ:
+		/* illegal bytes in input sequence */
+		/* try to fix by skipping a byte */
+		info("plugin_iconv: illegal character in input string: %c", *source);
+		source_left--;
+		source++;
+		break;
+	    case EINVAL:
+		/* input string ends during a multibyte sequence */
+		/* try to fix by simply ignoring */
+		info("plugin_iconv: illegal character at end of input");
+		source_left = 0;
+		break;
+	    case E2BIG:
+		/* not enough bytes in outbuf: double its size and go on */
+		done = dest_pos - Buffer;
+		if (iconv_grow(2 * BufSize) < 0) {
 		    source_left = 0;
 		    break;
-		default:
-		    error("plugin_iconv: strange errno state (%d) occurred", errno);
-		    source_left = 0;
 		}
+		dest_pos = Buffer + done;
+		dest_left = BufSize - 1 - done;
+		break;
+	    default:
+		error("plugin_iconv: strange errno state (%d) occurred", errno);
+		source_left = 0;
 	    }
-	} while (source_left > 0);	/* don't check for == 0, could be negative in EILSEQ case */
+	}
+    } while (source_left > 0);
 
-	/* terminate the string, we're sure to have that byte left, see above */
-	*dest_pos = 0;
-	dest_pos++;
-
-	iconv_close(cd);
-    } else {
-	error("plugin_iconv: could not open conversion descriptor. Check if your charsets are supported!");
-	/* guaranteed to fit. */
-	strcpy(dest, source);
+    /* flush any pending shift sequence */
+    if (iconv(cd, NULL, NULL, &dest_pos, &dest_left) == (size_t) (-1) && errno == E2BIG) {
+	size_t done = dest_pos - Buffer;
+	if (iconv_grow(2 * BufSize) == 0) {
+	    dest_pos = Buffer + done;
+	    dest_left = BufSize - 1 - done;
+	    iconv(cd, NULL, NULL, &dest_pos, &dest_left);
+	}
     }
 
-    SetResult(&result, R_STRING, dest);
+    /* terminate the string, we're sure to have that byte left, see above */
+    *dest_pos = 0;
 
-    free(dest);
+    memo_store(memo, from, to, input, Buffer);
+    SetResult(&result, R_STRING, Buffer);
 }
 
 
 /* plugin initialization */
 int plugin_init_iconv(void)
 {
+    memset(Desc, 0, sizeof(Desc));
+    memset(Memo, 0, sizeof(Memo));
 
     AddFunction("iconv", 3, my_iconv);
 
@@ -138,5 +301,22 @@ int plugin_init_iconv(void)
 
 void plugin_exit_iconv(void)
 {
-    /* nothing to clean */
+    int i;
+
+    for (i = 0; i < ICONV_CACHE_SIZE; i++) {
+	if (Desc[i].from != NULL) {
+	    iconv_close(Desc[i].cd);
+	    free(Desc[i].from);
+	    free(Desc[i].to);
+	}
+    }
+    memset(Desc, 0, sizeof(Desc));
+
+    for (i = 0; i < ICONV_MEMO_SIZE; i++) {
+	memo_free(&Memo[i]);
+    }
+
+    free(Buffer);
+    Buffer = NULL;
+    BufSize = 0;
 }
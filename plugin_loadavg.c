@@ -46,6 +46,7 @@
 #include <fcntl.h>
 
 #include "debug.h"
+#include "timer.h"
 #include "plugin.h"
 
 #ifndef HAVE_GETLOADAVG
@@ -97,7 +98,7 @@ static void my_loadavg(RESULT * result, RESULT * arg1)
     static struct timeval last_value;
     struct timeval now;
 
-    gettimeofday(&now, NULL);
+    timer_now(&now);
 
     age = (now.tv_sec - last_value.tv_sec) * 1000 + (now.tv_usec - last_value.tv_usec) / 1000;
     /* reread every 10 msec only */
@@ -45,32 +45,27 @@
 #include "plugin.h"
 
 #include "hash.h"
+#include "procfs.h"
 
 
 static HASH MemInfo;
-static FILE *stream = NULL;
+static PROCFS Proc;
 
 static int parse_meminfo(void)
 {
     int age;
+    char *buffer;
 
     /* reread every 10 msec only */
     age = hash_age(&MemInfo, NULL);
     if (age > 0 && age <= 10)
 	return 0;
 
-    if (stream == NULL)
-	stream = fopen("/proc/meminfo", "r");
-    if (stream == NULL) {
-	error("fopen(/proc/meminfo) failed: %s", strerror(errno));
+    if (procfs_read(&Proc) < 0)
 	return -1;
-    }
 
-    rewind(stream);
-    while (!feof(stream)) {
-	char buffer[256];
+    while ((buffer = procfs_line(&Proc)) != NULL) {
 	char *c, *key, *val;
-	fgets(buffer, sizeof(buffer), stream);
 	c = strchr(buffer, ':');
 	if (c == NULL)
 	    continue;
@@ -88,7 +83,7 @@ static int parse_meminfo(void)
 	    *val++ = '\0';
 	/* strip trailing blanks from value */
 	for (c = val; *c != '\0'; c++);
-	while (isspace(*--c))
+	while (c > val && isspace(*--c))
 	    *c = '\0';
 	/* skip lines that do not end with " kB" */
 	if (*c == 'B' && *(c - 1) == 'k' && *(c - 2) == ' ') {
@@ -122,6 +117,7 @@ static void my_meminfo(RESULT * result, RESULT * arg1)
 int plugin_init_meminfo(void)
 {
     hash_create(&MemInfo);
+    procfs_open(&Proc, "/proc/meminfo");
     AddFunction("meminfo", 1, my_meminfo);
     return 0;
 }
@@ -129,9 +125,6 @@ int plugin_init_meminfo(void)
 
 void plugin_exit_meminfo(void)
 {
-    if (stream != NULL) {
-	fclose(stream);
-	stream = NULL;
-    }
+    procfs_close(&Proc);
     hash_destroy(&MemInfo);
 }
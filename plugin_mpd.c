@@ -67,6 +67,16 @@
  * changelog v0.83 (26.07.2008):
  *  added:    -mpd::cmd* commands
  *
+ * changelog v0.84:
+ *  added:    -event driven mode ('idle 1'): the connection waits in MPD's
+ *             idle state, the cached fields are refreshed only when MPD
+ *             reports a change, elapsed time is interpolated locally
+ *            -event driven mode connects without blocking, and reads the
+ *             idle responses line by line from the main loop
+ *            -event driven mode never waits for MPD: password, status,
+ *             current song, stats and commands are sent behind each other,
+ *             and their responses are parsed as they come in
+ *
  */
 
 /*
@@ -82,10 +92,18 @@ TODO:
 #include <string.h>
 #include <ctype.h>
 #include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "debug.h"
 #include "plugin.h"
 #include "cfg.h"
+#include "event.h"
+#include "timer.h"
 /* struct timeval */
 #include <sys/time.h>
 
@@ -103,10 +121,20 @@ TODO:
 #define TIMEOUT_IN_S 10
 #define ERROR_DISPLAY 5
 
+/* reconnect delays in event driven mode [msec] */
+#define RETRY_MIN 1000
+#define RETRY_MAX 60000
+
+/* changes which refresh the cached fields */
+#define IDLE_STATUS (MPD_IDLE_PLAYER | MPD_IDLE_MIXER | MPD_IDLE_QUEUE | MPD_IDLE_OPTIONS)
+#define IDLE_STATS  (MPD_IDLE_PLAYER | MPD_IDLE_DATABASE)
+
 /* current song */
 
 static int l_totalTimeSec;
 static int l_elapsedTimeSec;
+static unsigned l_elapsedMs;
+static struct timeval l_elapsedStamp;
 static int l_bitRate;
 static int l_repeatEnabled;
 static int l_randomEnabled;
@@ -134,6 +162,34 @@ static int plugin_enabled;
 static int waittime;
 struct timeval timestamp;
 
+/* event driven mode */
+static int idle_mode;
+static int idle_active;
+static int idle_fd = -1;
+static int idle_write;
+static int idle_retry = RETRY_MIN;
+static char *idle_event;
+/* owned by conn once the welcome line is in */
+static struct mpd_async *idle_async;
+static int idle_owned;
+static struct mpd_parser *idle_parser;
+static enum mpd_idle idle_changes;
+static int idle_refresh;
+
+/* responses expected in event driven mode, oldest first */
+#define IDLE_PENDING 16
+enum idle_response { RESPONSE_PASSWORD, RESPONSE_IDLE, RESPONSE_STATUS, RESPONSE_SONG, RESPONSE_STATS, RESPONSE_COMMAND };
+static struct {
+    enum idle_response response;
+    const char *command;
+} idle_pending[IDLE_PENDING];
+static int idle_first;
+static int idle_count;
+/* responses being parsed */
+static struct mpd_status *idle_status;
+static struct mpd_song *idle_song;
+static struct mpd_stats *idle_stats;
+
 static struct mpd_connection *conn;
 static char Section[] = "Plugin:MPD";
 static int errorcnt = 0;
@@ -272,6 +328,10 @@ static int configure_mpd(void)
 	info("[MPD] no '%s.minUpdateTime' entry from %s using MPD's default", Section, cfg_source());
     }
 
+    /* event driven mode, and the event triggered on changes */
+    cfg_number(Section, "idle", 0, 0, 1, &idle_mode);
+    idle_event = cfg_get(Section, "event", "mpd");
+
 
     /* read password */
     s = cfg_get(Section, "password", "");
@@ -307,49 +367,27 @@ static void mpd_printerror(const char *cmd)
     }
 }
 
-void mpd_query_status(struct mpd_connection *conn)
+/* take over a status, and the current song (NULL if there is none) */
+static void mpd_store_status(const struct mpd_status *status, struct mpd_song *song)
 {
-    struct mpd_status *status;
-    struct mpd_song *song;
     const struct mpd_audio_format *audio;
 
-    if (!conn)
-	return;
-
-    if (!mpd_command_list_begin(conn, true) ||
-	!mpd_send_status(conn) || !mpd_send_current_song(conn) || !mpd_command_list_end(conn)) {
-	mpd_printerror("queue_commands");
-	return;
-    }
-
-    status = mpd_recv_status(conn);
-    if (status == NULL) {
-	mpd_printerror("recv_status");
-	return;
-    }
-    if (currentSong != NULL) {
+    if (currentSong != NULL)
 	mpd_song_free(currentSong);
-	currentSong = NULL;
-    }
-
-    if (!mpd_response_next(conn)) {
-	mpd_printerror("response_next");
-	return;
-    }
+    currentSong = song;
 
-    song = mpd_recv_song(conn);
     if (song != NULL) {
-	currentSong = mpd_song_dup(song);
-	mpd_song_free(song);
-
 	l_elapsedTimeSec = mpd_status_get_elapsed_time(status);
+	l_elapsedMs = mpd_status_get_elapsed_ms(status);
 	l_totalTimeSec = mpd_status_get_total_time(status);
 	l_bitRate = mpd_status_get_kbit_rate(status);
     } else {
 	l_elapsedTimeSec = 0;
+	l_elapsedMs = 0;
 	l_totalTimeSec = 0;
 	l_bitRate = 0;
     }
+    gettimeofday(&l_elapsedStamp, NULL);
     l_state = mpd_status_get_state(status);
 
     l_repeatEnabled = mpd_status_get_repeat(status);
@@ -374,7 +412,46 @@ void mpd_query_status(struct mpd_connection *conn)
 
     if (mpd_status_get_error(status) != NULL)
 	error("[MPD] query status : %s", charset_from_utf8(mpd_status_get_error(status)));
+}
+
+static void mpd_store_stats(const struct mpd_stats *stats)
+{
+    l_numberOfSongs = mpd_stats_get_number_of_songs(stats);
+    l_uptime = mpd_stats_get_uptime(stats);
+    l_playTime = mpd_stats_get_play_time(stats);
+    l_dbPlayTime = mpd_stats_get_db_play_time(stats);
+}
+
+void mpd_query_status(struct mpd_connection *conn)
+{
+    struct mpd_status *status;
+
+    if (!conn)
+	return;
+
+    if (!mpd_command_list_begin(conn, true) ||
+	!mpd_send_status(conn) || !mpd_send_current_song(conn) || !mpd_command_list_end(conn)) {
+	mpd_printerror("queue_commands");
+	return;
+    }
 
+    status = mpd_recv_status(conn);
+    if (status == NULL) {
+	mpd_printerror("recv_status");
+	return;
+    }
+    if (currentSong != NULL) {
+	mpd_song_free(currentSong);
+	currentSong = NULL;
+    }
+
+    if (!mpd_response_next(conn)) {
+	mpd_status_free(status);
+	mpd_printerror("response_next");
+	return;
+    }
+
+    mpd_store_status(status, mpd_recv_song(conn));
     mpd_status_free(status);
 
     if (!mpd_response_finish(conn)) {
@@ -401,11 +478,7 @@ void mpd_query_stats(struct mpd_connection *conn)
 	return;
     }
 
-    l_numberOfSongs = mpd_stats_get_number_of_songs(stats);
-    l_uptime = mpd_stats_get_uptime(stats);
-    l_playTime = mpd_stats_get_play_time(stats);
-    l_dbPlayTime = mpd_stats_get_db_play_time(stats);
-
+    mpd_store_stats(stats);
     mpd_stats_free(stats);
 
     if (!mpd_response_finish(conn)) {
@@ -414,10 +487,467 @@ void mpd_query_stats(struct mpd_connection *conn)
     }
 }
 
+static void mpd_idle_connect(void *data);
+static void mpd_idle_timeout(void *data);
+
+/* drop half received responses */
+static void mpd_idle_free(void)
+{
+    if (idle_status) {
+	mpd_status_free(idle_status);
+	idle_status = NULL;
+    }
+    if (idle_song) {
+	mpd_song_free(idle_song);
+	idle_song = NULL;
+    }
+    if (idle_stats) {
+	mpd_stats_free(idle_stats);
+	idle_stats = NULL;
+    }
+}
+
+
+/* drop the connection and try again later */
+static void mpd_idle_retry(void)
+{
+    if (idle_fd >= 0)
+	event_del(idle_fd);
+    if (conn) {
+	mpd_connection_free(conn);
+	conn = NULL;
+    } else if (idle_async && !idle_owned) {
+	mpd_async_free(idle_async);
+    } else if (idle_fd >= 0 && !idle_owned) {
+	close(idle_fd);
+    }
+    idle_async = NULL;
+    idle_owned = 0;
+    idle_fd = -1;
+    idle_active = 0;
+    idle_changes = 0;
+    idle_refresh = 0;
+    idle_first = 0;
+    idle_count = 0;
+    mpd_idle_free();
+
+    timer_add(mpd_idle_connect, NULL, idle_retry, 1);
+    idle_retry *= 2;
+    if (idle_retry > RETRY_MAX)
+	idle_retry = RETRY_MAX;
+}
+
+
+/* connection lost in event driven mode */
+static void mpd_idle_lost(void)
+{
+    timer_remove(mpd_idle_timeout, NULL);
+    mpd_idle_retry();
+}
+
+
+static void mpd_idle_asyncerror(const char *cmd)
+{
+    error("[MPD] %s to [%s]:[%i] failed : [%s]", cmd, host, iport, mpd_async_get_error_message(idle_async));
+}
+
+
+static void mpd_idle_callback(event_flags_t flags, void *data);
+
+/* watch the socket for what mpd_async is waiting for */
+static void mpd_idle_watch(void)
+{
+    int write = (mpd_async_events(idle_async) & MPD_ASYNC_EVENT_WRITE) != 0;
+
+    if (write == idle_write)
+	return;
+    event_del(idle_fd);
+    event_add(mpd_idle_callback, NULL, idle_fd, 1, write, 1);
+    idle_write = write;
+}
+
+
+/* write as much as the socket takes, the main loop does the rest */
+static int mpd_idle_flush(void)
+{
+    if (!mpd_async_io(idle_async, MPD_ASYNC_EVENT_WRITE)) {
+	mpd_idle_asyncerror("send");
+	return -1;
+    }
+    mpd_idle_watch();
+    return 0;
+}
+
+
+/* the response to this command comes after all pending ones */
+static void mpd_idle_expect(const enum idle_response response, const char *command)
+{
+    int n = (idle_first + idle_count) % IDLE_PENDING;
+
+    idle_pending[n].response = response;
+    idle_pending[n].command = command;
+    idle_count++;
+}
+
+
+/* send a command on the async level, command must be a constant */
+static int mpd_idle_send(const enum idle_response response, const char *command, const char *arg)
+{
+    if (!mpd_async_send_command(idle_async, command, arg, NULL)) {
+	mpd_idle_asyncerror(command);
+	return -1;
+    }
+    mpd_idle_expect(response, command);
+    return 0;
+}
+
+
+/* wait for the next change */
+static int mpd_idle_enter(void)
+{
+    /* must match IDLE_STATUS | IDLE_STATS */
+    if (!mpd_async_send_command(idle_async, "idle", "player", "mixer", "playlist", "options", "database", NULL)) {
+	mpd_idle_asyncerror("send_idle");
+	return -1;
+    }
+    mpd_idle_expect(RESPONSE_IDLE, "idle");
+    idle_active = 1;
+    return 0;
+}
+
+
+/* all responses are in: query what has changed, or wait for the next change */
+static int mpd_idle_next(void)
+{
+    if (conn == NULL || idle_count > 0)
+	return 0;
+
+    if ((idle_changes & IDLE_STATUS) &&
+	(mpd_idle_send(RESPONSE_STATUS, "status", NULL) < 0 || mpd_idle_send(RESPONSE_SONG, "currentsong", NULL) < 0))
+	return -1;
+    if ((idle_changes & IDLE_STATS) && mpd_idle_send(RESPONSE_STATS, "stats", NULL) < 0)
+	return -1;
+    idle_changes = 0;
+    if (idle_count > 0) {
+	idle_refresh = 1;
+	return 0;
+    }
+
+    /* the cache is up to date, tell the widgets */
+    if (idle_refresh && *idle_event)
+	named_event_trigger(idle_event);
+    idle_refresh = 0;
+
+    return mpd_idle_enter();
+}
+
+
+/* the connection works */
+static void mpd_idle_ready(void)
+{
+    if (errorcnt)
+	debug("[MPD] connection fixed...");
+    errorcnt = 0;
+    idle_retry = RETRY_MIN;
+}
+
+
+/* one name/value pair of the oldest pending response */
+static void mpd_idle_pair(const enum idle_response response, const struct mpd_pair *pair)
+{
+    switch (response) {
+    case RESPONSE_IDLE:
+	if (strcmp(pair->name, "changed") == 0)
+	    idle_changes |= mpd_idle_name_parse(pair->value);
+	break;
+    case RESPONSE_STATUS:
+	if (idle_status == NULL)
+	    idle_status = mpd_status_begin();
+	if (idle_status != NULL)
+	    mpd_status_feed(idle_status, pair);
+	break;
+    case RESPONSE_SONG:
+	if (idle_song == NULL)
+	    idle_song = mpd_song_begin(pair);
+	else
+	    mpd_song_feed(idle_song, pair);
+	break;
+    case RESPONSE_STATS:
+	if (idle_stats == NULL)
+	    idle_stats = mpd_stats_begin();
+	if (idle_stats != NULL)
+	    mpd_stats_feed(idle_stats, pair);
+	break;
+    default:
+	break;
+    }
+}
+
+
+/* the oldest pending response is complete */
+static void mpd_idle_done(const enum idle_response response)
+{
+    switch (response) {
+    case RESPONSE_PASSWORD:
+	mpd_idle_ready();
+	break;
+    case RESPONSE_IDLE:
+	idle_active = 0;
+	break;
+    case RESPONSE_SONG:
+	/* status and current song are stored together */
+	if (idle_status != NULL) {
+	    mpd_store_status(idle_status, idle_song);
+	    idle_song = NULL;
+	}
+	mpd_idle_free();
+	break;
+    case RESPONSE_STATS:
+	if (idle_stats != NULL)
+	    mpd_store_stats(idle_stats);
+	mpd_idle_free();
+	break;
+    default:
+	break;
+    }
+}
+
+
+/* feed one line of the oldest pending response */
+static int mpd_idle_line(char *line)
+{
+    struct mpd_pair pair;
+    enum idle_response response;
+    const char *command;
+
+    if (idle_count == 0) {
+	error("[MPD] receive from [%s]:[%i] failed : unexpected response", host, iport);
+	return -1;
+    }
+    response = idle_pending[idle_first].response;
+    command = idle_pending[idle_first].command;
+
+    switch (mpd_parser_feed(idle_parser, line)) {
+    case MPD_PARSER_PAIR:
+	pair.name = mpd_parser_get_name(idle_parser);
+	pair.value = mpd_parser_get_value(idle_parser);
+	mpd_idle_pair(response, &pair);
+	return 0;
+    case MPD_PARSER_SUCCESS:
+	mpd_idle_done(response);
+	break;
+    case MPD_PARSER_ERROR:
+	error("[MPD] %s to [%s]:[%i] failed : [%s]", command, host, iport,
+	      charset_from_utf8(mpd_parser_get_message(idle_parser)));
+	mpd_idle_free();
+	/* the connection itself is fine after a failed command */
+	if (response == RESPONSE_PASSWORD)
+	    errorcnt++;
+	if (response == RESPONSE_PASSWORD || response == RESPONSE_IDLE)
+	    return -1;
+	break;
+    default:
+	error("[MPD] %s to [%s]:[%i] failed : malformed response", command, host, iport);
+	return -1;
+    }
+
+    idle_first = (idle_first + 1) % IDLE_PENDING;
+    idle_count--;
+    return 0;
+}
+
+
+/* the welcome line is in: set up the connection */
+static int mpd_idle_welcome(const char *line)
+{
+    conn = mpd_connection_new_async(idle_async, line);
+    if (conn == NULL) {
+	error("[MPD] connect to [%s]:[%i] failed : out of memory", host, iport);
+	return -1;
+    }
+    /* mpd_connection_free() closes everything from now on */
+    idle_owned = 1;
+    timer_remove(mpd_idle_timeout, NULL);
+    if (mpd_connection_get_error(conn) != MPD_ERROR_SUCCESS) {
+	if (errorcnt < ERROR_DISPLAY)
+	    mpd_printerror("connect");
+	if (errorcnt == ERROR_DISPLAY)
+	    error("[MPD] stop logging, until connection is fixed!");
+	errorcnt++;
+	return -1;
+    }
+
+    /* everything is new, queried once the password is accepted */
+    idle_changes = IDLE_STATUS | IDLE_STATS;
+    if (*pw)
+	return mpd_idle_send(RESPONSE_PASSWORD, "password", pw);
+
+    mpd_idle_ready();
+    return 0;
+}
+
+
+static void mpd_idle_callback(event_flags_t flags, void *data)
+{
+    enum mpd_async_event events = 0;
+    char *line;
+
+    (void) data;
+
+    if (flags & EVENT_READ)
+	events |= MPD_ASYNC_EVENT_READ;
+    if (flags & EVENT_WRITE)
+	events |= MPD_ASYNC_EVENT_WRITE;
+    if (flags & EVENT_HUP)
+	events |= MPD_ASYNC_EVENT_HUP;
+    if (flags & EVENT_ERR)
+	events |= MPD_ASYNC_EVENT_ERROR;
+
+    if (!mpd_async_io(idle_async, events)) {
+	mpd_idle_asyncerror("receive");
+	mpd_idle_lost();
+	return;
+    }
+
+    /* only complete lines, the responses are parsed as they come in */
+    while ((line = mpd_async_recv_line(idle_async)) != NULL) {
+	if (conn == NULL ? mpd_idle_welcome(line) < 0 : mpd_idle_line(line) < 0) {
+	    mpd_idle_lost();
+	    return;
+	}
+    }
+
+    if (mpd_async_get_error(idle_async) != MPD_ERROR_SUCCESS) {
+	mpd_idle_asyncerror("receive");
+	mpd_idle_lost();
+	return;
+    }
+
+    if (mpd_idle_next() < 0 || mpd_idle_flush() < 0)
+	mpd_idle_lost();
+}
+
+
+/* the non-blocking connect() has finished */
+static void mpd_idle_connected(event_flags_t flags, void *data)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    (void) flags;
+    (void) data;
+
+    if (getsockopt(idle_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+	err = errno;
+    if (err != 0) {
+	if (errorcnt < ERROR_DISPLAY)
+	    error("[MPD] connect to [%s]:[%i] failed : [%s]", host, iport, strerror(err));
+	errorcnt++;
+	mpd_idle_lost();
+	return;
+    }
+
+    idle_async = mpd_async_new(idle_fd);
+    if (idle_async == NULL) {
+	error("[MPD] connect to [%s]:[%i] failed : out of memory", host, iport);
+	mpd_idle_lost();
+	return;
+    }
+
+    /* wait for the welcome line */
+    event_del(idle_fd);
+    event_add(mpd_idle_callback, NULL, idle_fd, 1, 0, 1);
+    idle_write = 0;
+}
+
+
+static void mpd_idle_timeout(void *data)
+{
+    (void) data;
+
+    if (conn != NULL)
+	return;
+    if (errorcnt < ERROR_DISPLAY)
+	error("[MPD] connect to [%s]:[%i] failed : timeout", host, iport);
+    errorcnt++;
+    /* not mpd_idle_lost(): this timer must not remove itself */
+    mpd_idle_retry();
+}
+
+
+/* start a non-blocking connect, the main loop does the rest */
+static void mpd_idle_connect(void *data)
+{
+    struct addrinfo hints, *ai = NULL;
+    struct sockaddr_un sa_un;
+    struct sockaddr *addr;
+    socklen_t len;
+    char port[16];
+    int fd;
+
+    (void) data;
+
+    if (idle_parser == NULL && (idle_parser = mpd_parser_new()) == NULL) {
+	error("[MPD] out of memory");
+	return;
+    }
+
+    if (host[0] == '/') {
+	memset(&sa_un, 0, sizeof(sa_un));
+	sa_un.sun_family = AF_UNIX;
+	strncpy(sa_un.sun_path, host, sizeof(sa_un.sun_path) - 1);
+	addr = (struct sockaddr *) &sa_un;
+	len = sizeof(sa_un);
+    } else {
+	/* the name lookup itself still blocks */
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(port, sizeof(port), "%d", iport);
+	if (getaddrinfo(host, port, &hints, &ai) != 0) {
+	    if (errorcnt < ERROR_DISPLAY)
+		error("[MPD] cannot resolve [%s]", host);
+	    errorcnt++;
+	    mpd_idle_lost();
+	    return;
+	}
+	addr = ai->ai_addr;
+	len = ai->ai_addrlen;
+    }
+
+    fd = socket(addr->sa_family, SOCK_STREAM, 0);
+    if (fd >= 0) {
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	if (connect(fd, addr, len) < 0 && errno != EINPROGRESS) {
+	    if (errorcnt < ERROR_DISPLAY)
+		error("[MPD] connect to [%s]:[%i] failed : [%s]", host, iport, strerror(errno));
+	    errorcnt++;
+	    close(fd);
+	    fd = -1;
+	}
+    }
+    if (ai)
+	freeaddrinfo(ai);
+    if (fd < 0) {
+	mpd_idle_lost();
+	return;
+    }
+
+    idle_fd = fd;
+    event_add(mpd_idle_connected, NULL, idle_fd, 0, 1, 1);
+    timer_add(mpd_idle_timeout, NULL, TIMEOUT_IN_S * 1000, 1);
+}
+
+
 static int mpd_update()
 {
     struct timeval now;
 
+    /* event driven mode: the cache is always up to date */
+    if (idle_mode)
+	return 1;
+
     /* reread every 1000 msec only */
     gettimeofday(&now, NULL);
     int timedelta = (now.tv_sec - timestamp.tv_sec) * 1000 + (now.tv_usec - timestamp.tv_usec) / 1000;
@@ -471,11 +1001,67 @@ static int mpd_update()
 }
 
 
+/* commands need a current song */
+static int mpd_command_begin(void)
+{
+    mpd_update();
+    return conn != NULL && currentSong != NULL;
+}
+
+
+/* run a command, in event driven mode it is sent behind the pending responses */
+static void mpd_command(const char *command, const int arg)
+{
+    char value[16];
+    const char *s = NULL;
+
+    if (arg >= 0) {
+	snprintf(value, sizeof(value), "%d", arg);
+	s = value;
+    }
+
+    if (!idle_mode) {
+	if (!mpd_send_command(conn, command, s, NULL) || !mpd_response_finish(conn))
+	    mpd_printerror(command);
+	return;
+    }
+
+    if (idle_count == IDLE_PENDING) {
+	error("[MPD] %s to [%s]:[%i] failed : too many commands pending", command, host, iport);
+	return;
+    }
+    /* noidle ends the pending idle response, the command follows it */
+    if (idle_active) {
+	if (!mpd_async_send_command(idle_async, "noidle", NULL)) {
+	    mpd_idle_asyncerror("send_noidle");
+	    mpd_idle_lost();
+	    return;
+	}
+	idle_active = 0;
+    }
+    /* the command's own changes will be reported by idle */
+    if (mpd_idle_send(RESPONSE_COMMAND, command, s) < 0 || mpd_idle_flush() < 0)
+	mpd_idle_lost();
+}
+
+
 static void elapsedTimeSec(RESULT * result)
 {
     double d;
     mpd_update();
     d = (double) l_elapsedTimeSec;
+
+    /* MPD reports changes only, so the time goes on here */
+    if (idle_mode && l_state == MPD_STATE_PLAY) {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	d = (l_elapsedMs + (now.tv_sec - l_elapsedStamp.tv_sec) * 1000.0 +
+	     (now.tv_usec - l_elapsedStamp.tv_usec) / 1000.0) / 1000.0;
+	if (l_totalTimeSec > 0 && d > l_totalTimeSec)
+	    d = l_totalTimeSec;
+	d = (int) d;
+    }
+
     SetResult(&result, R_NUMBER, &d);
 }
 
@@ -698,124 +1284,80 @@ static void getSamplerateHz(RESULT * result)
 
 static void nextSong()
 {
-    mpd_update();
-    if (currentSong != NULL) {
-	if ((!mpd_run_next(conn))
-	    || (!mpd_response_finish(conn))) {
-	    mpd_printerror("run_next");
-	}
-    }
+    if (mpd_command_begin())
+	mpd_command("next", -1);
 }
 
 static void prevSong()
 {
-    mpd_update();
-    if (currentSong != NULL) {
-	if ((!mpd_run_previous(conn))
-	    || (!mpd_response_finish(conn))) {
-	    mpd_printerror("run_previous");
-	}
-    }
+    if (mpd_command_begin())
+	mpd_command("previous", -1);
 }
 
 static void stopSong()
 {
-    mpd_update();
-    if (currentSong != NULL) {
-	if ((!mpd_run_stop(conn))
-	    || (!mpd_response_finish(conn))) {
-	    mpd_printerror("run_stop");
-	}
-    }
+    if (mpd_command_begin())
+	mpd_command("stop", -1);
 }
 
 static void pauseSong()
 {
-    mpd_update();
-    if (currentSong != NULL) {
-	if ((!mpd_send_pause(conn, l_state == MPD_STATE_PAUSE ? 0 : 1))
-	    || (!mpd_response_finish(conn))) {
-	    mpd_printerror("send_pause");
-	}
-    }
+    if (mpd_command_begin())
+	mpd_command("pause", l_state == MPD_STATE_PAUSE ? 0 : 1);
 }
 
 static void volUp()
 {
-    mpd_update();
-    if (currentSong != NULL) {
+    if (mpd_command_begin()) {
 	l_volume += 5;
 	if (l_volume > 100)
 	    l_volume = 100;
 
-	if ((!mpd_run_set_volume(conn, l_volume))
-	    || (!mpd_response_finish(conn))) {
-	    mpd_printerror("set_volume");
-	}
+	mpd_command("setvol", l_volume);
     }
 }
 
 static void volDown()
 {
-    mpd_update();
-    if (currentSong != NULL) {
+    if (mpd_command_begin()) {
 	if (l_volume > 5)
 	    l_volume -= 5;
 	else
 	    l_volume = 0;
 
-	if ((!mpd_run_set_volume(conn, l_volume))
-	    || (!mpd_response_finish(conn))) {
-	    mpd_printerror("set_volume");
-	}
+	mpd_command("setvol", l_volume);
     }
 }
 
 static void toggleRepeat()
 {
-    mpd_update();
-    if (currentSong != NULL) {
+    if (mpd_command_begin()) {
 	l_repeatEnabled = !l_repeatEnabled;
-	if ((!mpd_run_repeat(conn, l_repeatEnabled))
-	    || (!mpd_response_finish(conn))) {
-	    mpd_printerror("run_repeat");
-	}
+	mpd_command("repeat", l_repeatEnabled);
     }
 }
 
 static void toggleRandom()
 {
-    mpd_update();
-    if (currentSong != NULL) {
+    if (mpd_command_begin()) {
 	l_randomEnabled = !l_randomEnabled;
-	if ((!mpd_run_random(conn, l_randomEnabled))
-	    || (!mpd_response_finish(conn))) {
-	    mpd_printerror("run_random");
-	}
+	mpd_command("random", l_randomEnabled);
     }
 }
 
 static void toggleSingle()
 {
-    mpd_update();
-    if (currentSong != NULL) {
+    if (mpd_command_begin()) {
 	l_singleEnabled = !l_singleEnabled;
-	if ((!mpd_run_single(conn, l_singleEnabled))
-	    || (!mpd_response_finish(conn))) {
-	    mpd_printerror("run_single");
-	}
+	mpd_command("single", l_singleEnabled);
     }
 }
 
 static void toggleConsume()
 {
-    mpd_update();
-    if (currentSong != NULL) {
+    if (mpd_command_begin()) {
 	l_consumeEnabled = !l_consumeEnabled;
-	if ((!mpd_run_consume(conn, l_consumeEnabled))
-	    || (!mpd_response_finish(conn))) {
-	    mpd_printerror("run_consume");
-	}
+	mpd_command("consume", l_consumeEnabled);
     }
 }
 
@@ -878,6 +1420,11 @@ int plugin_init_mpd(void)
     signal(SIGPIPE, SIG_IGN);
     gettimeofday(&timestamp, NULL);
 
+    if (idle_mode) {
+	info("[MPD] event driven, triggering event '%s' on changes", idle_event);
+	mpd_idle_connect(NULL);
+    }
+
     AddFunction("mpd::artist", 0, getArtist);
     AddFunction("mpd::title", 0, getTitle);
     AddFunction("mpd::album", 0, getAlbum);
@@ -925,6 +1472,27 @@ void plugin_exit_mpd(void)
 	if (currentSong != NULL)
 	    mpd_song_free(currentSong);
     }
+    if (idle_mode) {
+	timer_remove(mpd_idle_connect, NULL);
+	timer_remove(mpd_idle_timeout, NULL);
+	if (idle_fd >= 0)
+	    event_del(idle_fd);
+	if (conn == NULL && idle_async != NULL && !idle_owned)
+	    mpd_async_free(idle_async);
+	else if (conn == NULL && idle_fd >= 0 && !idle_owned)
+	    close(idle_fd);
+	idle_async = NULL;
+	idle_fd = -1;
+	mpd_idle_free();
+	if (idle_parser) {
+	    mpd_parser_free(idle_parser);
+	    idle_parser = NULL;
+	}
+    }
+    if (idle_event) {
+	free(idle_event);
+	idle_event = NULL;
+    }
     if (conn != NULL)
 	mpd_connection_free(conn);
     charset_close();
@@ -30,6 +30,19 @@
  * int plugin_init_mpris_dbus (void)
  *  adds various functions
  *
+ * The plugin is driven by D-Bus signals delivered through the main
+ * loop (see dbus_event.c): TrackChange/StatusChange of the old
+ * org.freedesktop.MediaPlayer interface and PropertiesChanged/Seeked
+ * of org.mpris.MediaPlayer2.Player update a cache of the track
+ * metadata and the playback state. The playback position is kept as
+ * (position, timestamp, rate) and extrapolated, so evaluating the
+ * functions never waits for the player; the position is re-synced
+ * with an asynchronous call every few seconds to catch unsignalled
+ * seeks and drift.
+ *
+ * Widgets may use "event 'mpris_dbus'" to be redrawn on track and
+ * status changes.
+ *
  */
 
 #include "config.h"
@@ -38,196 +51,375 @@
 #include <stdint.h>
 #include <string.h>
 #include <ctype.h>
+#include <sys/time.h>
 
 #include <stdio.h>
 
-// TODO: dbus-1 folder should be added to include path 
 #include <dbus/dbus.h>
 
 /* these should always be included */
 #include "debug.h"
 #include "plugin.h"
 #include "hash.h"
+#include "event.h"
+#include "dbus_event.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
 #endif
 
+#define MPRIS1_INTERFACE "org.freedesktop.MediaPlayer"
+#define MPRIS2_PREFIX    "org.mpris.MediaPlayer2."
+#define MPRIS2_PATH      "/org/mpris/MediaPlayer2"
+#define MPRIS2_PLAYER    "org.mpris.MediaPlayer2.Player"
+#define PROPERTIES       "org.freedesktop.DBus.Properties"
+
+/* named event triggered on track and status changes */
+#define MPRIS_EVENT "mpris_dbus"
+
+/* re-query the player position every RESYNC msec */
+#define RESYNC 5000
+
 static HASH DBUS;
 
-// D-Bus variables
-static DBusMessage *msg;
-static DBusMessageIter args;
 static DBusConnection *conn;
-static DBusError err;
 static DBusPendingCall *pending;
 
-static void read_MetaData()
+/* player queried by method_PositionGet */
+static char *Target = NULL;
+static struct timeval Synced;
+
+/* playback position model: Position msec at Stamp, advancing with Rate while Playing */
+static int Valid = 0;
+static int Playing = 1;
+static double Rate = 1.0;
+static double Position = 0.0;
+static struct timeval Stamp;
+
+
+static double msec_since(const struct timeval *tv)
 {
-    // put pairs to hash table
-    int current_type;
-    // TODO: check size of char arrays
-    char str_key[255];
-    char str_value[2048];
-    DBusMessageIter subiter1;
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - tv->tv_sec) * 1000.0 + (now.tv_usec - tv->tv_usec) / 1000.0;
+}
+
 
-    dbus_message_iter_recurse(&args, &subiter1);
-    while ((current_type = dbus_message_iter_get_arg_type(&subiter1)) != DBUS_TYPE_INVALID) {
-	DBusMessageIter subiter2;
-	DBusMessageIter subiter3;
+static double position_now(void)
+{
+    if (!Valid)
+	return 0.0;
+    if (!Playing)
+	return Position;
+    return Position + Rate * msec_since(&Stamp);
+}
+
+
+static void position_set(const double msec)
+{
+    Position = msec;
+    gettimeofday(&Stamp, NULL);
+    Valid = 1;
+}
+
+
+static void playing_set(const int playing)
+{
+    /* freeze the position at the moment of the change */
+    position_set(position_now());
+    Playing = playing;
+}
+
+
+static void rate_set(const double rate)
+{
+    position_set(position_now());
+    Rate = rate;
+}
 
-	strcpy(str_key, "");
-	strcpy(str_value, "");
-	dbus_message_iter_recurse(&subiter1, &subiter2);
-	current_type = dbus_message_iter_get_arg_type(&subiter2);
 
-	if (current_type == DBUS_TYPE_INVALID)
+/* convert a variant to a string, returns the type of the contained value */
+static int read_variant(DBusMessageIter * variant, char *buffer, const size_t size)
+{
+    DBusMessageIter value, array;
+    int type;
+    size_t len;
+
+    *buffer = '\0';
+    dbus_message_iter_recurse(variant, &value);
+    type = dbus_message_iter_get_arg_type(&value);
+
+    switch (type) {
+    case DBUS_TYPE_STRING:
+    case DBUS_TYPE_OBJECT_PATH:
+	{
+	    char *str;
+	    dbus_message_iter_get_basic(&value, &str);
+	    snprintf(buffer, size, "%s", str);
 	    break;
-	if (current_type == DBUS_TYPE_STRING) {
-	    void *str_tmp1;
-	    void *str_tmp2;
-	    dbus_message_iter_get_basic(&subiter2, &str_tmp1);
-	    strcpy(str_key, str_tmp1);
-	    dbus_message_iter_next(&subiter2);
-	    dbus_message_iter_recurse(&subiter2, &subiter3);
-	    current_type = dbus_message_iter_get_arg_type(&subiter3);
-	    switch (current_type) {
-	    case DBUS_TYPE_STRING:
-		{
-		    dbus_message_iter_get_basic(&subiter3, &str_tmp2);
-		    strcpy(str_value, str_tmp2);
-		    break;
-		}
-	    case DBUS_TYPE_INT32:
-		{
-		    dbus_int32_t val;
-		    dbus_message_iter_get_basic(&subiter3, &val);
-		    sprintf(str_value, "%d", val);
-		    break;
-		}
-	    case DBUS_TYPE_INT64:
-		{
-		    dbus_int64_t val;
-		    dbus_message_iter_get_basic(&subiter3, &val);
-		    sprintf(str_value, "%jd", (intmax_t) val);
-		    break;
-		}
-	    default:
-		// unexpected type
-		//printf (" (2-dbus-monitor too dumb to decipher arg type '%c')\n", current_type);
-		break;
-	    }
-	    // add key-value pair to hash
-	    hash_put(&DBUS, str_key, str_value);
-	    //printf("Key: %s , Value: %s\t",str_key,str_value);
 	}
-	//else
-	// unexpected type
-	//printf (" (2-dbus-monitor too dumb to decipher arg type '%c')\n", current_type);                                                              
-	dbus_message_iter_next(&subiter1);
+    case DBUS_TYPE_INT32:
+	{
+	    dbus_int32_t val;
+	    dbus_message_iter_get_basic(&value, &val);
+	    snprintf(buffer, size, "%d", val);
+	    break;
+	}
+    case DBUS_TYPE_UINT32:
+	{
+	    dbus_uint32_t val;
+	    dbus_message_iter_get_basic(&value, &val);
+	    snprintf(buffer, size, "%u", val);
+	    break;
+	}
+    case DBUS_TYPE_INT64:
+	{
+	    dbus_int64_t val;
+	    dbus_message_iter_get_basic(&value, &val);
+	    snprintf(buffer, size, "%jd", (intmax_t) val);
+	    break;
+	}
+    case DBUS_TYPE_UINT64:
+	{
+	    dbus_uint64_t val;
+	    dbus_message_iter_get_basic(&value, &val);
+	    snprintf(buffer, size, "%ju", (uintmax_t) val);
+	    break;
+	}
+    case DBUS_TYPE_DOUBLE:
+	{
+	    double val;
+	    dbus_message_iter_get_basic(&value, &val);
+	    snprintf(buffer, size, "%g", val);
+	    break;
+	}
+    case DBUS_TYPE_ARRAY:
+	/* MPRIS2 artist lists: join strings with ", " */
+	dbus_message_iter_recurse(&value, &array);
+	while (dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_STRING) {
+	    char *str;
+	    dbus_message_iter_get_basic(&array, &str);
+	    len = strlen(buffer);
+	    snprintf(buffer + len, size - len, "%s%s", len ? ", " : "", str);
+	    dbus_message_iter_next(&array);
+	}
+	break;
+    default:
+	/* unexpected type */
+	break;
     }
+
+    return type;
 }
 
-static int listen_TrackChange(void)
+
+/* put the string-variant pairs of an a{sv} array to the hash table */
+static void read_MetaData(DBusMessageIter * args)
 {
-    // non blocking read of the next available message
-    dbus_connection_read_write(conn, 0);
-    msg = dbus_connection_pop_message(conn);
+    DBusMessageIter dict, entry;
+    char str_value[2048];
+    char *str_key;
 
-    // nothing to do if we haven't read a message
-    if (NULL == msg)
-	return 0;
+    /* a new track replaces all keys */
+    hash_destroy(&DBUS);
+    hash_create(&DBUS);
 
-    // check if the message is a signal from the correct interface and with the correct name
-    if (dbus_message_is_signal(msg, "org.freedesktop.MediaPlayer", "TrackChange")) {
-	// read the parameters
-	// TrackChange signal returns an array of string-variant pairs
-	if (!dbus_message_iter_init(msg, &args)) {
-	    // No parameter !
-	    //fprintf(stderr, "Message Has No Parameters\n");
-	    return 0;
-	} else if (DBUS_TYPE_ARRAY != dbus_message_iter_get_arg_type(&args)) {
-	    // Argument is not array
-	    //fprintf(stderr, "Argument is not array!\n");
-	    return 0;
-	} else
-	    read_MetaData();
-	//printf("Got Signal\n");
+    dbus_message_iter_recurse(args, &dict);
+    while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY) {
+	dbus_message_iter_recurse(&dict, &entry);
+	if (dbus_message_iter_get_arg_type(&entry) == DBUS_TYPE_STRING) {
+	    dbus_message_iter_get_basic(&entry, &str_key);
+	    dbus_message_iter_next(&entry);
+	    if (dbus_message_iter_get_arg_type(&entry) == DBUS_TYPE_VARIANT) {
+		read_variant(&entry, str_value, sizeof(str_value));
+		hash_put(&DBUS, str_key, str_value);
+	    }
+	}
+	dbus_message_iter_next(&dict);
     }
-    // free message
-    dbus_message_unref(msg);
-    return 1;
 }
 
-static unsigned long int call_PositionGet(char *target)
+
+/* a{sv} of org.mpris.MediaPlayer2.Player properties (PropertiesChanged, GetAll) */
+static void read_Properties(DBusMessageIter * args)
 {
-    unsigned long int value = 0;
-
-    // create a new method call and check for errors
-    msg = dbus_message_new_method_call(target,	//target for the method call e.g "org.kde.amarok"
-				       "/Player",	// object to call on
-				       "org.freedesktop.MediaPlayer",	// interface to call on
-				       "PositionGet");	// method name
-    if (NULL == msg) {
-	//fprintf(stderr, "Message Null\n");
-	return 0;
-    }
-    // send message and get a handle for a reply
-    if (!dbus_connection_send_with_reply(conn, msg, &pending, -1)) {	// -1 is default timeout
-	//fprintf(stderr, "Out Of Memory!\n");
-	return 0;
+    DBusMessageIter dict, entry, value;
+    char buffer[32];
+    char *key;
+    double position = -1.0;
+
+    dbus_message_iter_recurse(args, &dict);
+    while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY) {
+	dbus_message_iter_recurse(&dict, &entry);
+	dbus_message_iter_get_basic(&entry, &key);
+	dbus_message_iter_next(&entry);
+
+	if (strcmp(key, "Metadata") == 0) {
+	    dbus_message_iter_recurse(&entry, &value);
+	    if (dbus_message_iter_get_arg_type(&value) == DBUS_TYPE_ARRAY) {
+		/* players resend the metadata of the current track (e.g. cover art) */
+		char *trackid = hash_get(&DBUS, "mpris:trackid", NULL);
+		trackid = trackid ? strdup(trackid) : NULL;
+		read_MetaData(&value);
+		key = hash_get(&DBUS, "mpris:trackid", NULL);
+		if (position < 0 && (trackid == NULL || key == NULL || strcmp(trackid, key) != 0))
+		    position = 0.0;
+		if (trackid)
+		    free(trackid);
+	    }
+	} else if (strcmp(key, "PlaybackStatus") == 0) {
+	    if (read_variant(&entry, buffer, sizeof(buffer)) == DBUS_TYPE_STRING)
+		playing_set(strcmp(buffer, "Playing") == 0);
+	} else if (strcmp(key, "Rate") == 0) {
+	    if (read_variant(&entry, buffer, sizeof(buffer)) == DBUS_TYPE_DOUBLE)
+		rate_set(atof(buffer));
+	} else if (strcmp(key, "Position") == 0) {
+	    if (read_variant(&entry, buffer, sizeof(buffer)) == DBUS_TYPE_INT64)
+		position = atof(buffer) / 1000.0;
+	}
+	dbus_message_iter_next(&dict);
     }
-    if (NULL == pending) {
-	//fprintf(stderr, "Pending Call Null\n");
-	return 0;
+
+    if (position >= 0)
+	position_set(position);
+}
+
+
+static DBusHandlerResult mpris_filter(DBusConnection * connection, DBusMessage * msg, void *data)
+{
+    DBusMessageIter args;
+    int changed = 1;
+
+    (void) connection;
+    (void) data;
+
+    if (!dbus_message_iter_init(msg, &args))
+	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+    if (dbus_message_is_signal(msg, MPRIS1_INTERFACE, "TrackChange")) {
+	/* TrackChange signal returns an array of string-variant pairs */
+	if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_ARRAY)
+	    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+	read_MetaData(&args);
+	position_set(0.0);
+
+    } else if (dbus_message_is_signal(msg, MPRIS1_INTERFACE, "StatusChange")) {
+	/* either an int or a struct of four ints, the first one is 0=playing 1=paused 2=stopped */
+	DBusMessageIter status;
+	dbus_int32_t val;
+	if (dbus_message_iter_get_arg_type(&args) == DBUS_TYPE_STRUCT) {
+	    dbus_message_iter_recurse(&args, &status);
+	} else {
+	    status = args;
+	}
+	if (dbus_message_iter_get_arg_type(&status) != DBUS_TYPE_INT32)
+	    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+	dbus_message_iter_get_basic(&status, &val);
+	playing_set(val == 0);
+
+    } else if (dbus_message_is_signal(msg, PROPERTIES, "PropertiesChanged")) {
+	char *interface;
+	if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_STRING)
+	    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+	dbus_message_iter_get_basic(&args, &interface);
+	if (strcmp(interface, MPRIS2_PLAYER) != 0 || !dbus_message_iter_next(&args))
+	    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+	read_Properties(&args);
+
+    } else if (dbus_message_is_signal(msg, MPRIS2_PLAYER, "Seeked")) {
+	dbus_int64_t val;
+	if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_INT64)
+	    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+	dbus_message_iter_get_basic(&args, &val);
+	position_set(val / 1000.0);
+	changed = 0;
+
+    } else {
+	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
     }
-    dbus_connection_flush(conn);
 
-    //printf("Request Sent\n");
+    if (changed)
+	named_event_trigger(MPRIS_EVENT);
 
-    // free message
-    dbus_message_unref(msg);
+    /* signals may be of interest to plugin_dbus as well */
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
 
-    // block until we recieve a reply
-    dbus_pending_call_block(pending);
 
-    // get the reply message
-    msg = dbus_pending_call_steal_reply(pending);
-    if (NULL == msg) {
-	//fprintf(stderr, "Reply Null\n");
-	return 0;
+static void position_reply(DBusPendingCall * call, void *data)
+{
+    DBusMessage *msg;
+    DBusMessageIter args;
+
+    (void) data;
+
+    msg = dbus_pending_call_steal_reply(call);
+    dbus_pending_call_unref(call);
+    if (call == pending)
+	pending = NULL;
+
+    if (msg == NULL)
+	return;
+
+    if (dbus_message_get_type(msg) == DBUS_MESSAGE_TYPE_ERROR) {
+	debug("[mpris_dbus] %s: %s", Target, dbus_message_get_error_name(msg));
+    } else if (dbus_message_iter_init(msg, &args)) {
+	switch (dbus_message_iter_get_arg_type(&args)) {
+	case DBUS_TYPE_INT32:
+	    {
+		/* org.freedesktop.MediaPlayer.PositionGet, msec */
+		dbus_int32_t val;
+		dbus_message_iter_get_basic(&args, &val);
+		position_set(val);
+		break;
+	    }
+	case DBUS_TYPE_ARRAY:
+	    /* org.freedesktop.DBus.Properties.GetAll */
+	    read_Properties(&args);
+	    break;
+	}
     }
-    // free the pending message handle
-    dbus_pending_call_unref(pending);
 
-    // read the parameters
-    if (!dbus_message_iter_init(msg, &args)) {
-	//fprintf(stderr, "Message has no arguments!\n");
-	return 0;
+    dbus_message_unref(msg);
+}
+
+
+/* ask the player for its position (and state, for MPRIS2) without waiting for the answer */
+static void position_query(void)
+{
+    DBusMessage *msg;
+
+    gettimeofday(&Synced, NULL);
+
+    if (strncmp(Target, MPRIS2_PREFIX, strlen(MPRIS2_PREFIX)) == 0) {
+	const char *interface = MPRIS2_PLAYER;
+	msg = dbus_message_new_method_call(Target, MPRIS2_PATH, PROPERTIES, "GetAll");
+	if (msg != NULL)
+	    dbus_message_append_args(msg, DBUS_TYPE_STRING, &interface, DBUS_TYPE_INVALID);
+    } else {
+	msg = dbus_message_new_method_call(Target, "/Player", MPRIS1_INTERFACE, "PositionGet");
+    }
+    if (msg == NULL)
+	return;
+
+    if (!dbus_connection_send_with_reply(conn, msg, &pending, -1) || pending == NULL) {
+	error("[mpris_dbus] cannot query %s: out of memory", Target);
+	pending = NULL;
+    } else if (!dbus_pending_call_set_notify(pending, position_reply, NULL, NULL)) {
+	dbus_pending_call_cancel(pending);
+	dbus_pending_call_unref(pending);
+	pending = NULL;
     }
-    if (DBUS_TYPE_INT32 != dbus_message_iter_get_arg_type(&args)) {
-	//fprintf(stderr, "Argument is not INT32!\n");
-	return 0;
-    } else
-	dbus_message_iter_get_basic(&args, &value);
-    //printf("\nGot Reply: %d", value);
 
-    // free message
     dbus_message_unref(msg);
-
-    return value;
 }
 
+
 static void signal_TrackChange(RESULT * result, RESULT * arg1)
 {
     char *str_tmp;
-    /*
-       if (listen_TrackChange() < 0) {
-       SetResult(&result, R_STRING, "");
-       return;
-       }
-     */
-    listen_TrackChange();
+
     str_tmp = hash_get(&DBUS, R2S(arg1), NULL);
     if (str_tmp == NULL)
 	str_tmp = "";
@@ -235,74 +427,92 @@ static void signal_TrackChange(RESULT * result, RESULT * arg1)
     SetResult(&result, R_STRING, str_tmp);
 }
 
+
 static void method_PositionGet(RESULT * result, RESULT * arg1)
 {
-    unsigned long int mtime = 0;
-    unsigned long int value = 0;
+    double mtime = 0;
     double ratio = 0;
+    char *target = R2S(arg1);
     char *str_tmp;
 
-    value = call_PositionGet(R2S(arg1));
-    //printf("\ncalled :call_PositionGet %d",value);
+    if (Target == NULL || strcmp(Target, target) != 0) {
+	/* another player: forget everything we know about the old one */
+	if (pending != NULL) {
+	    dbus_pending_call_cancel(pending);
+	    dbus_pending_call_unref(pending);
+	    pending = NULL;
+	}
+	if (Target)
+	    free(Target);
+	Target = strdup(target);
+	Valid = 0;
+	Playing = 1;
+	Rate = 1.0;
+	position_query();
+    } else if (pending == NULL && msec_since(&Synced) >= RESYNC) {
+	position_query();
+    }
 
+    /* length in msec (MPRIS1) or usec (MPRIS2) */
+    if ((str_tmp = hash_get(&DBUS, "mtime", NULL)) != NULL)
+	mtime = atof(str_tmp);
+    else if ((str_tmp = hash_get(&DBUS, "mpris:length", NULL)) != NULL)
+	mtime = atof(str_tmp) / 1000.0;
 
-    str_tmp = hash_get(&DBUS, "mtime", NULL);
-    if (str_tmp != NULL)
-	mtime = atoi(str_tmp);
     if (mtime > 0)
-	ratio = (double) (((float) value / mtime) * 100);
+	ratio = position_now() / mtime * 100.0;
+    if (ratio > 100.0)
+	ratio = 100.0;
 
-    //printf("\nvalue:%d mtime:%d ratio:%f",value,mtime,ratio);
-    // return actual position as percentage of total length 
+    /* return actual position as percentage of total length */
     SetResult(&result, R_NUMBER, &ratio);
 }
 
+
 /* plugin initialization */
 /* MUST NOT be declared 'static'! */
 int plugin_init_mpris_dbus(void)
 {
-    hash_create(&DBUS);
-
+    DBusError err;
     int ret;
 
-    //printf("Listening for signals\n");
+    hash_create(&DBUS);
 
-    // initialise the errors
     dbus_error_init(&err);
 
-    // connect to the bus and check for errors
+    /* connect to the bus and check for errors */
     conn = dbus_bus_get(DBUS_BUS_SESSION, &err);
-    /*
-       if (dbus_error_is_set(&err)) {
-       fprintf(stderr, "Connection Error (%s)\n", err.message);
-       dbus_error_free(&err);
-       }
-     */
-    if (NULL == conn)
+    if (NULL == conn) {
+	error("[mpris_dbus] cannot connect to the session bus: %s", err.message);
+	dbus_error_free(&err);
 	return 0;
+    }
 
-    // request our name on the bus and check for errors
+    /* request our name on the bus and check for errors */
     ret = dbus_bus_request_name(conn, "org.lcd4linux.mpris_dbus", DBUS_NAME_FLAG_REPLACE_EXISTING, &err);
-    /*
-       if (dbus_error_is_set(&err)) {
-       fprintf(stderr, "Name Error (%s)\n", err.message);
-       dbus_error_free(&err);
-       }
-     */
-    if (DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER != ret)
+    if (dbus_error_is_set(&err)) {
+	error("[mpris_dbus] cannot request name: %s", err.message);
+	dbus_error_free(&err);
+    }
+    if (DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER != ret) {
+	dbus_connection_unref(conn);
+	conn = NULL;
 	return 0;
+    }
 
-    // add a rule for which messages we want to see
-    dbus_bus_add_match(conn, "type='signal',interface='org.freedesktop.MediaPlayer'", &err);	// see signals from the given interface
-    dbus_connection_flush(conn);
-    /*
-       if (dbus_error_is_set(&err)) {
-       fprintf(stderr, "Match Error (%s)\n", err.message);
-       return 0;
-       }
-     */
-    //printf("Match rule sent\n");
+    if (!dbus_connection_add_filter(conn, mpris_filter, NULL, NULL) || dbus_event_add(conn) < 0) {
+	error("[mpris_dbus] cannot hook into the main loop");
+	dbus_connection_remove_filter(conn, mpris_filter, NULL);
+	dbus_connection_unref(conn);
+	conn = NULL;
+	return 0;
+    }
 
+    /* add rules for the signals we want to see, without waiting for the bus to confirm them */
+    dbus_bus_add_match(conn, "type='signal',interface='" MPRIS1_INTERFACE "'", NULL);
+    dbus_bus_add_match(conn, "type='signal',interface='" PROPERTIES "',member='PropertiesChanged',"
+		       "path='" MPRIS2_PATH "',arg0='" MPRIS2_PLAYER "'", NULL);
+    dbus_bus_add_match(conn, "type='signal',interface='" MPRIS2_PLAYER "',member='Seeked'", NULL);
 
     /* register all our cool functions */
     /* the second parameter is the number of arguments */
@@ -317,9 +527,20 @@ void plugin_exit_mpris_dbus(void)
 {
     /* free any allocated memory */
     /* close filedescriptors */
+    if (pending != NULL) {
+	dbus_pending_call_cancel(pending);
+	dbus_pending_call_unref(pending);
+	pending = NULL;
+    }
+    if (conn != NULL) {
+	dbus_connection_remove_filter(conn, mpris_filter, NULL);
+	dbus_event_del(conn);
+	dbus_connection_unref(conn);
+	conn = NULL;
+    }
+    if (Target) {
+	free(Target);
+	Target = NULL;
+    }
     hash_destroy(&DBUS);
-
-    if (NULL != msg)
-	dbus_message_unref(msg);
-    dbus_error_free(&err);
 }
@@ -40,46 +40,43 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <regex.h>
 
 #include "debug.h"
 #include "plugin.h"
 #include "qprintf.h"
-#include "hash.h"
+#include "procfs.h"
+#include "series.h"
 
 
-static HASH NetDev;
-static FILE *Stream = NULL;
-static char *DELIMITER = " :|\t\n";
+static SERIES NetDev;
+static PROCFS Proc;
+static char *DELIMITER = " :|\t";
+
+/* Rx and Tx counters per interface */
+#define NETDEV_COLUMNS 16
 
 static int parse_netdev(void)
 {
     int age;
     int row, col;
+    char *buffer;
     static int first_time = 1;
 
     /* reread every 10 msec only */
-    age = hash_age(&NetDev, NULL);
-    if (age > 0 && age <= 10)
+    age = series_age(&NetDev);
+    if (age >= 0 && age <= 10)
 	return 0;
 
-    if (Stream == NULL)
-	Stream = fopen("/proc/net/dev", "r");
-    if (Stream == NULL) {
-	error("fopen(/proc/net/dev) failed: %s", strerror(errno));
+    if (procfs_read(&Proc) < 0)
 	return -1;
-    }
 
-    rewind(Stream);
+    series_begin(&NetDev);
     row = 0;
 
-    while (!feof(Stream)) {
-	char buffer[256];
-	char dev[16];
-	char *beg, *end;
-	unsigned int len;
-
-	if (fgets(buffer, sizeof(buffer), Stream) == NULL)
-	    break;
+    while ((buffer = procfs_line(&Proc)) != NULL) {
+	char *token[NETDEV_COLUMNS + 1];
+	int i, n, dev;
 
 	switch (++row) {
 
@@ -92,48 +89,55 @@ static int parse_netdev(void)
 	    if (first_time) {
 		char *RxTx = strrchr(buffer, '|');
 		first_time = 0;
-		col = 0;
-		beg = buffer;
-		while (beg) {
+		n = procfs_split(buffer, DELIMITER, token, NETDEV_COLUMNS + 1);
+		/* skip the "face" column */
+		for (col = 1; col < n; col++) {
 		    char key[32];
-
-		    while (strchr(DELIMITER, *beg))
-			beg++;
-		    if ((end = strpbrk(beg, DELIMITER)) != NULL)
-			*end = '\0';
-		    qprintf(key, sizeof(key), "%s_%s", beg < RxTx ? "Rx" : "Tx", beg);
-		    hash_set_column(&NetDev, col++, key);
-		    beg = end ? end + 1 : NULL;
+		    qprintf(key, sizeof(key), "%s_%s", token[col] < RxTx ? "Rx" : "Tx", token[col]);
+		    series_set_column(&NetDev, col - 1, key);
 		}
 	    }
 	    continue;
 
 	default:
-	    /* fetch interface name (1st column) as key */
-	    beg = buffer;
-	    while (*beg && *beg == ' ')
-		beg++;
-	    end = beg + 1;
-	    while (*end && *end != ':')
-		end++;
-	    len = end - beg;
-	    if (len >= sizeof(dev))
-		len = sizeof(dev) - 1;
-	    strncpy(dev, beg, len);
-	    dev[len] = '\0';
-
-	    hash_put_delta(&NetDev, dev, buffer);
+	    /* interface name (1st column) as row, followed by the counters */
+	    n = procfs_split(buffer, DELIMITER, token, NETDEV_COLUMNS + 1);
+	    if (n < 1)
+		continue;
+	    dev = series_add_row(&NetDev, token[0]);
+	    for (i = 1; i < n; i++) {
+		series_set(&NetDev, dev, i - 1, strtod(token[i], NULL));
+	    }
 	}
     }
 
     return 0;
 }
 
+
+/* value of a counter: absolute if delay is zero, rate per second otherwise */
+static double netdev_value(const int row, const int col, const int delay)
+{
+    double *rate;
+
+    if (delay == 0)
+	return series_get(&NetDev, row, col);
+
+    rate = series_get_delta(&NetDev, delay);
+    if (rate == NULL)
+	return 0.0;
+
+    return rate[row * NETDEV_COLUMNS + col];
+}
+
+
+/* sum of all interfaces matching a regular expression */
 static void my_netdev(RESULT * result, RESULT * arg1, RESULT * arg2, RESULT * arg3)
 {
     char *dev, *key;
-    int delay;
+    int delay, row, col, err;
     double value;
+    regex_t preg;
 
     if (parse_netdev() < 0) {
 	SetResult(&result, R_STRING, "");
@@ -144,7 +148,21 @@ static void my_netdev(RESULT * result, RESULT * arg1, RESULT * arg2, RESULT * ar
     key = R2S(arg2);
     delay = R2N(arg3);
 
-    value = hash_get_regex(&NetDev, dev, key, delay);
+    value = 0.0;
+    col = series_column(&NetDev, key);
+
+    err = regcomp(&preg, dev, REG_ICASE | REG_NOSUB);
+    if (err != 0) {
+	char buffer[32];
+	regerror(err, &preg, buffer, sizeof(buffer));
+	error("error in regular expression: %s", buffer);
+    } else if (col >= 0) {
+	for (row = 0; row < NetDev.nRows; row++) {
+	    if (regexec(&preg, NetDev.Rows[row], 0, NULL, 0) == 0)
+		value += netdev_value(row, col, delay);
+	}
+    }
+    regfree(&preg);
 
     SetResult(&result, R_NUMBER, &value);
 }
@@ -152,7 +170,7 @@ static void my_netdev(RESULT * result, RESULT * arg1, RESULT * arg2, RESULT * ar
 static void my_netdev_fast(RESULT * result, RESULT * arg1, RESULT * arg2, RESULT * arg3)
 {
     char *dev, *key;
-    int delay;
+    int delay, row, col;
     double value;
 
     if (parse_netdev() < 0) {
@@ -164,7 +182,10 @@ static void my_netdev_fast(RESULT * result, RESULT * arg1, RESULT * arg2, RESULT
     key = R2S(arg2);
     delay = R2N(arg3);
 
-    value = hash_get_delta(&NetDev, dev, key, delay);
+    row = series_row(&NetDev, dev);
+    col = series_column(&NetDev, key);
+
+    value = (row < 0 || col < 0) ? 0.0 : netdev_value(row, col, delay);
 
     SetResult(&result, R_NUMBER, &value);
 }
@@ -172,8 +193,8 @@ static void my_netdev_fast(RESULT * result, RESULT * arg1, RESULT * arg2, RESULT
 
 int plugin_init_netdev(void)
 {
-    hash_create(&NetDev);
-    hash_set_delimiter(&NetDev, " :|\t\n");
+    series_create(&NetDev, NETDEV_COLUMNS);
+    procfs_open(&Proc, "/proc/net/dev");
 
     AddFunction("netdev", 3, my_netdev);
     AddFunction("netdev::fast", 3, my_netdev_fast);
@@ -182,9 +203,6 @@ int plugin_init_netdev(void)
 
 void plugin_exit_netdev(void)
 {
-    if (Stream != NULL) {
-	fclose(Stream);
-	Stream = NULL;
-    }
-    hash_destroy(&NetDev);
+    procfs_close(&Proc);
+    series_destroy(&NetDev);
 }
@@ -50,10 +50,18 @@
 #include "plugin.h"
 #include "qprintf.h"
 #include "hash.h"
+#include "procfs.h"
+#include "series.h"
 
 
 static HASH Stat;
-static FILE *stream = NULL;
+static SERIES CPU;
+static PROCFS Proc;
+
+/* counters of the cpu lines, in /proc/stat order */
+static char *CPU_Fields[] = { "user", "nice", "system", "idle", "iow", "irq", "sirq" };
+
+#define CPU_FIELDS 7
 
 
 static void hash_put1(const char *key1, const char *val)
@@ -85,142 +93,100 @@ static int parse_proc_stat(void)
     int age;
 
     /* reread every 10 msec only */
-    age = hash_age(&Stat, NULL);
-    if (age > 0 && age <= 10)
+    age = series_age(&CPU);
+    if (age >= 0 && age <= 10)
 	return 0;
 
 #ifndef __MAC_OS_X_VERSION_10_3
 
     /* Linux Kernel, /proc-filesystem */
 
-    if (stream == NULL)
-	stream = fopen("/proc/stat", "r");
-    if (stream == NULL) {
-	error("fopen(/proc/stat) failed: %s", strerror(errno));
-	return -1;
-    }
+    char *line;
 
-    rewind(stream);
-
-    while (!feof(stream)) {
-	char buffer[1024];
-	if (fgets(buffer, sizeof(buffer), stream) == NULL)
-	    break;
+    if (procfs_read(&Proc) < 0)
+	return -1;
 
-	if (strncmp(buffer, "cpu", 3) == 0) {
-	    char *key[] = { "user", "nice", "system", "idle", "iow", "irq", "sirq" };
-	    char delim[] = " \t\n";
-	    char *cpu, *beg, *end;
-	    int i;
+    /* a failed read must not commit a copy of the last sample */
+    series_begin(&CPU);
 
-	    cpu = buffer;
+    while ((line = procfs_line(&Proc)) != NULL) {
 
-	    /* skip "cpu" or "cpu0" block */
-	    if ((end = strpbrk(buffer, delim)) != NULL)
-		*end = '\0';
-	    beg = end ? end + 1 : NULL;
+	if (strncmp(line, "cpu", 3) == 0) {
+	    char *token[CPU_FIELDS + 1];
+	    int i, n, row;
 
-	    for (i = 0; i < 7 && beg != NULL; i++) {
-		while (strchr(delim, *beg))
-		    beg++;
-		if ((end = strpbrk(beg, delim)))
-		    *end = '\0';
-		hash_put2(cpu, key[i], beg);
-		beg = end ? end + 1 : NULL;
+	    /* "cpu" or "cpu0" block followed by the counters */
+	    n = procfs_split(line, " \t", token, CPU_FIELDS + 1);
+	    row = series_add_row(&CPU, token[0]);
+	    for (i = 1; i < n; i++) {
+		series_set(&CPU, row, i - 1, strtod(token[i], NULL));
 	    }
 	}
 
-	else if (strncmp(buffer, "page ", 5) == 0) {
+	else if (strncmp(line, "page ", 5) == 0 || strncmp(line, "swap ", 5) == 0) {
 	    char *key[] = { "in", "out" };
-	    char delim[] = " \t\n";
-	    char *beg, *end;
-	    int i;
-
-	    for (i = 0, beg = buffer + 5; i < 2 && beg != NULL; i++) {
-		while (strchr(delim, *beg))
-		    beg++;
-		if ((end = strpbrk(beg, delim)))
-		    *end = '\0';
-		hash_put2("page", key[i], beg);
-		beg = end ? end + 1 : NULL;
-	    }
-	}
+	    char *token[3];
+	    int i, n;
 
-	else if (strncmp(buffer, "swap ", 5) == 0) {
-	    char *key[] = { "in", "out" };
-	    char delim[] = " \t\n";
-	    char *beg, *end;
-	    int i;
-
-	    for (i = 0, beg = buffer + 5; i < 2 && beg != NULL; i++) {
-		while (strchr(delim, *beg))
-		    beg++;
-		if ((end = strpbrk(beg, delim)))
-		    *end = '\0';
-		hash_put2("swap", key[i], beg);
-		beg = end ? end + 1 : NULL;
+	    n = procfs_split(line, " \t", token, 3);
+	    for (i = 1; i < n; i++) {
+		hash_put2(token[0], key[i - 1], token[i]);
 	    }
 	}
 
-	else if (strncmp(buffer, "intr ", 5) == 0) {
-	    char delim[] = " \t\n";
-	    char *beg, *end, num[4];
-	    int i;
+	else if (strncmp(line, "intr ", 5) == 0) {
+	    /* the intr line may hold thousands of counters on big machines, */
+	    /* but only the sum and the first 16 interrupts are of interest */
+	    char *token[18];
+	    char num[4];
+	    int i, n;
 
-	    for (i = 0, beg = buffer + 5; i < 17 && beg != NULL; i++) {
-		while (strchr(delim, *beg))
-		    beg++;
-		if ((end = strpbrk(beg, delim)))
-		    *end = '\0';
-		if (i == 0)
+	    n = procfs_split(line, " \t", token, 18);
+	    for (i = 1; i < n; i++) {
+		if (i == 1)
 		    strcpy(num, "sum");
 		else
-		    qprintf(num, sizeof(num), "%d", i - 1);
-		hash_put2("intr", num, beg);
-		beg = end ? end + 1 : NULL;
+		    qprintf(num, sizeof(num), "%d", i - 2);
+		hash_put2("intr", num, token[i]);
 	    }
 	}
 
-	else if (strncmp(buffer, "disk_io:", 8) == 0) {
+	else if (strncmp(line, "disk_io:", 8) == 0) {
 	    char *key[] = { "io", "rio", "rblk", "wio", "wblk" };
-	    char delim[] = " ():,\t\n";
+	    char delim[] = " ():,\t";
 	    char *dev, *beg, *end, *p;
-	    int i;
-
-	    dev = buffer + 8;
-	    while (dev != NULL) {
-		while (strchr(delim, *dev))
-		    dev++;
-		if ((end = strchr(dev, ')')))
-		    *end = '\0';
+	    char *token[5];
+	    int i, n;
+
+	    dev = line + 8;
+	    while (*dev != '\0') {
+		dev += strspn(dev, delim);
+		if (*dev == '\0')
+		    break;
+		if ((end = strchr(dev, ')')) == NULL)
+		    break;
+		*end = '\0';
 		while ((p = strchr(dev, ',')) != NULL)
 		    *p = ':';
-		beg = end ? end + 1 : NULL;
-		for (i = 0; i < 5 && beg != NULL; i++) {
-		    while (strchr(delim, *beg))
-			beg++;
-		    if ((end = strpbrk(beg, delim)))
-			*end = '\0';
-		    hash_put3("disk_io", dev, key[i], beg);
-		    beg = end ? end + 1 : NULL;
+		beg = end + 1;
+		/* counters of this device end with the closing brace */
+		if ((end = strchr(beg, ')')) != NULL)
+		    *end = '\0';
+		n = procfs_split(beg, delim, token, 5);
+		for (i = 0; i < n; i++) {
+		    hash_put3("disk_io", dev, key[i], token[i]);
 		}
-		dev = beg;
+		if (end == NULL)
+		    break;
+		dev = end + 1;
 	    }
 	}
 
 	else {
-	    char delim[] = " \t\n";
-	    char *beg, *end;
+	    char *token[2];
 
-	    beg = buffer;
-	    if ((end = strpbrk(beg, delim)))
-		*end = '\0';
-	    beg = end ? end + 1 : NULL;
-	    if ((end = strpbrk(beg, delim)))
-		*end = '\0';
-	    while (strchr(delim, *beg))
-		beg++;
-	    hash_put1(buffer, beg);
+	    if (procfs_split(line, " \t", token, 2) == 2)
+		hash_put1(token[0], token[1]);
 	}
     }
 
@@ -232,7 +198,7 @@ static int parse_proc_stat(void)
     mach_msg_type_number_t count;
     host_info_t r_load;
     host_cpu_load_info_data_t cpu_load;
-    char s_val[8];
+    int row;
 
     r_load = &cpu_load;
     count = HOST_CPU_LOAD_INFO_COUNT;
@@ -241,14 +207,12 @@ static int parse_proc_stat(void)
 	error("Error getting cpu load");
 	return -1;
     }
-    snprintf(s_val, sizeof(s_val), "%d", cpu_load.cpu_ticks[CPU_STATE_USER]);
-    hash_put2("cpu", "user", s_val);
-    snprintf(s_val, sizeof(s_val), "%d", cpu_load.cpu_ticks[CPU_STATE_NICE]);
-    hash_put2("cpu", "nice", s_val);
-    snprintf(s_val, sizeof(s_val), "%d", cpu_load.cpu_ticks[CPU_STATE_SYSTEM]);
-    hash_put2("cpu", "system", s_val);
-    snprintf(s_val, sizeof(s_val), "%d", cpu_load.cpu_ticks[CPU_STATE_IDLE]);
-    hash_put2("cpu", "idle", s_val);
+    series_begin(&CPU);
+    row = series_add_row(&CPU, "cpu");
+    series_set(&CPU, row, 0, cpu_load.cpu_ticks[CPU_STATE_USER]);
+    series_set(&CPU, row, 1, cpu_load.cpu_ticks[CPU_STATE_NICE]);
+    series_set(&CPU, row, 2, cpu_load.cpu_ticks[CPU_STATE_SYSTEM]);
+    series_set(&CPU, row, 3, cpu_load.cpu_ticks[CPU_STATE_IDLE]);
 
 #endif
 
@@ -256,10 +220,51 @@ static int parse_proc_stat(void)
 }
 
 
+/* lookup a "cpu.user" or "cpu3.idle" style key in the cpu series */
+static int cpu_key(const char *key, int *row, int *col)
+{
+    char name[16];
+    char *dot;
+    size_t len;
+
+    if (strncmp(key, "cpu", 3) != 0 || (dot = strrchr(key, '.')) == NULL)
+	return -1;
+
+    len = dot - key;
+    if (len >= sizeof(name))
+	return -1;
+    strncpy(name, key, len);
+    name[len] = '\0';
+
+    *row = series_row(&CPU, name);
+    *col = series_column(&CPU, dot + 1);
+
+    return (*row < 0 || *col < 0) ? -1 : 0;
+}
+
+
+/* row of cpu number n, or of the summary line if n < 0 */
+static int cpu_row(const int n)
+{
+    char name[16];
+
+    /* /proc/stat lists "cpu" first, followed by cpu0, cpu1, ... */
+    if (n < 0)
+	return series_row(&CPU, "cpu");
+
+    qprintf(name, sizeof(name), "cpu%d", n);
+    if (n + 1 < CPU.nRows && strcmp(CPU.Rows[n + 1], name) == 0)
+	return n + 1;
+
+    return series_row(&CPU, name);
+}
+
+
 static void my_proc_stat(RESULT * result, const int argc, RESULT * argv[])
 {
-    char *string;
-    double number;
+    char *string, buffer[32];
+    double number, *rate;
+    int row, col;
 
     if (parse_proc_stat() < 0) {
 	SetResult(&result, R_STRING, "");
@@ -268,13 +273,27 @@ static void my_proc_stat(RESULT * result, const int argc, RESULT * argv[])
 
     switch (argc) {
     case 1:
-	string = hash_get(&Stat, R2S(argv[0]), NULL);
+	if (cpu_key(R2S(argv[0]), &row, &col) == 0) {
+	    snprintf(buffer, sizeof(buffer), "%.0f", series_get(&CPU, row, col));
+	    string = buffer;
+	} else {
+	    string = hash_get(&Stat, R2S(argv[0]), NULL);
+	}
 	if (string == NULL)
 	    string = "";
 	SetResult(&result, R_STRING, string);
 	break;
     case 2:
-	number = hash_get_delta(&Stat, R2S(argv[0]), NULL, R2N(argv[1]));
+	if (cpu_key(R2S(argv[0]), &row, &col) == 0) {
+	    if (R2N(argv[1]) == 0) {
+		number = series_get(&CPU, row, col);
+	    } else {
+		rate = series_get_delta(&CPU, R2N(argv[1]));
+		number = rate ? rate[row * CPU_FIELDS + col] : 0.0;
+	    }
+	} else {
+	    number = hash_get_delta(&Stat, R2S(argv[0]), NULL, R2N(argv[1]));
+	}
 	SetResult(&result, R_NUMBER, &number);
 	break;
     default:
@@ -284,52 +303,68 @@ static void my_proc_stat(RESULT * result, const int argc, RESULT * argv[])
 }
 
 
-static void my_cpu(RESULT * result, RESULT * arg1, RESULT * arg2)
+/* proc_stat::cpu(key, delay [, cpu]) */
+/* The rates of all CPUs are computed in one pass per sample and delay, */
+/* so a row of per-core bars costs one lookup per widget. */
+static void my_cpu(RESULT * result, const int argc, RESULT * argv[])
 {
     char *key;
-    int delay;
-    double value;
-    double cpu_user, cpu_nice, cpu_system, cpu_idle, cpu_total;
-    double cpu_iow, cpu_irq, cpu_sirq;
+    int delay, row, i;
+    double value, *rate;
+    double cpu[CPU_FIELDS];
+    double cpu_total;
 
-    if (parse_proc_stat() < 0) {
+    if (argc < 2 || argc > 3) {
+	error("proc_stat::cpu(): wrong number of parameters");
 	SetResult(&result, R_STRING, "");
 	return;
     }
 
-    key = R2S(arg1);
-    delay = R2N(arg2);
-
-    cpu_user = hash_get_delta(&Stat, "cpu.user", NULL, delay);
-    cpu_nice = hash_get_delta(&Stat, "cpu.nice", NULL, delay);
-    cpu_system = hash_get_delta(&Stat, "cpu.system", NULL, delay);
-    cpu_idle = hash_get_delta(&Stat, "cpu.idle", NULL, delay);
+    if (parse_proc_stat() < 0) {
+	SetResult(&result, R_STRING, "");
+	return;
+    }
 
-    /* new fields for kernel 2.6 */
-    /* even if we dont have this param (ie kernel 2.4) */
-    /* the return is 0.0 and not change the results */
-    cpu_iow = hash_get_delta(&Stat, "cpu.iow", NULL, delay);
-    cpu_irq = hash_get_delta(&Stat, "cpu.irq", NULL, delay);
-    cpu_sirq = hash_get_delta(&Stat, "cpu.sirq", NULL, delay);
+    key = R2S(argv[0]);
+    delay = R2N(argv[1]);
+    row = cpu_row(argc == 3 ? (int) R2N(argv[2]) : -1);
+
+    /* fields missing on old kernels (iow, irq, sirq) stay zero */
+    /* and do not change the results */
+    for (i = 0; i < CPU_FIELDS; i++)
+	cpu[i] = 0.0;
+
+    if (row >= 0) {
+	if (delay == 0) {
+	    for (i = 0; i < CPU_FIELDS; i++)
+		cpu[i] = series_get(&CPU, row, i);
+	} else if ((rate = series_get_delta(&CPU, delay)) != NULL) {
+	    for (i = 0; i < CPU_FIELDS; i++)
+		cpu[i] = rate[row * CPU_FIELDS + i];
+	}
+    }
 
-    cpu_total = cpu_user + cpu_nice + cpu_system + cpu_idle + cpu_iow + cpu_irq + cpu_sirq;
+    cpu_total = 0.0;
+    for (i = 0; i < CPU_FIELDS; i++)
+	cpu_total += cpu[i];
 
+    value = 0.0;
     if (strcasecmp(key, "user") == 0)
-	value = cpu_user;
+	value = cpu[0];
     else if (strcasecmp(key, "nice") == 0)
-	value = cpu_nice;
+	value = cpu[1];
     else if (strcasecmp(key, "system") == 0)
-	value = cpu_system;
+	value = cpu[2];
     else if (strcasecmp(key, "idle") == 0)
-	value = cpu_idle;
+	value = cpu[3];
     else if (strcasecmp(key, "iowait") == 0)
-	value = cpu_iow;
+	value = cpu[4];
     else if (strcasecmp(key, "irq") == 0)
-	value = cpu_irq;
+	value = cpu[5];
     else if (strcasecmp(key, "softirq") == 0)
-	value = cpu_sirq;
+	value = cpu[6];
     else if (strcasecmp(key, "busy") == 0)
-	value = cpu_total - cpu_idle;
+	value = cpu_total - cpu[3];
 
     if (cpu_total > 0.0)
 	value = 100 * value / cpu_total;
@@ -364,18 +399,23 @@ static void my_disk(RESULT * result, RESULT * arg1, RESULT * arg2, RESULT * arg3
 
 int plugin_init_proc_stat(void)
 {
+    int i;
+
     hash_create(&Stat);
+    series_create(&CPU, CPU_FIELDS);
+    for (i = 0; i < CPU_FIELDS; i++) {
+	series_set_column(&CPU, i, CPU_Fields[i]);
+    }
+    procfs_open(&Proc, "/proc/stat");
     AddFunction("proc_stat", -1, my_proc_stat);
-    AddFunction("proc_stat::cpu", 2, my_cpu);
+    AddFunction("proc_stat::cpu", -1, my_cpu);
     AddFunction("proc_stat::disk", 3, my_disk);
     return 0;
 }
 
 void plugin_exit_proc_stat(void)
 {
-    if (stream != NULL) {
-	fclose(stream);
-	stream = NULL;
-    }
+    procfs_close(&Proc);
+    series_destroy(&CPU);
     hash_destroy(&Stat);
 }
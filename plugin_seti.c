@@ -49,6 +49,7 @@
 #include "plugin.h"
 #include "hash.h"
 #include "cfg.h"
+#include "filecache.h"
 
 #define SECTION   "Plugin:Seti"
 #define DIRKEY    "Directory"
@@ -60,18 +61,14 @@ static int fatal = 0;
 static int parse_seti(void)
 {
     static char fn[256] = "";
-    FILE *stream;
-    int age;
+    static int file = -1;
+    static int generation = 0;
+    int n, current;
 
     /* if a fatal error occurred, do nothing */
     if (fatal != 0)
 	return -1;
 
-    /* reread every 100 msec only */
-    age = hash_age(&SETI, NULL);
-    if (age > 0 && age <= 100)
-	return 0;
-
     if (fn[0] == '\0') {
 	char *dir = cfg_get(SECTION, DIRKEY, NULL);
 	if (dir == NULL || *dir == '\0') {
@@ -90,18 +87,21 @@ static int parse_seti(void)
 	    strcat(fn, "/");
 	strcat(fn, STATEFILE);
 	free(dir);
+	file = filecache_open(fn);
     }
 
-    stream = fopen(fn, "r");
-    if (stream == NULL) {
-	error("fopen(%s) failed: %s", fn, strerror(errno));
+    /* parse again only if the file has changed */
+    current = filecache_read(file);
+    if (current < 0)
 	return -1;
-    }
+    if (current == generation)
+	return 0;
+    generation = current;
 
-    while (!feof(stream)) {
+    for (n = 1; n <= filecache_lines(file); n++) {
 	char buffer[256];
 	char *c, *key, *val;
-	fgets(buffer, sizeof(buffer), stream);
+	snprintf(buffer, sizeof(buffer), "%s", filecache_line(file, n));
 	c = strchr(buffer, '=');
 	if (c == NULL)
 	    continue;
@@ -125,8 +125,6 @@ static int parse_seti(void)
 	hash_put(&SETI, key, val);
     }
 
-    fclose(stream);
-
     return 0;
 }
 
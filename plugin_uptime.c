@@ -46,6 +46,7 @@
 #include <fcntl.h>
 
 #include "debug.h"
+#include "timer.h"
 #include "plugin.h"
 
 static int fd = -2;
@@ -199,7 +200,7 @@ static void my_uptime(RESULT * result, const int argc, RESULT * argv[])
 	return;
     }
 
-    gettimeofday(&now, NULL);
+    timer_now(&now);
 
     age = (now.tv_sec - last_value.tv_sec) * 1000 + (now.tv_usec - last_value.tv_usec) / 1000;
     /* reread every 100 msec only */
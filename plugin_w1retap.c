@@ -50,6 +50,7 @@
 
 #include "debug.h"
 #include "plugin.h"
+#include "filecache.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -61,56 +62,38 @@
 
 static void my_readkey(RESULT * result, RESULT * arg1, RESULT * arg2)
 {
-    char value[80], val2[80];
-    FILE *fp;
-    char *reqkey, *pval;
+    char value[80];
+    char *reqkey, *line;
     size_t size;
+    int file, n;
 
     *value = 0;
-    pval = value;
 
     reqkey = R2S(arg2);
-    fp = fopen(R2S(arg1), "r");
+    file = filecache_open(R2S(arg1));
 
-    if (!fp) {
-	error("w1retap couldn't open file '%s'", R2S(arg1));
-	value[0] = '\0';
-    } else {
+    if (filecache_read(file) >= 0) {
 	size = strlen(reqkey);
-	while (!feof(fp) && pval == value) {
-	    fgets(val2, sizeof(val2), fp);
-	    if (*(val2 + size) == '=') {
-		if (strncmp(val2, reqkey, size) == 0) {
-		    char *p;
-		    p = index(val2, ' ');
-		    if (p == NULL) {
-			p = index(val2, '\n');
-		    }
-
-		    if (p) {
-			*p = 0;
-			pval = val2 + size + 1;
-			{
-			    double d;
-			    char *ep;
-			    d = strtod(pval, &ep);
-			    if (ep != pval && (*ep == 0 || isspace(*ep))) {
-				if (d > 500)
-				    sprintf(val2, "%.0f", d);
-				else
-				    sprintf(val2, "%.1f", d);
-				pval = val2;
-			    }
-			}
-		    }
+	for (n = 1; (line = filecache_line(file, n)) != NULL; n++) {
+	    if (strncmp(line, reqkey, size) == 0 && line[size] == '=') {
+		double d;
+		char *ep;
+		/* value ends at the first blank */
+		snprintf(value, sizeof(value), "%.*s", (int) strcspn(line + size + 1, " "), line + size + 1);
+		d = strtod(value, &ep);
+		if (ep != value && (*ep == 0 || isspace(*ep))) {
+		    if (d > 500)
+			snprintf(value, sizeof(value), "%.0f", d);
+		    else
+			snprintf(value, sizeof(value), "%.1f", d);
 		}
+		break;
 	    }
 	}
-	fclose(fp);
     }
 
     /* store result */
-    SetResult(&result, R_STRING, pval);
+    SetResult(&result, R_STRING, value);
 }
 
 
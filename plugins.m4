@@ -300,10 +300,12 @@ if test "$PLUGIN_CPUINFO" = "yes"; then
 fi
 
 #DBus
+DBUS_EVENT="no"
 if test "$PLUGIN_DBUS" = "yes"; then
    PKG_CHECK_MODULES(DBUS, dbus-1 >= 1.0.0, HAVE_DBUS="yes", HAVE_DBUS="no")
    if test "x$HAVE_DBUS" == "xyes"; then
       PLUGINS="$PLUGINS plugin_dbus.o"
+      DBUS_EVENT="yes"
       PLUGINLIBS="$PLUGINLIBS $DBUS_LIBS"
       CPPFLAGS="$CPPFLAGS $DBUS_CFLAGS"
       AC_DEFINE(PLUGIN_DBUS,1,[dbus plugin])
@@ -476,6 +478,7 @@ if test "$PLUGIN_MPRIS_DBUS" = "yes"; then
       AC_CHECK_LIB(dbus-1, dbus_bus_get, [has_libdbus1_lib="true"], [has_libdbus1_lib="false"])
       if test "$has_libdbus1_lib" = "true"; then
 	  PLUGINS="$PLUGINS plugin_mpris_dbus.o"
+	  DBUS_EVENT="yes"
 	  PLUGINLIBS="$PLUGINLIBS -ldbus-1"
 	  AC_DEFINE(PLUGIN_MPRIS_DBUS,1,[mpris_dbus plugin])
       else
@@ -487,6 +490,11 @@ if test "$PLUGIN_MPRIS_DBUS" = "yes"; then
 fi
 
 
+# D-Bus main loop integration, shared by the dbus plugins
+if test "$DBUS_EVENT" = "yes"; then
+   PLUGINS="$PLUGINS dbus_event.o"
+fi
+
 # MySQL
 if test "$PLUGIN_MYSQL" = "yes"; then
    AC_CHECK_HEADERS(mysql/mysql.h, [has_mysql_header="true"], [has_mysql_header="false"])
@@ -0,0 +1,224 @@
+/* $Id$
+ * $URL$
+ *
+ * single-syscall reader for /proc files
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/* 
+ * exported functions:
+ *
+ * void procfs_open (PROCFS *proc, char *path)
+ *   initializes a reader for the given file (the file is opened lazily)
+ *   With 'ProcRoot' set in the config, paths below /proc are read
+ *   from there instead, e.g. from a snapshot of another host for
+ *   benchmarking (lcd4linux -B).
+ *
+ * int procfs_read (PROCFS *proc)
+ *   reads the whole file into the reader's buffer with pread()
+ *   returns 0 on success, -1 on error
+ *
+ * char *procfs_line (PROCFS *proc)
+ *   returns the next line of the buffer, terminated in place
+ *   returns NULL if there are no more lines
+ *
+ * int procfs_split (char *line, char *delimiter, char **token, int max)
+ *   splits a line in place into at most max tokens
+ *   the rest of the line is left untouched after the last token
+ *   returns the number of tokens
+ *
+ * void procfs_close (PROCFS *proc)
+ *   closes the file and releases the buffer
+ *
+ */
+
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "debug.h"
+#include "cfg.h"
+#include "bench.h"
+#include "procfs.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+/* initial buffer size, doubled whenever a file does not fit */
+#define PROCFS_CHUNK 4096
+
+
+void procfs_open(PROCFS * proc, const char *path)
+{
+    char *root;
+
+    root = cfg_get(NULL, "ProcRoot", "");
+    if (*root != '\0' && strncmp(path, "/proc/", 6) == 0) {
+	proc->path = malloc(strlen(root) + strlen(path + 5) + 1);
+	strcpy(proc->path, root);
+	strcat(proc->path, path + 5);
+    } else {
+	proc->path = strdup(path);
+    }
+    free(root);
+
+    proc->stats = stats_register("procfs", proc->path);
+    proc->fd = -1;
+    proc->buffer = NULL;
+    proc->size = 0;
+    proc->len = 0;
+    proc->pos = NULL;
+}
+
+
+int procfs_read(PROCFS * proc)
+{
+    STATS_TIME t;
+    ssize_t len;
+    size_t total;
+
+    if (proc->fd < 0) {
+	proc->fd = open(proc->path, O_RDONLY);
+	if (proc->fd < 0) {
+	    error("open(%s) failed: %s", proc->path, strerror(errno));
+	    return -1;
+	}
+    }
+
+    if (proc->buffer == NULL) {
+	proc->buffer = malloc(PROCFS_CHUNK);
+	if (proc->buffer == NULL) {
+	    error("read(%s) failed: out of memory", proc->path);
+	    return -1;
+	}
+	proc->size = PROCFS_CHUNK;
+    }
+
+    /* seq_file based /proc files hand out (about) one page per */
+    /* read, so read on until EOF, growing the buffer as needed. */
+    /* The buffer is kept, so it grows only once per file. */
+    STATS_BENCH_BEGIN(t, BENCH_PROCFS);
+    total = 0;
+    while (1) {
+	if (total == proc->size - 1) {
+	    /* keep the old buffer if it cannot grow */
+	    char *buffer = realloc(proc->buffer, 2 * proc->size);
+	    if (buffer == NULL) {
+		STATS_BENCH_END(proc->stats, t, BENCH_PROCFS);
+		error("read(%s) failed: out of memory", proc->path);
+		return -1;
+	    }
+	    proc->buffer = buffer;
+	    proc->size *= 2;
+	}
+	len = pread(proc->fd, proc->buffer + total, proc->size - 1 - total, total);
+	if (len < 0 && errno == EINTR)
+	    continue;
+	if (len < 0) {
+	    STATS_BENCH_END(proc->stats, t, BENCH_PROCFS);
+	    error("pread(%s) failed: %s", proc->path, strerror(errno));
+	    return -1;
+	}
+	if (len == 0)
+	    break;
+	total += len;
+    }
+    STATS_BENCH_END(proc->stats, t, BENCH_PROCFS);
+    stats_count(proc->stats, total);
+
+    proc->buffer[total] = '\0';
+    proc->len = total;
+    proc->pos = proc->buffer;
+
+    return 0;
+}
+
+
+char *procfs_line(PROCFS * proc)
+{
+    char *line, *end;
+
+    line = proc->pos;
+    if (line == NULL || line >= proc->buffer + proc->len)
+	return NULL;
+
+    end = memchr(line, '\n', proc->buffer + proc->len - line);
+    if (end != NULL) {
+	*end = '\0';
+	proc->pos = end + 1;
+    } else {
+	proc->pos = proc->buffer + proc->len;
+    }
+
+    return line;
+}
+
+
+int procfs_split(char *line, const char *delimiter, char **token, const int max)
+{
+    char *beg, *end;
+    int n;
+
+    beg = line;
+    for (n = 0; n < max; n++) {
+	beg += strspn(beg, delimiter);
+	if (*beg == '\0')
+	    break;
+	token[n] = beg;
+	end = beg + strcspn(beg, delimiter);
+	if (*end == '\0') {
+	    n++;
+	    break;
+	}
+	*end = '\0';
+	beg = end + 1;
+    }
+
+    return n;
+}
+
+
+void procfs_close(PROCFS * proc)
+{
+    if (proc->fd >= 0) {
+	close(proc->fd);
+	proc->fd = -1;
+    }
+    if (proc->buffer) {
+	free(proc->buffer);
+	proc->buffer = NULL;
+    }
+    if (proc->path) {
+	free(proc->path);
+	proc->path = NULL;
+    }
+    proc->size = 0;
+    proc->len = 0;
+    proc->pos = NULL;
+    proc->stats = -1;
+}
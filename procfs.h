@@ -0,0 +1,49 @@
+/* $Id$
+ * $URL$
+ *
+ * single-syscall reader for /proc files
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef _PROCFS_H_
+#define _PROCFS_H_
+
+/* size_t */
+#include <stdio.h>
+
+typedef struct {
+    char *path;
+    int fd;
+    char *buffer;
+    size_t size;
+    size_t len;
+    char *pos;
+    int stats;			/* STATS slot */
+} PROCFS;
+
+void procfs_open(PROCFS * proc, const char *path);
+int procfs_read(PROCFS * proc);
+char *procfs_line(PROCFS * proc);
+int procfs_split(char *line, const char *delimiter, char **token, const int max);
+void procfs_close(PROCFS * proc);
+
+#endif
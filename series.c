@@ -0,0 +1,376 @@
+/* $Id$
+ * $URL$
+ *
+ * columnar time series of numeric counters
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/* 
+ * A series holds a ring of samples. Each sample is a contiguous
+ * row x column matrix of counters (e.g. one row per CPU or per
+ * network interface), so rates can be computed for all rows at
+ * once with a single pass over two samples.
+ *
+ * exported functions:
+ *
+ * void series_create (SERIES *Series, int nColumns)
+ *   initializes a series with nColumns counters per row
+ *
+ * void series_set_column (SERIES *Series, int column, char *name)
+ *   names a column
+ *
+ * int series_column (SERIES *Series, char *name)
+ *   returns the number of a named column, or -1
+ *
+ * int series_row (SERIES *Series, char *name)
+ *   returns the number of a row, or -1
+ *
+ * int series_add_row (SERIES *Series, char *name)
+ *   returns the number of a row, adding it if necessary
+ *
+ * int series_age (SERIES *Series)
+ *   returns the age of the latest sample in milliseconds
+ *
+ * double *series_begin (SERIES *Series)
+ *   starts a new sample, which is initialized with the previous one
+ *
+ * void series_set (SERIES *Series, int row, int column, double value)
+ *   sets a counter of the current sample
+ *
+ * double series_get (SERIES *Series, int row, int column)
+ *   returns a counter of the current sample
+ *
+ * double *series_get_delta (SERIES *Series, int delay)
+ *   returns the rates per second of all counters over delay
+ *   milliseconds. The array is computed once per sample and delay.
+ *   Returns NULL if there are not enough samples yet.
+ *
+ * void series_destroy (SERIES *Series)
+ *   releases a series
+ *
+ */
+
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+#include "timer.h"
+#include "series.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+/* number of samples for delta processing */
+#define SERIES_SLOTS 64
+
+/* rows are allocated in chunks */
+#define SERIES_CHUNK 8
+
+
+#define SAMPLE(S, slot) ((S)->Data + (size_t) (slot) * (S)->maxRows * (S)->nColumns)
+
+
+void series_create(SERIES * Series, const int nColumns)
+{
+    Series->nSlot = SERIES_SLOTS;
+    Series->index = 0;
+    Series->seq = 0;
+
+    Series->nRows = 0;
+    Series->maxRows = 0;
+    Series->Rows = NULL;
+    Series->Born = NULL;
+
+    Series->nColumns = nColumns;
+    Series->Columns = calloc(nColumns, sizeof(char *));
+
+    Series->Time = calloc(Series->nSlot, sizeof(struct timeval));
+    Series->Seq = calloc(Series->nSlot, sizeof(unsigned long));
+    Series->Data = NULL;
+
+    Series->nDelta = 0;
+    Series->Delta = NULL;
+}
+
+
+void series_set_column(SERIES * Series, const int column, const char *name)
+{
+    if (column < 0 || column >= Series->nColumns)
+	return;
+
+    if (Series->Columns[column])
+	free(Series->Columns[column]);
+    Series->Columns[column] = strdup(name);
+}
+
+
+int series_column(SERIES * Series, const char *name)
+{
+    int i;
+
+    if (name == NULL)
+	return -1;
+
+    for (i = 0; i < Series->nColumns; i++) {
+	if (Series->Columns[i] && strcasecmp(name, Series->Columns[i]) == 0)
+	    return i;
+    }
+    return -1;
+}
+
+
+int series_row(SERIES * Series, const char *name)
+{
+    int i;
+
+    if (name == NULL)
+	return -1;
+
+    for (i = 0; i < Series->nRows; i++) {
+	if (strcmp(name, Series->Rows[i]) == 0)
+	    return i;
+    }
+    return -1;
+}
+
+
+/* enlarge every sample to hold maxRows rows */
+static void series_grow(SERIES * Series, const int maxRows)
+{
+    size_t old, new;
+    int i, slot;
+
+    old = (size_t) Series->maxRows * Series->nColumns;
+    new = (size_t) maxRows * Series->nColumns;
+
+    Series->Data = realloc(Series->Data, Series->nSlot * new * sizeof(double));
+
+    /* move samples to their new position, last one first */
+    for (slot = Series->nSlot - 1; slot >= 0; slot--) {
+	memmove(Series->Data + slot * new, Series->Data + slot * old, old * sizeof(double));
+	memset(Series->Data + slot * new + old, 0, (new - old) * sizeof(double));
+    }
+
+    for (i = 0; i < Series->nDelta; i++) {
+	Series->Delta[i].rate = realloc(Series->Delta[i].rate, new * sizeof(double));
+	Series->Delta[i].seq = 0;
+    }
+
+    Series->Rows = realloc(Series->Rows, maxRows * sizeof(char *));
+    Series->Born = realloc(Series->Born, maxRows * sizeof(unsigned long));
+    Series->maxRows = maxRows;
+}
+
+
+int series_add_row(SERIES * Series, const char *name)
+{
+    int row;
+
+    row = series_row(Series, name);
+    if (row >= 0)
+	return row;
+
+    if (Series->nRows >= Series->maxRows)
+	series_grow(Series, Series->maxRows + SERIES_CHUNK);
+
+    row = Series->nRows++;
+    Series->Rows[row] = strdup(name);
+    /* samples taken before this row appeared do not count */
+    Series->Born[row] = Series->seq;
+
+    return row;
+}
+
+
+int series_age(SERIES * Series)
+{
+    struct timeval now, *timestamp;
+
+    if (Series->seq == 0)
+	return -1;
+
+    timestamp = &(Series->Time[Series->index]);
+    timer_now(&now);
+
+    return (now.tv_sec - timestamp->tv_sec) * 1000 + (now.tv_usec - timestamp->tv_usec) / 1000;
+}
+
+
+double *series_begin(SERIES * Series)
+{
+    int prev;
+
+    prev = Series->index;
+    if (++Series->index >= Series->nSlot)
+	Series->index = 0;
+
+    /* rows missing from the new sample keep their last value */
+    if (Series->Data != NULL && Series->seq > 0)
+	memcpy(SAMPLE(Series, Series->index), SAMPLE(Series, prev),
+	       (size_t) Series->maxRows * Series->nColumns * sizeof(double));
+
+    Series->seq++;
+    Series->Seq[Series->index] = Series->seq;
+    timer_now(&(Series->Time[Series->index]));
+
+    return SAMPLE(Series, Series->index);
+}
+
+
+void series_set(SERIES * Series, const int row, const int column, const double value)
+{
+    if (row < 0 || row >= Series->nRows || column < 0 || column >= Series->nColumns)
+	return;
+
+    SAMPLE(Series, Series->index)[row * Series->nColumns + column] = value;
+}
+
+
+double series_get(SERIES * Series, const int row, const int column)
+{
+    if (row < 0 || row >= Series->nRows || column < 0 || column >= Series->nColumns)
+	return 0.0;
+
+    return SAMPLE(Series, Series->index)[row * Series->nColumns + column];
+}
+
+
+/* compute the rates of all counters between the current sample */
+/* and the latest one which is at least 'delay' msec older */
+static int series_delta(SERIES * Series, const int delay, double *rate)
+{
+    struct timeval *now, end;
+    double *v1, *v2;
+    double dt, dv;
+    int i, n, slot, row, col;
+
+    now = &(Series->Time[Series->index]);
+    end.tv_sec = now->tv_sec;
+    end.tv_usec = now->tv_usec - 1000 * delay;
+    while (end.tv_usec < 0) {
+	end.tv_sec--;
+	end.tv_usec += 1000000;
+    }
+
+    /* search delta slot */
+    slot = Series->index;
+    for (i = 1; i < Series->nSlot; i++) {
+	slot = (Series->index - i + Series->nSlot) % Series->nSlot;
+	if (Series->Seq[slot] == 0)
+	    break;
+	if (timercmp(&(Series->Time[slot]), &end, <))
+	    break;
+    }
+
+    /* empty slot => try the one before */
+    if (Series->Seq[slot] == 0) {
+	i--;
+	slot = (Series->index - i + Series->nSlot) % Series->nSlot;
+    }
+
+    /* not enough slots available... */
+    if (i == 0)
+	return -1;
+
+    dt = (now->tv_sec - Series->Time[slot].tv_sec) + (now->tv_usec - Series->Time[slot].tv_usec) / 1000000.0;
+
+    v1 = SAMPLE(Series, Series->index);
+    v2 = SAMPLE(Series, slot);
+    n = Series->nColumns;
+
+    for (row = 0; row < Series->nRows; row++) {
+	int valid = (dt > 0.0 && Series->Seq[slot] >= Series->Born[row]);
+	for (col = 0; col < n; col++) {
+	    dv = v1[row * n + col] - v2[row * n + col];
+	    rate[row * n + col] = (valid && dv >= 0.0) ? dv / dt : 0.0;
+	}
+    }
+
+    return 0;
+}
+
+
+double *series_get_delta(SERIES * Series, const int delay)
+{
+    SERIES_DELTA *Delta = NULL;
+    int i;
+
+    if (Series->seq == 0 || Series->nRows == 0)
+	return NULL;
+
+    for (i = 0; i < Series->nDelta; i++) {
+	if (Series->Delta[i].delay == delay) {
+	    Delta = &(Series->Delta[i]);
+	    break;
+	}
+    }
+
+    if (Delta == NULL) {
+	Series->nDelta++;
+	Series->Delta = realloc(Series->Delta, Series->nDelta * sizeof(SERIES_DELTA));
+	Delta = &(Series->Delta[Series->nDelta - 1]);
+	Delta->delay = delay;
+	Delta->seq = 0;
+	Delta->rate = malloc((size_t) Series->maxRows * Series->nColumns * sizeof(double));
+    }
+
+    /* already computed for this sample */
+    if (Delta->seq == Series->seq)
+	return Delta->rate;
+
+    if (series_delta(Series, delay, Delta->rate) < 0)
+	return NULL;
+
+    Delta->seq = Series->seq;
+    return Delta->rate;
+}
+
+
+void series_destroy(SERIES * Series)
+{
+    int i;
+
+    for (i = 0; i < Series->nRows; i++) {
+	free(Series->Rows[i]);
+    }
+    for (i = 0; i < Series->nColumns; i++) {
+	if (Series->Columns[i])
+	    free(Series->Columns[i]);
+    }
+    for (i = 0; i < Series->nDelta; i++) {
+	free(Series->Delta[i].rate);
+    }
+
+    free(Series->Rows);
+    free(Series->Born);
+    free(Series->Columns);
+    free(Series->Time);
+    free(Series->Seq);
+    free(Series->Data);
+    free(Series->Delta);
+
+    memset(Series, 0, sizeof(SERIES));
+}
@@ -0,0 +1,76 @@
+/* $Id$
+ * $URL$
+ *
+ * columnar time series of numeric counters
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef _SERIES_H_
+#define _SERIES_H_
+
+/* struct timeval */
+#include <sys/time.h>
+
+
+typedef struct {
+    int delay;
+    unsigned long seq;
+    double *rate;
+} SERIES_DELTA;
+
+typedef struct {
+    int nSlot;
+    int index;
+    unsigned long seq;
+    int nRows;
+    int maxRows;
+    char **Rows;
+    unsigned long *Born;
+    int nColumns;
+    char **Columns;
+    struct timeval *Time;
+    unsigned long *Seq;
+    double *Data;
+    int nDelta;
+    SERIES_DELTA *Delta;
+} SERIES;
+
+
+void series_create(SERIES * Series, const int nColumns);
+void series_set_column(SERIES * Series, const int column, const char *name);
+int series_column(SERIES * Series, const char *name);
+
+int series_row(SERIES * Series, const char *name);
+int series_add_row(SERIES * Series, const char *name);
+
+int series_age(SERIES * Series);
+
+double *series_begin(SERIES * Series);
+void series_set(SERIES * Series, const int row, const int column, const double value);
+
+double series_get(SERIES * Series, const int row, const int column);
+double *series_get_delta(SERIES * Series, const int delay);
+
+void series_destroy(SERIES * Series);
+
+
+#endif
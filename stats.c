@@ -0,0 +1,430 @@
+/* $Id$
+ * $URL$
+ *
+ * lightweight run-time statistics (counters and latency histograms)
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/* 
+ * Every instrumented code path (main loop stages, evaluator functions,
+ * widget classes, display drivers) owns a STATS slot, identified by a
+ * small integer returned from stats_register(). Timing costs two
+ * clock_gettime(CLOCK_MONOTONIC) calls and a few additions, so the
+ * statistics are always enabled.
+ *
+ * The statistics are dumped on SIGUSR1 and optionally every
+ * 'Stats.Interval' msec. The dump goes to 'Stats.Output' (a regular
+ * file or a FIFO) if set, or to the log otherwise.
+ *
+ * exported functions:
+ *
+ * STATS_TIME stats_now (void)
+ *   returns a monotonic timestamp in nanoseconds
+ *
+ * int stats_register (char *prefix, char *name)
+ *   returns the slot for 'prefix:name' (or 'prefix' if name is NULL),
+ *   creating it if necessary
+ *
+ * void stats_add (int id, STATS_TIME start)
+ *   accounts one call started at 'start' (use STATS_BEGIN/STATS_END)
+ *
+ * void stats_time (int id, STATS_TIME t)
+ *   accounts one call which took 't' nanoseconds
+ *
+ * void stats_count (int id, long n)
+ *   adds n to the counter (e.g. bytes written) of a slot
+ *
+ * int stats_init (void)
+ *   reads the config, installs the SIGUSR1 handler and
+ *   adds the stats:: functions to the evaluator
+ *
+ * void stats_dump (void)
+ *   writes all statistics to the output or the log
+ *
+ * void stats_exit (void)
+ *   releases all resources
+ *
+ */
+
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+
+#include "debug.h"
+#include "cfg.h"
+#include "qprintf.h"
+#include "timer.h"
+#include "event.h"
+#include "plugin.h"
+#include "stats.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+#define STATS_CHUNK 16
+
+static STATS *Stats = NULL;
+static int nStats = 0;
+static int maxStats = 0;
+
+static char *Output = NULL;
+static int Pipe[2] = { -1, -1 };
+
+
+STATS_TIME stats_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (STATS_TIME) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+
+static int stats_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < nStats; i++) {
+	if (strcmp(Stats[i].name, name) == 0)
+	    return i;
+    }
+
+    return -1;
+}
+
+
+int stats_register(const char *prefix, const char *name)
+{
+    char key[64];
+    int id;
+
+    if (name == NULL)
+	qprintf(key, sizeof(key), "%s", prefix);
+    else
+	qprintf(key, sizeof(key), "%s:%s", prefix, name);
+
+    id = stats_find(key);
+    if (id >= 0)
+	return id;
+
+    if (nStats >= maxStats) {
+	STATS *tmp = realloc(Stats, (maxStats + STATS_CHUNK) * sizeof(STATS));
+	if (tmp == NULL) {
+	    error("stats: realloc() failed: %s", strerror(errno));
+	    return -1;
+	}
+	Stats = tmp;
+	maxStats += STATS_CHUNK;
+    }
+
+    id = nStats++;
+    memset(&Stats[id], 0, sizeof(STATS));
+    Stats[id].name = strdup(key);
+
+    return id;
+}
+
+
+void stats_add(const int id, const STATS_TIME start)
+{
+    stats_time(id, stats_now() - start);
+}
+
+
+void stats_time(const int id, const STATS_TIME t)
+{
+    STATS *S;
+    unsigned long long usec;
+    int bucket;
+
+    /* slots are gone after stats_exit() */
+    if (id < 0 || id >= nStats)
+	return;
+
+    S = &Stats[id];
+    usec = t / 1000;
+
+    S->count++;
+    S->total += t;
+    if (t > S->max)
+	S->max = t;
+
+    /* bucket n holds durations from 2^(n-1) to 2^n usec */
+    bucket = usec ? 64 - __builtin_clzll(usec) : 0;
+    if (bucket >= STATS_BUCKETS)
+	bucket = STATS_BUCKETS - 1;
+    S->hist[bucket]++;
+}
+
+
+void stats_count(const int id, const long n)
+{
+    if (id >= 0 && id < nStats)
+	Stats[id].sum += n;
+}
+
+
+/* upper bound of the given percentile in usec */
+static double stats_percentile(const STATS * S, const double p)
+{
+    unsigned long sum, limit;
+    double bound;
+    int i;
+
+    if (S->count == 0)
+	return 0.0;
+
+    limit = S->count * p / 100.0;
+    sum = 0;
+    for (i = 0; i < STATS_BUCKETS - 1; i++) {
+	sum += S->hist[i];
+	if (sum > limit)
+	    break;
+    }
+
+    /* the last bucket is open-ended, and no bound exceeds the maximum */
+    bound = (double) (1ULL << i);
+    if (i == STATS_BUCKETS - 1 || bound > S->max / 1000.0)
+	bound = S->max / 1000.0;
+
+    return bound;
+}
+
+
+static int stats_format(char *buffer, const int size, const STATS * S)
+{
+    int len;
+
+    len = snprintf(buffer, size, "%-32s %10lu %10.1f %10.1f %10.1f %10.1f %12llu", S->name, S->count,
+		   S->count ? S->total / 1000.0 / S->count : 0.0, S->max / 1000.0,
+		   stats_percentile(S, 50), stats_percentile(S, 99), S->sum);
+
+    return len < size ? len : size - 1;
+}
+
+
+void stats_dump(void)
+{
+    static char header[] = "name                                  count    avg/us    max/us    p50/us    p99/us          sum";
+    char line[160];
+    char *buffer;
+    int fd, i, len;
+
+    if (Output == NULL) {
+	message(0, "stats: %s", header);
+	for (i = 0; i < nStats; i++) {
+	    if (Stats[i].count == 0 && Stats[i].sum == 0)
+		continue;
+	    stats_format(line, sizeof(line), &Stats[i]);
+	    message(0, "stats: %s", line);
+	}
+	return;
+    }
+
+    /* collect everything for a single write() */
+    buffer = malloc((nStats + 1) * sizeof(line));
+    if (buffer == NULL) {
+	error("stats: malloc() failed: %s", strerror(errno));
+	return;
+    }
+    len = snprintf(buffer, sizeof(line), "%s\n", header);
+    for (i = 0; i < nStats; i++) {
+	/* skip unused slots */
+	if (Stats[i].count == 0 && Stats[i].sum == 0)
+	    continue;
+	len += stats_format(buffer + len, sizeof(line) - 1, &Stats[i]);
+	buffer[len++] = '\n';
+    }
+
+    /* a FIFO without a reader fails with ENXIO: nobody is listening */
+    fd = open(Output, O_WRONLY | O_NONBLOCK | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+	if (errno != ENXIO)
+	    error("stats: open(%s) failed: %s", Output, strerror(errno));
+    } else {
+	if (write(fd, buffer, len) < 0 && errno != EAGAIN && errno != EPIPE)
+	    error("stats: write(%s) failed: %s", Output, strerror(errno));
+	close(fd);
+    }
+
+    free(buffer);
+}
+
+
+static void stats_timer( __attribute__ ((unused))
+			void *notused)
+{
+    stats_dump();
+}
+
+
+static void stats_signal( __attribute__ ((unused))
+			 int signum)
+{
+    int saved = errno;
+    char c = 0;
+
+    /* defer the dump to the main loop */
+    if (write(Pipe[1], &c, 1) < 0) {
+	/* pipe full: a dump is pending anyway */
+    }
+
+    errno = saved;
+}
+
+
+static void stats_event( __attribute__ ((unused))
+			event_flags_t flags, __attribute__ ((unused))
+			void *data)
+{
+    char buffer[16];
+
+    while (read(Pipe[0], buffer, sizeof(buffer)) > 0);
+
+    stats_dump();
+}
+
+
+static const STATS *stats_lookup(RESULT * arg)
+{
+    int id = stats_find(R2S(arg));
+
+    return id < 0 ? NULL : &Stats[id];
+}
+
+
+static void my_count(RESULT * result, RESULT * arg1)
+{
+    const STATS *S = stats_lookup(arg1);
+    double value = S ? S->count : 0.0;
+
+    SetResult(&result, R_NUMBER, &value);
+}
+
+
+static void my_sum(RESULT * result, RESULT * arg1)
+{
+    const STATS *S = stats_lookup(arg1);
+    double value = S ? S->sum : 0.0;
+
+    SetResult(&result, R_NUMBER, &value);
+}
+
+
+static void my_avg(RESULT * result, RESULT * arg1)
+{
+    const STATS *S = stats_lookup(arg1);
+    double value = (S && S->count) ? S->total / 1000.0 / S->count : 0.0;
+
+    SetResult(&result, R_NUMBER, &value);
+}
+
+
+static void my_max(RESULT * result, RESULT * arg1)
+{
+    const STATS *S = stats_lookup(arg1);
+    double value = S ? S->max / 1000.0 : 0.0;
+
+    SetResult(&result, R_NUMBER, &value);
+}
+
+
+static void my_percentile(RESULT * result, RESULT * arg1, RESULT * arg2)
+{
+    const STATS *S = stats_lookup(arg1);
+    double value = S ? stats_percentile(S, R2N(arg2)) : 0.0;
+
+    SetResult(&result, R_NUMBER, &value);
+}
+
+
+int stats_init(void)
+{
+    int interval;
+
+    Output = cfg_get("Stats", "Output", NULL);
+    if (Output != NULL && *Output == '\0') {
+	free(Output);
+	Output = NULL;
+    }
+
+    /* a FIFO reader going away must not kill us */
+    if (Output != NULL)
+	signal(SIGPIPE, SIG_IGN);
+
+    cfg_number("Stats", "Interval", 0, 0, -1, &interval);
+    if (interval > 0) {
+	timer_add(stats_timer, NULL, interval, 0);
+    }
+
+    if (pipe(Pipe) < 0) {
+	error("stats: pipe() failed: %s", strerror(errno));
+    } else {
+	fcntl(Pipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(Pipe[1], F_SETFL, O_NONBLOCK);
+	event_add(stats_event, NULL, Pipe[0], 1, 0, 1);
+	signal(SIGUSR1, stats_signal);
+    }
+
+    AddFunction("stats::count", 1, my_count);
+    AddFunction("stats::sum", 1, my_sum);
+    AddFunction("stats::avg", 1, my_avg);
+    AddFunction("stats::max", 1, my_max);
+    AddFunction("stats::percentile", 2, my_percentile);
+
+    return 0;
+}
+
+
+void stats_exit(void)
+{
+    int i;
+
+    signal(SIGUSR1, SIG_DFL);
+    if (Pipe[0] >= 0) {
+	event_del(Pipe[0]);
+	close(Pipe[0]);
+	close(Pipe[1]);
+	Pipe[0] = Pipe[1] = -1;
+    }
+
+    for (i = 0; i < nStats; i++) {
+	free(Stats[i].name);
+    }
+    free(Stats);
+    Stats = NULL;
+    nStats = maxStats = 0;
+
+    if (Output) {
+	free(Output);
+	Output = NULL;
+    }
+}
@@ -0,0 +1,57 @@
+/* $Id$
+ * $URL$
+ *
+ * lightweight run-time statistics (counters and latency histograms)
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+/* latency histogram: bucket n counts durations below 2^n usec */
+#define STATS_BUCKETS 24
+
+typedef unsigned long long STATS_TIME;
+
+typedef struct {
+    char *name;
+    unsigned long count;
+    STATS_TIME total;		/* nanoseconds */
+    STATS_TIME max;		/* nanoseconds */
+    unsigned long long sum;	/* counter, e.g. bytes written */
+    unsigned long hist[STATS_BUCKETS];
+} STATS;
+
+/* time a code path: STATS_BEGIN(t); ...; STATS_END(id, t); */
+#define STATS_BEGIN(t) do { (t) = stats_now(); } while (0)
+#define STATS_END(id, t) do { if ((id) >= 0) stats_add(id, t); } while (0)
+
+STATS_TIME stats_now(void);
+int stats_register(const char *prefix, const char *name);
+void stats_add(const int id, const STATS_TIME start);
+void stats_time(const int id, const STATS_TIME t);
+void stats_count(const int id, const long n);
+int stats_init(void);
+void stats_dump(void);
+void stats_exit(void);
+
+#endif
@@ -53,6 +53,23 @@
  *
  *   Release all timers and free the associated memory block.
  *
+ *
+ * void timer_simulate(void)
+ *
+ *   Switch the timer queue to a simulated clock which jumps to the
+ *   next upcoming timer instead of waiting for it (benchmark mode).
+ *
+ *
+ * int timer_simulated(void)
+ *
+ *   Return the simulated time in milliseconds since timer_simulate().
+ *
+ *
+ * void timer_now(struct timeval *now)
+ *
+ *   Get the current time, from the simulated clock in benchmark mode.
+ *   Everything measuring ages or rates must use this clock.
+ *
  */
 
 
@@ -67,6 +84,7 @@
 #include "debug.h"
 #include "cfg.h"
 #include "timer.h"
+#include "drv.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -98,6 +116,10 @@ typedef struct TIMER {
        it is deleted (value of 0) or only once (all other values) */
     int one_shot;
 
+    /* display which was selected when the timer was added (or -1);
+       it will be selected again before the callback is called */
+    int display;
+
     /* marks timer as being active (so it will get processed) or
        inactive (which means the timer has been deleted and its
        allocated memory may be re-used) */
@@ -110,6 +132,26 @@ int nTimers = 0;
 /* pointer to memory allocated for storing the timer slots */
 TIMER *Timers = NULL;
 
+/* simulated clock (benchmark mode): current and starting time */
+static int simulate = 0;
+static struct timeval sim_now, sim_start;
+
+
+void timer_now(struct timeval *now)
+/*  Get the current time, either from the system or from the
+    simulated clock.
+
+	now (timeval pointer): struct receiving the current time
+
+	return value: void
+ */
+{
+    if (simulate)
+	*now = sim_now;
+    else
+	gettimeofday(now, NULL);
+}
+
 
 static void timer_inc(const int timer, struct timeval *now)
 /*  Update the time a given timer updates next.
@@ -250,7 +292,7 @@ int timer_add(void (*callback) (void *data), void *data, const int interval, con
     }
 
     /* get current time so the timer triggers immediately */
-    gettimeofday(&now, NULL);
+    timer_now(&now);
 
     /* initialize timer data */
     Timers[timer].callback = callback;
@@ -258,6 +300,7 @@ int timer_add(void (*callback) (void *data), void *data, const int interval, con
     Timers[timer].when = now;
     Timers[timer].interval = interval;
     Timers[timer].one_shot = one_shot;
+    Timers[timer].display = drv_current();
 
     /* set timer to active so that it is processed and not overwritten
        by the memory optimization routine above */
@@ -301,7 +344,7 @@ int timer_add_late(void (*callback) (void *data), void *data, const int interval
     /* create new timer slot and add it to the timer queue; mask it as
        one-shot timer for now, so the timer will be delayed by a
        single timer interval */
-    if (!timer_add(callback, data, interval, 1)) {
+    if (timer_add(callback, data, interval, 1) < 0) {
 	/* signal unsuccessful timer creation */
 	return -1;
     }
@@ -345,7 +388,7 @@ int timer_process(struct timespec *delay)
     struct timeval now;		/* struct to hold current time */
 
     /* get current time to check which timers need processing */
-    gettimeofday(&now, NULL);
+    timer_now(&now);
 
     /* sanity check; by now, at least one timer should be
        instantiated */
@@ -373,6 +416,7 @@ int timer_process(struct timespec *delay)
 	    /* if the timer's callback function has been set, call it and
 	       pass the corresponding data */
 	    if (Timers[timer].callback != NULL) {
+		drv_select(Timers[timer].display);
 		Timers[timer].callback(Timers[timer].data);
 	    }
 
@@ -422,7 +466,7 @@ int timer_process(struct timespec *delay)
 
     /* processing all the timers might have taken a while, so update
        the current time to compensate for processing delay */
-    gettimeofday(&now, NULL);
+    timer_now(&now);
 
     struct timeval diff;	/* struct holding the time difference
 				   between current time and the triggering time of the
@@ -475,6 +519,13 @@ int timer_process(struct timespec *delay)
 	}
     }
 
+    /* with a simulated clock, jump to the next upcoming timer event
+       right away instead of waiting for it */
+    if (simulate) {
+	timeradd(&sim_now, &diff, &sim_now);
+	timerclear(&diff);
+    }
+
     /* set timespec "delay" passed by calling function to "diff" */
     delay->tv_sec = diff.tv_sec;
     /* timespec uses nanoseconds instead of microseconds!!! */
@@ -500,3 +551,32 @@ void timer_exit(void)
 	Timers = NULL;
     }
 }
+
+
+void timer_simulate(void)
+/*  Switch to a simulated clock, starting at the current time. From now
+	on, timer_process() advances the clock to the next upcoming timer
+	event and returns a zero delay, so the main loop runs as fast as
+	possible.
+
+	return value: void
+*/
+{
+    gettimeofday(&sim_now, NULL);
+    sim_start = sim_now;
+    simulate = 1;
+}
+
+
+int timer_simulated(void)
+/*  Return the simulated time elapsed since timer_simulate().
+
+	return value (integer): simulated time in milliseconds
+*/
+{
+    struct timeval diff;
+
+    timersub(&sim_now, &sim_start, &diff);
+
+    return diff.tv_sec * 1000 + diff.tv_usec / 1000;
+}
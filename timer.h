@@ -32,6 +32,7 @@
 #define TIMER_INACTIVE  0
 
 #include <time.h>
+#include <sys/time.h>
 
 int timer_add(void (*callback) (void *data), void *data, const int interval, const int one_shot);
 
@@ -43,4 +44,10 @@ int timer_remove(void (*callback) (void *data), void *data);
 
 void timer_exit(void);
 
+void timer_simulate(void);
+
+int timer_simulated(void);
+
+void timer_now(struct timeval *now);
+
 #endif
@@ -67,6 +67,8 @@
 #include "cfg.h"
 #include "timer.h"
 #include "timer_group.h"
+#include "drv.h"
+#include "bench.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -112,6 +114,10 @@ typedef struct TIMER_GROUP_WIDGET {
        it is deleted (value of 0) or only once (all other values) */
     int one_shot;
 
+    /* display the widget belongs to (i.e. the display which was
+       selected when the widget slot was added, or -1) */
+    int display;
+
     /* marks timer as being active (so it will get processed) or
        inactive (which means the timer has been deleted and its
        allocated memory may be re-used) */
@@ -362,8 +368,12 @@ void timer_process_group(void *data)
 	if (TimerGroupWidgets[widget].interval == interval) {
 	    /* if the widget's callback function has been set, call it and
 	       pass the corresponding data */
-	    if (TimerGroupWidgets[widget].callback != NULL)
+	    if (TimerGroupWidgets[widget].callback != NULL) {
+		drv_select(TimerGroupWidgets[widget].display);
+		BENCH_BEGIN(BENCH_UPDATE);
 		TimerGroupWidgets[widget].callback(TimerGroupWidgets[widget].data);
+		BENCH_END(BENCH_UPDATE);
+	    }
 
 	    /* mark one-shot widget as inactive (which means the it has
 	       been deleted and its allocated memory may be re-used) */
@@ -439,6 +449,7 @@ int timer_add_widget(void (*callback) (void *data), void *data, const int interv
     TimerGroupWidgets[widget].data = data;
     TimerGroupWidgets[widget].interval = interval;
     TimerGroupWidgets[widget].one_shot = one_shot;
+    TimerGroupWidgets[widget].display = drv_current();
 
     /* set widget slot to active so that it is processed and not
        overwritten by the memory optimization routine above */
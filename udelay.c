@@ -41,6 +41,13 @@
  *   This function does busy-waiting! so use only for delays smaller
  *   than 10 msec
  *
+ * unsigned long long nclock (void)
+ *   returns a monotonic time stamp in nanoseconds
+ *
+ * void ndelay_until (unsigned long long deadline)
+ *   waits until nclock() reaches deadline; sleeps for the longer part
+ *   of the wait, and busy-waits only for the last few microseconds
+ *
  */
 
 #include "config.h"
@@ -54,6 +61,7 @@
 #include <errno.h>
 #include <string.h>
 #include <sys/time.h>
+#include <time.h>
 
 
 #include "debug.h"
@@ -63,9 +71,33 @@
 
 
 
+/* how much longer than requested nanosleep() may take [nsec] */
+static unsigned long slack = 0;
+
+
 void udelay_init(void)
 {
+    struct timespec ts = { 0, 50000 };
+    unsigned long long t;
+    int i;
+
     info("udelay: using gettimeofday() delay loop");
+
+    if (slack > 0)
+	return;
+
+    /* calibrate the oversleep of a short nanosleep() */
+    for (i = 0; i < 4; i++) {
+	t = nclock();
+	nanosleep(&ts, NULL);
+	t = nclock() - t - ts.tv_nsec;
+	if (t > slack)
+	    slack = t;
+    }
+    /* leave some headroom */
+    slack += slack / 2 + 10000;
+
+    info("udelay: sleeping for waits longer than %lu usec", slack / 1000);
 }
 
 
@@ -112,3 +144,33 @@ void ndelay(const unsigned long nsec)
 	gettimeofday(&now, NULL);
     } while (now.tv_sec == end.tv_sec ? now.tv_usec < end.tv_usec : now.tv_sec < end.tv_sec);
 }
+
+
+unsigned long long nclock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+void ndelay_until(const unsigned long long deadline)
+{
+    unsigned long long now = nclock();
+
+    /* sleep as long as we surely wake up in time */
+    if (slack > 0 && now + slack < deadline) {
+	struct timespec ts;
+	unsigned long long nsec = deadline - now - slack;
+	ts.tv_sec = nsec / 1000000000ULL;
+	ts.tv_nsec = nsec % 1000000000ULL;
+	nanosleep(&ts, NULL);
+	now = nclock();
+    }
+
+    while (now < deadline) {
+	rep_nop();
+	now = nclock();
+    }
+}
@@ -44,6 +44,8 @@ static inline void rep_nop(void)
 void udelay_init(void);
 unsigned long timing(const char *driver, const char *section, const char *name, const int defval, const char *unit);
 void ndelay(const unsigned long nsec);
+unsigned long long nclock(void);
+void ndelay_until(const unsigned long long deadline);
 
 #define udelay(usec) ndelay(usec*1000)
 
@@ -41,6 +41,10 @@
 #include "debug.h"
 #include "cfg.h"
 #include "widget.h"
+#include "bench.h"
+#include "stats.h"
+#include "drv.h"
+#include "drv_generic.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -70,8 +74,9 @@ int widget_register(WIDGET_CLASS * widget)
 	return -1;
     }
 
+    /* every display registers its own classes */
     for (i = 0; i < nClasses; i++) {
-	if (strcasecmp(widget->name, Classes[i].name) == 0) {
+	if (strcasecmp(widget->name, Classes[i].name) == 0 && Classes[i].display == drv_current()) {
 	    error("internal error: widget '%s' already exists!", widget->name);
 	    return -1;
 	}
@@ -80,6 +85,9 @@ int widget_register(WIDGET_CLASS * widget)
     nClasses++;
     Classes = realloc(Classes, nClasses * sizeof(WIDGET_CLASS));
     Classes[nClasses - 1] = *widget;
+    Classes[nClasses - 1].stats_update = stats_register("update", widget->name);
+    Classes[nClasses - 1].stats_draw = stats_register("draw", widget->name);
+    Classes[nClasses - 1].display = drv_current();
 
     return 0;
 }
@@ -93,8 +101,10 @@ void widget_unregister(void)
 	    free(Widgets[i].name);
     }
     free(Widgets);
+    Widgets = NULL;
 
     free(Classes);
+    Classes = NULL;
 
     nWidgets = 0;
     nClasses = 0;
@@ -188,15 +198,15 @@ int widget_add(const char *name, const int type, const int layer, const int row,
 
     free(section);
 
-    /* lookup widget class */
+    /* lookup widget class, prefer the one of the current display */
     Class = NULL;
     for (i = 0; i < nClasses; i++) {
 	if (strcasecmp(class, Classes[i].name) == 0) {
-	    Class = &(Classes[i]);
-	    break;
+	    if (Class == NULL || Classes[i].display == drv_current())
+		Class = &(Classes[i]);
 	}
     }
-    if (i == nClasses) {
+    if (Class == NULL) {
 	error("widget '%s': class '%s' not supported", name, class);
 	if (class)
 	    free(class);
@@ -243,10 +253,10 @@ int widget_add(const char *name, const int type, const int layer, const int row,
 	return -1;
     }
 
-    /* look up parent widget (widget with the same name) */
+    /* look up parent widget (widget with the same name on the same display) */
     Parent = NULL;
     for (i = 0; i < nWidgets; i++) {
-	if (strcmp(name, Widgets[i].name) == 0) {
+	if (strcmp(name, Widgets[i].name) == 0 && Widgets[i].display == drv_current()) {
 	    Parent = &(Widgets[i]);
 	    break;
 	}
@@ -265,6 +275,7 @@ int widget_add(const char *name, const int type, const int layer, const int row,
     Widget->layer = layer;
     Widget->row = row;
     Widget->col = col;
+    Widget->display = drv_current();
 
     if (Class->init != NULL) {
 	Class->init(Widget);
@@ -278,7 +289,7 @@ int widget_add(const char *name, const int type, const int layer, const int row,
 
     /* sanity check: look for overlapping widgets */
     for (i = 0; i < nWidgets - 1; i++) {
-	if (Widgets[i].layer == layer) {
+	if (Widgets[i].layer == layer && Widgets[i].display == Widget->display) {
 	    if (intersect(&(Widgets[i]), Widget)) {
 		info("WARNING widget %s(%i,%i) intersects with %s(%i,%i) on layer %d",
 		     Widgets[i].name, Widgets[i].row, Widgets[i].col, name, row, col, layer);
@@ -297,7 +308,7 @@ WIDGET *widget_find(int type, void *needle)
 
     for (i = 0; i < nWidgets; i++) {
 	widget = &(Widgets[i]);
-	if (widget->class->type == type) {
+	if (widget->class->type == type && widget->display == drv_current()) {
 	    if (widget->class->find != NULL && widget->class->find(widget, needle) == 0)
 		break;
 	}
@@ -306,3 +317,57 @@ WIDGET *widget_find(int type, void *needle)
 
     return widget;
 }
+
+
+/* let the driver render a widget */
+int widget_draw(WIDGET * W)
+{
+    STATS_TIME t;
+    int ret, display;
+
+    if (W->class->draw == NULL)
+	return 0;
+
+    STATS_BENCH_BEGIN(t, BENCH_DRAW);
+    display = drv_select(W->display);
+    ret = W->class->draw(W);
+    drv_select(display);
+    STATS_BENCH_END(W->class->stats_draw, t, BENCH_DRAW);
+
+    return ret;
+}
+
+
+/* does (the upper left corner of) a widget lie on the display? */
+int widget_onscreen(WIDGET * W)
+{
+    int rows, cols, display, ret;
+
+    display = drv_select(W->display);
+
+    switch (DTYPE) {
+    case DISPLAY_TEXT:
+	rows = DROWS;
+	cols = DCOLS;
+	break;
+    case DISPLAY_GRAPHIC:
+	if (W->class->type == WIDGET_TYPE_XY) {
+	    rows = DROWS;
+	    cols = DCOLS;
+	} else {
+	    /* row/col are chars, display size is pixels */
+	    rows = (DROWS + YRES - 1) / YRES;
+	    cols = (DCOLS + XRES - 1) / XRES;
+	}
+	break;
+    default:
+	/* no idea, assume it is */
+	rows = W->row + 1;
+	cols = W->col + 1;
+    }
+    ret = W->row < rows && W->col < cols;
+
+    drv_select(display);
+
+    return ret;
+}
@@ -41,6 +41,9 @@ typedef struct WIDGET_CLASS {
     int (*draw) (struct WIDGET * Self);
     int (*find) (struct WIDGET * Self, void *needle);
     int (*quit) (struct WIDGET * Self);
+    int stats_update;		/* statistics slots, see stats.h */
+    int stats_draw;
+    int display;		/* display which registered the class */
 } WIDGET_CLASS;
 
 
@@ -58,6 +61,7 @@ typedef struct WIDGET {
     void *data;
     int x2;			/* x of opposite corner, -1 for no display widget */
     int y2;			/* y of opposite corner, -1 for no display widget */
+    int display;		/* display the widget is placed on */
 } WIDGET;
 
 
@@ -73,6 +77,8 @@ void widget_unregister(void);
 int intersect(WIDGET * w1, WIDGET * w2);
 int widget_add(const char *name, const int type, const int layer, const int row, const int col);
 WIDGET *widget_find(int type, void *needle);
+int widget_draw(WIDGET * W);
+int widget_onscreen(WIDGET * W);
 int widget_color(const char *section, const char *name, const char *key, RGBA * C);
 
 #undef MIN
@@ -44,6 +44,7 @@
 #include "timer_group.h"
 #include "widget.h"
 #include "widget_bar.h"
+#include "stats.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -54,6 +55,13 @@ void widget_bar_update(void *Self)
 {
     WIDGET *W = (WIDGET *) Self;
     WIDGET_BAR *Bar = W->data;
+    STATS_TIME t;
+
+    /* nothing to evaluate outside of the display */
+    if (!widget_onscreen(W))
+	return;
+
+    STATS_BEGIN(t);
 
     double val1, val2;
     double min, max;
@@ -114,9 +122,9 @@ void widget_bar_update(void *Self)
     }
 
     /* finally, draw it! */
-    if (W->class->draw)
-	W->class->draw(W);
+    widget_draw(W);
 
+    STATS_END(W->class->stats_update, t);
 }
 
 
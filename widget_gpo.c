@@ -44,6 +44,7 @@
 #include "timer_group.h"
 #include "widget.h"
 #include "widget_gpo.h"
+#include "stats.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -54,20 +55,23 @@ void widget_gpo_update(void *Self)
 {
     WIDGET *W = (WIDGET *) Self;
     WIDGET_GPO *GPO = W->data;
+    STATS_TIME t;
+
+    STATS_BEGIN(t);
 
     /* evaluate properties */
     property_eval(&GPO->expression);
     property_eval(&GPO->update);
 
     /* finally, draw it! */
-    if (W->class->draw)
-	W->class->draw(W);
+    widget_draw(W);
 
     /* add a new one-shot timer */
     if (P2N(&GPO->update) > 0) {
 	timer_add_widget(widget_gpo_update, Self, P2N(&GPO->update), 1);
     }
 
+    STATS_END(W->class->stats_update, t);
 }
 
 
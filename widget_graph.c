@@ -0,0 +1,254 @@
+/* $Id$
+ * $URL$
+ *
+ * graph (sparkline) widget handling
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+/*
+ * exported functions:
+ *
+ * WIDGET_CLASS Widget_Graph
+ *   the graph widget: plots its expression over time, one sample
+ *   per pixel column (graphic displays) or per character (text
+ *   displays). Drivers scroll the pixels already drawn and render
+ *   the new columns only, see Graph->drawn.
+ *
+ * double widget_graph_value (WIDGET_GRAPH *Graph, int age)
+ *   returns a sample 'age' steps back (0 = newest), scaled to
+ *   0.0 ... 1.0, or NAN if there is none
+ *
+ */
+
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "debug.h"
+#include "cfg.h"
+#include "property.h"
+#include "timer_group.h"
+#include "drv_generic.h"
+#include "history.h"
+#include "widget.h"
+#include "widget_graph.h"
+#include "stats.h"
+
+#ifdef WITH_DMALLOC
+#include <dmalloc.h>
+#endif
+
+
+double widget_graph_value(WIDGET_GRAPH * Graph, const int age)
+{
+    double val;
+
+    if (age < 0 || age >= Graph->size || (unsigned long) age >= Graph->samples)
+	return NAN;
+
+    val = Graph->values[(Graph->head - age + Graph->size) % Graph->size];
+    if (isnan(val) || Graph->max <= Graph->min)
+	return val;
+
+    val = (val - Graph->min) / (Graph->max - Graph->min);
+    if (val < 0.0)
+	val = 0.0;
+    if (val > 1.0)
+	val = 1.0;
+
+    return val;
+}
+
+
+static void widget_graph_add(WIDGET_GRAPH * Graph, const double val)
+{
+    double min, max;
+
+    Graph->head = (Graph->head + 1) % Graph->size;
+    Graph->values[Graph->head] = val;
+    Graph->samples++;
+
+    /* minimum: if expression is empty, do auto-scaling */
+    if (property_valid(&Graph->expr_min)) {
+	property_eval(&Graph->expr_min);
+	min = P2N(&Graph->expr_min);
+    } else {
+	min = Graph->min;
+	if (val < min)
+	    min = val;
+    }
+
+    /* maximum: if expression is empty, do auto-scaling */
+    if (property_valid(&Graph->expr_max)) {
+	property_eval(&Graph->expr_max);
+	max = P2N(&Graph->expr_max);
+    } else {
+	max = Graph->max;
+	if (val > max)
+	    max = val;
+    }
+
+    /* all columns have to be rendered again */
+    if (Graph->min != min || Graph->max != max) {
+	Graph->min = min;
+	Graph->max = max;
+	Graph->rescaled = 1;
+    }
+}
+
+
+void widget_graph_update(void *Self)
+{
+    WIDGET *W = (WIDGET *) Self;
+    WIDGET_GRAPH *Graph = W->data;
+    STATS_TIME t;
+
+    /* nothing to evaluate outside of the display */
+    if (!widget_onscreen(W))
+	return;
+
+    STATS_BEGIN(t);
+
+    property_eval(&Graph->expression);
+    widget_graph_add(Graph, P2N(&Graph->expression));
+
+    /* draw the new sample */
+    widget_draw(W);
+
+    STATS_END(W->class->stats_update, t);
+}
+
+
+/* start with the recent past of a history, one sample per update */
+/* interval, so the prefill scrolls at the speed of the live samples */
+static void widget_graph_history(WIDGET_GRAPH * Graph, const char *name)
+{
+    HISTORY *H;
+    double *values;
+    int i, n;
+
+    if ((H = history_open(name)) == NULL)
+	return;
+
+    values = malloc(Graph->size * sizeof(double));
+    n = history_resample(H, HISTORY_AVG, Graph->update, Graph->size, values);
+
+    /* gaps stay empty columns */
+    if (n > 0) {
+	for (i = 0; i < Graph->size; i++)
+	    widget_graph_add(Graph, values[i]);
+    }
+
+    free(values);
+}
+
+
+int widget_graph_init(WIDGET * Self)
+{
+    char *section;
+    char *c;
+    WIDGET_GRAPH *Graph;
+    int i;
+
+    /* prepare config section */
+    /* strlen("Widget:")=7 */
+    section = malloc(strlen(Self->name) + 8);
+    strcpy(section, "Widget:");
+    strcat(section, Self->name);
+
+    Graph = malloc(sizeof(WIDGET_GRAPH));
+    memset(Graph, 0, sizeof(WIDGET_GRAPH));
+
+    /* load properties */
+    property_load(section, "expression", NULL, &Graph->expression);
+    property_load(section, "min", NULL, &Graph->expr_min);
+    property_load(section, "max", NULL, &Graph->expr_max);
+
+    /* sanity checks */
+    if (!property_valid(&Graph->expression)) {
+	error("Warning: widget %s has no expression", section);
+    }
+
+    /* size in characters, default 10x1 */
+    cfg_number(section, "width", 10, 1, -1, &(Graph->width));
+    cfg_number(section, "height", 1, 1, -1, &(Graph->height));
+    Self->x2 = Self->col + Graph->width - 1;
+    Self->y2 = Self->row + Graph->height - 1;
+
+    /* update interval (msec), default 1 sec */
+    cfg_number(section, "update", 1000, 10, -1, &(Graph->update));
+
+    /* one sample per pixel column */
+    Graph->size = Graph->width * (XRES > 0 ? XRES : 1);
+    Graph->values = malloc(Graph->size * sizeof(double));
+    for (i = 0; i < Graph->size; i++)
+	Graph->values[i] = NAN;
+    Graph->head = Graph->size - 1;
+    Graph->rescaled = 1;
+
+    /* get widget special color */
+    Graph->color_valid = widget_color(section, Self->name, "graphcolor", &Graph->color);
+
+    /* optionally start with a recorded history */
+    c = cfg_get(section, "history", "");
+    if (*c != '\0')
+	widget_graph_history(Graph, c);
+    free(c);
+
+    free(section);
+    Self->data = Graph;
+
+    timer_add_widget(widget_graph_update, Self, Graph->update, 0);
+
+    return 0;
+}
+
+
+int widget_graph_quit(WIDGET * Self)
+{
+    if (Self) {
+	if (Self->data) {
+	    WIDGET_GRAPH *Graph = Self->data;
+	    property_free(&Graph->expression);
+	    property_free(&Graph->expr_min);
+	    property_free(&Graph->expr_max);
+	    free(Graph->values);
+	    free(Self->data);
+	}
+	Self->data = NULL;
+    }
+
+    return 0;
+}
+
+
+
+WIDGET_CLASS Widget_Graph = {
+    .name = "graph",
+    .type = WIDGET_TYPE_RC,
+    .init = widget_graph_init,
+    .draw = NULL,
+    .quit = widget_graph_quit,
+};
@@ -0,0 +1,59 @@
+/* $Id$
+ * $URL$
+ *
+ * graph (sparkline) widget handling
+ *
+ * Copyright (C) 2026 The LCD4Linux Team <lcd4linux-devel@users.sourceforge.net>
+ *
+ * This file is part of LCD4Linux.
+ *
+ * LCD4Linux is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * LCD4Linux is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+
+#ifndef _WIDGET_GRAPH_H_
+#define _WIDGET_GRAPH_H_
+
+#include "property.h"
+#include "widget.h"
+#include "rgb.h"
+
+typedef struct WIDGET_GRAPH {
+    PROPERTY expression;	/* sampled value */
+    PROPERTY expr_min;		/* explicit minimum value */
+    PROPERTY expr_max;		/* explicit maximum value */
+    int width;			/* width in characters */
+    int height;			/* height in characters */
+    int update;			/* sample interval (msec) */
+    int size;			/* ring size, one sample per pixel column */
+    double *values;		/* ring of samples, NAN for none */
+    int head;			/* index of the newest sample */
+    unsigned long samples;	/* samples taken so far */
+    unsigned long drawn;	/* samples already rendered by the driver */
+    int rescaled;		/* scale changed, render everything */
+    double min;			/* minimum value */
+    double max;			/* maximum value */
+    RGBA color;			/* graph color */
+    int color_valid;		/* graph color is valid */
+} WIDGET_GRAPH;
+
+
+/* sample 'age' steps back (0 = newest), scaled to 0.0 ... 1.0, or NAN */
+double widget_graph_value(WIDGET_GRAPH * Graph, const int age);
+
+extern WIDGET_CLASS Widget_Graph;
+
+#endif
@@ -42,9 +42,10 @@
 #include "cfg.h"
 #include "qprintf.h"
 #include "property.h"
-#include "timer_group.h"
+#include "animation.h"
 #include "widget.h"
 #include "widget_icon.h"
+#include "stats.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -94,6 +95,14 @@ void widget_icon_update(void *Self)
 {
     WIDGET *W = (WIDGET *) Self;
     WIDGET_ICON *Icon = W->data;
+    STATS_TIME t;
+    int speed;
+
+    /* nothing to animate outside of the display */
+    if (!widget_onscreen(W))
+	return;
+
+    STATS_BEGIN(t);
 
     /* process the parent only */
     if (W->parent == NULL) {
@@ -113,16 +122,28 @@ void widget_icon_update(void *Self)
 	    if (Icon->curmap >= Icon->maxmap)
 		Icon->curmap = 0;
 	}
+
+	/* an invisible icon is cleared once, and not drawn again */
+	/* until it becomes visible (the children follow the parent) */
+	if (P2N(&Icon->visible))
+	    Icon->paused = 0;
+	else if (Icon->paused < 2)
+	    Icon->paused++;
     }
 
     /* finally, draw it! */
-    if (W->class->draw)
-	W->class->draw(W);
+    if (Icon->paused < 2)
+	widget_draw(W);
 
-    /* add a new one-shot timer */
-    if (P2N(&Icon->speed) > 0) {
-	timer_add_widget(widget_icon_update, Self, P2N(&Icon->speed), 1);
+    /* the speed may change on every call */
+    speed = P2N(&Icon->speed);
+    if (speed > 0) {
+	animation_add(widget_icon_update, Self, speed);
+    } else {
+	animation_remove(widget_icon_update, Self);
     }
+
+    STATS_END(W->class->stats_update, t);
 }
 
 
@@ -157,8 +178,8 @@ int widget_icon_init(WIDGET * Self)
 	Self->x2 = Self->col + 1;
 	Self->y2 = Self->row + 1;
 
-	/* as the speed is evaluatod on every call, we use 'one-shot'-timers.  */
-	/* The timer will be reactivated on every call to widget_icon_update().  */
+	/* the speed is evaluated on every call to widget_icon_update(), */
+	/* which (re-)schedules the icon on the animation clock. */
 	/* We do the initial call here... */
 	Icon->prvmap = -1;
 
@@ -182,6 +203,7 @@ int widget_icon_init(WIDGET * Self)
 int widget_icon_quit(WIDGET * Self)
 {
     if (Self) {
+	animation_remove(widget_icon_update, Self);
 	/* do not deallocate child widget! */
 	if (Self->parent == NULL) {
 	    if (Self->data) {
@@ -39,6 +39,7 @@ typedef struct WIDGET_ICON {
     int curmap;			/* current bitmap sequence */
     int prvmap;			/* previous bitmap sequence  */
     int maxmap;			/* number of bitmap sequences */
+    int paused;			/* 0: visible, 1: just hidden, 2: hidden and drawn */
     unsigned char *bitmap;	/* bitmaps of (animated) icon */
 } WIDGET_ICON;
 
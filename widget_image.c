@@ -63,6 +63,7 @@
 #include "widget.h"
 #include "widget_image.h"
 #include "rgb.h"
+#include "stats.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -173,6 +174,9 @@ static void widget_image_update(void *Self)
 {
     WIDGET *W = (WIDGET *) Self;
     WIDGET_IMAGE *Image = W->data;
+    STATS_TIME t;
+
+    STATS_BEGIN(t);
 
     /* process the parent only */
     if (W->parent == NULL) {
@@ -190,13 +194,14 @@ static void widget_image_update(void *Self)
     }
 
     /* finally, draw it! */
-    if (W->class->draw)
-	W->class->draw(W);
+    widget_draw(W);
 
     /* add a new one-shot timer */
     if (P2N(&Image->update) > 0) {
 	timer_add_widget(widget_image_update, Self, P2N(&Image->update), 1);
     }
+
+    STATS_END(W->class->stats_update, t);
 }
 
 
@@ -46,9 +46,11 @@
 #include "property.h"
 #include "timer.h"
 #include "timer_group.h"
+#include "animation.h"
 #include "event.h"
 #include "widget.h"
 #include "widget_text.h"
+#include "stats.h"
 
 #ifdef WITH_DMALLOC
 #include <dmalloc.h>
@@ -62,6 +64,11 @@ void widget_text_scroll(void *Self)
 	error("Warning: internal data error in Textwidget");
 	return;
     }
+
+    /* nothing to render outside of the display */
+    if (!widget_onscreen(W))
+	return;
+
     WIDGET_TEXT *T = W->data;
 
     char *prefix = P2S(&T->prefix);
@@ -213,8 +220,7 @@ void widget_text_scroll(void *Self)
     *dst = '\0';
 
     /* finally, draw it! */
-    if (W->class->draw)
-	W->class->draw(W);
+    widget_draw(W);
 }
 
 
@@ -225,6 +231,13 @@ void widget_text_update(void *Self)
     WIDGET_TEXT *T = W->data;
     char *string;
     int update = 0;
+    STATS_TIME t;
+
+    /* nothing to evaluate outside of the display */
+    if (!widget_onscreen(W))
+	return;
+
+    STATS_BEGIN(t);
 
     /* evaluate properties */
     update += property_eval(&T->prefix);
@@ -296,6 +309,7 @@ void widget_text_update(void *Self)
 	}
     }
 
+    STATS_END(W->class->stats_update, t);
 }
 
 
@@ -409,10 +423,10 @@ int widget_text_init(WIDGET * Self)
     /* add update timer, use one-shot if 'update' is zero */
     timer_add_widget(widget_text_update, Self, Text->update, Text->update == 0);
 
-    /* a marquee scroller has its own timer and callback */
+    /* a marquee scroller is advanced by the animation clock */
     if (Text->align == ALIGN_MARQUEE || Text->align == ALIGN_AUTOMATIC || Text->align == ALIGN_PINGPONG_LEFT
 	|| Text->align == ALIGN_PINGPONG_CENTER || Text->align == ALIGN_PINGPONG_RIGHT) {
-	timer_add(widget_text_scroll, Self, Text->speed, 0);
+	animation_add(widget_text_scroll, Self, Text->speed);
     }
 
     return 0;
@@ -423,6 +437,7 @@ int widget_text_quit(WIDGET * Self)
 {
     WIDGET_TEXT *Text;
     if (Self) {
+	animation_remove(widget_text_scroll, Self);
 	Text = Self->data;
 	if (Self->data) {
 	    property_free(&Text->prefix);